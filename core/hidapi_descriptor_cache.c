@@ -0,0 +1,177 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* The file of hid_set_report_descriptor_cache(), for the POSIX backends
+   which implement the cache. Included by those backends only. Each of
+   them keeps the cache its own way, and defines
+   report_descriptor_cache_add_record() for the loading and
+   report_descriptor_cache_next_record() for the saving.
+
+   The file is a magic of 8 bytes followed by a record for each
+   descriptor: its header of 7 little-endian 16-bit words (bus type,
+   VID, PID, release number, interface number, the length the descriptor
+   is looked up by, the length of the descriptor), then the descriptor. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hidapi.h"
+
+#define HIDAPI_REPORT_DESCRIPTOR_CACHE_MAGIC "HIDRDC01"
+
+/* A record of the file */
+struct report_descriptor_cache_record {
+	unsigned short bus_type;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	unsigned short release_number;
+	int interface_number;
+	unsigned short expected_size;
+	const unsigned char *descriptor;
+	size_t size;
+};
+
+/* Called for each record read by report_descriptor_cache_load() */
+static void report_descriptor_cache_add_record(const struct report_descriptor_cache_record *record);
+/* Fills in the record of *iter, the first entry to save, and moves
+   *iter to the next one. Returns 0 once there are no entries left. */
+static int report_descriptor_cache_next_record(void **iter, struct report_descriptor_cache_record *record);
+
+static unsigned short get_le16(const unsigned char *p)
+{
+	return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static void put_le16(unsigned char *p, unsigned short value)
+{
+	p[0] = (unsigned char)(value & 0xFF);
+	p[1] = (unsigned char)(value >> 8);
+}
+
+/* Loads the file of hid_set_report_descriptor_cache() into the cache,
+   with the lock of the cache held. A file which does not exist (yet)
+   is empty. Returns 0 on success and -1 on error. */
+static int report_descriptor_cache_load(const char *path)
+{
+	unsigned char header[14];
+	unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	FILE *file = fopen(path, "rb");
+
+	if (!file)
+		return errno == ENOENT? 0: -1;
+	fcntl(fileno(file), F_SETFD, FD_CLOEXEC);
+
+	if (fread(header, 1, 8, file) != 8 || memcmp(header, HIDAPI_REPORT_DESCRIPTOR_CACHE_MAGIC, 8) != 0) {
+		fclose(file);
+		return -1;
+	}
+
+	while (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+		struct report_descriptor_cache_record record;
+
+		record.size = get_le16(&header[12]);
+		if (record.size > sizeof(descriptor) || fread(descriptor, 1, record.size, file) != record.size)
+			break;
+
+		record.bus_type = get_le16(&header[0]);
+		record.vendor_id = get_le16(&header[2]);
+		record.product_id = get_le16(&header[4]);
+		record.release_number = get_le16(&header[6]);
+		record.interface_number = (short) get_le16(&header[8]);
+		record.expected_size = get_le16(&header[10]);
+		record.descriptor = descriptor;
+		report_descriptor_cache_add_record(&record);
+	}
+
+	fclose(file);
+	return 0;
+}
+
+/* Writes the cached descriptors, starting from first (see
+   report_descriptor_cache_next_record()), to the file of
+   hid_set_report_descriptor_cache(), with the lock of the cache held.
+   They are written to a temporary file of a unique name next to it,
+   which is synced and then renamed over the file, so a reader never
+   sees a partial file, not even after a crash.
+   Returns 0 on success and -1 on error. */
+static int report_descriptor_cache_save(const char *path, void *first)
+{
+	struct report_descriptor_cache_record record;
+	void *iter = first;
+	size_t tmp_path_len = strlen(path) + sizeof(".XXXXXX");
+	char *tmp_path = (char*) malloc(tmp_path_len);
+	FILE *file;
+	int fd;
+	int res = 0;
+
+	if (!tmp_path)
+		return -1;
+	snprintf(tmp_path, tmp_path_len, "%s.XXXXXX", path);
+
+	fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		free(tmp_path);
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	file = fdopen(fd, "wb");
+	if (!file) {
+		close(fd);
+		remove(tmp_path);
+		free(tmp_path);
+		return -1;
+	}
+
+	if (fwrite(HIDAPI_REPORT_DESCRIPTOR_CACHE_MAGIC, 1, 8, file) != 8)
+		res = -1;
+
+	while (res == 0 && report_descriptor_cache_next_record(&iter, &record)) {
+		unsigned char header[14];
+
+		put_le16(&header[0], record.bus_type);
+		put_le16(&header[2], record.vendor_id);
+		put_le16(&header[4], record.product_id);
+		put_le16(&header[6], record.release_number);
+		put_le16(&header[8], (unsigned short) record.interface_number);
+		put_le16(&header[10], record.expected_size);
+		put_le16(&header[12], (unsigned short) record.size);
+		if (fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+		    fwrite(record.descriptor, 1, record.size, file) != record.size)
+			res = -1;
+	}
+
+	/* The data has to be on the disk before the rename is */
+	if (fflush(file) != 0 || fsync(fd) != 0)
+		res = -1;
+	if (fclose(file) != 0)
+		res = -1;
+
+	if (res == 0 && rename(tmp_path, path) != 0)
+		res = -1;
+	if (res != 0)
+		remove(tmp_path);
+
+	free(tmp_path);
+	return res;
+}
@@ -0,0 +1,95 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* Reads a report descriptor out of a textual dump, for the tools and tests
+   which take the _real.rpt_desc files of windows/test/data. Not part of
+   the library: like hidapi_report_layout.c, it is included where needed. */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int descriptor_text_is_hex_byte(const char *token)
+{
+	return strlen(token) == 2 && isxdigit((unsigned char)token[0]) && isxdigit((unsigned char)token[1]);
+}
+
+static char *descriptor_text_skip_prefix(char *line)
+{
+	while (*line == '#' || *line == ' ' || *line == '\t')
+		line++;
+	return line;
+}
+
+/* The dumps come from several tools. Either every line holding descriptor
+   bytes starts with "0x" (C arrays, hidrd-convert), or the bytes are the
+   trailing hex tokens of each line (USB Prober, mac-hid-dump and the
+   "Usage Page (...) 05 0C" item listings).
+   Returns 0 on success and -1 if the file can't be read, with errno set. */
+static int descriptor_text_read_file(const char *filename, unsigned char *descriptor, size_t max_length, size_t *length)
+{
+	FILE *file;
+	char line[1024];
+	int c_array = 0;
+
+	*length = 0;
+
+	file = fopen(filename, "r");
+	if (!file)
+		return -1;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(descriptor_text_skip_prefix(line), "0x", 2) == 0)
+			c_array = 1;
+	}
+	rewind(file);
+
+	while (fgets(line, sizeof(line), file)) {
+		char *p = descriptor_text_skip_prefix(line);
+
+		if (c_array) {
+			char *comment;
+			if (strncmp(p, "0x", 2) != 0)
+				continue;
+			comment = strstr(p, "//");
+			if (comment)
+				*comment = '\0';
+			while ((p = strstr(p, "0x")) != NULL && *length < max_length)
+				descriptor[(*length)++] = (unsigned char) strtoul(p, &p, 16);
+		}
+		else {
+			char *tokens[256];
+			size_t num_tokens = 0, first, i;
+			char *token = strtok(p, " \t\r\n");
+			while (token && num_tokens < sizeof(tokens) / sizeof(tokens[0])) {
+				tokens[num_tokens++] = token;
+				token = strtok(NULL, " \t\r\n");
+			}
+			first = num_tokens;
+			while (first > 0 && descriptor_text_is_hex_byte(tokens[first - 1]))
+				first--;
+			for (i = first; i < num_tokens && *length < max_length; i++)
+				descriptor[(*length)++] = (unsigned char) strtoul(tokens[i], NULL, 16);
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,70 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* Copies of struct hid_device_info records, for the backends which keep
+   the records of the connected devices around (the enumeration cache and
+   the hotplug notifications). Included by those backends only, as the
+   others would have unused functions, after hidapi_enumerate_filter.c.
+   Needs strdup() and wcsdup(). */
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "hidapi.h"
+
+/* Returns a copy of a single record, with next set to NULL,
+   or NULL if an allocation failed. Free it with hid_free_enumeration(). */
+static struct hid_device_info *copy_device_info(const struct hid_device_info *info)
+{
+	struct hid_device_info *copy = (struct hid_device_info*) malloc(sizeof(struct hid_device_info));
+	if (!copy)
+		return NULL;
+
+	*copy = *info;
+	copy->next = NULL;
+	copy->path = info->path? strdup(info->path): NULL;
+	copy->serial_number = info->serial_number? wcsdup(info->serial_number): NULL;
+	copy->manufacturer_string = info->manufacturer_string? wcsdup(info->manufacturer_string): NULL;
+	copy->product_string = info->product_string? wcsdup(info->product_string): NULL;
+
+	if ((info->path && !copy->path) ||
+	    (info->serial_number && !copy->serial_number) ||
+	    (info->manufacturer_string && !copy->manufacturer_string) ||
+	    (info->product_string && !copy->product_string)) {
+		hid_free_enumeration(copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
+/* Whether a record matches the whole filter of hid_enumerate_ex() */
+static int enumerate_filter_match(const struct hid_enumerate_filter *filter, const struct hid_device_info *info)
+{
+	if (!filter)
+		return 1;
+
+	return (filter->vendor_id == 0x0 || filter->vendor_id == info->vendor_id) &&
+	       (filter->product_id == 0x0 || filter->product_id == info->product_id) &&
+	       (!(filter->match & HID_API_FILTER_BUS_TYPE) || filter->bus_type == info->bus_type) &&
+	       (!(filter->match & HID_API_FILTER_INTERFACE_NUMBER) || filter->interface_number == info->interface_number) &&
+	       enumerate_filter_match_usage(filter, info->usage_page, info->usage) &&
+	       enumerate_filter_match_serial_number(filter, info->serial_number);
+}
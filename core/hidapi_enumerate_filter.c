@@ -0,0 +1,61 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* The filter of hid_enumerate_ex(), included by each backend.
+   A NULL filter (used internally) matches every device, and asks
+   for all of the strings. The backends check the vendor and
+   product IDs, the bus type and the interface number themselves,
+   wherever they are cheapest to get. */
+
+#include <wchar.h>
+
+#include "hidapi.h"
+
+static int enumerate_filter_fields(const struct hid_enumerate_filter *filter)
+{
+	if (!filter)
+		return HID_API_DEVICE_INFO_ALL_STRINGS;
+
+	/* The serial number has to be read to be checked */
+	if (filter->serial_number_prefix)
+		return filter->fields | HID_API_DEVICE_INFO_SERIAL_NUMBER;
+
+	return filter->fields;
+}
+
+static int enumerate_filter_match_usage(const struct hid_enumerate_filter *filter, unsigned short usage_page, unsigned short usage)
+{
+	if (!filter)
+		return 1;
+
+	if ((filter->match & HID_API_FILTER_USAGE_PAGE) && filter->usage_page != usage_page)
+		return 0;
+	if ((filter->match & HID_API_FILTER_USAGE) && filter->usage != usage)
+		return 0;
+
+	return 1;
+}
+
+static int enumerate_filter_match_serial_number(const struct hid_enumerate_filter *filter, const wchar_t *serial_number)
+{
+	if (!filter || !filter->serial_number_prefix)
+		return 1;
+
+	return wcsncmp(serial_number? serial_number: L"", filter->serial_number_prefix, wcslen(filter->serial_number_prefix)) == 0;
+}
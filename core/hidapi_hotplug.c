@@ -0,0 +1,116 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* The callbacks of hid_hotplug_register_callback(), for the backends
+   which run them on a hotplug thread of their own. Included by those
+   backends only, which keep the list of callbacks and the records of the
+   connected devices, and define hotplug_lock() and hotplug_unlock() for
+   the mutex protecting them. */
+
+#include <stdlib.h>
+
+#include "hidapi.h"
+
+/* A callback registered with hid_hotplug_register_callback() */
+struct hid_hotplug_callback {
+	hid_hotplug_callback_handle handle;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	int events; /* 0 once deregistered, the hotplug thread frees it then */
+	int enumerate; /* the connected devices are yet to be reported */
+	hid_hotplug_callback_fn callback;
+	void *user_data;
+	struct hid_hotplug_callback *next;
+};
+
+static void hotplug_lock(void);
+static void hotplug_unlock(void);
+
+static int hotplug_match(const struct hid_hotplug_callback *hotplug_cb, const struct hid_device_info *info)
+{
+	return (hotplug_cb->vendor_id == 0x0 || hotplug_cb->vendor_id == info->vendor_id) &&
+	       (hotplug_cb->product_id == 0x0 || hotplug_cb->product_id == info->product_id);
+}
+
+/* The hotplug_* functions below are called on the hotplug thread with
+   the hotplug mutex locked. They unlock it while a callback is running,
+   so the callback can register or deregister callbacks. Only the hotplug
+   thread removes callbacks from the list, so the list can be walked
+   across the calls. */
+
+static void hotplug_call(struct hid_hotplug_callback *hotplug_cb, struct hid_device_info *info, hid_hotplug_event event)
+{
+	int res;
+
+	hotplug_unlock();
+	res = hotplug_cb->callback(hotplug_cb->handle, info, event, hotplug_cb->user_data);
+	hotplug_lock();
+
+	if (res)
+		hotplug_cb->events = 0;
+}
+
+static void hotplug_dispatch(struct hid_hotplug_callback *callbacks, struct hid_device_info *info, hid_hotplug_event event)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+
+	for (hotplug_cb = callbacks; hotplug_cb; hotplug_cb = hotplug_cb->next) {
+		/* A callback which is yet to get the connected devices gets
+		   this one with them, see hotplug_enumerate() */
+		if ((hotplug_cb->events & event) && !hotplug_cb->enumerate && hotplug_match(hotplug_cb, info))
+			hotplug_call(hotplug_cb, info, event);
+	}
+}
+
+/* Reports the connected devices to the callbacks registered
+   with HID_API_HOTPLUG_ENUMERATE since the last call */
+static void hotplug_enumerate(struct hid_hotplug_callback *callbacks, struct hid_device_info *devices)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+	struct hid_device_info *info;
+
+	for (hotplug_cb = callbacks; hotplug_cb; hotplug_cb = hotplug_cb->next) {
+		if (!hotplug_cb->enumerate)
+			continue;
+
+		hotplug_cb->enumerate = 0;
+		for (info = devices; info; info = info->next) {
+			if (!(hotplug_cb->events & HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED))
+				break;
+			if (hotplug_match(hotplug_cb, info))
+				hotplug_call(hotplug_cb, info, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED);
+		}
+	}
+}
+
+static void hotplug_remove_deregistered(struct hid_hotplug_callback **callbacks)
+{
+	struct hid_hotplug_callback **hotplug_cb_ptr = callbacks;
+
+	while (*hotplug_cb_ptr) {
+		struct hid_hotplug_callback *hotplug_cb = *hotplug_cb_ptr;
+		if (hotplug_cb->events == 0) {
+			*hotplug_cb_ptr = hotplug_cb->next;
+			free(hotplug_cb);
+		}
+		else {
+			hotplug_cb_ptr = &hotplug_cb->next;
+		}
+	}
+}
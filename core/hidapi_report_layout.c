@@ -0,0 +1,1037 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* Compiles a HID report descriptor into a struct hid_report_layout,
+   and decodes reports with it.
+
+   This file is not a translation unit of its own: each backend includes it,
+   so every backend still builds from a single source file. The parser is
+   made of static functions, which return errors as static strings for each
+   backend to register the way it does. The decoding functions need nothing
+   from the backends, and are defined here for all of them.
+
+   The backends which find the top-level usage pairs themselves define
+   REPORT_LAYOUT_WITH_SCAN before including it, for report_layout_scan():
+   the others would have it as an unused function. */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "hidapi.h"
+
+/* Define HIDAPI_NO_SIMD to decode reports with portable code only */
+#if !defined(HIDAPI_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define REPORT_LAYOUT_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__) || defined(__AVX__)
+#define REPORT_LAYOUT_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif
+
+#define REPORT_LAYOUT_MAX_PUSH 16
+#define REPORT_LAYOUT_NUM_TYPES 3
+
+/* HID Report Items (USB HID Specification, section 6.2.2) */
+#define REPORT_LAYOUT_TYPE_MAIN   0
+#define REPORT_LAYOUT_TYPE_GLOBAL 1
+#define REPORT_LAYOUT_TYPE_LOCAL  2
+/* Not a type of short items: a Long item */
+#define REPORT_LAYOUT_TYPE_LONG   4
+
+#define REPORT_LAYOUT_MAIN_INPUT              0x8
+#define REPORT_LAYOUT_MAIN_OUTPUT             0x9
+#define REPORT_LAYOUT_MAIN_COLLECTION         0xA
+#define REPORT_LAYOUT_MAIN_FEATURE            0xB
+#define REPORT_LAYOUT_MAIN_END_COLLECTION     0xC
+
+#define REPORT_LAYOUT_GLOBAL_USAGE_PAGE       0x0
+#define REPORT_LAYOUT_GLOBAL_LOGICAL_MINIMUM  0x1
+#define REPORT_LAYOUT_GLOBAL_LOGICAL_MAXIMUM  0x2
+#define REPORT_LAYOUT_GLOBAL_REPORT_SIZE      0x7
+#define REPORT_LAYOUT_GLOBAL_REPORT_ID        0x8
+#define REPORT_LAYOUT_GLOBAL_REPORT_COUNT     0x9
+#define REPORT_LAYOUT_GLOBAL_PUSH             0xA
+#define REPORT_LAYOUT_GLOBAL_POP              0xB
+
+#define REPORT_LAYOUT_LOCAL_USAGE             0x0
+#define REPORT_LAYOUT_LOCAL_USAGE_MINIMUM     0x1
+#define REPORT_LAYOUT_LOCAL_USAGE_MAXIMUM     0x2
+
+#define REPORT_LAYOUT_FIELD_FLAGS_MASK        0x1FF
+
+/* The Global items that the layout depends on */
+struct report_layout_globals {
+	unsigned short usage_page;
+	unsigned int logical_minimum;
+	unsigned int logical_minimum_size;
+	unsigned int logical_maximum;
+	unsigned int logical_maximum_size;
+	unsigned int report_size;
+	unsigned int report_count;
+	unsigned char report_id;
+};
+
+/* Usages are kept with their Usage Page in the high 16 bits
+   when they were declared as extended (4-byte) usages, and
+   with a page of 0 otherwise, to take the Usage Page in
+   effect at the Main item. */
+struct report_layout_usage {
+	unsigned int usage;
+	int extended;
+};
+
+struct report_layout_locals {
+	struct report_layout_usage *usages;
+	size_t num_usages;
+	size_t usages_capacity;
+	struct report_layout_usage usage_minimum;
+	struct report_layout_usage usage_maximum;
+	int has_usage_minimum;
+	int has_usage_maximum;
+};
+
+/* An item of a report descriptor (USB HID Specification, section 6.2.2) */
+struct report_layout_item {
+	unsigned int type;
+	unsigned int tag;
+	/* The size of the data in bytes */
+	unsigned int size;
+	/* The data, unless type is REPORT_LAYOUT_TYPE_LONG */
+	unsigned int value;
+};
+
+/* A top-level usage pair of a report descriptor */
+struct report_layout_usage_pair {
+	unsigned short usage_page;
+	unsigned short usage;
+};
+
+/* What the backends need to know of a report descriptor,
+   see report_layout_scan() */
+struct report_layout_summary {
+	/* The usage pairs of the top-level collections,
+	   to be freed with free() */
+	struct report_layout_usage_pair *usage_pairs;
+	size_t num_usage_pairs;
+	/* Non-zero if the descriptor declares Report IDs */
+	int numbered_reports;
+	/* The size in bytes of the largest report of each type
+	   (indexed by hid_api_report_type), with its Report ID byte */
+	size_t max_report_size[REPORT_LAYOUT_NUM_TYPES];
+	/* Non-zero if the descriptor was not entirely valid */
+	int malformed;
+};
+
+struct report_layout_parser {
+	/* Set by report_layout_scan() */
+	int scan;
+	int malformed;
+
+	struct report_layout_globals globals;
+	size_t stack_depth;
+	struct report_layout_locals locals;
+
+	struct hid_report_field *fields;
+	size_t num_fields;
+	size_t fields_capacity;
+
+	int numbered_reports;
+	/* The reports seen so far, a bit per type and Report ID */
+	unsigned char seen[REPORT_LAYOUT_NUM_TYPES][256 / 8];
+	size_t num_reports;
+
+	struct report_layout_usage_pair *usage_pairs;
+	size_t num_usage_pairs;
+	size_t usage_pairs_capacity;
+
+	/* From here on, left uninitialized by report_layout_parser_init():
+	   clearing these would cost more than a typical descriptor takes
+	   to walk, and only what was written to is ever read back */
+	struct report_layout_globals stack[REPORT_LAYOUT_MAX_PUSH];
+	/* The bit length of every report seen so far, by type and Report ID */
+	unsigned int bit_length[REPORT_LAYOUT_NUM_TYPES][256];
+};
+
+static void report_layout_parser_init(struct report_layout_parser *parser, int scan)
+{
+	memset(parser, 0, offsetof(struct report_layout_parser, stack));
+	parser->scan = scan;
+}
+
+static int report_layout_seen(const struct report_layout_parser *parser, int type, int report_id)
+{
+	return (parser->seen[type][report_id >> 3] >> (report_id & 7)) & 1;
+}
+
+static int report_layout_sign_extend(unsigned int value, unsigned int size)
+{
+	switch (size) {
+	case 1:
+		return (signed char)(value & 0xFF);
+	case 2:
+		return (short)(value & 0xFFFF);
+	default:
+		return (int)value;
+	}
+}
+
+static const char *report_layout_add_usage(struct report_layout_locals *locals, unsigned int usage, int extended)
+{
+	if (locals->num_usages == locals->usages_capacity) {
+		size_t capacity = locals->usages_capacity ? locals->usages_capacity * 2 : 16;
+		struct report_layout_usage *usages = (struct report_layout_usage*) realloc(locals->usages, capacity * sizeof(*usages));
+		if (!usages)
+			return "Couldn't allocate memory";
+		locals->usages = usages;
+		locals->usages_capacity = capacity;
+	}
+	locals->usages[locals->num_usages].usage = usage;
+	locals->usages[locals->num_usages].extended = extended;
+	locals->num_usages++;
+	return NULL;
+}
+
+static void report_layout_reset_locals(struct report_layout_locals *locals)
+{
+	locals->num_usages = 0;
+	locals->has_usage_minimum = 0;
+	locals->has_usage_maximum = 0;
+}
+
+static struct hid_report_field *report_layout_new_field(struct report_layout_parser *parser)
+{
+	struct hid_report_field *field;
+
+	if (parser->num_fields == parser->fields_capacity) {
+		size_t capacity = parser->fields_capacity ? parser->fields_capacity * 2 : 32;
+		struct hid_report_field *fields = (struct hid_report_field*) realloc(parser->fields, capacity * sizeof(*fields));
+		if (!fields)
+			return NULL;
+		parser->fields = fields;
+		parser->fields_capacity = capacity;
+	}
+
+	field = &parser->fields[parser->num_fields++];
+	memset(field, 0, sizeof(*field));
+	return field;
+}
+
+static unsigned short report_layout_usage_page(const struct report_layout_parser *parser, const struct report_layout_usage *usage)
+{
+	return usage->extended ? (unsigned short)(usage->usage >> 16) : parser->globals.usage_page;
+}
+
+/* Turns an Input, Output or Feature item into one field or more,
+   placed at the end of its report. */
+static const char *report_layout_main_data(struct report_layout_parser *parser, hid_api_report_type type, unsigned int data)
+{
+	const struct report_layout_globals *globals = &parser->globals;
+	const struct report_layout_locals *locals = &parser->locals;
+	unsigned int *bit_length = &parser->bit_length[type][globals->report_id];
+	unsigned int flags = data & REPORT_LAYOUT_FIELD_FLAGS_MASK;
+	unsigned long long total_bits = (unsigned long long)globals->report_size * globals->report_count;
+	int logical_minimum, logical_maximum;
+	struct hid_report_field *field;
+	size_t i, num_elements_fields;
+
+	if (parser->numbered_reports && globals->report_id == 0 && !parser->scan)
+		return "Report descriptor has a Main item before its first Report ID";
+
+	if (!report_layout_seen(parser, type, globals->report_id)) {
+		parser->seen[type][globals->report_id >> 3] |= (unsigned char)(1 << (globals->report_id & 7));
+		*bit_length = 0;
+		parser->num_reports++;
+	}
+
+	if (total_bits == 0)
+		return NULL;
+	if (*bit_length + total_bits > (UINT_MAX >> 1))
+		return "Report descriptor declares a report which is too long";
+
+	if (parser->scan) {
+		*bit_length += (unsigned int)total_bits;
+		return NULL;
+	}
+
+	logical_minimum = report_layout_sign_extend(globals->logical_minimum, globals->logical_minimum_size);
+	/* Devices commonly declare e.g. 0..255 in single bytes: the maximum
+	   only reads as a signed value when the minimum is negative */
+	if (logical_minimum < 0)
+		logical_maximum = report_layout_sign_extend(globals->logical_maximum, globals->logical_maximum_size);
+	else
+		logical_maximum = (int)globals->logical_maximum;
+
+	/* A variable item with a list of usages, one per element:
+	   a field per usage, the last one taking the remaining elements */
+	num_elements_fields = 0;
+	if ((flags & HID_API_FIELD_VARIABLE) && locals->num_usages > 1) {
+		num_elements_fields = locals->num_usages;
+		if (num_elements_fields > globals->report_count)
+			num_elements_fields = globals->report_count;
+	}
+
+	if (num_elements_fields > 1) {
+		for (i = 0; i < num_elements_fields; i++) {
+			const struct report_layout_usage *usage = &locals->usages[i];
+			unsigned int count = (i + 1 < num_elements_fields) ? 1 : (unsigned int)(globals->report_count - i);
+
+			field = report_layout_new_field(parser);
+			if (!field)
+				return "Couldn't allocate memory";
+			field->report_type = type;
+			field->report_id = globals->report_id;
+			field->bit_offset = *bit_length;
+			field->bit_size = globals->report_size;
+			field->count = count;
+			field->logical_minimum = logical_minimum;
+			field->logical_maximum = logical_maximum;
+			field->usage_page = report_layout_usage_page(parser, usage);
+			field->usage_minimum = (unsigned short)(usage->usage & 0xFFFF);
+			field->usage_maximum = field->usage_minimum;
+			field->flags = flags;
+			*bit_length += globals->report_size * count;
+		}
+		return NULL;
+	}
+
+	field = report_layout_new_field(parser);
+	if (!field)
+		return "Couldn't allocate memory";
+	field->report_type = type;
+	field->report_id = globals->report_id;
+	field->bit_offset = *bit_length;
+	field->bit_size = globals->report_size;
+	field->count = globals->report_count;
+	field->logical_minimum = logical_minimum;
+	field->logical_maximum = logical_maximum;
+	field->flags = flags;
+
+	if (locals->num_usages > 0) {
+		/* A single usage, or the list of the choices of an array */
+		const struct report_layout_usage *first = &locals->usages[0];
+		const struct report_layout_usage *last = &locals->usages[locals->num_usages - 1];
+		field->usage_page = report_layout_usage_page(parser, first);
+		field->usage_minimum = (unsigned short)(first->usage & 0xFFFF);
+		field->usage_maximum = (unsigned short)(last->usage & 0xFFFF);
+	}
+	else if (locals->has_usage_minimum || locals->has_usage_maximum) {
+		const struct report_layout_usage *minimum = locals->has_usage_minimum ? &locals->usage_minimum : &locals->usage_maximum;
+		const struct report_layout_usage *maximum = locals->has_usage_maximum ? &locals->usage_maximum : &locals->usage_minimum;
+		field->usage_page = report_layout_usage_page(parser, minimum);
+		field->usage_minimum = (unsigned short)(minimum->usage & 0xFFFF);
+		field->usage_maximum = (unsigned short)(maximum->usage & 0xFFFF);
+	}
+
+	*bit_length += (unsigned int)total_bits;
+	return NULL;
+}
+
+/* Builds the result in a single allocation: the layout, then its reports,
+   then the fields of each report, in the order of the reports. */
+static struct hid_report_layout *report_layout_build(const struct report_layout_parser *parser)
+{
+	struct hid_report_layout *layout;
+	struct hid_report_info *reports;
+	struct hid_report_field *fields;
+	size_t report_index[REPORT_LAYOUT_NUM_TYPES][256];
+	size_t next_field;
+	size_t i;
+	int type, id;
+
+	layout = (struct hid_report_layout*) calloc(1, sizeof(*layout)
+		+ parser->num_reports * sizeof(*reports)
+		+ parser->num_fields * sizeof(*fields));
+	if (!layout)
+		return NULL;
+
+	reports = (struct hid_report_info*) (layout + 1);
+	fields = (struct hid_report_field*) (reports + parser->num_reports);
+
+	layout->numbered_reports = parser->numbered_reports;
+	layout->num_reports = parser->num_reports;
+	layout->reports = reports;
+	layout->num_fields = parser->num_fields;
+	layout->fields = fields;
+
+	/* Count the fields of each report, then place them: the fields of a
+	   report come in the order of the descriptor, which is by bit offset */
+	i = 0;
+	for (type = 0; type < REPORT_LAYOUT_NUM_TYPES; type++) {
+		for (id = 0; id < 256; id++) {
+			if (!report_layout_seen(parser, type, id))
+				continue;
+			reports[i].report_type = (hid_api_report_type)type;
+			reports[i].report_id = (unsigned char)id;
+			reports[i].bit_length = parser->bit_length[type][id];
+			report_index[type][id] = i;
+			i++;
+		}
+	}
+
+	for (i = 0; i < parser->num_fields; i++)
+		reports[report_index[parser->fields[i].report_type][parser->fields[i].report_id]].num_fields++;
+
+	next_field = 0;
+	for (i = 0; i < parser->num_reports; i++) {
+		reports[i].first_field = next_field;
+		next_field += reports[i].num_fields;
+		reports[i].num_fields = 0;
+	}
+
+	for (i = 0; i < parser->num_fields; i++) {
+		struct hid_report_info *report = &reports[report_index[parser->fields[i].report_type][parser->fields[i].report_id]];
+		struct hid_report_field *field = &fields[report->first_field + report->num_fields++];
+		*field = parser->fields[i];
+		field->value_index = report->num_values;
+		report->num_values += field->count;
+	}
+
+	return layout;
+}
+
+/* Reads the item at *pos and moves *pos past it.
+   Returns 1 for an item, 0 at the end of the descriptor
+   and -1 on a truncated item. */
+static int report_layout_next_item(const unsigned char *descriptor, size_t length, size_t *pos, struct report_layout_item *item)
+{
+	size_t i = *pos;
+	unsigned char prefix;
+
+	if (i >= length)
+		return 0;
+
+	prefix = descriptor[i];
+	if (prefix == 0xFE) {
+		/* Long item: bDataSize, bLongItemTag, then the data */
+		if (length - i < 3 || length - i - 3 < descriptor[i + 1])
+			return -1;
+		item->type = REPORT_LAYOUT_TYPE_LONG;
+		item->tag = descriptor[i + 2];
+		item->size = descriptor[i + 1];
+		item->value = 0;
+		*pos = i + 3 + item->size;
+		return 1;
+	}
+
+	item->size = prefix & 0x3;
+	if (item->size == 3)
+		item->size = 4;
+	item->type = (prefix >> 2) & 0x3;
+	item->tag = prefix >> 4;
+
+	if (length - i - 1 < item->size)
+		return -1;
+
+	item->value = 0;
+	switch (item->size) {
+	case 4:
+		item->value |= (unsigned int)descriptor[i + 4] << 24;
+		item->value |= (unsigned int)descriptor[i + 3] << 16;
+		/* fall through */
+	case 2:
+		item->value |= (unsigned int)descriptor[i + 2] << 8;
+		/* fall through */
+	case 1:
+		item->value |= descriptor[i + 1];
+		break;
+	default:
+		break;
+	}
+
+	*pos = i + 1 + item->size;
+	return 1;
+}
+
+static const char *report_layout_add_usage_pair(struct report_layout_parser *parser, unsigned short usage_page, unsigned short usage)
+{
+	if (parser->num_usage_pairs == parser->usage_pairs_capacity) {
+		size_t capacity = parser->usage_pairs_capacity ? parser->usage_pairs_capacity * 2 : 4;
+		struct report_layout_usage_pair *usage_pairs = (struct report_layout_usage_pair*) realloc(parser->usage_pairs, capacity * sizeof(*usage_pairs));
+		if (!usage_pairs)
+			return "Couldn't allocate memory";
+		parser->usage_pairs = usage_pairs;
+		parser->usage_pairs_capacity = capacity;
+	}
+	parser->usage_pairs[parser->num_usage_pairs].usage_page = usage_page;
+	parser->usage_pairs[parser->num_usage_pairs].usage = usage;
+	parser->num_usage_pairs++;
+	return NULL;
+}
+
+/* Walks the items of the descriptor once, for both report_layout_parse()
+   and report_layout_scan(). A scan only tracks the sizes of the reports
+   and the top-level usage pairs, and goes past the errors it can. */
+static const char *report_layout_parse_items(struct report_layout_parser *parser, const unsigned char *descriptor, size_t length)
+{
+	struct report_layout_item item;
+	size_t pos = 0;
+	int collection_depth = 0;
+	const char *error;
+	int res;
+
+	/* The top-level usage pair, from the items outside of the collections */
+	unsigned short top_usage_page = 0, top_usage = 0;
+	int top_usage_page_found = 0, top_usage_found = 0;
+	int pending_pair = 0;
+
+	while ((res = report_layout_next_item(descriptor, length, &pos, &item)) > 0) {
+		error = NULL;
+
+		switch (item.type) {
+		case REPORT_LAYOUT_TYPE_MAIN:
+			switch (item.tag) {
+			case REPORT_LAYOUT_MAIN_INPUT:
+				error = report_layout_main_data(parser, HID_API_REPORT_INPUT, item.value);
+				break;
+			case REPORT_LAYOUT_MAIN_OUTPUT:
+				error = report_layout_main_data(parser, HID_API_REPORT_OUTPUT, item.value);
+				break;
+			case REPORT_LAYOUT_MAIN_FEATURE:
+				error = report_layout_main_data(parser, HID_API_REPORT_FEATURE, item.value);
+				break;
+			case REPORT_LAYOUT_MAIN_COLLECTION:
+				/* A top-level collection yields a usage pair once it
+				   is closed, if a Usage and a Usage Page were found
+				   before it. This gives the same pairs as macOS
+				   (kIOHIDDeviceUsagePairsKey) and Windows do. */
+				if (collection_depth == 0)
+					pending_pair = top_usage_found && top_usage_page_found;
+				collection_depth++;
+				break;
+			case REPORT_LAYOUT_MAIN_END_COLLECTION:
+				if (collection_depth == 0) {
+					error = "Report descriptor has an End Collection without a Collection";
+					break;
+				}
+				collection_depth--;
+				if (collection_depth == 0 && pending_pair) {
+					error = report_layout_add_usage_pair(parser, top_usage_page, top_usage);
+					top_usage_found = 0;
+					pending_pair = 0;
+				}
+				break;
+			default:
+				break;
+			}
+			report_layout_reset_locals(&parser->locals);
+			break;
+
+		case REPORT_LAYOUT_TYPE_GLOBAL:
+			switch (item.tag) {
+			case REPORT_LAYOUT_GLOBAL_USAGE_PAGE:
+				parser->globals.usage_page = (unsigned short)item.value;
+				if (collection_depth == 0) {
+					top_usage_page = (unsigned short)item.value;
+					top_usage_page_found = 1;
+				}
+				break;
+			case REPORT_LAYOUT_GLOBAL_LOGICAL_MINIMUM:
+				parser->globals.logical_minimum = item.value;
+				parser->globals.logical_minimum_size = item.size;
+				break;
+			case REPORT_LAYOUT_GLOBAL_LOGICAL_MAXIMUM:
+				parser->globals.logical_maximum = item.value;
+				parser->globals.logical_maximum_size = item.size;
+				break;
+			case REPORT_LAYOUT_GLOBAL_REPORT_SIZE:
+				parser->globals.report_size = item.value;
+				break;
+			case REPORT_LAYOUT_GLOBAL_REPORT_ID:
+				if (item.value == 0 || item.value > 0xFF) {
+					error = "Report descriptor has an invalid Report ID";
+					break;
+				}
+				if (!parser->numbered_reports && parser->num_reports > 0 && !parser->scan) {
+					error = "Report descriptor has a Main item before its first Report ID";
+					break;
+				}
+				parser->numbered_reports = 1;
+				parser->globals.report_id = (unsigned char)item.value;
+				break;
+			case REPORT_LAYOUT_GLOBAL_REPORT_COUNT:
+				parser->globals.report_count = item.value;
+				break;
+			case REPORT_LAYOUT_GLOBAL_PUSH:
+				if (parser->stack_depth == REPORT_LAYOUT_MAX_PUSH) {
+					error = "Report descriptor has too many nested Push items";
+					break;
+				}
+				parser->stack[parser->stack_depth++] = parser->globals;
+				break;
+			case REPORT_LAYOUT_GLOBAL_POP:
+				if (parser->stack_depth == 0) {
+					error = "Report descriptor has a Pop item without a Push";
+					break;
+				}
+				parser->globals = parser->stack[--parser->stack_depth];
+				break;
+			default:
+				break;
+			}
+			break;
+
+		case REPORT_LAYOUT_TYPE_LOCAL:
+			switch (item.tag) {
+			case REPORT_LAYOUT_LOCAL_USAGE:
+				if (collection_depth == 0) {
+					/* An extended usage sets the Usage Page of the pair too */
+					if (item.size == 4) {
+						top_usage_page = (unsigned short)(item.value >> 16);
+						top_usage_page_found = 1;
+					}
+					top_usage = (unsigned short)(item.value & 0xFFFF);
+					top_usage_found = 1;
+				}
+				if (!parser->scan)
+					error = report_layout_add_usage(&parser->locals, item.value, item.size == 4);
+				break;
+			case REPORT_LAYOUT_LOCAL_USAGE_MINIMUM:
+				parser->locals.usage_minimum.usage = item.value;
+				parser->locals.usage_minimum.extended = (item.size == 4);
+				parser->locals.has_usage_minimum = 1;
+				break;
+			case REPORT_LAYOUT_LOCAL_USAGE_MAXIMUM:
+				parser->locals.usage_maximum.usage = item.value;
+				parser->locals.usage_maximum.extended = (item.size == 4);
+				parser->locals.has_usage_maximum = 1;
+				break;
+			default:
+				break;
+			}
+			break;
+
+		default:
+			/* Long items and the reserved item type */
+			break;
+		}
+
+		if (error) {
+			if (!parser->scan)
+				return error;
+			parser->malformed = 1;
+		}
+	}
+
+	if (res < 0) {
+		if (!parser->scan)
+			return "Report descriptor has a truncated item";
+		parser->malformed = 1;
+	}
+
+	if (collection_depth > 0) {
+		/* The last collection is never closed: its pair is dropped */
+		parser->malformed = 1;
+	}
+	else if (parser->num_usage_pairs == 0 && top_usage_found && top_usage_page_found) {
+		/* Without a top-level collection, the usage pair in scope is used, see
+		   https://docs.microsoft.com/en-us/windows-hardware/drivers/hid/top-level-collections */
+		error = report_layout_add_usage_pair(parser, top_usage_page, top_usage);
+		if (error && !parser->scan)
+			return error;
+	}
+
+	return NULL;
+}
+
+/* Returns NULL and sets *error on failure. */
+static struct hid_report_layout *report_layout_parse(const unsigned char *descriptor, size_t length, const char **error)
+{
+	struct report_layout_parser *parser;
+	struct hid_report_layout *layout = NULL;
+
+	*error = NULL;
+
+	if (!descriptor && length > 0) {
+		*error = "Report descriptor is NULL";
+		return NULL;
+	}
+
+	parser = (struct report_layout_parser*) malloc(sizeof(*parser));
+	if (!parser) {
+		*error = "Couldn't allocate memory";
+		return NULL;
+	}
+	report_layout_parser_init(parser, 0);
+
+	*error = report_layout_parse_items(parser, descriptor, length);
+	if (!*error) {
+		layout = report_layout_build(parser);
+		if (!layout)
+			*error = "Couldn't allocate memory";
+	}
+
+	free(parser->locals.usages);
+	free(parser->fields);
+	free(parser->usage_pairs);
+	free(parser);
+	return layout;
+}
+
+#ifdef REPORT_LAYOUT_WITH_SCAN
+/* Finds the top-level usage pairs and the report sizes of a descriptor
+   in a single pass, without building its layout. Unlike
+   report_layout_parse(), it keeps what it can of a malformed descriptor.
+   Returns 0 on success and -1 if out of memory. */
+static int report_layout_scan(const unsigned char *descriptor, size_t length, struct report_layout_summary *summary)
+{
+	struct report_layout_parser parser;
+	size_t reports_left;
+	int type, id;
+
+	memset(summary, 0, sizeof(*summary));
+	report_layout_parser_init(&parser, 1);
+
+	if (descriptor)
+		report_layout_parse_items(&parser, descriptor, length);
+
+	summary->usage_pairs = parser.usage_pairs;
+	summary->num_usage_pairs = parser.num_usage_pairs;
+	summary->numbered_reports = parser.numbered_reports;
+	summary->malformed = parser.malformed;
+
+	reports_left = parser.num_reports;
+	for (type = 0; type < REPORT_LAYOUT_NUM_TYPES && reports_left > 0; type++) {
+		for (id = 0; id < 256 && reports_left > 0; id++) {
+			size_t report_size;
+			if (!parser.seen[type][id >> 3]) {
+				id |= 7;
+				continue;
+			}
+			if (!report_layout_seen(&parser, type, id))
+				continue;
+			reports_left--;
+			report_size = (parser.bit_length[type][id] + 7) / 8 + (parser.numbered_reports ? 1 : 0);
+			if (report_size > summary->max_report_size[type])
+				summary->max_report_size[type] = report_size;
+		}
+	}
+
+	free(parser.locals.usages);
+	return 0;
+}
+#endif /* REPORT_LAYOUT_WITH_SCAN */
+
+static void report_layout_free(struct hid_report_layout *layout)
+{
+	free(layout);
+}
+
+/* Decoding */
+
+/* Reports decoded at once by hid_decode_reports(), before their values
+   are spread over the columns */
+#define REPORT_LAYOUT_DECODE_BLOCK 16
+
+static const struct hid_report_info *report_layout_find_report(const struct hid_report_layout *layout, hid_api_report_type type, unsigned char report_id)
+{
+	size_t low = 0, high = layout->num_reports;
+
+	/* The reports are ordered by type, then by Report ID */
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		const struct hid_report_info *report = &layout->reports[middle];
+		if (report->report_type < type || (report->report_type == type && report->report_id < report_id))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low < layout->num_reports && layout->reports[low].report_type == type && layout->reports[low].report_id == report_id)
+		return &layout->reports[low];
+	return NULL;
+}
+
+static int report_layout_extend(unsigned int value, unsigned int bit_size, int is_signed)
+{
+	unsigned int sign_bit;
+
+	if (!is_signed || bit_size >= 32)
+		return (int)value;
+
+	sign_bit = 1u << (bit_size - 1);
+	return (int)((value ^ sign_bit) - sign_bit);
+}
+
+/* Reads bit_size bits (at most 32) at bit_offset, least significant first */
+static unsigned int report_layout_extract(const unsigned char *data, unsigned int bit_offset, unsigned int bit_size)
+{
+	const unsigned char *src = data + (bit_offset >> 3);
+	unsigned int shift = bit_offset & 7;
+	unsigned int num_bytes = (shift + bit_size + 7) >> 3;
+	unsigned long long raw = 0;
+	unsigned int i;
+
+	for (i = 0; i < num_bytes; i++)
+		raw |= (unsigned long long)src[i] << (8 * i);
+
+	raw >>= shift;
+	if (bit_size < 32)
+		raw &= (1ull << bit_size) - 1;
+	return (unsigned int)raw;
+}
+
+#ifdef REPORT_LAYOUT_SSE2
+/* Stores 8 16-bit lanes as 8 ints */
+static void report_layout_store_epi16(__m128i v, int is_signed, int *values)
+{
+	__m128i low, high;
+
+	if (is_signed) {
+		low = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		high = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+	}
+	else {
+		low = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+		high = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+	}
+
+	_mm_storeu_si128((__m128i*) values, low);
+	_mm_storeu_si128((__m128i*) (values + 4), high);
+}
+#endif
+
+/* Each of the unpack functions below decodes count elements of a field
+   starting on a byte boundary at src. */
+
+static void report_layout_unpack1(const unsigned char *src, size_t count, int is_signed, int *values)
+{
+	size_t i = 0;
+
+#ifdef REPORT_LAYOUT_SSE2
+	const __m128i low_bits = _mm_setr_epi32(0x01, 0x02, 0x04, 0x08);
+	const __m128i high_bits = _mm_setr_epi32(0x10, 0x20, 0x40, 0x80);
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i byte = _mm_set1_epi32(src[i >> 3]);
+		/* All ones where the bit is set: -1 as a signed value */
+		__m128i low = _mm_cmpeq_epi32(_mm_and_si128(byte, low_bits), low_bits);
+		__m128i high = _mm_cmpeq_epi32(_mm_and_si128(byte, high_bits), high_bits);
+		if (!is_signed) {
+			low = _mm_srli_epi32(low, 31);
+			high = _mm_srli_epi32(high, 31);
+		}
+		_mm_storeu_si128((__m128i*) (values + i), low);
+		_mm_storeu_si128((__m128i*) (values + i + 4), high);
+	}
+#endif
+
+	for (; i < count; i++) {
+		int bit = (src[i >> 3] >> (i & 7)) & 1;
+		values[i] = is_signed ? -bit : bit;
+	}
+}
+
+static void report_layout_unpack8(const unsigned char *src, size_t count, int is_signed, int *values)
+{
+	size_t i = 0;
+
+#ifdef REPORT_LAYOUT_SSE2
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i low, high;
+		if (is_signed) {
+			low = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+			high = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+		}
+		else {
+			low = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+			high = _mm_unpackhi_epi8(v, _mm_setzero_si128());
+		}
+		report_layout_store_epi16(low, is_signed, values + i);
+		report_layout_store_epi16(high, is_signed, values + i + 8);
+	}
+#endif
+
+	for (; i < count; i++)
+		values[i] = is_signed ? (signed char)src[i] : src[i];
+}
+
+/* end is the end of the report, as 12-bit fields are loaded 16 bytes
+   at a time for 12 bytes of elements */
+static void report_layout_unpack12(const unsigned char *src, const unsigned char *end, size_t count, int is_signed, int *values)
+{
+	size_t i = 0;
+
+#ifdef REPORT_LAYOUT_SSSE3
+	/* Two elements per 3 bytes: the 16-bit lane of each element holds
+	   the two bytes it overlaps, with the element in the low 12 bits
+	   for even elements and in the high 12 bits for odd ones */
+	const __m128i spread = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	const __m128i even = _mm_setr_epi16(0x0FFF, 0, 0x0FFF, 0, 0x0FFF, 0, 0x0FFF, 0);
+	const __m128i odd = _mm_setr_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+
+	for (; i + 8 <= count && (size_t)(end - (src + i / 2 * 3)) >= 16; i += 8) {
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (src + i / 2 * 3)), spread);
+		v = _mm_or_si128(_mm_and_si128(v, even), _mm_and_si128(_mm_srli_epi16(v, 4), odd));
+		if (is_signed)
+			v = _mm_srai_epi16(_mm_slli_epi16(v, 4), 4);
+		report_layout_store_epi16(v, is_signed, values + i);
+	}
+#else
+	(void)end;
+#endif
+
+	for (; i + 2 <= count; i += 2) {
+		const unsigned char *pair = src + i / 2 * 3;
+		values[i] = report_layout_extend(pair[0] | ((pair[1] & 0x0Fu) << 8), 12, is_signed);
+		values[i + 1] = report_layout_extend((pair[1] >> 4) | ((unsigned int)pair[2] << 4), 12, is_signed);
+	}
+	if (i < count) {
+		const unsigned char *pair = src + i / 2 * 3;
+		values[i] = report_layout_extend(pair[0] | ((pair[1] & 0x0Fu) << 8), 12, is_signed);
+	}
+}
+
+static void report_layout_unpack16(const unsigned char *src, size_t count, int is_signed, int *values)
+{
+	size_t i = 0;
+
+#ifdef REPORT_LAYOUT_SSE2
+	for (; i + 8 <= count; i += 8)
+		report_layout_store_epi16(_mm_loadu_si128((const __m128i*) (src + 2 * i)), is_signed, values + i);
+#endif
+
+	for (; i < count; i++) {
+		unsigned int value = src[2 * i] | ((unsigned int)src[2 * i + 1] << 8);
+		values[i] = is_signed ? (short)value : (int)value;
+	}
+}
+
+/* data and end delimit the report, without its Report ID */
+static void report_layout_decode_field(const struct hid_report_field *field, const unsigned char *data, const unsigned char *end, int *values)
+{
+	int is_signed = field->logical_minimum < 0;
+	unsigned int bit_size = field->bit_size < 32 ? field->bit_size : 32;
+	unsigned int i;
+
+	if ((field->bit_offset & 7) == 0) {
+		const unsigned char *src = data + (field->bit_offset >> 3);
+		switch (field->bit_size) {
+		case 1:
+			report_layout_unpack1(src, field->count, is_signed, values);
+			return;
+		case 8:
+			report_layout_unpack8(src, field->count, is_signed, values);
+			return;
+		case 12:
+			report_layout_unpack12(src, end, field->count, is_signed, values);
+			return;
+		case 16:
+			report_layout_unpack16(src, field->count, is_signed, values);
+			return;
+		default:
+			break;
+		}
+	}
+
+	for (i = 0; i < field->count; i++) {
+		unsigned int value = report_layout_extract(data, field->bit_offset + i * field->bit_size, bit_size);
+		values[i] = report_layout_extend(value, bit_size, is_signed);
+	}
+}
+
+static void report_layout_decode(const struct hid_report_layout *layout, const struct hid_report_info *report, const unsigned char *data, const unsigned char *end, int *values)
+{
+	size_t i;
+
+	for (i = 0; i < report->num_fields; i++) {
+		const struct hid_report_field *field = &layout->fields[report->first_field + i];
+		report_layout_decode_field(field, data, end, values + field->value_index);
+	}
+}
+
+int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, hid_api_report_type type, const unsigned char *data, size_t length, int *values, size_t num_values)
+{
+	const struct hid_report_info *report;
+	unsigned char report_id = 0;
+
+	if (!layout || !data)
+		return -1;
+
+	if (layout->numbered_reports) {
+		if (length < 1)
+			return -1;
+		report_id = data[0];
+		data++;
+		length--;
+	}
+
+	report = report_layout_find_report(layout, type, report_id);
+	if (!report || length < (report->bit_length + 7) / 8)
+		return -1;
+	if (num_values < report->num_values || (report->num_values > 0 && !values))
+		return -1;
+
+	report_layout_decode(layout, report, data, data + length, values);
+	return (int)report->num_values;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_decode_reports(const struct hid_report_layout *layout, hid_api_report_type type, unsigned char report_id, const unsigned char *reports, size_t report_size, size_t num_reports, int *columns, size_t column_length)
+{
+	const struct hid_report_info *report;
+	size_t id_size, num_values, n, k, v;
+	int *rows;
+
+	if (!layout || (num_reports > 0 && !reports))
+		return -1;
+
+	report = report_layout_find_report(layout, type, report_id);
+	if (!report)
+		return -1;
+
+	id_size = layout->numbered_reports ? 1 : 0;
+	num_values = report->num_values;
+	if (report_size < id_size + (report->bit_length + 7) / 8 || column_length < num_reports)
+		return -1;
+	if (num_values == 0 || num_reports == 0)
+		return (int)num_values;
+	if (!columns)
+		return -1;
+
+	/* Reports are decoded a block at a time into rows, which are then
+	   transposed into the columns */
+	rows = (int*) malloc(REPORT_LAYOUT_DECODE_BLOCK * num_values * sizeof(int));
+	if (!rows)
+		return -1;
+
+	for (n = 0; n < num_reports; n += REPORT_LAYOUT_DECODE_BLOCK) {
+		size_t block = num_reports - n < REPORT_LAYOUT_DECODE_BLOCK ? num_reports - n : REPORT_LAYOUT_DECODE_BLOCK;
+
+		for (k = 0; k < block; k++) {
+			const unsigned char *data = reports + (n + k) * report_size;
+			if (id_size && data[0] != report_id) {
+				free(rows);
+				return -1;
+			}
+			report_layout_decode(layout, report, data + id_size, data + report_size, rows + k * num_values);
+		}
+
+		for (v = 0; v < num_values; v++) {
+			int *column = columns + v * column_length + n;
+			for (k = 0; k < block; k++)
+				column[k] = rows[k * num_values + v];
+		}
+	}
+
+	free(rows);
+	return (int)num_values;
+}
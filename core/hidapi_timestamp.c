@@ -0,0 +1,79 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* The clock of the timestamps of hid_read_timestamped() and
+   hid_read_many(). Like hidapi_report_layout.c, this file is
+   included by each backend rather than built on its own. */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_WIN32)
+
+/* Returns the current QueryPerformanceCounter() time in nanoseconds,
+   see hid_read_timestamped() */
+static uint64_t get_timestamp(void)
+{
+	LARGE_INTEGER counter, frequency;
+	uint64_t seconds;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	/* Split up to not overflow the 64 bits */
+	seconds = (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart;
+	return seconds * 1000000000 +
+		((uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart) * 1000000000 / (uint64_t)frequency.QuadPart;
+}
+
+#elif defined(__APPLE__)
+
+/* Returns the current mach_absolute_time() in nanoseconds,
+   see hid_read_timestamped() */
+static uint64_t get_timestamp(void)
+{
+	static mach_timebase_info_data_t timebase;
+	uint64_t t = mach_absolute_time();
+
+	if (timebase.denom == 0)
+		mach_timebase_info(&timebase);
+
+	/* Split up to not overflow the 64 bits */
+	return (t / timebase.denom) * timebase.numer + (t % timebase.denom) * timebase.numer / timebase.denom;
+}
+
+#else
+
+/* Returns the current CLOCK_MONOTONIC time in nanoseconds,
+   see hid_read_timestamped() */
+static uint64_t get_timestamp(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+#endif
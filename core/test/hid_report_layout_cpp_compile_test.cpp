@@ -0,0 +1,43 @@
+/* Misuses of hidapi_report_layout.hpp which have to be compile errors:
+   built by the tests with one of HIDAPI_TEST_MISSING_USAGE,
+   HIDAPI_TEST_MISSING_REPORT or HIDAPI_TEST_BUFFER_TOO_SMALL defined,
+   the build has to fail with the message of the static_assert. */
+
+#include "hidapi_report_layout.hpp"
+
+/* 046D_C534_0002_0001: a mouse, with 12-bit axes in Report ID 2 */
+static constexpr unsigned char mouse_descriptor[] = {
+	0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00,
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10,
+	0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+	0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81,
+	0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06, 0x05, 0x0C,
+	0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+};
+
+static constexpr auto mouse = hidapi::parse_report_descriptor(mouse_descriptor);
+
+using mouse_report = hidapi::report<mouse, HID_API_REPORT_INPUT, 2>;
+using mouse_x = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0001, 0x0030>;
+
+int read_mouse(const unsigned char *report)
+{
+#if defined(HIDAPI_TEST_MISSING_USAGE)
+	/* The mouse has no Z axis */
+	using mouse_z = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0001, 0x0032>;
+	return mouse_z::read(report);
+#elif defined(HIDAPI_TEST_MISSING_REPORT)
+	/* The mouse only has the input report 2 */
+	using mouse_report_1 = hidapi::report<mouse, HID_API_REPORT_INPUT, 1>;
+	return mouse_report_1::make()[0] + report[0];
+#elif defined(HIDAPI_TEST_BUFFER_TOO_SMALL)
+	/* The report is 8 bytes long */
+	std::array<unsigned char, 4> data = { { report[0], report[1], report[2], report[3] } };
+	return mouse_x::read(data);
+#else
+	mouse_report::buffer data = mouse_report::make();
+	for (std::size_t i = 1; i < data.size(); i++)
+		data[i] = report[i];
+	return mouse_x::read(data);
+#endif
+}
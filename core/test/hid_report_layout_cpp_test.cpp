@@ -0,0 +1,336 @@
+#include "../hidapi_report_layout.c"
+#include "../hidapi_descriptor_text.c"
+
+#include "hidapi_report_layout.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/* Descriptors of the Windows test data, parsed at compile time */
+
+/* 046D_C534_0002_0001: a mouse, with 12-bit axes in Report ID 2 */
+static constexpr unsigned char mouse_descriptor[] = {
+	0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00,
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10,
+	0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+	0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81,
+	0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06, 0x05, 0x0C,
+	0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+};
+
+/* 046A_0011_0006_0001: a keyboard, with an array of key codes and LEDs */
+static constexpr unsigned char keyboard_descriptor[] = {
+	0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7,
+	0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x75, 0x08,
+	0x95, 0x01, 0x81, 0x03, 0x19, 0x00, 0x29, 0xDD, 0x15, 0x00, 0x26, 0xDD,
+	0x00, 0x75, 0x08, 0x95, 0x06, 0x81, 0x00, 0x05, 0x08, 0x19, 0x01, 0x29,
+	0x03, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x03, 0x91, 0x02, 0x75,
+	0x05, 0x95, 0x01, 0x91, 0x03, 0xC0,
+};
+
+/* The first reports of 17CC_1130_0000_FF01: lists of repeated usages,
+   4-bit and 16-bit elements, and a feature report */
+static constexpr unsigned char vendor_descriptor[] = {
+	0x06, 0x01, 0xFF, 0x09, 0x00, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x02, 0x85,
+	0x01, 0x09, 0x03, 0x09, 0x03, 0x09, 0x03, 0x09, 0x03, 0x15, 0x00, 0x25,
+	0x0F, 0x75, 0x04, 0x95, 0x04, 0x81, 0x02, 0x09, 0x0B, 0x09, 0x0B, 0x09,
+	0x0B, 0x09, 0x0B, 0x09, 0x0B, 0x09, 0x0B, 0x09, 0x0B, 0x09, 0x0B, 0x15,
+	0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0xC0, 0x09, 0x02,
+	0xA1, 0x02, 0x85, 0x02, 0x09, 0x04, 0x09, 0x04, 0x09, 0x04, 0x09, 0x04,
+	0x15, 0x00, 0x26, 0xFF, 0x0F, 0x75, 0x10, 0x95, 0x1A, 0x81, 0x02, 0xC0,
+	0x09, 0xD0, 0xA1, 0x02, 0x85, 0xF3, 0x09, 0xD1, 0x15, 0x00, 0x25, 0x7F,
+	0x75, 0x08, 0x95, 0x02, 0xB1, 0x82, 0xC0, 0xC0,
+};
+
+static constexpr auto mouse = hidapi::parse_report_descriptor(mouse_descriptor);
+static constexpr auto keyboard = hidapi::parse_report_descriptor(keyboard_descriptor);
+static constexpr auto vendor = hidapi::parse_report_descriptor(vendor_descriptor);
+
+static_assert(mouse.error == nullptr && mouse.numbered_reports, "");
+static_assert(mouse.report_size(HID_API_REPORT_INPUT, 2) == 8, "");
+static_assert(!mouse.has_report(HID_API_REPORT_INPUT, 1), "");
+static_assert(keyboard.error == nullptr && !keyboard.numbered_reports, "");
+static_assert(keyboard.report_size(HID_API_REPORT_INPUT, 0) == 8, "");
+static_assert(keyboard.report_size(HID_API_REPORT_OUTPUT, 0) == 1, "");
+static_assert(vendor.error == nullptr && vendor.report_size(HID_API_REPORT_FEATURE, 0xF3) == 3, "");
+
+using mouse_report = hidapi::report<mouse, HID_API_REPORT_INPUT, 2>;
+using mouse_button_1 = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0009, 0x0001>;
+using mouse_button_16 = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0009, 0x0010>;
+using mouse_x = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0001, 0x0030>;
+using mouse_y = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0001, 0x0031>;
+using mouse_wheel = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0001, 0x0038>;
+using mouse_pan = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x000C, 0x0238>;
+
+static_assert(std::is_same<mouse_button_1::value_type, std::uint8_t>::value, "");
+static_assert(std::is_same<mouse_x::value_type, std::int16_t>::value, "");
+static_assert(std::is_same<mouse_wheel::value_type, std::int8_t>::value, "");
+static_assert(mouse_report::size == 8 && mouse_x::report_size == 8, "");
+
+using keyboard_modifier_shift = hidapi::report_usage<keyboard, HID_API_REPORT_INPUT, 0, 0x0007, 0x00E1>;
+using keyboard_keys = hidapi::report_array<keyboard, HID_API_REPORT_INPUT, 0, 0x0007, 0x0004>;
+using keyboard_caps_lock = hidapi::report_usage<keyboard, HID_API_REPORT_OUTPUT, 0, 0x0008, 0x0002>;
+
+static_assert(keyboard_keys::count == 6, "");
+
+using vendor_nibble = hidapi::report_usage<vendor, HID_API_REPORT_INPUT, 1, 0xFF01, 0x0003>;
+using vendor_bits = hidapi::report_usage<vendor, HID_API_REPORT_INPUT, 1, 0xFF01, 0x000B>;
+using vendor_words = hidapi::report_usage<vendor, HID_API_REPORT_INPUT, 2, 0xFF01, 0x0004>;
+using vendor_feature = hidapi::report_usage<vendor, HID_API_REPORT_FEATURE, 0xF3, 0xFF01, 0x00D1>;
+
+static_assert(std::is_same<vendor_words::value_type, std::uint16_t>::value, "");
+
+/* Reads and writes are constant expressions too */
+static constexpr std::int16_t constexpr_x()
+{
+	mouse_report::buffer data = mouse_report::make();
+	mouse_x::write(data, -2047);
+	mouse_y::write(data, 2047);
+	return mouse_x::read(data);
+}
+static_assert(constexpr_x() == -2047, "");
+static_assert(mouse_report::make()[0] == 2, "");
+
+/* A descriptor which doesn't parse has its error instead of fields */
+static constexpr unsigned char truncated_descriptor[] = { 0x05, 0x01, 0x26, 0xFF };
+static_assert(hidapi::parse_report_descriptor(truncated_descriptor).error != nullptr, "");
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+static unsigned int random_state = 0x12345678;
+
+static unsigned char random_byte()
+{
+	random_state = random_state * 1103515245u + 12345u;
+	return static_cast<unsigned char>(random_state >> 16);
+}
+
+static bool same_field(const hid_report_field &a, const hid_report_field &b)
+{
+	return a.report_type == b.report_type && a.report_id == b.report_id
+		&& a.bit_offset == b.bit_offset && a.bit_size == b.bit_size && a.count == b.count
+		&& a.logical_minimum == b.logical_minimum && a.logical_maximum == b.logical_maximum
+		&& a.usage_page == b.usage_page && a.usage_minimum == b.usage_minimum && a.usage_maximum == b.usage_maximum
+		&& a.flags == b.flags && a.value_index == b.value_index;
+}
+
+/* The layout parsed at compile time has to have the very fields of the
+   one report_layout_parse() compiles at run time. */
+template <std::size_t MaxFields>
+static void check_layout(const char *name, const hidapi::report_layout<MaxFields> &layout, const unsigned char *descriptor, std::size_t length)
+{
+	const char *error = nullptr;
+	hid_report_layout *expected = report_layout_parse(descriptor, length, &error);
+
+	if (!expected) {
+		fprintf(stderr, "%s: report_layout_parse failed: %s\n", name, error);
+		failures++;
+		return;
+	}
+
+	CHECK(layout.numbered_reports == expected->numbered_reports);
+	CHECK(layout.num_fields == expected->num_fields);
+	for (std::size_t i = 0; i < layout.num_fields; i++) {
+		bool found = false;
+		for (std::size_t j = 0; j < expected->num_fields && !found; j++)
+			found = same_field(layout.fields[i], expected->fields[j]);
+		if (!found) {
+			fprintf(stderr, "%s: field %u has no match in report_layout_parse()\n", name, static_cast<unsigned>(i));
+			failures++;
+		}
+	}
+	for (std::size_t r = 0; r < expected->num_reports; r++) {
+		const hid_report_info &info = expected->reports[r];
+		CHECK(layout.bit_length(info.report_type, info.report_id) == info.bit_length);
+	}
+
+	report_layout_free(expected);
+}
+
+/* A descriptor file of the Windows test data, parsed at run time both
+   ways: the same fields, or the same error */
+static void check_file(const char *filename)
+{
+	static unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	static hidapi::report_layout<1024> layout;
+	std::size_t length;
+	const char *error = nullptr;
+	hid_report_layout *expected;
+
+	if (descriptor_text_read_file(filename, descriptor, sizeof(descriptor), &length) < 0 || length == 0) {
+		fprintf(stderr, "%s: couldn't read the descriptor: %s\n", filename, length == 0 ? "no descriptor bytes found" : strerror(errno));
+		failures++;
+		return;
+	}
+
+	layout = hidapi::parse_report_descriptor<1024>(descriptor, length);
+	expected = report_layout_parse(descriptor, length, &error);
+	if (!expected || layout.error) {
+		if (!expected != !layout.error || strcmp(error, layout.error) != 0) {
+			fprintf(stderr, "%s: report_layout_parse: %s, parse_report_descriptor: %s\n", filename,
+				expected ? "OK" : error, layout.error ? layout.error : "OK");
+			failures++;
+		}
+		report_layout_free(expected);
+		return;
+	}
+	report_layout_free(expected);
+
+	check_layout(filename, layout, descriptor, length);
+}
+
+/* Decodes a random report both ways */
+template <typename Report>
+static bool decode(const hid_report_layout *layout, hid_api_report_type type, typename Report::buffer &data, int *values, std::size_t num_values)
+{
+	const unsigned char report_id = data[0];
+	for (auto &byte : data)
+		byte = random_byte();
+	if (layout->numbered_reports)
+		data[0] = report_id;
+	return hid_decode_report(layout, type, data.data(), data.size(), values, num_values) >= 0;
+}
+
+template <typename Usage>
+static void check_usage(const typename Usage::value_type value, const int *values, unsigned short usage)
+{
+	CHECK(static_cast<int>(value) == values[Usage::field.value_index + (usage - Usage::field.usage_minimum)]);
+}
+
+static void check_mouse()
+{
+	const char *error;
+	hid_report_layout *layout = report_layout_parse(mouse_descriptor, sizeof(mouse_descriptor), &error);
+	mouse_report::buffer data = mouse_report::make();
+	int values[64];
+
+	for (int n = 0; n < 1000; n++) {
+		if (!decode<mouse_report>(layout, HID_API_REPORT_INPUT, data, values, 64)) {
+			CHECK(!"hid_decode_report failed");
+			break;
+		}
+		check_usage<mouse_button_1>(mouse_button_1::read(data), values, 0x0001);
+		check_usage<mouse_button_16>(mouse_button_16::read(data), values, 0x0010);
+		check_usage<mouse_x>(mouse_x::read(data), values, 0x0030);
+		check_usage<mouse_y>(mouse_y::read(data), values, 0x0031);
+		check_usage<mouse_wheel>(mouse_wheel::read(data), values, 0x0038);
+		check_usage<mouse_pan>(mouse_pan::read(data), values, 0x0238);
+
+		/* A write changes only its own element */
+		const std::int16_t y = mouse_y::read(data);
+		const std::int8_t wheel = mouse_wheel::read(data);
+		const std::uint8_t button_16 = mouse_button_16::read(data);
+		mouse_x::write(data, static_cast<std::int16_t>(n - 500));
+		CHECK(mouse_x::read(data) == n - 500);
+		CHECK(mouse_y::read(data) == y && mouse_wheel::read(data) == wheel && mouse_button_16::read(data) == button_16);
+		CHECK(data[0] == 2);
+	}
+
+	report_layout_free(layout);
+}
+
+static void check_keyboard()
+{
+	const char *error;
+	using input = hidapi::report<keyboard, HID_API_REPORT_INPUT>;
+	using output = hidapi::report<keyboard, HID_API_REPORT_OUTPUT>;
+	hid_report_layout *layout = report_layout_parse(keyboard_descriptor, sizeof(keyboard_descriptor), &error);
+	input::buffer data = input::make();
+	output::buffer leds = output::make();
+	int values[64];
+
+	for (int n = 0; n < 1000; n++) {
+		if (!decode<input>(layout, HID_API_REPORT_INPUT, data, values, 64)) {
+			CHECK(!"hid_decode_report failed");
+			break;
+		}
+		check_usage<keyboard_modifier_shift>(keyboard_modifier_shift::read(data), values, 0x00E1);
+		CHECK(keyboard_keys::read<0>(data.data()) == values[keyboard_keys::field.value_index]);
+		CHECK(keyboard_keys::read<5>(data.data()) == values[keyboard_keys::field.value_index + 5]);
+		for (std::size_t i = 0; i < keyboard_keys::count; i++)
+			CHECK(keyboard_keys::read(data.data(), i) == values[keyboard_keys::field.value_index + i]);
+
+		keyboard_keys::write(data.data(), n % 6, 0x04);
+		CHECK(keyboard_keys::read(data.data(), n % 6) == 0x04);
+		keyboard_keys::write<2>(data.data(), 0x2C);
+		CHECK(data[2 + 2] == 0x2C);
+	}
+
+	keyboard_caps_lock::write(leds, 1);
+	CHECK(leds[0] == 0x02);
+	keyboard_caps_lock::write(leds, 0);
+	CHECK(leds[0] == 0x00);
+
+	report_layout_free(layout);
+}
+
+static void check_vendor()
+{
+	const char *error;
+	using report_1 = hidapi::report<vendor, HID_API_REPORT_INPUT, 1>;
+	using report_2 = hidapi::report<vendor, HID_API_REPORT_INPUT, 2>;
+	using feature = hidapi::report<vendor, HID_API_REPORT_FEATURE, 0xF3>;
+	hid_report_layout *layout = report_layout_parse(vendor_descriptor, sizeof(vendor_descriptor), &error);
+	report_1::buffer data_1 = report_1::make();
+	report_2::buffer data_2 = report_2::make();
+	feature::buffer data_f = feature::make();
+	int values[64];
+
+	for (int n = 0; n < 1000; n++) {
+		if (!decode<report_1>(layout, HID_API_REPORT_INPUT, data_1, values, 64)
+		    || !decode<report_2>(layout, HID_API_REPORT_INPUT, data_2, values + 32, 32)) {
+			CHECK(!"hid_decode_report failed");
+			break;
+		}
+		check_usage<vendor_nibble>(vendor_nibble::read(data_1), values, 0x0003);
+		check_usage<vendor_bits>(vendor_bits::read(data_1), values, 0x000B);
+		check_usage<vendor_words>(vendor_words::read(data_2), values + 32, 0x0004);
+
+		vendor_nibble::write(data_1, static_cast<std::uint8_t>(n & 0xF));
+		CHECK(vendor_nibble::read(data_1) == (n & 0xF));
+	}
+
+	vendor_feature::write(data_f, 0x7F);
+	CHECK(data_f[0] == 0xF3 && data_f[1] == 0x7F && data_f[2] == 0x00);
+
+	report_layout_free(layout);
+}
+
+int main(int argc, char **argv)
+{
+	/* With descriptor files: only the comparison of those */
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			check_file(argv[i]);
+		if (failures) {
+			fprintf(stderr, "%d checks failed\n", failures);
+			return EXIT_FAILURE;
+		}
+		printf("%d descriptors: OK\n", argc - 1);
+		return EXIT_SUCCESS;
+	}
+
+	check_layout("mouse", mouse, mouse_descriptor, sizeof(mouse_descriptor));
+	check_layout("keyboard", keyboard, keyboard_descriptor, sizeof(keyboard_descriptor));
+	check_layout("vendor", vendor, vendor_descriptor, sizeof(vendor_descriptor));
+
+	check_mouse();
+	check_keyboard();
+	check_vendor();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,423 @@
+#if defined(_MSC_VER)
+	#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#define REPORT_LAYOUT_WITH_SCAN
+#include "../hidapi_report_layout.c"
+#include "../hidapi_descriptor_text.c"
+
+#include <errno.h>
+#include <time.h>
+
+#define MAX_DESCRIPTOR_FILES 64
+
+static size_t read_descriptor_file(const char *filename, unsigned char *descriptor, size_t max_length)
+{
+	size_t length;
+
+	if (descriptor_text_read_file(filename, descriptor, max_length, &length) < 0) {
+		fprintf(stderr, "ERROR: Couldn't open file '%s' for reading: %s\n", filename, strerror(errno));
+		return 0;
+	}
+	return length;
+}
+
+static unsigned int random_state = 0x2545F491u;
+
+/* xorshift32: the same sequence on every platform */
+static unsigned int random_next(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+static void random_fill(unsigned char *data, size_t length)
+{
+	size_t i;
+	for (i = 0; i < length; i++)
+		data[i] = (unsigned char) random_next();
+}
+
+/* The value of an element, read one bit at a time: nothing in common
+   with the decoder, SIMD or not, but the rules of hid_decode_report() */
+static int reference_value(const unsigned char *data, const struct hid_report_field *field, unsigned int element)
+{
+	unsigned int bit_size = field->bit_size < 32 ? field->bit_size : 32;
+	unsigned long bit_offset = field->bit_offset + (unsigned long) element * field->bit_size;
+	unsigned long long value = 0;
+	unsigned int k;
+
+	for (k = 0; k < bit_size; k++) {
+		unsigned long bit = bit_offset + k;
+		if ((data[bit / 8] >> (bit % 8)) & 1)
+			value |= 1ull << k;
+	}
+
+	if (field->logical_minimum < 0 && bit_size < 32 && ((value >> (bit_size - 1)) & 1))
+		return (int)((long long) value - (1ll << bit_size));
+	return (int)(unsigned int) value;
+}
+
+/* Decodes a report with hid_decode_report(), and the same report three
+   times in a row with hid_decode_reports(), against reference_value().
+   report is exactly the size of the report, for the sanitizers to catch
+   reads past its end. */
+static int check_decoding(const char *name, const struct hid_report_layout *layout, const struct hid_report_info *info, const unsigned char *report, size_t report_size)
+{
+	const unsigned char *data = report + (layout->numbered_reports ? 1 : 0);
+	size_t num_values = info->num_values;
+	int *expected = (int*) malloc((num_values + 1) * sizeof(int));
+	int *values = (int*) malloc((num_values + 1) * sizeof(int));
+	int *columns = (int*) malloc((num_values * 3 + 1) * sizeof(int));
+	unsigned char *reports = (unsigned char*) malloc(report_size * 3);
+	int result = 0;
+	size_t f, v, n;
+	int res;
+
+	if (!expected || !values || !columns || !reports) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		result = -1;
+		goto end;
+	}
+
+	for (f = 0; f < info->num_fields; f++) {
+		const struct hid_report_field *field = &layout->fields[info->first_field + f];
+		unsigned int i;
+		for (i = 0; i < field->count; i++)
+			expected[field->value_index + i] = reference_value(data, field, i);
+	}
+
+	res = hid_decode_report(layout, info->report_type, report, report_size, values, num_values);
+	if (res < 0 || (size_t) res != num_values) {
+		fprintf(stderr, "%s: hid_decode_report returned %d for report %d, expected %u values\n", name, res, info->report_id, (unsigned) num_values);
+		result = -1;
+		goto end;
+	}
+	for (v = 0; v < num_values; v++) {
+		if (values[v] != expected[v]) {
+			fprintf(stderr, "%s: report %d type %d: value %u is %d, expected %d\n", name, info->report_id, (int) info->report_type, (unsigned) v, values[v], expected[v]);
+			result = -1;
+			goto end;
+		}
+	}
+
+	for (n = 0; n < 3; n++)
+		memcpy(reports + n * report_size, report, report_size);
+	res = hid_decode_reports(layout, info->report_type, info->report_id, reports, report_size, 3, columns, 3);
+	if (res < 0 || (size_t) res != num_values) {
+		fprintf(stderr, "%s: hid_decode_reports returned %d for report %d, expected %u values\n", name, res, info->report_id, (unsigned) num_values);
+		result = -1;
+		goto end;
+	}
+	for (v = 0; v < num_values; v++) {
+		for (n = 0; n < 3; n++) {
+			if (columns[v * 3 + n] != expected[v]) {
+				fprintf(stderr, "%s: report %d type %d: column %u row %u is %d, expected %d\n", name, info->report_id, (int) info->report_type, (unsigned) v, (unsigned) n, columns[v * 3 + n], expected[v]);
+				result = -1;
+				goto end;
+			}
+		}
+	}
+
+end:
+	free(expected);
+	free(values);
+	free(columns);
+	free(reports);
+	return result;
+}
+
+/* Decodes every report of a layout, filled with random data */
+static int check_layout_decoding(const char *name, const struct hid_report_layout *layout)
+{
+	int result = 0;
+	size_t i;
+
+	for (i = 0; i < layout->num_reports; i++) {
+		const struct hid_report_info *info = &layout->reports[i];
+		size_t report_size = (info->bit_length + 7) / 8 + (layout->numbered_reports ? 1 : 0);
+		unsigned char *report;
+
+		if (report_size == 0)
+			continue;
+		report = (unsigned char*) malloc(report_size);
+		if (!report)
+			return -1;
+		random_fill(report, report_size);
+		if (layout->numbered_reports)
+			report[0] = info->report_id;
+		if (check_decoding(name, layout, info, report, report_size) < 0)
+			result = -1;
+		free(report);
+	}
+
+	return result;
+}
+
+static void put_item(unsigned char *descriptor, size_t *length, unsigned int type, unsigned int tag, unsigned int value, unsigned int size)
+{
+	unsigned int i;
+
+	descriptor[(*length)++] = (unsigned char)((tag << 4) | (type << 2) | (size == 4 ? 3 : size));
+	for (i = 0; i < size; i++)
+		descriptor[(*length)++] = (unsigned char)(value >> (8 * i));
+}
+
+/* A descriptor of random fields, with the sizes the decoder has SIMD
+   paths for (1, 8, 12 and 16 bits) more often than the others, at byte
+   boundaries or not. It fits in HID_API_MAX_REPORT_DESCRIPTOR_SIZE. */
+static size_t random_descriptor(unsigned char *descriptor)
+{
+	static const unsigned int common_sizes[] = { 1, 8, 12, 16 };
+	int numbered = random_next() % 2;
+	unsigned int num_reports = numbered ? 1 + random_next() % 4 : 1;
+	size_t length = 0;
+	unsigned int r, i;
+
+	put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_USAGE_PAGE, 0x01, 1);
+	put_item(descriptor, &length, REPORT_LAYOUT_TYPE_LOCAL, REPORT_LAYOUT_LOCAL_USAGE, 0x00, 1);
+	put_item(descriptor, &length, REPORT_LAYOUT_TYPE_MAIN, REPORT_LAYOUT_MAIN_COLLECTION, 0x01, 1);
+	put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_USAGE_PAGE, 0x09, 1);
+
+	for (r = 0; r < num_reports; r++) {
+		static const unsigned int main_tags[] = { REPORT_LAYOUT_MAIN_INPUT, REPORT_LAYOUT_MAIN_OUTPUT, REPORT_LAYOUT_MAIN_FEATURE };
+		unsigned int main_tag = main_tags[random_next() % 3];
+		unsigned int num_items = 1 + random_next() % 6;
+
+		if (numbered)
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_REPORT_ID, 1 + r * 61, 1);
+
+		for (i = 0; i < num_items; i++) {
+			unsigned int bit_size = random_next() % 3 ? common_sizes[random_next() % 4] : 1 + random_next() % 40;
+			unsigned int count = 1 + random_next() % 24;
+			unsigned int minimum_size = 1u << (random_next() % 3);
+
+			if (random_next() % 4 == 0) {
+				/* Padding, which moves the next field off a byte boundary */
+				put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_REPORT_SIZE, 1 + random_next() % 7, 1);
+				put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_REPORT_COUNT, 1, 1);
+				put_item(descriptor, &length, REPORT_LAYOUT_TYPE_MAIN, main_tag, 0x01, 1);
+			}
+
+			/* A Logical Minimum of -1 or 0, for signed or unsigned elements */
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_LOGICAL_MINIMUM, random_next() % 2 ? 0xFFFFFFFFu : 0, minimum_size);
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_LOGICAL_MAXIMUM, 0x7F, 1);
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_LOCAL, REPORT_LAYOUT_LOCAL_USAGE_MINIMUM, 1, 1);
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_LOCAL, REPORT_LAYOUT_LOCAL_USAGE_MAXIMUM, count, 1);
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_REPORT_SIZE, bit_size, 1);
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_GLOBAL, REPORT_LAYOUT_GLOBAL_REPORT_COUNT, count, 1);
+			/* Variable or array elements */
+			put_item(descriptor, &length, REPORT_LAYOUT_TYPE_MAIN, main_tag, random_next() % 2 ? 0x02 : 0x00, 1);
+		}
+	}
+
+	put_item(descriptor, &length, REPORT_LAYOUT_TYPE_MAIN, REPORT_LAYOUT_MAIN_END_COLLECTION, 0, 0);
+	return length;
+}
+
+/* Decodes random reports of random layouts against reference_value() */
+static int check_random_layouts(size_t iterations)
+{
+	static unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	size_t n;
+
+	for (n = 0; n < iterations; n++) {
+		size_t length = random_descriptor(descriptor);
+		const char *error;
+		struct hid_report_layout *layout = report_layout_parse(descriptor, length, &error);
+		char name[64];
+		int res;
+
+		snprintf(name, sizeof(name), "random layout %u", (unsigned) n);
+		if (!layout) {
+			fprintf(stderr, "%s: report_layout_parse failed: %s\n", name, error);
+			return -1;
+		}
+		res = check_layout_decoding(name, layout);
+		report_layout_free(layout);
+		if (res < 0)
+			return -1;
+	}
+
+	printf("%u random layouts decoded as expected\n", (unsigned) iterations);
+	return 0;
+}
+
+/* Checks report_layout_scan() and report_layout_parse() against each
+   other, and against the top-level usage pair the file is named after. */
+static int check_descriptor(const char *filename, const unsigned char *descriptor, size_t length, unsigned short usage_page, unsigned short usage)
+{
+	struct report_layout_summary summary;
+	struct hid_report_layout *layout;
+	const char *error;
+	size_t max_report_size[REPORT_LAYOUT_NUM_TYPES] = { 0, 0, 0 };
+	int found = 0;
+	int result = 0;
+	size_t i;
+
+	if (report_layout_scan(descriptor, length, &summary) < 0) {
+		fprintf(stderr, "%s: report_layout_scan failed\n", filename);
+		return -1;
+	}
+	if (summary.malformed) {
+		fprintf(stderr, "%s: descriptor scanned as malformed\n", filename);
+		result = -1;
+	}
+	for (i = 0; i < summary.num_usage_pairs; i++) {
+		if (summary.usage_pairs[i].usage_page == usage_page && summary.usage_pairs[i].usage == usage)
+			found = 1;
+	}
+	if (!found) {
+		fprintf(stderr, "%s: usage pair 0x%04hx/0x%04hx not found in %u pairs\n", filename, usage_page, usage, (unsigned) summary.num_usage_pairs);
+		result = -1;
+	}
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		fprintf(stderr, "%s: report_layout_parse failed: %s\n", filename, error);
+		free(summary.usage_pairs);
+		return -1;
+	}
+
+	if (layout->numbered_reports != summary.numbered_reports) {
+		fprintf(stderr, "%s: numbered reports differ: %d (layout) vs %d (scan)\n", filename, layout->numbered_reports, summary.numbered_reports);
+		result = -1;
+	}
+
+	for (i = 0; i < layout->num_reports; i++) {
+		const struct hid_report_info *info = &layout->reports[i];
+		size_t report_size = (info->bit_length + 7) / 8 + (layout->numbered_reports ? 1 : 0);
+
+		if (report_size > max_report_size[info->report_type])
+			max_report_size[info->report_type] = report_size;
+	}
+
+	if (check_layout_decoding(filename, layout) < 0)
+		result = -1;
+
+	for (i = 0; i < REPORT_LAYOUT_NUM_TYPES; i++) {
+		if (max_report_size[i] != summary.max_report_size[i]) {
+			fprintf(stderr, "%s: largest report of type %u differs: %u bytes (layout) vs %u bytes (scan)\n", filename, (unsigned) i, (unsigned) max_report_size[i], (unsigned) summary.max_report_size[i]);
+			result = -1;
+		}
+	}
+
+	report_layout_free(layout);
+	free(summary.usage_pairs);
+	return result;
+}
+
+static double elapsed_ns(clock_t start, size_t iterations)
+{
+	return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (double) iterations;
+}
+
+/* Times the scan, the layout compilation and the decoding of every
+   input report, per descriptor of the corpus. */
+static int benchmark(int num_files, char **filenames, size_t iterations)
+{
+	static unsigned char descriptors[MAX_DESCRIPTOR_FILES][HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	static unsigned char report[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	static int values[HID_API_MAX_REPORT_DESCRIPTOR_SIZE * 8];
+	struct hid_report_layout *layouts[MAX_DESCRIPTOR_FILES];
+	size_t lengths[MAX_DESCRIPTOR_FILES];
+	size_t total_length = 0, num_reports = 0;
+	volatile size_t sink = 0;
+	const char *error;
+	clock_t start;
+	size_t n, i, r;
+	int f;
+
+	if (num_files > MAX_DESCRIPTOR_FILES)
+		num_files = MAX_DESCRIPTOR_FILES;
+
+	for (f = 0; f < num_files; f++) {
+		lengths[f] = read_descriptor_file(filenames[f], descriptors[f], sizeof(descriptors[f]));
+		total_length += lengths[f];
+		layouts[f] = report_layout_parse(descriptors[f], lengths[f], &error);
+		if (!layouts[f]) {
+			fprintf(stderr, "%s: report_layout_parse failed: %s\n", filenames[f], error);
+			return -1;
+		}
+	}
+
+	printf("%d descriptors, %u bytes on average, %u iterations\n", num_files, (unsigned)(total_length / (num_files ? num_files : 1)), (unsigned) iterations);
+
+	start = clock();
+	for (n = 0; n < iterations; n++) {
+		for (f = 0; f < num_files; f++) {
+			struct report_layout_summary summary;
+			report_layout_scan(descriptors[f], lengths[f], &summary);
+			sink += summary.num_usage_pairs + summary.max_report_size[HID_API_REPORT_INPUT];
+			free(summary.usage_pairs);
+		}
+	}
+	printf("report_layout_scan:   %8.0f ns per descriptor\n", elapsed_ns(start, iterations * num_files));
+
+	start = clock();
+	for (n = 0; n < iterations; n++) {
+		for (f = 0; f < num_files; f++) {
+			struct hid_report_layout *layout = report_layout_parse(descriptors[f], lengths[f], &error);
+			sink += layout ? layout->num_fields : 0;
+			report_layout_free(layout);
+		}
+	}
+	printf("report_layout_parse:  %8.0f ns per descriptor\n", elapsed_ns(start, iterations * num_files));
+
+	memset(report, 0x5A, sizeof(report));
+	start = clock();
+	for (n = 0; n < iterations; n++) {
+		for (f = 0; f < num_files; f++) {
+			for (r = 0; r < layouts[f]->num_reports; r++) {
+				const struct hid_report_info *info = &layouts[f]->reports[r];
+				if (info->report_type != HID_API_REPORT_INPUT)
+					continue;
+				report[0] = info->report_id;
+				sink += (size_t) hid_decode_report(layouts[f], HID_API_REPORT_INPUT, report, (info->bit_length + 7) / 8 + 1, values, sizeof(values) / sizeof(values[0]));
+				if (n == 0)
+					num_reports++;
+			}
+		}
+	}
+	printf("hid_decode_report:    %8.0f ns per input report\n", elapsed_ns(start, iterations * (num_reports ? num_reports : 1)));
+
+	for (i = 0; i < (size_t) num_files; i++)
+		report_layout_free(layouts[i]);
+	(void) sink;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	unsigned long usage_page, usage;
+	size_t length;
+
+	if (argc >= 3 && strcmp(argv[1], "--benchmark") == 0) {
+		return benchmark(argc - 2, argv + 2, 2000) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "--random") == 0) {
+		return check_random_layouts(strtoul(argv[2], NULL, 10)) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <descriptor.rpt_desc> <usage_page> <usage>\n", argv[0]);
+		fprintf(stderr, "       %s --benchmark <descriptor.rpt_desc>...\n", argv[0]);
+		fprintf(stderr, "       %s --random <iterations>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	length = read_descriptor_file(argv[1], descriptor, sizeof(descriptor));
+	if (length == 0) {
+		fprintf(stderr, "%s: no descriptor bytes found\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	usage_page = strtoul(argv[2], NULL, 16);
+	usage = strtoul(argv[3], NULL, 16);
+
+	return check_descriptor(argv[1], descriptor, length, (unsigned short) usage_page, (unsigned short) usage) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -27,6 +27,7 @@
 #ifndef HIDAPI_H__
 #define HIDAPI_H__
 
+#include <stdint.h>
 #include <wchar.h>
 
 /* #480: this is to be refactored properly for v1.0 */
@@ -251,6 +252,134 @@ extern "C" {
 		*/
 		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id);
 
+		/** @brief String fields of struct #hid_device_info,
+			see @ref hid_enumerate_fields.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** hid_device_info::serial_number */
+			HID_API_DEVICE_INFO_SERIAL_NUMBER = (1 << 0),
+			/** hid_device_info::manufacturer_string */
+			HID_API_DEVICE_INFO_MANUFACTURER_STRING = (1 << 1),
+			/** hid_device_info::product_string */
+			HID_API_DEVICE_INFO_PRODUCT_STRING = (1 << 2),
+			/** All of the above, what hid_enumerate() fills */
+			HID_API_DEVICE_INFO_ALL_STRINGS = (1 << 3) - 1
+		} hid_device_info_field;
+
+		/** @brief Enumerate the HID Devices, with only the requested strings.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Works like hid_enumerate(), but only the string fields
+			given in @p fields are guaranteed to be filled, the others
+			may be NULL. Getting the strings is the most expensive part
+			of the enumeration on some platforms (e.g. with libusb, where
+			it takes opening the device and requesting string descriptors;
+			on Windows, where it takes a request to the device per string),
+			so a scan which only needs the path, the IDs, the interface
+			number, the usage and the bus type is done with 0.
+
+			@ingroup API
+			@param vendor_id The Vendor ID (VID) of the types of device
+				to open, or 0 for any vendor.
+			@param product_id The Product ID (PID) of the types of
+				device to open, or 0 for any product.
+			@param fields Bitwise or of the string fields to fill,
+				see @ref hid_device_info_field.
+
+			@returns
+				This function returns a pointer to a linked list of type
+				struct #hid_device_info, or NULL in the case of failure
+				or if no HID devices present in the system.
+				Call hid_error(NULL) to get the failure reason.
+
+			@note The returned value by this function must to be freed by calling hid_free_enumeration(),
+			      when not needed anymore.
+		*/
+		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_fields(unsigned short vendor_id, unsigned short product_id, int fields);
+
+		/** @brief The criteria of struct #hid_enumerate_filter
+			which are only checked when requested.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** hid_enumerate_filter::usage_page */
+			HID_API_FILTER_USAGE_PAGE = (1 << 0),
+			/** hid_enumerate_filter::usage */
+			HID_API_FILTER_USAGE = (1 << 1),
+			/** hid_enumerate_filter::bus_type */
+			HID_API_FILTER_BUS_TYPE = (1 << 2),
+			/** hid_enumerate_filter::interface_number */
+			HID_API_FILTER_INTERFACE_NUMBER = (1 << 3)
+		} hid_enumerate_filter_match;
+
+		/** @brief The records to return from hid_enumerate_ex().
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			A record has to match all of the criteria.
+			A zero-initialized filter matches every record,
+			but without any of the strings.
+
+			@ingroup API
+		*/
+		struct hid_enumerate_filter {
+			/** Device Vendor ID, 0 for any vendor */
+			unsigned short vendor_id;
+			/** Device Product ID, 0 for any product */
+			unsigned short product_id;
+			/** Usage Page, checked with #HID_API_FILTER_USAGE_PAGE */
+			unsigned short usage_page;
+			/** Usage, checked with #HID_API_FILTER_USAGE */
+			unsigned short usage;
+			/** Underlying bus type, checked with #HID_API_FILTER_BUS_TYPE */
+			hid_bus_type bus_type;
+			/** USB interface number, checked with #HID_API_FILTER_INTERFACE_NUMBER
+			    (-1 matches the devices which are not USB interfaces) */
+			int interface_number;
+			/** The beginning of the Serial Number, NULL for any */
+			const wchar_t *serial_number_prefix;
+			/** Bitwise or of the criteria above to check,
+			    see @ref hid_enumerate_filter_match */
+			int match;
+			/** Bitwise or of the string fields to fill,
+			    see @ref hid_device_info_field */
+			int fields;
+		};
+
+		/** @brief Enumerate the HID Devices matching a filter.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Works like hid_enumerate_fields(), but returns only the
+			records matching @p filter. The criteria are checked as soon
+			as the backend knows the value, so devices which don't match
+			are mostly skipped before their strings and report descriptor
+			are read (the serial number is the exception:
+			it has to be read to check hid_enumerate_filter::serial_number_prefix,
+			and is then returned even if not requested).
+
+			@ingroup API
+			@param filter The records to return.
+
+			@returns
+				This function returns a pointer to a linked list of type
+				struct #hid_device_info, or NULL in the case of failure
+				or if no HID devices match the filter.
+				Call hid_error(NULL) to get the failure reason.
+
+			@note The returned value by this function must to be freed by calling hid_free_enumeration(),
+			      when not needed anymore.
+		*/
+		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_ex(const struct hid_enumerate_filter *filter);
+
 		/** @brief Free an enumeration Linked List
 
 			This function frees a linked list created by hid_enumerate().
@@ -261,6 +390,197 @@ extern "C" {
 		*/
 		void  HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *devs);
 
+		/** @brief Enable or disable the enumeration cache.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			While the cache is enabled, HIDAPI keeps the records of
+			all of the HID devices of the system, and keeps them up to
+			date with the device arrival and removal notifications of
+			the OS. hid_enumerate() and its variants then only copy
+			the matching records, probing only the devices which
+			were added or changed since the previous call.
+			hid_open() doesn't use the cache: it looks the device
+			up directly, without building an enumeration.
+
+			The cache is process-wide and is disabled by hid_exit().
+			It is available with the Linux hidraw backend and, where
+			libusb supports hotplug, with the libusb backend.
+
+			@ingroup API
+			@param enable Non-zero to enable the cache, 0 to disable it
+				and free the cached records.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable);
+
+		/** @brief Enable or disable the report descriptor cache.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			While the cache is enabled, HIDAPI keeps each distinct
+			report descriptor it gets, along with its top-level usage
+			pairs, keyed by the identity of the device (bus type,
+			VID, PID, release number and interface number) and the
+			length of the descriptor. Each of them is then only
+			fetched and parsed once per process:
+
+			- With the libusb backend, opening a device,
+			  hid_get_report_descriptor() and the enumeration of
+			  the usages (with INVASIVE_GET_USAGE) make no control
+			  transfer for a descriptor already in the cache.
+			- With the Linux hidraw backend, hid_enumerate() only
+			  parses the usages of a descriptor it has not seen
+			  yet, or which is not the same as the cached one.
+
+			Devices with the same identity are assumed to have the
+			same report descriptor.
+
+			The cache is process-wide and is disabled by hid_exit().
+			It is available with the Linux hidraw and libusb backends.
+
+			@ingroup API
+			@param enable Non-zero to enable the cache, 0 to disable it
+				and free the cached descriptors.
+			@param path A file to persist the cache in, or NULL.
+				When enabling, the descriptors it holds (if it exists)
+				are loaded into the cache. When the cache is disabled,
+				all of the cached descriptors are written to it.
+
+			@returns
+				This function returns 0 on success and -1 on error
+				(the cache is enabled even if @p path can't be read).
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_report_descriptor_cache(int enable, const char *path);
+
+		/** @brief Callback handle.
+
+			Callbacks handles are generated by hid_hotplug_register_callback()
+			and can be used to deregister callbacks. Callback handles are unique
+			and it is safe to call hid_hotplug_deregister_callback() on
+			an already deregistered callback.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef int hid_hotplug_callback_handle;
+
+		/** @brief Hotplug events
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** A device has been plugged in and is ready to use */
+			HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED = (1 << 0),
+
+			/** A device has left and is no longer available.
+				It is the user's responsibility to call hid_close with a disconnected device.
+			*/
+			HID_API_HOTPLUG_EVENT_DEVICE_LEFT = (1 << 1)
+		} hid_hotplug_event;
+
+		/** @brief Hotplug flags
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** Arm the callback and fire it for all matching currently attached devices. */
+			HID_API_HOTPLUG_ENUMERATE = (1 << 0)
+		} hid_hotplug_flag;
+
+		/** @brief Hotplug callback function type.
+
+			When requesting hotplug event notifications, you pass a pointer to
+			a callback function of this type.
+
+			The callback is called on the hotplug thread of HIDAPI, one
+			event at a time. It may call hid_hotplug_register_callback()
+			and hid_hotplug_deregister_callback(), but not hid_exit().
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param callback_handle The hid_hotplug_callback_handle callback handle.
+			@param device The hid_device_info of device this event occurred on.
+				It is only valid until the callback returns.
+			@param event Event that occurred.
+			@param user_data User data provided when this callback was registered.
+
+			@returns
+				Returning non-zero deregisters the callback,
+				so it is not called anymore.
+		*/
+		typedef int (HID_API_CALL *hid_hotplug_callback_fn)(
+			hid_hotplug_callback_handle callback_handle,
+			struct hid_device_info *device,
+			hid_hotplug_event event,
+			void *user_data);
+
+		/** @brief Register a HID hotplug callback function.
+
+			If @p vendor_id is set to 0 then any vendor matches.
+			If @p product_id is set to 0 then any product matches.
+			If @p vendor_id and @p product_id are both set to 0, then all HID devices will be notified.
+
+			With @ref HID_API_HOTPLUG_ENUMERATE, the callback is first
+			called with @ref HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED for each
+			of the matching devices which are already connected. Like all
+			other events, these calls are made on the hotplug thread,
+			possibly after this function returned.
+
+			The hotplug thread is started by the first registration and
+			is stopped by hid_exit().
+
+			Available with the Linux hidraw backend and, where libusb
+			supports hotplug, with the libusb backend.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param vendor_id The Vendor ID (VID) of the types of device to notify about.
+			@param product_id The Product ID (PID) of the types of device to notify about.
+			@param events Bitwise or of hotplug events that will trigger this callback.
+				See @ref hid_hotplug_event.
+			@param flags Bitwise or of hotplug flags that affect registration.
+				See @ref hid_hotplug_flag.
+			@param callback The callback function that will be called on device connection/disconnection.
+				See @ref hid_hotplug_callback_fn.
+			@param user_data The user data you wanted to provide to your callback function.
+			@param callback_handle Pointer to store the handle of the allocated callback, may be NULL.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle);
+
+		/** @brief Deregister a callback from a HID hotplug.
+
+			Once this function returns, the callback is not called
+			anymore. A call already in progress on the hotplug thread
+			may still be running though, unless this function is
+			called from that very callback.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param callback_handle The handle of the callback to deregister.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle);
+
 		/** @brief Open a HID device using a Vendor ID (VID), Product ID
 			(PID) and optionally a serial number.
 
@@ -380,6 +700,185 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length);
 
+		/** @brief Read an Input report from a HID device with timeout,
+			along with the time the report arrived.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Same as hid_read_timeout(), and also returns the time
+			the report arrived, in nanoseconds of the monotonic clock
+			of the platform. Comparing it with the current time of the
+			same clock tells how long the report was queued.
+
+			 - libusb, Linux hidraw, NetBSD: CLOCK_MONOTONIC, taken when
+			   the transfer completed (libusb) or right after the report
+			   was read from the kernel (hidraw, uhid), which queues the
+			   reports before that without timestamps.
+			 - macOS: mach_absolute_time(), taken when IOKit delivered
+			   the report.
+			 - Windows: QueryPerformanceCounter(), taken when the read
+			   of the report completed.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param data A buffer to put the read data into.
+			@param length The number of bytes to read. For devices with
+				multiple reports, make sure to read an extra byte for
+				the report number.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+			@param timestamp Receives the arrival time of the report,
+				in nanoseconds, if a report was read.
+
+			@returns
+				This function returns the actual number of bytes read and
+				-1 on error.
+				Call hid_read_error(dev) to get the failure reason.
+				If no packet was available to be read within
+				the timeout period, this function returns 0.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_timestamped(hid_device *dev, unsigned char *data, size_t length, int milliseconds, uint64_t *timestamp);
+
+		/** @brief A buffer for one Input report, for hid_read_many().
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		struct hid_input_report_buffer {
+			/** A buffer to put the read data into, set by the caller */
+			unsigned char *data;
+			/** The size of @p data, set by the caller. For devices with
+			    multiple reports, make sure to read an extra byte for
+			    the report number. */
+			size_t length;
+			/** The actual number of bytes read, set by hid_read_many() */
+			size_t bytes_read;
+			/** When the report arrived, set by hid_read_many(),
+			    see hid_read_timestamped() */
+			uint64_t timestamp;
+		};
+
+		/** @brief Read several Input reports from a HID device at once, with timeout.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Waits for an Input report just like hid_read_timeout() does,
+			then also returns the reports which are already queued,
+			up to @p count reports in total, without waiting any further.
+			This way, a consumer of a high-rate stream of reports pays for
+			the locking (libusb) or the system calls (hidraw) once per
+			batch instead of once per report.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param reports An array of @p count buffers. The reports are
+				stored in the order they were received, starting with
+				reports[0]. The number of bytes of each report is stored
+				in its @ref hid_input_report_buffer::bytes_read, and its
+				arrival time in @ref hid_input_report_buffer::timestamp.
+			@param count The number of elements in @p reports.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the number of reports read and
+				-1 on error.
+				Call hid_read_error(dev) to get the failure reason.
+				If no report was available to be read within
+				the timeout period, this function returns 0.
+				If an error occurs after some of the reports are read,
+				those are returned and the error is reported by the next call.
+
+			@note This function doesn't change the buffer returned by the hid_error(dev).
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_many(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds);
+
+		/** @brief Callback receiving the Input reports of a device,
+			see hid_set_input_callback().
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param dev The device the report was received from.
+			@param data The report. The first byte contains the Report
+				number if the device uses numbered reports. The buffer
+				is only valid until the callback returns.
+			@param length The length of the report in bytes.
+			@param user_data The pointer passed to hid_set_input_callback().
+		*/
+		typedef void (HID_API_CALL *hid_input_callback)(hid_device *dev, const unsigned char *data, size_t length, void *user_data);
+
+		/** @brief Have the Input reports of a device passed to a callback
+			as soon as they are received, instead of being queued.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			The callback is called on a thread owned by HIDAPI:
+			 - libusb: the event thread shared by all of the devices,
+			   straight from the transfer completion, so the callback
+			   should return quickly and must not call hid_close().
+			 - Linux hidraw: a reader thread started for the device.
+			 - macOS: the read thread of the device.
+
+			Reports which are already queued stay in the queue and can
+			still be read with hid_read(). Reports received while a
+			callback is set are not queued: don't mix both ways of
+			reading. After hid_close() returns, the callback is
+			not called anymore.
+
+			When this function returns, the previous callback is not
+			running anymore and is not going to be called again, so
+			its @p user_data can be released. Called from the callback
+			itself, this function doesn't wait for it to return, of course.
+
+			Not supported on Windows and NetBSD.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param callback The callback, or NULL to queue the
+				reports again.
+			@param user_data Passed to @p callback.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_input_callback(hid_device *dev, hid_input_callback callback, void *user_data);
+
+		/** @brief Get a file descriptor which can be polled for Input reports.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			The file descriptor becomes readable (POLLIN) when hid_read()
+			would not block, i.e. when there is an Input report to read
+			or an error to report. This lets a single event loop
+			(poll/epoll/select) wait on many devices without a blocking
+			reader thread per device. Only wait for readability, then call
+			hid_read() (usually in non-blocking mode, see
+			hid_set_nonblocking()) until it returns 0:
+			don't read from the file descriptor directly.
+
+			 - Linux hidraw: the hidraw file descriptor of the device.
+			 - libusb: an eventfd (a pipe where there is no eventfd),
+			   created on the first call. It stays readable for as long
+			   as the input report queue isn't empty, so it can be used
+			   both edge- and level-triggered.
+			 - NetBSD: the uhid file descriptor, if the device has a
+			   single one.
+
+			Not supported on Windows and macOS.
+
+			The file descriptor is owned by HIDAPI and closed by hid_close().
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+
+			@returns
+				This function returns the file descriptor on success
+				and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_pollable_fd(hid_device *dev);
+
 		/** @brief Get a string describing the last error which occurred during hid_read/hid_read_timeout.
 
 			Since version 0.15.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 15, 0)
@@ -423,6 +922,86 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonblock);
 
+		/** @brief What happens to an Input report which arrives while
+			the input report queue of a device is full.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** Discard the oldest queued report to make room for the new one.
+			    This is the default. */
+			HID_API_INPUT_QUEUE_DROP_OLDEST = 0,
+
+			/** Discard the new report, keeping the queued ones. */
+			HID_API_INPUT_QUEUE_DROP_NEWEST = 1,
+
+			/** Stop reading from the device until a report is read
+			    from the queue. No report is discarded: the device
+			    has to hold back its reports in the meantime. */
+			HID_API_INPUT_QUEUE_BLOCK = 2,
+
+			/** Keep only the latest report for each Report ID:
+			    a queued report with the same Report ID is replaced
+			    with the new one. Reports with a Report ID which is
+			    not queued yet are handled as with
+			    @ref HID_API_INPUT_QUEUE_DROP_OLDEST. */
+			HID_API_INPUT_QUEUE_CONFLATE = 3,
+		} hid_input_queue_policy;
+
+		/** @brief Set the depth and the overflow policy of the input report queue of a device.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Input reports received from the device are queued until
+			they are read with hid_read()/hid_read_timeout().
+			The queue can be reconfigured at any time; if it holds more
+			than @p max_reports reports at that time, the oldest ones
+			are discarded.
+
+			Not all backends support all of the policies. The libusb
+			and macOS backends support all of them, except for
+			@ref HID_API_INPUT_QUEUE_BLOCK on macOS. On Windows,
+			the queue is kept by the OS and only
+			@ref HID_API_INPUT_QUEUE_DROP_OLDEST is supported.
+			The Linux hidraw kernel driver has a fixed queue,
+			which cannot be configured.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param max_reports The maximum number of queued reports, at least 1.
+			@param policy What to do with a report which arrives while
+				the queue is full, see @ref hid_input_queue_policy.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_input_queue(hid_device *dev, size_t max_reports, hid_input_queue_policy policy);
+
+		/** @brief Get the number of Input reports which were discarded
+			because the input report queue of a device was full.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			The count includes reports replaced with a newer one under
+			@ref HID_API_INPUT_QUEUE_CONFLATE. It only covers the
+			queue kept by HIDAPI itself, so it is not available where
+			the queue is kept by the OS (Windows, Linux hidraw).
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param dropped Receives the number of reports discarded since
+				the device was opened or the count was last reset.
+			@param reset If non-zero, the count is reset to 0.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_input_reports_dropped(hid_device *dev, size_t *dropped, int reset);
+
 		/** @brief Send a Feature report to the device.
 
 			Feature reports are sent over the Control endpoint as a
@@ -634,6 +1213,274 @@ extern "C" {
 		*/
 		int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char *buf, size_t buf_size);
 
+		/** @brief The type of a report.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** Input report, see @ref hid_read */
+			HID_API_REPORT_INPUT = 0,
+			/** Output report, see @ref hid_write */
+			HID_API_REPORT_OUTPUT = 1,
+			/** Feature report, see @ref hid_get_feature_report */
+			HID_API_REPORT_FEATURE = 2
+		} hid_api_report_type;
+
+		/** @brief The flags of struct #hid_report_field, the data
+			of its Input, Output or Feature item
+			(see USB HID Specification, section 6.2.2.5).
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/** Constant (padding) rather than Data */
+			HID_API_FIELD_CONSTANT = (1 << 0),
+			/** Variable rather than Array */
+			HID_API_FIELD_VARIABLE = (1 << 1),
+			/** Relative rather than Absolute */
+			HID_API_FIELD_RELATIVE = (1 << 2),
+			/** Wrap rather than No Wrap */
+			HID_API_FIELD_WRAP = (1 << 3),
+			/** Non Linear rather than Linear */
+			HID_API_FIELD_NON_LINEAR = (1 << 4),
+			/** No Preferred rather than Preferred State */
+			HID_API_FIELD_NO_PREFERRED = (1 << 5),
+			/** Null State rather than No Null position */
+			HID_API_FIELD_NULL_STATE = (1 << 6),
+			/** Volatile rather than Non Volatile */
+			HID_API_FIELD_VOLATILE = (1 << 7),
+			/** Buffered Bytes rather than Bit Field */
+			HID_API_FIELD_BUFFERED_BYTES = (1 << 8)
+		} hid_report_field_flag;
+
+		/** @brief A field of a report: one or more elements of the
+			same size, as declared by an Input, Output or Feature item.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			For a variable field (@ref HID_API_FIELD_VARIABLE), element i
+			holds the value of usage hid_report_field::usage_minimum + i, up to
+			hid_report_field::usage_maximum (the last elements of a field declared
+			with fewer usages than elements share the last one).
+			A variable field declared with a list of usages is split
+			into a field per usage.
+			For an array, each element holds the index of one of the
+			usages from hid_report_field::usage_minimum to
+			hid_report_field::usage_maximum which is active,
+			relative to hid_report_field::logical_minimum.
+
+			@ingroup API
+		*/
+		struct hid_report_field {
+			/** The type of the report the field is part of */
+			hid_api_report_type report_type;
+			/** The Report ID of the report, 0 if the device
+				does not use numbered reports */
+			unsigned char report_id;
+			/** The offset of the first element in bits, from the
+				start of the report data, after the Report ID byte
+				(if the device uses numbered reports) */
+			unsigned int bit_offset;
+			/** The size of each element in bits (Report Size) */
+			unsigned int bit_size;
+			/** The number of elements (Report Count) */
+			unsigned int count;
+			/** The smallest value of an element (Logical Minimum) */
+			int logical_minimum;
+			/** The largest value of an element (Logical Maximum) */
+			int logical_maximum;
+			/** Usage Page of the usages of the field */
+			unsigned short usage_page;
+			/** The usage of the first element, or of the first
+				choice of an array */
+			unsigned short usage_minimum;
+			/** The usage of the last element, or of the last
+				choice of an array */
+			unsigned short usage_maximum;
+			/** Bitwise or of @ref hid_report_field_flag */
+			unsigned int flags;
+			/** The index of the value of the first element in
+				the values decoded by @ref hid_decode_report */
+			size_t value_index;
+		};
+
+		/** @brief A report of struct #hid_report_layout.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		struct hid_report_info {
+			/** The type of the report */
+			hid_api_report_type report_type;
+			/** The Report ID of the report, 0 if the device
+				does not use numbered reports */
+			unsigned char report_id;
+			/** The size of the report data in bits,
+				without the Report ID byte */
+			unsigned int bit_length;
+			/** The index of the first field of the report
+				in hid_report_layout::fields */
+			size_t first_field;
+			/** The number of fields of the report */
+			size_t num_fields;
+			/** The number of values decoded by @ref hid_decode_report,
+				the sum of the counts of the fields */
+			size_t num_values;
+		};
+
+		/** @brief The fields of all of the reports of a device,
+			compiled from its report descriptor.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+		*/
+		struct hid_report_layout {
+			/** Non-zero if the device uses numbered reports,
+				in which case the first byte of each report
+				is its Report ID */
+			int numbered_reports;
+			/** The number of reports */
+			size_t num_reports;
+			/** The reports, ordered by type then by Report ID */
+			const struct hid_report_info *reports;
+			/** The number of fields */
+			size_t num_fields;
+			/** The fields of each report, by bit offset */
+			const struct hid_report_field *fields;
+		};
+
+		/** @brief Compile a report descriptor into the layout of its reports.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			The items of the descriptor are only interpreted once:
+			the resulting table tells where each field lives in each
+			report, so decoding a report takes no further parsing.
+
+			@ingroup API
+			@param descriptor A report descriptor, e.g. as returned by
+				@ref hid_get_report_descriptor.
+			@param length The length of the descriptor in bytes.
+
+			@returns
+				This function returns the layout on success and NULL
+				on error (e.g. a malformed descriptor).
+				Call hid_error(NULL) to get the failure reason.
+
+			@note The returned value by this function must to be freed by calling hid_free_report_layout(),
+			      when not needed anymore.
+		*/
+		struct hid_report_layout HID_API_EXPORT * HID_API_CALL hid_parse_report_descriptor(const unsigned char *descriptor, size_t length);
+
+		/** @brief Free a layout returned by @ref hid_parse_report_descriptor.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param layout The layout to free, may be NULL.
+		*/
+		void HID_API_EXPORT HID_API_CALL hid_free_report_layout(struct hid_report_layout *layout);
+
+		/** @brief Get the layout of the reports of a HID device.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			The report descriptor of the device is read and compiled
+			(see @ref hid_parse_report_descriptor) on the first call,
+			then the same layout is returned.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+
+			@returns
+				This function returns the layout on success and NULL
+				on error. It is owned by the device and stays valid
+				until @ref hid_close.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev);
+
+		/** @brief Decode all of the fields of a report.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Every element of every field of the report is unpacked into
+			@p values, the elements of field f starting at
+			hid_report_field::value_index. Elements of fields with a
+			negative hid_report_field::logical_minimum are sign
+			extended, other elements are zero extended; only the low
+			32 bits of elements larger than that are decoded.
+
+			Fields of 1, 8, 12 and 16 bits which start on a byte
+			boundary (e.g. button bitmaps and axes) are unpacked with
+			SIMD instructions where available (SSE2 and SSSE3 on x86),
+			unless the library is built with HIDAPI_NO_SIMD defined.
+
+			This function neither uses nor updates @ref hid_error,
+			and it may be called from several threads at once.
+
+			@ingroup API
+			@param layout The layout of the reports of the device.
+			@param type The type of the report.
+			@param data The report, as returned by e.g. @ref hid_read:
+				starting with its Report ID if the device uses
+				numbered reports.
+			@param length The length of the report in bytes.
+			@param values The decoded values.
+			@param num_values The number of elements of @p values,
+				at least hid_report_info::num_values.
+
+			@returns
+				This function returns the number of decoded values
+				(hid_report_info::num_values) on success and -1 if
+				the layout has no such report, or if @p length or
+				@p num_values are too small.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, hid_api_report_type type, const unsigned char *data, size_t length, int *values, size_t num_values);
+
+		/** @brief Decode a batch of reports into a column per value.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Decodes @p num_reports reports of the same type and Report ID,
+			as @ref hid_decode_report does, in struct-of-arrays order:
+			value v of report n is stored at
+			@p columns[v * @p column_length + n], so the successive
+			values of each element (e.g. an axis) are contiguous.
+
+			This function neither uses nor updates @ref hid_error,
+			and it may be called from several threads at once.
+
+			@ingroup API
+			@param layout The layout of the reports of the device.
+			@param type The type of the reports.
+			@param report_id The Report ID of the reports, 0 if the
+				device does not use numbered reports.
+			@param reports The reports, stored every @p report_size bytes,
+				each starting with its Report ID if the device uses
+				numbered reports.
+			@param report_size The size of each report in bytes.
+			@param num_reports The number of reports.
+			@param columns The decoded values: hid_report_info::num_values
+				columns of @p column_length elements.
+			@param column_length The length of each column, at least
+				@p num_reports.
+
+			@returns
+				This function returns the number of values of each
+				report (hid_report_info::num_values) on success and -1
+				if the layout has no such report, if @p report_size or
+				@p column_length are too small, or if one of the
+				reports has another Report ID.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_decode_reports(const struct hid_report_layout *layout, hid_api_report_type type, unsigned char report_id, const unsigned char *reports, size_t report_size, size_t num_reports, int *columns, size_t column_length);
+
 		/** @brief Get a string describing the last error which occurred.
 
 			This function is intended for logging/debugging purposes.
@@ -0,0 +1,752 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/** @file
+ * @defgroup CXX_API hidapi C++ report layout API
+ *
+ * A header-only C++17 layer over @ref hid_get_report_layout: a report
+ * descriptor known at compile time is parsed at compile time, and every
+ * field of its reports is read and written with fixed shifts and masks.
+ *
+ * @code{.cpp}
+ * static constexpr unsigned char mouse_descriptor[] = { 0x05, 0x01, 0x09, 0x02, ... };
+ * static constexpr auto mouse = hidapi::parse_report_descriptor(mouse_descriptor);
+ *
+ * using mouse_report = hidapi::report<mouse, HID_API_REPORT_INPUT, 2>;
+ * using x_axis = hidapi::report_usage<mouse, HID_API_REPORT_INPUT, 2, 0x0001, 0x0030>;
+ *
+ * mouse_report::buffer data = mouse_report::make();
+ * hid_read(dev, data.data(), data.size());
+ * int16_t x = x_axis::read(data);
+ * @endcode
+ *
+ * A usage which is not in the report, a report which is not in the
+ * descriptor, a buffer too small for the report or an invalid descriptor
+ * are compile errors.
+ */
+
+#ifndef HIDAPI_REPORT_LAYOUT_HPP__
+#define HIDAPI_REPORT_LAYOUT_HPP__
+
+#if !defined(__cplusplus) || ((defined(_MSVC_LANG) ? _MSVC_LANG : __cplusplus) < 201703L)
+#error "hidapi_report_layout.hpp requires C++17"
+#endif
+
+#include "hidapi.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace hidapi {
+
+	/** @brief The fields of all of the reports of a device, parsed at
+		compile time by @ref parse_report_descriptor.
+
+		Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+		The fields are the same as those of @ref hid_get_report_layout,
+		in the order of the descriptor rather than grouped by report.
+
+		@ingroup CXX_API
+		@tparam MaxFields The capacity of the layout, in fields.
+	*/
+	template <std::size_t MaxFields>
+	struct report_layout {
+		/** NULL for a valid descriptor, the reason it is invalid otherwise */
+		const char *error = nullptr;
+		/** Non-zero if the descriptor declares Report IDs */
+		int numbered_reports = 0;
+		/** The number of elements of @p fields in use */
+		std::size_t num_fields = 0;
+		/** The fields, as @ref hid_get_report_layout would list them */
+		hid_report_field fields[MaxFields] = {};
+
+		/** Non-zero if the descriptor has fields in that report */
+		constexpr bool has_report(hid_api_report_type type, unsigned char report_id) const noexcept
+		{
+			for (std::size_t i = 0; i < num_fields; i++) {
+				if (fields[i].report_type == type && fields[i].report_id == report_id)
+					return true;
+			}
+			return false;
+		}
+
+		/** The size of the report data in bits, without its Report ID byte */
+		constexpr unsigned int bit_length(hid_api_report_type type, unsigned char report_id) const noexcept
+		{
+			unsigned int length = 0;
+			for (std::size_t i = 0; i < num_fields; i++) {
+				const hid_report_field &field = fields[i];
+				if (field.report_type == type && field.report_id == report_id)
+					length = field.bit_offset + field.bit_size * field.count;
+			}
+			return length;
+		}
+
+		/** The size of the report in bytes, as given to or returned by
+			@ref hid_read, @ref hid_write and the feature report functions */
+		constexpr std::size_t report_size(hid_api_report_type type, unsigned char report_id) const noexcept
+		{
+			return (bit_length(type, report_id) + 7) / 8 + (numbered_reports ? 1 : 0);
+		}
+
+		/** The index of the variable field of the report with that usage,
+			or num_fields if there is none */
+		constexpr std::size_t find_usage(hid_api_report_type type, unsigned char report_id, unsigned short usage_page, unsigned short usage) const noexcept
+		{
+			for (std::size_t i = 0; i < num_fields; i++) {
+				const hid_report_field &field = fields[i];
+				if (field.report_type != type || field.report_id != report_id || field.usage_page != usage_page)
+					continue;
+				if (!(field.flags & HID_API_FIELD_VARIABLE) || (field.flags & HID_API_FIELD_CONSTANT))
+					continue;
+				if (usage >= field.usage_minimum && usage <= field.usage_maximum && static_cast<unsigned int>(usage - field.usage_minimum) < field.count)
+					return i;
+			}
+			return num_fields;
+		}
+
+		/** The index of the array field of the report which can hold
+			that usage, or num_fields if there is none */
+		constexpr std::size_t find_array(hid_api_report_type type, unsigned char report_id, unsigned short usage_page, unsigned short usage) const noexcept
+		{
+			for (std::size_t i = 0; i < num_fields; i++) {
+				const hid_report_field &field = fields[i];
+				if (field.report_type != type || field.report_id != report_id || field.usage_page != usage_page)
+					continue;
+				if (field.flags & (HID_API_FIELD_VARIABLE | HID_API_FIELD_CONSTANT))
+					continue;
+				if (usage >= field.usage_minimum && usage <= field.usage_maximum)
+					return i;
+			}
+			return num_fields;
+		}
+	};
+
+	namespace detail {
+		/* The Global items that the layout depends on */
+		struct report_globals {
+			unsigned short usage_page = 0;
+			std::uint32_t logical_minimum = 0;
+			unsigned int logical_minimum_size = 0;
+			std::uint32_t logical_maximum = 0;
+			unsigned int logical_maximum_size = 0;
+			std::uint32_t report_size = 0;
+			std::uint32_t report_count = 0;
+			unsigned char report_id = 0;
+		};
+
+		/* Usages are kept with their Usage Page in the high 16 bits
+		   when they were declared as extended (4-byte) usages */
+		struct local_usage {
+			std::uint32_t usage = 0;
+			bool extended = false;
+		};
+
+		constexpr std::size_t max_push = 16;
+		constexpr std::size_t max_usages = 256;
+
+		struct report_parser {
+			report_globals globals;
+			report_globals stack[max_push];
+			std::size_t stack_depth = 0;
+
+			local_usage usages[max_usages];
+			std::size_t num_usages = 0;
+			local_usage usage_minimum;
+			local_usage usage_maximum;
+			bool has_usage_minimum = false;
+			bool has_usage_maximum = false;
+
+			bool any_report = false;
+			unsigned int bit_length[3][256] = {};
+		};
+
+		/* Without the implementation-defined conversion of out of range values */
+		constexpr int to_signed(std::uint32_t value) noexcept
+		{
+			return value < 0x80000000u ? static_cast<int>(value) : -static_cast<int>(~value) - 1;
+		}
+
+		constexpr int sign_extend(std::uint32_t value, unsigned int size) noexcept
+		{
+			switch (size) {
+			case 1:
+				return to_signed((value & 0x80u) ? (value | 0xFFFFFF00u) : (value & 0xFFu));
+			case 2:
+				return to_signed((value & 0x8000u) ? (value | 0xFFFF0000u) : (value & 0xFFFFu));
+			default:
+				return to_signed(value);
+			}
+		}
+
+		constexpr unsigned short usage_page(const report_parser &parser, const local_usage &usage) noexcept
+		{
+			return usage.extended ? static_cast<unsigned short>(usage.usage >> 16) : parser.globals.usage_page;
+		}
+
+		/* Turns an Input, Output or Feature item into one field or more */
+		template <std::size_t MaxFields>
+		constexpr const char *main_data(report_layout<MaxFields> &layout, report_parser &parser, hid_api_report_type type, std::uint32_t data) noexcept
+		{
+			const report_globals &globals = parser.globals;
+			unsigned int &bit_length = parser.bit_length[type][globals.report_id];
+			const unsigned int flags = data & 0x1FFu;
+			const unsigned long long total_bits = static_cast<unsigned long long>(globals.report_size) * globals.report_count;
+			std::size_t num_element_fields = 0;
+			int logical_minimum = 0, logical_maximum = 0;
+
+			if (layout.numbered_reports && globals.report_id == 0)
+				return "Report descriptor has a Main item before its first Report ID";
+
+			parser.any_report = true;
+			if (total_bits == 0)
+				return nullptr;
+			if (bit_length + total_bits > (0xFFFFFFFFu >> 1))
+				return "Report descriptor declares a report which is too long";
+
+			logical_minimum = sign_extend(globals.logical_minimum, globals.logical_minimum_size);
+			/* The maximum only reads as a signed value when the minimum is negative */
+			if (logical_minimum < 0)
+				logical_maximum = sign_extend(globals.logical_maximum, globals.logical_maximum_size);
+			else
+				logical_maximum = to_signed(globals.logical_maximum);
+
+			/* A variable item with a list of usages, one per element:
+			   a field per usage, the last one taking the remaining elements */
+			if ((flags & HID_API_FIELD_VARIABLE) && parser.num_usages > 1) {
+				num_element_fields = parser.num_usages;
+				if (num_element_fields > globals.report_count)
+					num_element_fields = globals.report_count;
+			}
+
+			if (num_element_fields > 1) {
+				if (layout.num_fields + num_element_fields > MaxFields)
+					return "Report descriptor has more fields than the capacity of the report_layout";
+				for (std::size_t i = 0; i < num_element_fields; i++) {
+					hid_report_field &field = layout.fields[layout.num_fields++];
+					const local_usage &usage = parser.usages[i];
+					const unsigned int count = (i + 1 < num_element_fields) ? 1 : static_cast<unsigned int>(globals.report_count - i);
+					field.report_type = type;
+					field.report_id = globals.report_id;
+					field.bit_offset = bit_length;
+					field.bit_size = globals.report_size;
+					field.count = count;
+					field.logical_minimum = logical_minimum;
+					field.logical_maximum = logical_maximum;
+					field.usage_page = usage_page(parser, usage);
+					field.usage_minimum = static_cast<unsigned short>(usage.usage & 0xFFFFu);
+					field.usage_maximum = field.usage_minimum;
+					field.flags = flags;
+					bit_length += globals.report_size * count;
+				}
+				return nullptr;
+			}
+
+			if (layout.num_fields == MaxFields)
+				return "Report descriptor has more fields than the capacity of the report_layout";
+
+			hid_report_field &field = layout.fields[layout.num_fields++];
+			field.report_type = type;
+			field.report_id = globals.report_id;
+			field.bit_offset = bit_length;
+			field.bit_size = globals.report_size;
+			field.count = globals.report_count;
+			field.logical_minimum = logical_minimum;
+			field.logical_maximum = logical_maximum;
+			field.flags = flags;
+
+			if (parser.num_usages > 0) {
+				/* A single usage, or the list of the choices of an array */
+				const local_usage &first = parser.usages[0];
+				const local_usage &last = parser.usages[parser.num_usages - 1];
+				field.usage_page = usage_page(parser, first);
+				field.usage_minimum = static_cast<unsigned short>(first.usage & 0xFFFFu);
+				field.usage_maximum = static_cast<unsigned short>(last.usage & 0xFFFFu);
+			}
+			else if (parser.has_usage_minimum || parser.has_usage_maximum) {
+				const local_usage &minimum = parser.has_usage_minimum ? parser.usage_minimum : parser.usage_maximum;
+				const local_usage &maximum = parser.has_usage_maximum ? parser.usage_maximum : parser.usage_minimum;
+				field.usage_page = usage_page(parser, minimum);
+				field.usage_minimum = static_cast<unsigned short>(minimum.usage & 0xFFFFu);
+				field.usage_maximum = static_cast<unsigned short>(maximum.usage & 0xFFFFu);
+			}
+
+			bit_length += static_cast<unsigned int>(total_bits);
+			return nullptr;
+		}
+
+		/* Walks the items of the descriptor, the way report_layout_parse() does */
+		template <std::size_t MaxFields>
+		constexpr const char *parse_items(report_layout<MaxFields> &layout, report_parser &parser, const unsigned char *descriptor, std::size_t length) noexcept
+		{
+			std::size_t pos = 0;
+			int collection_depth = 0;
+
+			while (pos < length) {
+				const unsigned char prefix = descriptor[pos];
+				const char *error = nullptr;
+				std::uint32_t value = 0;
+
+				if (prefix == 0xFE) {
+					/* Long item: bDataSize, bLongItemTag, then the data */
+					if (length - pos < 3 || length - pos - 3 < descriptor[pos + 1])
+						return "Report descriptor has a truncated item";
+					pos += 3 + descriptor[pos + 1];
+					continue;
+				}
+
+				const unsigned int size = (prefix & 0x3u) == 3 ? 4 : (prefix & 0x3u);
+				const unsigned int type = (prefix >> 2) & 0x3u;
+				const unsigned int tag = prefix >> 4;
+				if (length - pos - 1 < size)
+					return "Report descriptor has a truncated item";
+				for (unsigned int i = 0; i < size; i++)
+					value |= static_cast<std::uint32_t>(descriptor[pos + 1 + i]) << (8 * i);
+				pos += 1 + size;
+
+				switch (type) {
+				case 0: /* Main */
+					switch (tag) {
+					case 0x8:
+						error = main_data(layout, parser, HID_API_REPORT_INPUT, value);
+						break;
+					case 0x9:
+						error = main_data(layout, parser, HID_API_REPORT_OUTPUT, value);
+						break;
+					case 0xB:
+						error = main_data(layout, parser, HID_API_REPORT_FEATURE, value);
+						break;
+					case 0xA:
+						collection_depth++;
+						break;
+					case 0xC:
+						if (collection_depth == 0)
+							error = "Report descriptor has an End Collection without a Collection";
+						else
+							collection_depth--;
+						break;
+					default:
+						break;
+					}
+					parser.num_usages = 0;
+					parser.has_usage_minimum = false;
+					parser.has_usage_maximum = false;
+					break;
+
+				case 1: /* Global */
+					switch (tag) {
+					case 0x0:
+						parser.globals.usage_page = static_cast<unsigned short>(value);
+						break;
+					case 0x1:
+						parser.globals.logical_minimum = value;
+						parser.globals.logical_minimum_size = size;
+						break;
+					case 0x2:
+						parser.globals.logical_maximum = value;
+						parser.globals.logical_maximum_size = size;
+						break;
+					case 0x7:
+						parser.globals.report_size = value;
+						break;
+					case 0x8:
+						if (value == 0 || value > 0xFF)
+							error = "Report descriptor has an invalid Report ID";
+						else if (!layout.numbered_reports && parser.any_report)
+							error = "Report descriptor has a Main item before its first Report ID";
+						else {
+							layout.numbered_reports = 1;
+							parser.globals.report_id = static_cast<unsigned char>(value);
+						}
+						break;
+					case 0x9:
+						parser.globals.report_count = value;
+						break;
+					case 0xA:
+						if (parser.stack_depth == max_push)
+							error = "Report descriptor has too many nested Push items";
+						else
+							parser.stack[parser.stack_depth++] = parser.globals;
+						break;
+					case 0xB:
+						if (parser.stack_depth == 0)
+							error = "Report descriptor has a Pop item without a Push";
+						else
+							parser.globals = parser.stack[--parser.stack_depth];
+						break;
+					default:
+						break;
+					}
+					break;
+
+				case 2: /* Local */
+					switch (tag) {
+					case 0x0:
+						if (parser.num_usages == max_usages) {
+							error = "Report descriptor has too many usages in a Main item";
+							break;
+						}
+						parser.usages[parser.num_usages].usage = value;
+						parser.usages[parser.num_usages].extended = (size == 4);
+						parser.num_usages++;
+						break;
+					case 0x1:
+						parser.usage_minimum.usage = value;
+						parser.usage_minimum.extended = (size == 4);
+						parser.has_usage_minimum = true;
+						break;
+					case 0x2:
+						parser.usage_maximum.usage = value;
+						parser.usage_maximum.extended = (size == 4);
+						parser.has_usage_maximum = true;
+						break;
+					default:
+						break;
+					}
+					break;
+
+				default:
+					/* The reserved item type */
+					break;
+				}
+
+				if (error)
+					return error;
+			}
+
+			return nullptr;
+		}
+
+		template <unsigned int Bits, bool Signed>
+		using report_value_t =
+			std::conditional_t<(Bits <= 8), std::conditional_t<Signed, std::int8_t, std::uint8_t>,
+			std::conditional_t<(Bits <= 16), std::conditional_t<Signed, std::int16_t, std::uint16_t>,
+			std::conditional_t<Signed, std::int32_t, std::uint32_t>>>;
+
+		/* Reads Bits bits (at most 32) at bit Shift of data[ByteOffset],
+		   least significant first */
+		template <std::size_t ByteOffset, unsigned int Shift, unsigned int Bits>
+		constexpr std::uint32_t extract_bits(const unsigned char *data) noexcept
+		{
+			constexpr unsigned int num_bytes = (Shift + Bits + 7) / 8;
+			std::uint64_t raw = 0;
+			for (unsigned int k = 0; k < num_bytes; k++)
+				raw |= static_cast<std::uint64_t>(data[ByteOffset + k]) << (8 * k);
+			raw >>= Shift;
+			if constexpr (Bits < 32)
+				raw &= (std::uint64_t(1) << Bits) - 1;
+			return static_cast<std::uint32_t>(raw);
+		}
+
+		template <std::size_t ByteOffset, unsigned int Shift, unsigned int Bits>
+		constexpr void insert_bits(unsigned char *data, std::uint32_t value) noexcept
+		{
+			constexpr unsigned int num_bytes = (Shift + Bits + 7) / 8;
+			constexpr std::uint64_t mask = ((Bits < 32) ? ((std::uint64_t(1) << Bits) - 1) : std::uint64_t(0xFFFFFFFFu)) << Shift;
+			const std::uint64_t bits = (static_cast<std::uint64_t>(value) << Shift) & mask;
+			for (unsigned int k = 0; k < num_bytes; k++)
+				data[ByteOffset + k] = static_cast<unsigned char>((data[ByteOffset + k] & ~(mask >> (8 * k))) | (bits >> (8 * k)));
+		}
+
+		/* The same, for an element chosen at run time */
+		inline std::uint32_t extract_bits(const unsigned char *data, std::size_t bit_offset, unsigned int bits) noexcept
+		{
+			const unsigned char *src = data + bit_offset / 8;
+			const unsigned int shift = bit_offset % 8;
+			const unsigned int num_bytes = (shift + bits + 7) / 8;
+			std::uint64_t raw = 0;
+			for (unsigned int k = 0; k < num_bytes; k++)
+				raw |= static_cast<std::uint64_t>(src[k]) << (8 * k);
+			raw >>= shift;
+			if (bits < 32)
+				raw &= (std::uint64_t(1) << bits) - 1;
+			return static_cast<std::uint32_t>(raw);
+		}
+
+		inline void insert_bits(unsigned char *data, std::size_t bit_offset, unsigned int bits, std::uint32_t value) noexcept
+		{
+			unsigned char *dst = data + bit_offset / 8;
+			const unsigned int shift = bit_offset % 8;
+			const unsigned int num_bytes = (shift + bits + 7) / 8;
+			const std::uint64_t mask = ((bits < 32) ? ((std::uint64_t(1) << bits) - 1) : std::uint64_t(0xFFFFFFFFu)) << shift;
+			const std::uint64_t value_bits = (static_cast<std::uint64_t>(value) << shift) & mask;
+			for (unsigned int k = 0; k < num_bytes; k++)
+				dst[k] = static_cast<unsigned char>((dst[k] & ~(mask >> (8 * k))) | (value_bits >> (8 * k)));
+		}
+
+		/* Sign or zero extends a raw element, as hid_decode_report() does */
+		template <unsigned int Bits, bool Signed>
+		constexpr report_value_t<Bits, Signed> to_value(std::uint32_t raw) noexcept
+		{
+			if constexpr (Signed && Bits < 32) {
+				constexpr std::uint32_t sign_bit = std::uint32_t(1) << (Bits - 1);
+				return static_cast<report_value_t<Bits, Signed>>(to_signed((raw ^ sign_bit) - sign_bit));
+			}
+			else if constexpr (Signed) {
+				return static_cast<report_value_t<Bits, Signed>>(to_signed(raw));
+			}
+			else {
+				return static_cast<report_value_t<Bits, Signed>>(raw);
+			}
+		}
+
+		template <unsigned int Bits, bool Signed>
+		constexpr std::uint32_t from_value(report_value_t<Bits, Signed> value) noexcept
+		{
+			return static_cast<std::uint32_t>(value);
+		}
+
+		/* Common to report_usage and report_array */
+		template <const auto &Layout, hid_api_report_type Type, unsigned char ReportId, std::size_t FieldIndex>
+		struct report_field_base {
+			static_assert(Layout.error == nullptr, "the report descriptor is invalid, see report_layout::error");
+			static_assert(FieldIndex < Layout.num_fields, "the report has no field with this usage");
+
+			/** The field, as listed in the layout */
+			static constexpr const hid_report_field &field = Layout.fields[FieldIndex];
+			/** The size of the report, with its Report ID byte */
+			static constexpr std::size_t report_size = Layout.report_size(Type, ReportId);
+			/** The bits of an element which are read and written:
+				like @ref hid_decode_report, only the low 32 bits */
+			static constexpr unsigned int bit_size = field.bit_size < 32 ? field.bit_size : 32;
+			/** Whether the elements are sign extended */
+			static constexpr bool is_signed = field.logical_minimum < 0;
+			/** The type of the value of an element */
+			using value_type = report_value_t<bit_size, is_signed>;
+
+		protected:
+			static constexpr std::size_t id_bytes = Layout.numbered_reports ? 1 : 0;
+		};
+	}
+
+	/** @brief Parses a report descriptor, at compile time when it is
+		a constant expression.
+
+		Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+		The descriptor is parsed the way @ref hid_parse_report_descriptor
+		does, with the same errors.
+
+		@ingroup CXX_API
+		@tparam MaxFields The capacity of the layout, in fields. A
+			descriptor with more fields is reported as invalid.
+		@param descriptor The report descriptor.
+		@param length The length of the descriptor in bytes.
+
+		@returns
+			The layout, with report_layout::error set if the
+			descriptor is invalid.
+	*/
+	template <std::size_t MaxFields = 128>
+	constexpr report_layout<MaxFields> parse_report_descriptor(const unsigned char *descriptor, std::size_t length) noexcept
+	{
+		report_layout<MaxFields> layout;
+		detail::report_parser parser;
+		std::size_t value_index[3][256] = {};
+
+		layout.error = detail::parse_items(layout, parser, descriptor, length);
+		if (layout.error) {
+			layout.num_fields = 0;
+			return layout;
+		}
+
+		for (std::size_t i = 0; i < layout.num_fields; i++) {
+			hid_report_field &field = layout.fields[i];
+			field.value_index = value_index[field.report_type][field.report_id];
+			value_index[field.report_type][field.report_id] += field.count;
+		}
+		return layout;
+	}
+
+	/** @copydoc parse_report_descriptor(const unsigned char *, std::size_t) */
+	template <std::size_t MaxFields = 128, std::size_t N>
+	constexpr report_layout<MaxFields> parse_report_descriptor(const unsigned char (&descriptor)[N]) noexcept
+	{
+		return parse_report_descriptor<MaxFields>(descriptor, N);
+	}
+
+	/** @copydoc parse_report_descriptor(const unsigned char *, std::size_t) */
+	template <std::size_t MaxFields = 128, std::size_t N>
+	constexpr report_layout<MaxFields> parse_report_descriptor(const std::array<unsigned char, N> &descriptor) noexcept
+	{
+		return parse_report_descriptor<MaxFields>(descriptor.data(), N);
+	}
+
+	/** @brief A report of a layout parsed at compile time.
+
+		Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+		@ingroup CXX_API
+		@tparam Layout The layout, a constexpr object with static
+			storage duration.
+		@tparam Type The type of the report.
+		@tparam ReportId The Report ID, 0 if the device does not
+			use numbered reports.
+	*/
+	template <const auto &Layout, hid_api_report_type Type, unsigned char ReportId = 0>
+	struct report {
+		static_assert(Layout.error == nullptr, "the report descriptor is invalid, see report_layout::error");
+		static_assert(Layout.has_report(Type, ReportId), "the report descriptor has no such report");
+
+		/** The size of the report, with its Report ID byte */
+		static constexpr std::size_t size = Layout.report_size(Type, ReportId);
+		/** A buffer for the report */
+		using buffer = std::array<unsigned char, size>;
+
+		/** An empty report, with its Report ID */
+		static constexpr buffer make() noexcept
+		{
+			buffer data{};
+			if (Layout.numbered_reports)
+				data[0] = ReportId;
+			return data;
+		}
+	};
+
+	/** @brief The element of a report with a given usage, in a variable
+		field (e.g. an axis or a button).
+
+		Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+		read() and write() take a report as given to or returned by
+		@ref hid_read and @ref hid_write: starting with its Report ID
+		if the device uses numbered reports. The offset, the shifts and
+		the masks of the element are constants: nothing of the
+		descriptor is looked up at run time.
+
+		@ingroup CXX_API
+		@tparam Layout The layout, a constexpr object with static
+			storage duration.
+		@tparam Type The type of the report.
+		@tparam ReportId The Report ID, 0 if the device does not
+			use numbered reports.
+		@tparam UsagePage The Usage Page of the element.
+		@tparam Usage The Usage of the element.
+	*/
+	template <const auto &Layout, hid_api_report_type Type, unsigned char ReportId, unsigned short UsagePage, unsigned short Usage>
+	struct report_usage : detail::report_field_base<Layout, Type, ReportId, Layout.find_usage(Type, ReportId, UsagePage, Usage)> {
+	private:
+		using base = detail::report_field_base<Layout, Type, ReportId, Layout.find_usage(Type, ReportId, UsagePage, Usage)>;
+		static constexpr unsigned int element = Usage - base::field.usage_minimum;
+		static constexpr std::size_t bit_offset = base::field.bit_offset + static_cast<std::size_t>(element) * base::field.bit_size;
+		static constexpr std::size_t byte_offset = base::id_bytes + bit_offset / 8;
+		static constexpr unsigned int shift = bit_offset % 8;
+
+	public:
+		using typename base::value_type;
+
+		/** Reads the element out of a report of at least report_size bytes */
+		static constexpr value_type read(const unsigned char *report) noexcept
+		{
+			return detail::to_value<base::bit_size, base::is_signed>(detail::extract_bits<byte_offset, shift, base::bit_size>(report));
+		}
+
+		/** Reads the element, out of a buffer checked for its size at compile time */
+		template <std::size_t N>
+		static constexpr value_type read(const std::array<unsigned char, N> &report) noexcept
+		{
+			static_assert(N >= base::report_size, "the buffer is too small for the report");
+			return read(report.data());
+		}
+
+		/** Writes the element into a report of at least report_size bytes,
+			leaving the other bits of the report as they are */
+		static constexpr void write(unsigned char *report, value_type value) noexcept
+		{
+			detail::insert_bits<byte_offset, shift, base::bit_size>(report, detail::from_value<base::bit_size, base::is_signed>(value));
+		}
+
+		/** Writes the element, into a buffer checked for its size at compile time */
+		template <std::size_t N>
+		static constexpr void write(std::array<unsigned char, N> &report, value_type value) noexcept
+		{
+			static_assert(N >= base::report_size, "the buffer is too small for the report");
+			write(report.data(), value);
+		}
+	};
+
+	/** @brief The array field of a report which holds a given usage when
+		it is active (e.g. the key codes of a keyboard).
+
+		Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+		Its elements are read and written like those of @ref report_usage,
+		by an index known at compile time or at run time.
+
+		@ingroup CXX_API
+		@tparam Layout The layout, a constexpr object with static
+			storage duration.
+		@tparam Type The type of the report.
+		@tparam ReportId The Report ID, 0 if the device does not
+			use numbered reports.
+		@tparam UsagePage The Usage Page of the choices of the array.
+		@tparam Usage One of the choices of the array.
+	*/
+	template <const auto &Layout, hid_api_report_type Type, unsigned char ReportId, unsigned short UsagePage, unsigned short Usage>
+	struct report_array : detail::report_field_base<Layout, Type, ReportId, Layout.find_array(Type, ReportId, UsagePage, Usage)> {
+	private:
+		using base = detail::report_field_base<Layout, Type, ReportId, Layout.find_array(Type, ReportId, UsagePage, Usage)>;
+
+		template <std::size_t Index>
+		static constexpr std::size_t bit_offset = base::field.bit_offset + Index * base::field.bit_size;
+
+	public:
+		using typename base::value_type;
+
+		/** The number of elements of the array */
+		static constexpr std::size_t count = base::field.count;
+
+		/** Reads element Index out of a report of at least report_size bytes */
+		template <std::size_t Index>
+		static constexpr value_type read(const unsigned char *report) noexcept
+		{
+			static_assert(Index < count, "the index is out of the array");
+			return detail::to_value<base::bit_size, base::is_signed>(
+				detail::extract_bits<base::id_bytes + bit_offset<Index> / 8, bit_offset<Index> % 8, base::bit_size>(report));
+		}
+
+		/** Reads element index (less than count) out of a report of at least report_size bytes */
+		static value_type read(const unsigned char *report, std::size_t index) noexcept
+		{
+			const std::size_t offset = base::id_bytes * 8 + base::field.bit_offset + index * base::field.bit_size;
+			return detail::to_value<base::bit_size, base::is_signed>(detail::extract_bits(report, offset, base::bit_size));
+		}
+
+		/** Writes element Index into a report of at least report_size bytes */
+		template <std::size_t Index>
+		static constexpr void write(unsigned char *report, value_type value) noexcept
+		{
+			static_assert(Index < count, "the index is out of the array");
+			detail::insert_bits<base::id_bytes + bit_offset<Index> / 8, bit_offset<Index> % 8, base::bit_size>(
+				report, detail::from_value<base::bit_size, base::is_signed>(value));
+		}
+
+		/** Writes element index (less than count) into a report of at least report_size bytes */
+		static void write(unsigned char *report, std::size_t index, value_type value) noexcept
+		{
+			const std::size_t offset = base::id_bytes * 8 + base::field.bit_offset + index * base::field.bit_size;
+			detail::insert_bits(report, offset, base::bit_size, detail::from_value<base::bit_size, base::is_signed>(value));
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,589 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026.
+
+ This contents of this file may be used by anyone
+ for any reason without any conditions and may be
+ used as a starting point for your own applications
+ which use HIDAPI.
+********************************************************/
+
+/* hidcodegen: turns a report descriptor into a C/C++ header, with a packed
+   struct and a pair of unpack/pack functions for every report. The report
+   layout comes from the same parser as hid_get_report_layout(), and every
+   element is read and written with shifts and masks fixed at generation
+   time: no loops, no branches and no tables at run time.
+
+   With --verify, it also writes a program which checks the generated
+   functions against hid_decode_report() on random reports. */
+
+#if defined(_MSC_VER)
+	#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "../core/hidapi_report_layout.c"
+#include "../core/hidapi_descriptor_text.c"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+
+/* Rounds of random reports checked by the --verify program, per report */
+#define CODEGEN_VERIFY_ROUNDS 1000
+
+struct codegen_member {
+	const struct hid_report_field *field;
+	char name[64];
+	const char *type;
+	/* Bits decoded per element: hid_decode_report() keeps the low 32 */
+	unsigned int width;
+	int is_signed;
+};
+
+struct codegen_report {
+	const struct hid_report_info *info;
+	char name[96];
+	char macro[96];
+	size_t size;
+	struct codegen_member *members;
+	size_t num_members;
+};
+
+static const char *codegen_report_type_name(hid_api_report_type type)
+{
+	switch (type) {
+	case HID_API_REPORT_INPUT:
+		return "input";
+	case HID_API_REPORT_OUTPUT:
+		return "output";
+	default:
+		return "feature";
+	}
+}
+
+static void codegen_upper(char *dst, const char *src, size_t size)
+{
+	size_t i;
+	for (i = 0; i + 1 < size && src[i]; i++)
+		dst[i] = (char) toupper((unsigned char) src[i]);
+	dst[i] = '\0';
+}
+
+/* Names a member after its usages, e.g. usage_0001_0030 for the X axis,
+   usages_0009_0001_0010 for 16 buttons, array_0007_0000_00ff for key codes */
+static void codegen_member_name(const struct codegen_report *report, size_t index, char *name, size_t size)
+{
+	const struct hid_report_field *field = report->members[index].field;
+	size_t i;
+
+	if (!(field->flags & HID_API_FIELD_VARIABLE))
+		snprintf(name, size, "array_%04x_%04x_%04x", field->usage_page, field->usage_minimum, field->usage_maximum);
+	else if (field->usage_minimum == field->usage_maximum)
+		snprintf(name, size, "usage_%04x_%04x", field->usage_page, field->usage_minimum);
+	else
+		snprintf(name, size, "usages_%04x_%04x_%04x", field->usage_page, field->usage_minimum, field->usage_maximum);
+
+	for (i = 0; i < index; i++) {
+		if (strcmp(report->members[i].name, name) == 0) {
+			size_t length = strlen(name);
+			snprintf(name + length, size - length, "_%u", (unsigned) index);
+			break;
+		}
+	}
+}
+
+static void codegen_free(struct codegen_report *reports, int num_reports)
+{
+	int i;
+	for (i = 0; i < num_reports; i++)
+		free(reports[i].members);
+	free(reports);
+}
+
+/* Collects the reports of the layout and their members: one per field,
+   except for the constant fields, which are padding. Reports made only
+   of padding are left out. Returns the number of reports, or -1. */
+static int codegen_collect(const struct hid_report_layout *layout, const char *prefix, struct codegen_report **reports)
+{
+	struct codegen_report *result;
+	size_t num_reports = 0;
+	size_t i, f;
+
+	result = (struct codegen_report*) calloc(layout->num_reports ? layout->num_reports : 1, sizeof(*result));
+	if (!result)
+		return -1;
+
+	for (i = 0; i < layout->num_reports; i++) {
+		const struct hid_report_info *info = &layout->reports[i];
+		struct codegen_report *report = &result[num_reports];
+
+		report->info = info;
+		report->size = (info->bit_length + 7) / 8 + (layout->numbered_reports ? 1 : 0);
+		if (layout->numbered_reports)
+			snprintf(report->name, sizeof(report->name), "%s_%s_%u", prefix, codegen_report_type_name(info->report_type), info->report_id);
+		else
+			snprintf(report->name, sizeof(report->name), "%s_%s", prefix, codegen_report_type_name(info->report_type));
+		codegen_upper(report->macro, report->name, sizeof(report->macro));
+
+		report->members = (struct codegen_member*) calloc(info->num_fields ? info->num_fields : 1, sizeof(*report->members));
+		if (!report->members) {
+			codegen_free(result, (int) num_reports);
+			return -1;
+		}
+
+		for (f = 0; f < info->num_fields; f++) {
+			const struct hid_report_field *field = &layout->fields[info->first_field + f];
+			struct codegen_member *member = &report->members[report->num_members];
+
+			if ((field->flags & HID_API_FIELD_CONSTANT) || field->count == 0)
+				continue;
+
+			member->field = field;
+			member->width = field->bit_size < 32 ? field->bit_size : 32;
+			member->is_signed = field->logical_minimum < 0;
+			if (member->width <= 8)
+				member->type = member->is_signed ? "int8_t" : "uint8_t";
+			else if (member->width <= 16)
+				member->type = member->is_signed ? "int16_t" : "uint16_t";
+			else
+				member->type = member->is_signed ? "int32_t" : "uint32_t";
+			codegen_member_name(report, report->num_members, member->name, sizeof(member->name));
+			report->num_members++;
+		}
+
+		if (report->num_members > 0)
+			num_reports++;
+		else
+			free(report->members);
+	}
+
+	*reports = result;
+	return (int) num_reports;
+}
+
+/* The byte of the report holding the first bit of element j, the Report ID included */
+static size_t codegen_element_byte(const struct hid_report_layout *layout, const struct codegen_member *member, unsigned int j)
+{
+	unsigned int bit_offset = member->field->bit_offset + j * member->field->bit_size;
+	return bit_offset / 8 + (layout->numbered_reports ? 1 : 0);
+}
+
+static unsigned int codegen_element_shift(const struct codegen_member *member, unsigned int j)
+{
+	return (member->field->bit_offset + j * member->field->bit_size) % 8;
+}
+
+/* A byte array with the elements on byte boundaries: a plain copy */
+static int codegen_is_byte_array(const struct codegen_member *member)
+{
+	return member->field->bit_size == 8 && member->field->count > 1 && member->field->bit_offset % 8 == 0;
+}
+
+static void codegen_lvalue(const struct codegen_member *member, unsigned int j, const char *object, char *buf, size_t size)
+{
+	if (member->field->count == 1)
+		snprintf(buf, size, "%s%s", object, member->name);
+	else
+		snprintf(buf, size, "%s%s[%u]", object, member->name, j);
+}
+
+static void codegen_unpack_element(FILE *out, const struct hid_report_layout *layout, const struct codegen_member *member, unsigned int j)
+{
+	size_t byte = codegen_element_byte(layout, member, j);
+	unsigned int shift = codegen_element_shift(member, j);
+	unsigned int num_bytes = (shift + member->width + 7) / 8;
+	const char *raw_type = (shift + member->width > 32) ? "uint64_t" : "uint32_t";
+	char lvalue[96];
+	char raw[256];
+	size_t length = 0;
+	unsigned int k;
+
+	if (num_bytes > 1)
+		length += snprintf(raw + length, sizeof(raw) - length, "(");
+	for (k = 0; k < num_bytes; k++) {
+		if (k == 0)
+			length += snprintf(raw + length, sizeof(raw) - length, "(%s)data[%u]", raw_type, (unsigned)(byte + k));
+		else
+			length += snprintf(raw + length, sizeof(raw) - length, " | (%s)data[%u] << %u", raw_type, (unsigned)(byte + k), 8 * k);
+	}
+	if (num_bytes > 1)
+		length += snprintf(raw + length, sizeof(raw) - length, ")");
+	if (shift > 0)
+		length += snprintf(raw + length, sizeof(raw) - length, " >> %u", shift);
+	if (shift + member->width < num_bytes * 8)
+		snprintf(raw + length, sizeof(raw) - length, " & 0x%xu", member->width < 32 ? (1u << member->width) - 1 : 0xFFFFFFFFu);
+
+	codegen_lvalue(member, j, "report->", lvalue, sizeof(lvalue));
+	if (member->is_signed && member->width < 32) {
+		unsigned int sign_bit = 1u << (member->width - 1);
+		fprintf(out, "\t%s = (%s)(int32_t)(((%s%s%s) ^ 0x%xu) - 0x%xu);\n", lvalue, member->type,
+			num_bytes > 4 ? "(uint32_t)(" : "", raw, num_bytes > 4 ? ")" : "", sign_bit, sign_bit);
+	}
+	else {
+		fprintf(out, "\t%s = (%s)(%s);\n", lvalue, member->type, raw);
+	}
+}
+
+static void codegen_pack_element(FILE *out, const struct hid_report_layout *layout, const struct codegen_member *member, unsigned int j)
+{
+	size_t byte = codegen_element_byte(layout, member, j);
+	unsigned int shift = codegen_element_shift(member, j);
+	unsigned int num_bytes = (shift + member->width + 7) / 8;
+	const char *value = (shift + member->width > 32) ? "(uint64_t)v" : "v";
+	char lvalue[96];
+	unsigned int k;
+
+	codegen_lvalue(member, j, "report->", lvalue, sizeof(lvalue));
+	if (member->width < 32)
+		fprintf(out, "\tv = (uint32_t)%s & 0x%xu;\n", lvalue, (1u << member->width) - 1);
+	else
+		fprintf(out, "\tv = (uint32_t)%s;\n", lvalue);
+
+	for (k = 0; k < num_bytes; k++) {
+		if (k == 0 && shift == 0)
+			fprintf(out, "\tdata[%u] |= (uint8_t)v;\n", (unsigned)(byte + k));
+		else if (k == 0)
+			fprintf(out, "\tdata[%u] |= (uint8_t)(v << %u);\n", (unsigned)(byte + k), shift);
+		else
+			fprintf(out, "\tdata[%u] |= (uint8_t)(%s >> %u);\n", (unsigned)(byte + k), value, 8 * k - shift);
+	}
+}
+
+static void codegen_member_comment(FILE *out, const struct codegen_member *member)
+{
+	const struct hid_report_field *field = member->field;
+
+	fprintf(out, "\t/* Usage Page 0x%04x, ", field->usage_page);
+	if (field->usage_minimum == field->usage_maximum)
+		fprintf(out, "Usage 0x%04x", field->usage_minimum);
+	else
+		fprintf(out, "Usages 0x%04x-0x%04x", field->usage_minimum, field->usage_maximum);
+	fprintf(out, "%s, %u bit%s, logical %d..%d */\n",
+		(field->flags & HID_API_FIELD_VARIABLE) ? "" : " (array)",
+		field->bit_size, field->bit_size == 1 ? "" : "s",
+		field->logical_minimum, field->logical_maximum);
+}
+
+static void codegen_report(FILE *out, const struct hid_report_layout *layout, const struct codegen_report *report)
+{
+	size_t m;
+	unsigned int j;
+	int needs_value = 0;
+
+	fprintf(out, "/* %s report", codegen_report_type_name(report->info->report_type));
+	if (layout->numbered_reports)
+		fprintf(out, " %u", report->info->report_id);
+	fprintf(out, ": %u bytes */\n\n", (unsigned) report->size);
+
+	if (layout->numbered_reports)
+		fprintf(out, "#define %s_ID %u\n", report->macro, report->info->report_id);
+	fprintf(out, "#define %s_SIZE %u\n\n", report->macro, (unsigned) report->size);
+
+	fprintf(out, "#pragma pack(push, 1)\n");
+	fprintf(out, "struct %s {\n", report->name);
+	for (m = 0; m < report->num_members; m++) {
+		const struct codegen_member *member = &report->members[m];
+		codegen_member_comment(out, member);
+		if (member->field->count == 1)
+			fprintf(out, "\t%s %s;\n", member->type, member->name);
+		else
+			fprintf(out, "\t%s %s[%u];\n", member->type, member->name, member->field->count);
+	}
+	fprintf(out, "};\n");
+	fprintf(out, "#pragma pack(pop)\n\n");
+
+	fprintf(out, "/* Reads a report of %s_SIZE bytes, as returned by hid_read()%s */\n",
+		report->macro, layout->numbered_reports ? ", starting with its Report ID" : "");
+	fprintf(out, "static inline void %s_unpack(struct %s *report, const uint8_t *data)\n{\n", report->name, report->name);
+	for (m = 0; m < report->num_members; m++) {
+		const struct codegen_member *member = &report->members[m];
+		if (codegen_is_byte_array(member)) {
+			fprintf(out, "\tmemcpy(report->%s, data + %u, %u);\n", member->name, (unsigned) codegen_element_byte(layout, member, 0), member->field->count);
+			continue;
+		}
+		for (j = 0; j < member->field->count; j++)
+			codegen_unpack_element(out, layout, member, j);
+	}
+	fprintf(out, "}\n\n");
+
+	for (m = 0; m < report->num_members; m++) {
+		if (!codegen_is_byte_array(&report->members[m]))
+			needs_value = 1;
+	}
+
+	fprintf(out, "/* Writes a report of %s_SIZE bytes, for hid_write() or hid_send_feature_report(),\n", report->macro);
+	fprintf(out, "   with zeros for its padding */\n");
+	fprintf(out, "static inline void %s_pack(const struct %s *report, uint8_t *data)\n{\n", report->name, report->name);
+	if (needs_value)
+		fprintf(out, "\tuint32_t v;\n\n");
+	fprintf(out, "\tmemset(data, 0, %s_SIZE);\n", report->macro);
+	if (layout->numbered_reports)
+		fprintf(out, "\tdata[0] = %s_ID;\n", report->macro);
+	for (m = 0; m < report->num_members; m++) {
+		const struct codegen_member *member = &report->members[m];
+		if (codegen_is_byte_array(member)) {
+			fprintf(out, "\tmemcpy(data + %u, report->%s, %u);\n", (unsigned) codegen_element_byte(layout, member, 0), member->name, member->field->count);
+			continue;
+		}
+		for (j = 0; j < member->field->count; j++)
+			codegen_pack_element(out, layout, member, j);
+	}
+	fprintf(out, "}\n\n");
+}
+
+static void codegen_header(FILE *out, const char *source, const char *prefix, const struct hid_report_layout *layout, const struct codegen_report *reports, int num_reports)
+{
+	char macro[64];
+	char guard[96];
+	int i;
+
+	codegen_upper(macro, prefix, sizeof(macro));
+	snprintf(guard, sizeof(guard), "%s_H", macro);
+
+	fprintf(out, "/* Generated by hidcodegen from %s: do not edit. */\n\n", source);
+	fprintf(out, "#ifndef %s\n#define %s\n\n", guard, guard);
+	fprintf(out, "#include <stdint.h>\n#include <string.h>\n\n");
+	fprintf(out, "#define %s_NUMBERED_REPORTS %d\n\n", macro, layout->numbered_reports);
+
+	for (i = 0; i < num_reports; i++)
+		codegen_report(out, layout, &reports[i]);
+
+	fprintf(out, "#endif\n");
+}
+
+static void codegen_verify(FILE *out, const char *header, const unsigned char *descriptor, size_t length, const struct hid_report_layout *layout, const struct codegen_report *reports, int num_reports)
+{
+	static const char *type_enums[REPORT_LAYOUT_NUM_TYPES] = { "HID_API_REPORT_INPUT", "HID_API_REPORT_OUTPUT", "HID_API_REPORT_FEATURE" };
+	unsigned char *mask;
+	size_t i, m;
+	unsigned int j, bit;
+	int r;
+
+	fprintf(out, "/* Generated by hidcodegen: checks %s against hid_decode_report(). */\n\n", header);
+	fprintf(out, "#include \"hidapi_report_layout.c\"\n");
+	fprintf(out, "#include \"%s\"\n\n", header);
+	fprintf(out, "#include <stdio.h>\n\n");
+
+	fprintf(out, "static const unsigned char report_descriptor[%u] = {", (unsigned) length);
+	for (i = 0; i < length; i++)
+		fprintf(out, "%s0x%02X,", (i % 12) ? " " : "\n\t", descriptor[i]);
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static uint8_t verify_random(uint32_t *state)\n{\n");
+	fprintf(out, "\t*state ^= *state << 13;\n\t*state ^= *state >> 17;\n\t*state ^= *state << 5;\n");
+	fprintf(out, "\treturn (uint8_t)(*state >> 24);\n}\n\n");
+
+	fprintf(out, "#define VERIFY(condition, what) \\\n");
+	fprintf(out, "\tif (!(condition)) { \\\n");
+	fprintf(out, "\t\tfprintf(stderr, \"%%s: %%s differs (round %%d)\\n\", __func__, what, n); \\\n");
+	fprintf(out, "\t\treturn -1; \\\n\t}\n\n");
+
+	for (r = 0; r < num_reports; r++) {
+		const struct codegen_report *report = &reports[r];
+
+		mask = (unsigned char*) calloc(report->size, 1);
+		if (!mask)
+			return;
+		if (layout->numbered_reports)
+			mask[0] = 0xFF;
+		for (m = 0; m < report->num_members; m++) {
+			const struct codegen_member *member = &report->members[m];
+			for (j = 0; j < member->field->count; j++) {
+				size_t byte = codegen_element_byte(layout, member, j);
+				unsigned int shift = codegen_element_shift(member, j);
+				for (bit = 0; bit < member->width; bit++)
+					mask[byte + (shift + bit) / 8] |= (unsigned char)(1u << ((shift + bit) % 8));
+			}
+		}
+
+		fprintf(out, "static int verify_%s(const struct hid_report_layout *layout, uint32_t *state)\n{\n", report->name);
+		fprintf(out, "\tstatic const uint8_t mask[%s_SIZE] = {", report->macro);
+		for (i = 0; i < report->size; i++)
+			fprintf(out, "%s0x%02X,", (i % 12) ? " " : "\n\t\t", mask[i]);
+		fprintf(out, "\n\t};\n");
+		fprintf(out, "\tstatic int values[%u];\n", (unsigned) report->info->num_values);
+		fprintf(out, "\tstruct %s report;\n", report->name);
+		fprintf(out, "\tuint8_t data[%s_SIZE], packed[%s_SIZE];\n", report->macro, report->macro);
+		fprintf(out, "\tsize_t i;\n\tint n;\n\n");
+		fprintf(out, "\tfor (n = 0; n < %d; n++) {\n", CODEGEN_VERIFY_ROUNDS);
+		fprintf(out, "\t\tfor (i = 0; i < sizeof(data); i++)\n\t\t\tdata[i] = verify_random(state);\n");
+		if (layout->numbered_reports)
+			fprintf(out, "\t\tdata[0] = %s_ID;\n", report->macro);
+		fprintf(out, "\t\tVERIFY(hid_decode_report(layout, %s, data, sizeof(data), values, %u) == %u, \"hid_decode_report()\");\n",
+			type_enums[report->info->report_type], (unsigned) report->info->num_values, (unsigned) report->info->num_values);
+		fprintf(out, "\t\t%s_unpack(&report, data);\n", report->name);
+		for (m = 0; m < report->num_members; m++) {
+			const struct codegen_member *member = &report->members[m];
+			if (member->field->count == 1) {
+				fprintf(out, "\t\tVERIFY((int)report.%s == values[%u], \"%s\");\n", member->name, (unsigned) member->field->value_index, member->name);
+			}
+			else {
+				fprintf(out, "\t\tfor (i = 0; i < %u; i++)\n", member->field->count);
+				fprintf(out, "\t\t\tVERIFY((int)report.%s[i] == values[%u + i], \"%s\");\n", member->name, (unsigned) member->field->value_index, member->name);
+			}
+		}
+		fprintf(out, "\t\t%s_pack(&report, packed);\n", report->name);
+		fprintf(out, "\t\tfor (i = 0; i < sizeof(data); i++)\n");
+		fprintf(out, "\t\t\tVERIFY(((packed[i] ^ data[i]) & mask[i]) == 0, \"%s_pack()\");\n", report->name);
+		fprintf(out, "\t}\n\treturn 0;\n}\n\n");
+
+		free(mask);
+	}
+
+	fprintf(out, "int main(void)\n{\n");
+	fprintf(out, "\tconst char *error;\n");
+	fprintf(out, "\tstruct hid_report_layout *layout = report_layout_parse(report_descriptor, sizeof(report_descriptor), &error);\n");
+	fprintf(out, "\tuint32_t state = 0x12345678u;\n\tint result = 0;\n\n");
+	fprintf(out, "\tif (!layout) {\n\t\tfprintf(stderr, \"report_layout_parse: %%s\\n\", error);\n\t\treturn 1;\n\t}\n\n");
+	for (r = 0; r < num_reports; r++)
+		fprintf(out, "\tresult |= verify_%s(layout, &state);\n", reports[r].name);
+	fprintf(out, "\n\treport_layout_free(layout);\n");
+	fprintf(out, "\tif (result == 0)\n\t\tprintf(\"%s: %d report(s) verified\\n\");\n", header, num_reports);
+	fprintf(out, "\treturn result == 0 ? 0 : 1;\n}\n");
+}
+
+static int read_binary_file(const char *filename, unsigned char *descriptor, size_t max_length, size_t *length)
+{
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+		return -1;
+	*length = fread(descriptor, 1, max_length, file);
+	fclose(file);
+	return 0;
+}
+
+/* The default prefix: the file name without its extension, as an identifier */
+static void default_prefix(const char *filename, char *prefix, size_t size)
+{
+	const char *base = filename;
+	const char *p;
+	size_t length = 0;
+
+	for (p = filename; *p; p++) {
+		if (*p == '/' || *p == '\\')
+			base = p + 1;
+	}
+
+	if (isdigit((unsigned char) *base))
+		length = (size_t) snprintf(prefix, size, "hid_");
+	for (p = base; *p && *p != '.' && length + 1 < size; p++)
+		prefix[length++] = isalnum((unsigned char) *p) ? (char) tolower((unsigned char) *p) : '_';
+	prefix[length] = '\0';
+}
+
+static const char *file_name(const char *path)
+{
+	const char *base = path;
+	for (; *path; path++) {
+		if (*path == '/' || *path == '\\')
+			base = path + 1;
+	}
+	return base;
+}
+
+static void print_usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [options] <descriptor> <header.h>\n", argv0);
+	fprintf(stderr, "  -x, --hex          the descriptor is a textual hex dump, not binary\n");
+	fprintf(stderr, "  -n, --name NAME    prefix of the generated identifiers (default: from the file name)\n");
+	fprintf(stderr, "  --verify FILE.c    also write a program checking the header against hid_decode_report()\n");
+	fprintf(stderr, "The header is written to standard output if it is \"-\".\n");
+}
+
+int main(int argc, char **argv)
+{
+	static unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	const char *descriptor_file = NULL, *header_file = NULL, *verify_file = NULL;
+	const char *name = NULL;
+	char prefix[64];
+	int hex = 0;
+	size_t length;
+	struct hid_report_layout *layout;
+	struct codegen_report *reports;
+	int num_reports;
+	const char *error;
+	FILE *out;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-x") == 0 || strcmp(argv[i], "--hex") == 0) {
+			hex = 1;
+		}
+		else if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--name") == 0) && i + 1 < argc) {
+			name = argv[++i];
+		}
+		else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+			verify_file = argv[++i];
+		}
+		else if (!descriptor_file) {
+			descriptor_file = argv[i];
+		}
+		else if (!header_file) {
+			header_file = argv[i];
+		}
+		else {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!descriptor_file || !header_file) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if ((hex ? descriptor_text_read_file(descriptor_file, descriptor, sizeof(descriptor), &length)
+	         : read_binary_file(descriptor_file, descriptor, sizeof(descriptor), &length)) < 0) {
+		fprintf(stderr, "ERROR: Couldn't open file '%s' for reading: %s\n", descriptor_file, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		fprintf(stderr, "ERROR: %s: %s\n", descriptor_file, error);
+		return EXIT_FAILURE;
+	}
+
+	if (name)
+		snprintf(prefix, sizeof(prefix), "%s", name);
+	else
+		default_prefix(descriptor_file, prefix, sizeof(prefix));
+
+	num_reports = codegen_collect(layout, prefix, &reports);
+	if (num_reports < 0) {
+		fprintf(stderr, "ERROR: Couldn't allocate memory\n");
+		report_layout_free(layout);
+		return EXIT_FAILURE;
+	}
+
+	out = strcmp(header_file, "-") == 0 ? stdout : fopen(header_file, "w");
+	if (!out) {
+		fprintf(stderr, "ERROR: Couldn't open file '%s' for writing: %s\n", header_file, strerror(errno));
+		codegen_free(reports, num_reports);
+		report_layout_free(layout);
+		return EXIT_FAILURE;
+	}
+	codegen_header(out, file_name(descriptor_file), prefix, layout, reports, num_reports);
+	if (out != stdout)
+		fclose(out);
+
+	if (verify_file) {
+		out = fopen(verify_file, "w");
+		if (!out) {
+			fprintf(stderr, "ERROR: Couldn't open file '%s' for writing: %s\n", verify_file, strerror(errno));
+			codegen_free(reports, num_reports);
+			report_layout_free(layout);
+			return EXIT_FAILURE;
+		}
+		codegen_verify(out, file_name(header_file), descriptor, length, layout, reports, num_reports);
+		fclose(out);
+	}
+
+	codegen_free(reports, num_reports);
+	report_layout_free(layout);
+	return EXIT_SUCCESS;
+}
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <locale.h>
+#include <limits.h>
 #include <errno.h>
 
 /* Unix */
@@ -40,6 +41,9 @@
 #include <sys/utsname.h>
 #include <fcntl.h>
 #include <wchar.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 /* GNU / LibUSB */
 #include <libusb.h>
@@ -52,11 +56,22 @@
 
 #include "hidapi_libusb.h"
 
+/* A custom thread model (see hidapi_thread_pthread.h for the reference)
+   has to provide everything the pthread one does. In particular:
+   - hidapi_thread_create() returns an int: 0 when the thread was started,
+     anything else when it wasn't (the callers recover from it);
+   - hidapi_thread_is_current() returns non-zero when called from the
+     thread started on the given state. */
 #ifndef HIDAPI_THREAD_MODEL_INCLUDE
 #define HIDAPI_THREAD_MODEL_INCLUDE "hidapi_thread_pthread.h"
 #endif
 #include HIDAPI_THREAD_MODEL_INCLUDE
 
+#define REPORT_LAYOUT_WITH_SCAN
+#include "../core/hidapi_report_layout.c"
+#include "../core/hidapi_timestamp.c"
+#include "../core/hidapi_enumerate_filter.c"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -71,6 +86,23 @@ extern "C" {
 #define DETACH_KERNEL_DRIVER
 #endif
 
+/* 0x01000105 is a LIBUSB_API_VERSION for 1.0.21 - version when libusb_interrupt_event_handler was introduced */
+#if (!defined(HIDAPI_TARGET_LIBUSB_API_VERSION) || HIDAPI_TARGET_LIBUSB_API_VERSION >= 0x01000105) && (LIBUSB_API_VERSION >= 0x01000105)
+#define HIDAPI_HAS_INTERRUPT_EVENT_HANDLER
+#endif
+
+/* 0x01000102 is a LIBUSB_API_VERSION for 1.0.16 - version when hotplug support was introduced */
+#if (!defined(HIDAPI_TARGET_LIBUSB_API_VERSION) || HIDAPI_TARGET_LIBUSB_API_VERSION >= 0x01000102) && (LIBUSB_API_VERSION >= 0x01000102)
+#define HIDAPI_HAS_HOTPLUG
+#endif
+
+#include "../core/hidapi_descriptor_cache.c"
+
+#ifdef HIDAPI_HAS_HOTPLUG
+#include "../core/hidapi_device_info.c"
+#include "../core/hidapi_hotplug.c"
+#endif
+
 /* Uncomment to enable the retrieval of Usage and Usage Page in
 hid_enumerate(). Warning, on platforms different from FreeBSD
 this is very invasive as it requires the detach
@@ -79,11 +111,60 @@ libusb HIDAPI programs are encouraged to use the interface number
 instead to differentiate between interfaces on a composite HID device. */
 /*#define INVASIVE_GET_USAGE*/
 
-/* Linked List of input reports received from the device. */
+/* Maximum number of input reports queued per device. When the queue is
+   full, the oldest report is dropped. This way we don't grow forever if
+   the user never reads anything from the device. */
+#define HIDAPI_INPUT_REPORT_QUEUE_SIZE 32
+
+/* Limits for the number of interrupt IN transfers kept in flight per device,
+   see hid_libusb_set_input_transfers(). */
+#define HIDAPI_MIN_INPUT_TRANSFERS 1
+#define HIDAPI_MAX_INPUT_TRANSFERS 16
+
+/* Maximum number of interrupt OUT (or control) transfers kept in flight
+   per device by hid_libusb_write_async() */
+#define HIDAPI_MAX_OUTPUT_TRANSFERS 8
+
+/* Limit for the number of threads probing devices in hid_enumerate(),
+   see hid_libusb_set_enumerate_threads() */
+#define HIDAPI_MAX_ENUMERATE_THREADS 32
+
+/* Timeout of each transfer getting a string descriptor, in milliseconds
+   (the one of libusb_get_string_descriptor()) */
+#define HIDAPI_STRING_DESCRIPTOR_TIMEOUT 1000
+
+/* Timeout of the transfer getting a report descriptor, in milliseconds */
+#define HIDAPI_REPORT_DESCRIPTOR_TIMEOUT 5000
+
+/* Number of buckets of the device cache of hid_open_path() */
+#define HIDAPI_DEVICE_CACHE_BUCKETS 64
+
+/* The location of a USB device, as in the paths of hid_enumerate() */
+struct usb_port_path {
+	uint8_t bus;
+	uint8_t num_ports;
+	/* Note that USB3 port count limit is 7; use 8 here for alignment */
+	uint8_t port_numbers[8];
+};
+
+/* Transfer used by hid_libusb_write_async() */
+struct output_transfer {
+	hid_device *dev;
+	struct libusb_transfer *transfer;
+	uint8_t *buffer;
+	size_t buffer_size;
+	int skipped_report_id;
+	hid_libusb_write_callback callback;
+	void *user_data;
+};
+
+/* Input report received from the device.
+   The data buffer is owned by the device's report buffer pool. */
 struct input_report {
 	uint8_t *data;
 	size_t len;
-	struct input_report *next;
+	/* CLOCK_MONOTONIC time the transfer completed, in nanoseconds */
+	uint64_t timestamp;
 };
 
 
@@ -129,20 +210,97 @@ struct hid_device_ {
 	/* Whether blocking reads are used */
 	int blocking; /* boolean */
 
-	/* Read thread objects */
+	/* Synchronization with the event thread.
+	   The thread itself is shared by all of the devices. */
 	hidapi_thread_state thread_state;
 	int shutdown_thread;
 	int transfer_loop_finished;
-	struct libusb_transfer *transfer;
-
-	/* List of received input reports. */
+	/* Set once the event thread failed: nothing handles the completions
+	   of the transfers anymore but hid_close() and hid_libusb_write_flush()
+	   themselves, see handle_events_in_place(). Set with both thread_state
+	   and write_state locked, so that either lock is enough to read it. */
+	int event_thread_gone;
+	/* Interrupt IN transfers, all submitted at once and each resubmitted
+	   from read_callback(), so that the host controller always holds
+	   an outstanding request for the endpoint. */
+	struct libusb_transfer *transfers[HIDAPI_MAX_INPUT_TRANSFERS];
+	int num_transfers;
+	/* Number of transfers not yet finished for good,
+	   protected by thread_state.mutex */
+	int transfers_in_flight;
+
+	/* Ring buffer of received input reports, protected by thread_state.mutex.
+	   Report buffers are allocated once, in hidapi_initialize_device().
+	   A completed transfer buffer is queued as is and the transfer is
+	   resubmitted with a free buffer, so queuing a report is O(1)
+	   and involves neither an allocation nor a copy. */
 	struct input_report *input_reports;
+	size_t input_reports_capacity;
+	size_t input_reports_head;
+	size_t input_reports_count;
+
+	/* Set by hid_set_input_callback(). The reports bypass
+	   the queue then. Protected by thread_state.mutex. */
+	hid_input_callback input_callback;
+	void *input_callback_user_data;
+	/* The callback is being called on the event thread, and whether
+	   hid_set_input_callback() waits for it to return */
+	int input_callback_running;
+	int input_callback_waiting;
+
+	/* See hid_get_pollable_fd(). Readable while the queue is not empty
+	   or the transfer loop is finished, created on demand. An eventfd
+	   (both elements are the same) or a pipe. Protected by
+	   thread_state.mutex. */
+	int pollable_fd[2];
+	int pollable_fd_signaled;
+
+	/* Report buffer handed out by hid_libusb_read_borrow(), if any */
+	uint8_t *borrowed_report;
+
+	/* Report buffers neither queued, borrowed nor owned by a transfer */
+	uint8_t **free_report_buffers;
+	size_t free_report_buffers_count;
+	/* Allocations backing the report buffers: one made when the device
+	   is opened, plus one for each time the queue is made deeper */
+	uint8_t **report_buffer_pools;
+	size_t report_buffer_pools_count;
+	size_t report_buffer_size;
+	size_t num_report_buffers;
+
+	/* Handling of the reports which arrive while the queue is full,
+	   see hid_set_input_queue(). Protected by thread_state.mutex. */
+	hid_input_queue_policy input_queue_policy;
+	size_t input_reports_dropped;
+	/* -1 until the report descriptor is parsed for
+	   HID_API_INPUT_QUEUE_CONFLATE */
+	int uses_numbered_reports;
+	/* See hid_get_report_layout(), compiled on the first call */
+	struct hid_report_layout *report_layout;
+	/* Completed transfers waiting for room in the queue under
+	   HID_API_INPUT_QUEUE_BLOCK, oldest first */
+	struct libusb_transfer *parked_transfers[HIDAPI_MAX_INPUT_TRANSFERS];
+	uint64_t parked_timestamps[HIDAPI_MAX_INPUT_TRANSFERS];
+	int num_parked_transfers;
 
 	/* Was kernel driver detached by libusb */
 #ifdef DETACH_KERNEL_DRIVER
 	int is_driver_detached;
 #endif
 
+	/* Asynchronous writes, see hid_libusb_write_async().
+	   Transfers are allocated on demand, up to HIDAPI_MAX_OUTPUT_TRANSFERS,
+	   and reused. Protected by write_state.mutex. */
+	hidapi_thread_state write_state;
+	struct output_transfer output_transfers[HIDAPI_MAX_OUTPUT_TRANSFERS];
+	int num_output_transfers;
+	struct output_transfer *free_output_transfers[HIDAPI_MAX_OUTPUT_TRANSFERS];
+	int free_output_transfers_count;
+	int writes_in_flight;
+
+	/* Next device in the open_devices list */
+	struct hid_device_ *next_open;
+
 	hidapi_error_ctx error;
 	wchar_t *last_read_error_str;
 };
@@ -155,10 +313,103 @@ static struct hid_api_version api_version = {
 
 static libusb_context *usb_context = NULL;
 
+/* The event thread, see event_thread() */
+static hidapi_thread_state event_thread_state; /* mutex protects open_devices */
+static int event_thread_shutdown = 0;
+static int event_thread_failed = 0;
+static hid_device *open_devices = NULL;
+
+/* Number of interrupt IN transfers for devices opened from now on */
+static int input_transfers = HIDAPI_MIN_INPUT_TRANSFERS;
+/* Options of hid_enumerate(), see hid_libusb_set_enumerate_threads()
+   and hid_libusb_set_enumerate_timeout() */
+static int enumerate_threads = 1;
+static int enumerate_timeout = -1;
+
+/* A report descriptor of the report descriptor cache,
+   see hid_set_report_descriptor_cache() */
+struct report_descriptor_cache_entry {
+	/* The identity of the device */
+	unsigned short vendor_id;
+	unsigned short product_id;
+	unsigned short release_number;
+	int interface_number;
+	/* The length given by the HID descriptor of the interface,
+	   which the descriptor is looked up by */
+	uint16_t expected_size;
+	unsigned char *descriptor;
+	size_t size;
+	/* The top-level usage pair, see get_usage() */
+	unsigned short usage_page;
+	unsigned short usage;
+	struct report_descriptor_cache_entry *next;
+};
+
+static hidapi_thread_state report_descriptor_cache_state; /* mutex protects the fields below */
+static int report_descriptor_cache_enabled = 0;
+static char *report_descriptor_cache_path = NULL;
+static struct report_descriptor_cache_entry *report_descriptor_cache = NULL;
+
+#ifdef HIDAPI_HAS_HOTPLUG
+/* A USB device of the enumeration cache, see hid_set_enumeration_cache() */
+struct enumeration_cache_entry {
+	libusb_device *device; /* referenced */
+	int probed;
+	/* The records of the HID interfaces of the device */
+	struct hid_device_info *info;
+	struct enumeration_cache_entry *next;
+};
+
+static hidapi_thread_state enumeration_cache_state; /* mutex protects the fields below */
+static int enumeration_cache_enabled = 0;
+static libusb_hotplug_callback_handle enumeration_cache_hotplug;
+static struct enumeration_cache_entry *enumeration_cache = NULL;
+
+/* A USB device of the device cache of hid_open_path() */
+struct device_cache_entry {
+	libusb_device *device; /* referenced */
+	struct usb_port_path port_path;
+	struct device_cache_entry *next;
+};
+
+static hidapi_thread_state device_cache_state; /* mutex protects the fields below */
+static int device_cache_started = 0; /* 1 once started, 2 if the callback is registered */
+static libusb_hotplug_callback_handle device_cache_hotplug;
+/* Hashed by port path, see port_path_hash() */
+static struct device_cache_entry *device_cache[HIDAPI_DEVICE_CACHE_BUCKETS];
+
+/* A libusb hotplug event, queued for the hotplug thread */
+struct hotplug_event {
+	libusb_device *device; /* referenced */
+	libusb_hotplug_event event;
+	struct hotplug_event *next;
+};
+
+/* The hotplug thread, see hotplug_thread() */
+static hidapi_thread_state hotplug_thread_state; /* mutex protects the fields below */
+static int hotplug_thread_running = 0;
+static int hotplug_thread_starting = 0;
+static int hotplug_thread_shutdown = 0;
+static int hotplug_callbacks_changed = 0;
+static libusb_hotplug_callback_handle hotplug_libusb_handle;
+static hid_hotplug_callback_handle hotplug_next_handle = 1;
+static struct hid_hotplug_callback *hotplug_callbacks = NULL;
+static struct hotplug_event *hotplug_events = NULL;
+/* The connected devices, only changed by the hotplug thread */
+static struct hid_device_info *hotplug_devices = NULL;
+#endif
+
 static hidapi_error_ctx last_global_error;
 
 uint16_t get_usb_code_for_current_locale(void);
 static int return_data(hid_device *dev, unsigned char *data, size_t length);
+static void *event_thread(void *param);
+static void report_descriptor_cache_disable(void);
+#ifdef HIDAPI_HAS_HOTPLUG
+static void enumeration_cache_disable(void);
+static void device_cache_stop(void);
+static void hotplug_stop(void);
+#endif
 
 static hid_device *new_hid_device(void)
 {
@@ -167,8 +418,12 @@ static hid_device *new_hid_device(void)
 		return NULL;
 
 	dev->blocking = 1;
+	dev->uses_numbered_reports = -1;
+	dev->pollable_fd[0] = -1;
+	dev->pollable_fd[1] = -1;
 
 	hidapi_thread_state_init(&dev->thread_state);
+	hidapi_thread_state_init(&dev->write_state);
 
 	return dev;
 }
@@ -180,10 +435,27 @@ static void free_hidapi_error(hidapi_error_ctx *err)
 
 static void free_hid_device(hid_device *dev)
 {
+	size_t i;
+
 	/* Clean up the thread objects */
 	hidapi_thread_state_destroy(&dev->thread_state);
+	hidapi_thread_state_destroy(&dev->write_state);
+
+	/* Free the input report queue and its buffers */
+	free(dev->input_reports);
+	free(dev->free_report_buffers);
+	for (i = 0; i < dev->report_buffer_pools_count; i++)
+		free(dev->report_buffer_pools[i]);
+	free(dev->report_buffer_pools);
+
+	if (dev->pollable_fd[0] >= 0) {
+		close(dev->pollable_fd[0]);
+		if (dev->pollable_fd[1] != dev->pollable_fd[0])
+			close(dev->pollable_fd[1]);
+	}
 
 	hid_free_enumeration(dev->device_info);
+	report_layout_free(dev->report_layout);
 	free_hidapi_error(&dev->error);
 	free(dev->last_read_error_str);
 
@@ -191,135 +463,140 @@ static void free_hid_device(hid_device *dev)
 	free(dev);
 }
 
-/* Get bytes from a HID Report Descriptor.
-   Only call with a num_bytes of 0, 1, 2, or 4. */
-static uint32_t get_bytes(uint8_t *rpt, size_t len, size_t num_bytes, size_t cur)
+/* Allocates count more report buffers, as a single allocation,
+   and puts them on the free list.
+   Returns 0 on success and -1 on failure. */
+static int add_report_buffers(hid_device *dev, size_t count)
 {
-	/* Return if there aren't enough bytes. */
-	if (cur + num_bytes >= len)
-		return 0;
+	uint8_t **free_list;
+	uint8_t **pools;
+	uint8_t *pool;
+	size_t i;
 
-	if (num_bytes == 0)
-		return 0;
-	else if (num_bytes == 1) {
-		return rpt[cur+1];
-	}
-	else if (num_bytes == 2) {
-		return (rpt[cur+2] * 256 + rpt[cur+1]);
-	}
-	else if (num_bytes == 4) {
-		return (rpt[cur+4] * 0x01000000 +
-		        rpt[cur+3] * 0x00010000 +
-		        rpt[cur+2] * 0x00000100 +
-		        rpt[cur+1] * 0x00000001);
+	free_list = (uint8_t**) realloc(dev->free_report_buffers, (dev->num_report_buffers + count) * sizeof(uint8_t*));
+	if (!free_list)
+		return -1;
+	dev->free_report_buffers = free_list;
+
+	pools = (uint8_t**) realloc(dev->report_buffer_pools, (dev->report_buffer_pools_count + 1) * sizeof(uint8_t*));
+	if (!pools)
+		return -1;
+	dev->report_buffer_pools = pools;
+
+	pool = (uint8_t*) malloc(count * dev->report_buffer_size);
+	if (!pool)
+		return -1;
+	dev->report_buffer_pools[dev->report_buffer_pools_count++] = pool;
+
+	for (i = 0; i < count; i++) {
+		dev->free_report_buffers[dev->free_report_buffers_count++] = pool + i * dev->report_buffer_size;
 	}
-	else
+	dev->num_report_buffers += count;
+
+	return 0;
+}
+
+/* Allocates the input report queue and all of the report buffers
+   that are used by the device unless the queue is made deeper:
+   one per queue slot, one for each of the transfers, and one which
+   can be borrowed by the user (see hid_libusb_read_borrow()).
+   Returns 0 on success and -1 on failure. Whatever was allocated
+   is freed by free_hid_device() in both cases. */
+static int alloc_input_reports(hid_device *dev, size_t capacity, size_t num_transfers, size_t report_size)
+{
+	/* The interrupt transfer never returns more than report_size bytes,
+	   but don't let a missing IN endpoint result in malloc(0) */
+	if (report_size == 0)
+		report_size = 1;
+	dev->report_buffer_size = report_size;
+
+	dev->input_reports = (struct input_report*) calloc(capacity, sizeof(struct input_report));
+	if (!dev->input_reports)
+		return -1;
+
+	dev->input_reports_capacity = capacity;
+	dev->input_reports_head = 0;
+	dev->input_reports_count = 0;
+
+	return add_report_buffers(dev, capacity + num_transfers + 1);
+}
+
+/* Returns the deadline of the probe of a device by hid_enumerate()
+   started now, or 0 for none, see hid_libusb_set_enumerate_timeout() */
+static uint64_t probe_deadline(void)
+{
+	if (enumerate_timeout < 0)
 		return 0;
+
+	return get_timestamp() + (uint64_t)enumerate_timeout * 1000000;
 }
 
-/* Retrieves the device's Usage Page and Usage from the report
-   descriptor. The algorithm is simple, as it just returns the first
-   Usage and Usage Page that it finds in the descriptor.
-   The return value is 0 on success and -1 on failure. */
-static int get_usage(uint8_t *report_descriptor, size_t size,
-                     unsigned short *usage_page, unsigned short *usage)
+/* Returns the timeout of the next control transfer of a probe: the
+   time left until the deadline, in milliseconds and at most the
+   usual 1 second, or 0 once the deadline passed (which libusb would
+   take as no timeout at all, so no transfer is to be made). */
+static unsigned int probe_timeout(uint64_t deadline)
 {
-	unsigned int i = 0;
-	int size_code;
-	int data_len, key_size;
-	int usage_found = 0, usage_page_found = 0;
+	uint64_t now;
+	uint64_t left;
 
-	while (i < size) {
-		int key = report_descriptor[i];
-		int key_cmd = key & 0xfc;
+	if (deadline == 0)
+		return HIDAPI_STRING_DESCRIPTOR_TIMEOUT;
 
-		//printf("key: %02hhx\n", key);
+	now = get_timestamp();
+	if (now >= deadline)
+		return 0;
 
-		if ((key & 0xf0) == 0xf0) {
-			/* This is a Long Item. The next byte contains the
-			   length of the data section (value) for this key.
-			   See the HID specification, version 1.11, section
-			   6.2.2.3, titled "Long Items." */
-			if (i+1 < size)
-				data_len = report_descriptor[i+1];
-			else
-				data_len = 0; /* malformed report */
-			key_size = 3;
-		}
-		else {
-			/* This is a Short Item. The bottom two bits of the
-			   key contain the size code for the data section
-			   (value) for this key.  Refer to the HID
-			   specification, version 1.11, section 6.2.2.2,
-			   titled "Short Items." */
-			size_code = key & 0x3;
-			switch (size_code) {
-			case 0:
-			case 1:
-			case 2:
-				data_len = size_code;
-				break;
-			case 3:
-				data_len = 4;
-				break;
-			default:
-				/* Can't ever happen since size_code is & 0x3 */
-				data_len = 0;
-				break;
-			};
-			key_size = 1;
-		}
+	left = (deadline - now + 999999) / 1000000;
+	return left < HIDAPI_STRING_DESCRIPTOR_TIMEOUT? (unsigned int)left: HIDAPI_STRING_DESCRIPTOR_TIMEOUT;
+}
 
-		if (key_cmd == 0x4) {
-			*usage_page  = get_bytes(report_descriptor, size, data_len, i);
-			usage_page_found = 1;
-			//printf("Usage Page: %x\n", (uint32_t)*usage_page);
-		}
-		if (key_cmd == 0x8) {
-			if (data_len == 4) { /* Usages 5.5 / Usage Page 6.2.2.7 */
-				*usage_page = get_bytes(report_descriptor, size, 2, i + 2);
-				usage_page_found = 1;
-				*usage = get_bytes(report_descriptor, size, 2, i);
-				usage_found = 1;
-			}
-			else {
-				*usage = get_bytes(report_descriptor, size, data_len, i);
-				usage_found = 1;
-			}
-			//printf("Usage: %x\n", (uint32_t)*usage);
-		}
+/* Retrieves the device's Usage Page and Usage from the report
+   descriptor: the usage pair of its first top-level collection,
+   see report_layout_scan().
+   The return value is 0 on success and -1 on failure. */
+static int get_usage(const uint8_t *report_descriptor, size_t size,
+                     unsigned short *usage_page, unsigned short *usage)
+{
+	struct report_layout_summary summary;
+	int res = -1;
 
-		if (usage_page_found && usage_found)
-			return 0; /* success */
+	if (report_layout_scan(report_descriptor, size, &summary) < 0)
+		return -1;
 
-		/* Skip over this key and it's associated data */
-		i += data_len + key_size;
+	if (summary.num_usage_pairs > 0) {
+		*usage_page = summary.usage_pairs[0].usage_page;
+		*usage = summary.usage_pairs[0].usage;
+		res = 0;
 	}
 
-	return -1; /* failure */
+	free(summary.usage_pairs);
+	return res;
 }
 
-#if defined(__FreeBSD__) && __FreeBSD__ < 10
-/* The libusb version included in FreeBSD < 10 doesn't have this function. In
-   mainline libusb, it's inlined in libusb.h. This function will bear a striking
-   resemblance to that one, because there's about one way to code it.
+/* Same as libusb_get_string_descriptor(), which is inlined in libusb.h
+   with a fixed timeout of 1 second (and is missing from the libusb
+   included in FreeBSD < 10), but each transfer gets the time left
+   until the deadline, see probe_timeout().
 
    Note that the data parameter is Unicode in UTF-16LE encoding.
    Return value is the number of bytes in data, or LIBUSB_ERROR_*.
  */
-static inline int libusb_get_string_descriptor(libusb_device_handle *dev,
+static int get_string_descriptor(libusb_device_handle *dev,
 	uint8_t descriptor_index, uint16_t lang_id,
-	unsigned char *data, int length)
+	unsigned char *data, int length, uint64_t deadline)
 {
+	unsigned int timeout = probe_timeout(deadline);
+	if (timeout == 0)
+		return LIBUSB_ERROR_TIMEOUT;
+
 	return libusb_control_transfer(dev,
 		LIBUSB_ENDPOINT_IN | 0x0, /* Endpoint 0 IN */
 		LIBUSB_REQUEST_GET_DESCRIPTOR,
 		(LIBUSB_DT_STRING << 8) | descriptor_index,
-		lang_id, data, (uint16_t) length, 1000);
+		lang_id, data, (uint16_t) length, timeout);
 }
 
-#endif
-
 
 static wchar_t *ctowcdup(const char *s, size_t slen)
 {
@@ -480,35 +757,35 @@ static wchar_t *utf8_to_wchar(char *utf8, size_t utf8bytes)
 
 /* Get the first language the device says it reports. This comes from
    USB string #0. */
-static uint16_t get_first_language(libusb_device_handle *dev)
+static uint16_t get_first_language(libusb_device_handle *dev, uint64_t deadline)
 {
 	uint16_t buf[32];
 	int len;
 
 	/* Get the string from libusb. */
-	len = libusb_get_string_descriptor(dev,
+	len = get_string_descriptor(dev,
 			0x0, /* String ID */
 			0x0, /* Language */
 			(unsigned char*)buf,
-			sizeof(buf));
+			sizeof(buf), deadline);
 	if (len < 4)
 		return 0x0;
 
 	return buf[1]; /* First two bytes are len and descriptor type. */
 }
 
-static int is_language_supported(libusb_device_handle *dev, uint16_t lang)
+static int is_language_supported(libusb_device_handle *dev, uint16_t lang, uint64_t deadline)
 {
 	uint16_t buf[32];
 	int len;
 	int i;
 
 	/* Get the string from libusb. */
-	len = libusb_get_string_descriptor(dev,
+	len = get_string_descriptor(dev,
 			0x0, /* String ID */
 			0x0, /* Language */
 			(unsigned char*)buf,
-			sizeof(buf));
+			sizeof(buf), deadline);
 	if (len < 4)
 		return 0x0;
 
@@ -524,26 +801,37 @@ static int is_language_supported(libusb_device_handle *dev, uint16_t lang)
 }
 
 
-/* This function returns a newly allocated wide string containing the USB
-   device string numbered by the index. The returned string must be freed
-   by using free(). */
-static wchar_t *get_usb_string(libusb_device_handle *dev, uint8_t idx, int *res)
+/* Gets the USB device string numbered by the index, in the language
+   of the current locale if the device supports it, into buf.
+   Returns the number of bytes of the string descriptor (the string itself,
+   in UTF-16LE, starts at its third byte), or LIBUSB_ERROR_*.
+   The transfers end by the deadline (see probe_deadline()), 0 for none. */
+static int get_usb_string_descriptor(libusb_device_handle *dev, uint8_t idx, uint64_t deadline, unsigned char *buf, int length)
 {
-	char buf[512];
-	int len;
-
 	/* Determine which language to use. */
 	uint16_t lang;
 	lang = get_usb_code_for_current_locale();
-	if (!is_language_supported(dev, lang))
-		lang = get_first_language(dev);
+	if (!is_language_supported(dev, lang, deadline))
+		lang = get_first_language(dev, deadline);
 
 	/* Get the string from libusb. */
-	len = libusb_get_string_descriptor(dev,
+	return get_string_descriptor(dev,
 			idx,
 			lang,
-			(unsigned char*)buf,
-			sizeof(buf));
+			buf,
+			length, deadline);
+}
+
+/* This function returns a newly allocated wide string containing the USB
+   device string numbered by the index. The returned string must be freed
+   by using free(). The transfers end by the deadline (see probe_deadline()),
+   0 for none. */
+static wchar_t *get_usb_string(libusb_device_handle *dev, uint8_t idx, uint64_t deadline, int *res)
+{
+	char buf[512];
+	int len;
+
+	len = get_usb_string_descriptor(dev, idx, deadline, (unsigned char*)buf, sizeof(buf));
 	*res = len;
 
 	if (len < 2) /* we always skip first 2 bytes */
@@ -552,6 +840,46 @@ static wchar_t *get_usb_string(libusb_device_handle *dev, uint8_t idx, int *res)
 	return utf16le_to_wchar(buf + 2, (size_t)(len - 2));
 }
 
+/* Returns non-zero if the USB device string numbered by the index is str.
+   The string descriptor is compared as is (in UTF-16LE), without
+   converting it to a wide string. */
+static int usb_string_equals(libusb_device_handle *dev, uint8_t idx, const wchar_t *str)
+{
+	unsigned char buf[512];
+	int len;
+	int i = 2; /* we always skip first 2 bytes */
+
+	len = get_usb_string_descriptor(dev, idx, 0, buf, sizeof(buf));
+	if (len < 2)
+		return 0;
+
+	for (; *str; str++) {
+		uint32_t c = (uint32_t)*str;
+		uint16_t units[2];
+		int num_units = 1;
+		int k;
+
+		if (c >= 0x10000) {
+			/* A surrogate pair, where wchar_t is 32 bits */
+			c -= 0x10000;
+			units[0] = (uint16_t)(0xD800 | (c >> 10));
+			units[1] = (uint16_t)(0xDC00 | (c & 0x3FF));
+			num_units = 2;
+		}
+		else {
+			units[0] = (uint16_t)c;
+		}
+
+		for (k = 0; k < num_units; k++) {
+			if (i + 2 > len || (uint16_t)(buf[i] | (buf[i + 1] << 8)) != units[k])
+				return 0;
+			i += 2;
+		}
+	}
+
+	return i + 2 > len;
+}
+
 /**
   Max length of the result: "000-000.000.000.000.000.000.000:000.000" (39 chars).
   64 is used for simplicity/alignment.
@@ -617,6 +945,36 @@ int HID_API_EXPORT hid_init(void)
 		locale = setlocale(LC_CTYPE, NULL);
 		if (!locale)
 			setlocale(LC_CTYPE, "");
+
+#ifdef HIDAPI_HAS_HOTPLUG
+		hidapi_thread_state_init(&enumeration_cache_state);
+		hidapi_thread_state_init(&device_cache_state);
+		hidapi_thread_state_init(&hotplug_thread_state);
+#endif
+
+		hidapi_thread_state_init(&report_descriptor_cache_state);
+
+		/* Start the event thread, shared by all of the devices */
+		event_thread_shutdown = 0;
+		event_thread_failed = 0;
+		hidapi_thread_state_init(&event_thread_state);
+		if (hidapi_thread_create(&event_thread_state, event_thread, NULL) != 0) {
+			hidapi_thread_state_destroy(&event_thread_state);
+#ifdef HIDAPI_HAS_HOTPLUG
+			hidapi_thread_state_destroy(&hotplug_thread_state);
+			hidapi_thread_state_destroy(&enumeration_cache_state);
+			hidapi_thread_state_destroy(&device_cache_state);
+#endif
+			hidapi_thread_state_destroy(&report_descriptor_cache_state);
+
+			libusb_exit(usb_context);
+			usb_context = NULL;
+			register_string_error(&last_global_error, "hid_init: couldn't start the event thread");
+			return -1;
+		}
+
+		/* Wait here for the event thread to be initialized. */
+		hidapi_thread_barrier_wait(&event_thread_state);
 	}
 
 	return 0;
@@ -625,6 +983,28 @@ int HID_API_EXPORT hid_init(void)
 int HID_API_EXPORT hid_exit(void)
 {
 	if (usb_context) {
+#ifdef HIDAPI_HAS_HOTPLUG
+		hotplug_stop();
+		hidapi_thread_state_destroy(&hotplug_thread_state);
+
+		enumeration_cache_disable();
+		hidapi_thread_state_destroy(&enumeration_cache_state);
+
+		device_cache_stop();
+		hidapi_thread_state_destroy(&device_cache_state);
+#endif
+
+		report_descriptor_cache_disable();
+		hidapi_thread_state_destroy(&report_descriptor_cache_state);
+
+		/* Stop the event thread */
+		event_thread_shutdown = 1;
+#ifdef HIDAPI_HAS_INTERRUPT_EVENT_HANDLER
+		libusb_interrupt_event_handler(usb_context);
+#endif
+		hidapi_thread_join(&event_thread_state);
+		hidapi_thread_state_destroy(&event_thread_state);
+
 		libusb_exit(usb_context);
 		usb_context = NULL;
 	}
@@ -636,22 +1016,180 @@ int HID_API_EXPORT hid_exit(void)
 	return 0;
 }
 
-static int hid_get_report_descriptor_libusb(libusb_device_handle *handle, int interface_num, uint16_t expected_report_descriptor_size, unsigned char *buf, size_t buf_size)
+/* Looks a descriptor up in the report descriptor cache, with the lock held */
+static struct report_descriptor_cache_entry *report_descriptor_cache_find(unsigned short vendor_id, unsigned short product_id, unsigned short release_number, int interface_number, uint16_t expected_size)
+{
+	struct report_descriptor_cache_entry *entry;
+
+	for (entry = report_descriptor_cache; entry; entry = entry->next) {
+		if (entry->vendor_id == vendor_id &&
+		    entry->product_id == product_id &&
+		    entry->release_number == release_number &&
+		    entry->interface_number == interface_number &&
+		    entry->expected_size == expected_size)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Adds a descriptor to the report descriptor cache (unless it is already
+   there), parsing its usage pair, with the lock held */
+static void report_descriptor_cache_add(unsigned short vendor_id, unsigned short product_id, unsigned short release_number, int interface_number, uint16_t expected_size, const unsigned char *descriptor, size_t size)
+{
+	struct report_descriptor_cache_entry *entry;
+
+	if (report_descriptor_cache_find(vendor_id, product_id, release_number, interface_number, expected_size))
+		return;
+
+	entry = (struct report_descriptor_cache_entry*) calloc(1, sizeof(struct report_descriptor_cache_entry));
+	if (!entry)
+		return;
+
+	entry->descriptor = (unsigned char*) malloc(size? size: 1);
+	if (!entry->descriptor) {
+		free(entry);
+		return;
+	}
+
+	entry->vendor_id = vendor_id;
+	entry->product_id = product_id;
+	entry->release_number = release_number;
+	entry->interface_number = interface_number;
+	entry->expected_size = expected_size;
+	memcpy(entry->descriptor, descriptor, size);
+	entry->size = size;
+	get_usage(entry->descriptor, entry->size, &entry->usage_page, &entry->usage);
+
+	entry->next = report_descriptor_cache;
+	report_descriptor_cache = entry;
+}
+
+/* Copies the cached descriptor of an interface of an opened device into
+   buf (if not NULL) and its usage pair into *usage_page and *usage
+   (if not NULL). Returns the length of the descriptor, or -1 if it
+   is not in the cache (or the cache is disabled). */
+static int report_descriptor_cache_get(libusb_device_handle *handle, int interface_num, uint16_t expected_size, unsigned char *buf, size_t buf_size, unsigned short *usage_page, unsigned short *usage)
+{
+	struct libusb_device_descriptor desc;
+	struct report_descriptor_cache_entry *entry;
+	int res = -1;
+
+	if (expected_size > HID_API_MAX_REPORT_DESCRIPTOR_SIZE)
+		expected_size = HID_API_MAX_REPORT_DESCRIPTOR_SIZE;
+
+	if (libusb_get_device_descriptor(libusb_get_device(handle), &desc) < 0)
+		return -1;
+
+	hidapi_thread_mutex_lock(&report_descriptor_cache_state);
+	entry = report_descriptor_cache_enabled? report_descriptor_cache_find(desc.idVendor, desc.idProduct, desc.bcdDevice, interface_num, expected_size): NULL;
+	if (entry) {
+		res = (int)entry->size;
+		if (buf) {
+			if (res > (int)buf_size)
+				res = (int)buf_size;
+			memcpy(buf, entry->descriptor, (size_t)res);
+		}
+		if (usage_page)
+			*usage_page = entry->usage_page;
+		if (usage)
+			*usage = entry->usage;
+	}
+	hidapi_thread_mutex_unlock(&report_descriptor_cache_state);
+
+	return res;
+}
+
+/* Adds the descriptor of an interface of an opened device
+   to the report descriptor cache, if it is enabled */
+static void report_descriptor_cache_put(libusb_device_handle *handle, int interface_num, uint16_t expected_size, const unsigned char *descriptor, size_t size)
+{
+	struct libusb_device_descriptor desc;
+
+	if (libusb_get_device_descriptor(libusb_get_device(handle), &desc) < 0)
+		return;
+
+	hidapi_thread_mutex_lock(&report_descriptor_cache_state);
+	if (report_descriptor_cache_enabled)
+		report_descriptor_cache_add(desc.idVendor, desc.idProduct, desc.bcdDevice, interface_num, expected_size, descriptor, size);
+	hidapi_thread_mutex_unlock(&report_descriptor_cache_state);
+}
+
+static void report_descriptor_cache_add_record(const struct report_descriptor_cache_record *record)
+{
+	/* Only USB devices are handled */
+	if (record->bus_type != HID_API_BUS_USB)
+		return;
+
+	report_descriptor_cache_add(record->vendor_id, record->product_id, record->release_number,
+		record->interface_number, record->expected_size, record->descriptor, record->size);
+}
+
+static int report_descriptor_cache_next_record(void **iter, struct report_descriptor_cache_record *record)
+{
+	struct report_descriptor_cache_entry *entry = (struct report_descriptor_cache_entry*) *iter;
+
+	if (!entry)
+		return 0;
+
+	record->bus_type = HID_API_BUS_USB;
+	record->vendor_id = entry->vendor_id;
+	record->product_id = entry->product_id;
+	record->release_number = entry->release_number;
+	record->interface_number = entry->interface_number;
+	record->expected_size = entry->expected_size;
+	record->descriptor = entry->descriptor;
+	record->size = entry->size;
+
+	*iter = entry->next;
+	return 1;
+}
+
+static void report_descriptor_cache_disable(void)
+{
+	hidapi_thread_mutex_lock(&report_descriptor_cache_state);
+
+	if (report_descriptor_cache_enabled && report_descriptor_cache_path) {
+		if (report_descriptor_cache_save(report_descriptor_cache_path, report_descriptor_cache) < 0)
+			LOG("Couldn't write the report descriptor cache to %s\n", report_descriptor_cache_path);
+	}
+
+	report_descriptor_cache_enabled = 0;
+	free(report_descriptor_cache_path);
+	report_descriptor_cache_path = NULL;
+
+	while (report_descriptor_cache) {
+		struct report_descriptor_cache_entry *next = report_descriptor_cache->next;
+		free(report_descriptor_cache->descriptor);
+		free(report_descriptor_cache);
+		report_descriptor_cache = next;
+	}
+
+	hidapi_thread_mutex_unlock(&report_descriptor_cache_state);
+}
+
+static int hid_get_report_descriptor_libusb(libusb_device_handle *handle, int interface_num, uint16_t expected_report_descriptor_size, unsigned char *buf, size_t buf_size, unsigned int timeout)
 {
 	unsigned char tmp[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
 
 	if (expected_report_descriptor_size > HID_API_MAX_REPORT_DESCRIPTOR_SIZE)
 		expected_report_descriptor_size = HID_API_MAX_REPORT_DESCRIPTOR_SIZE;
 
+	int res = report_descriptor_cache_get(handle, interface_num, expected_report_descriptor_size, buf, buf_size, NULL, NULL);
+	if (res >= 0)
+		return res;
+
 	/* Get the HID Report Descriptor.
 	   See USB HID Specification, section 7.1.1
 	*/
-	int res = libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN|LIBUSB_RECIPIENT_INTERFACE, LIBUSB_REQUEST_GET_DESCRIPTOR, (LIBUSB_DT_REPORT << 8), interface_num, tmp, expected_report_descriptor_size, 5000);
+	res = libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN|LIBUSB_RECIPIENT_INTERFACE, LIBUSB_REQUEST_GET_DESCRIPTOR, (LIBUSB_DT_REPORT << 8), interface_num, tmp, expected_report_descriptor_size, timeout);
 	if (res < 0) {
 		LOG("libusb_control_transfer() for getting the HID Report descriptor failed with %d: %s\n", res, libusb_error_name(res));
 		return res;
 	}
 
+	report_descriptor_cache_put(handle, interface_num, expected_report_descriptor_size, tmp, (size_t)res);
+
 	if (res > (int)buf_size)
 		res = (int)buf_size;
 
@@ -662,16 +1200,19 @@ static int hid_get_report_descriptor_libusb(libusb_device_handle *handle, int in
 /**
  * Requires an opened device with *claimed interface*.
  */
-static void fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t expected_report_descriptor_size)
+static void fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t expected_report_descriptor_size, unsigned int timeout)
 {
 	unsigned char hid_report_descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
 	unsigned short page = 0, usage = 0;
 
-	int res = hid_get_report_descriptor_libusb(handle, interface_num, expected_report_descriptor_size, hid_report_descriptor, sizeof(hid_report_descriptor));
-	if (res >= 0) {
-		/* Parse the usage and usage page
-		   out of the report descriptor. */
-		get_usage(hid_report_descriptor, res,  &page, &usage);
+	/* A cached descriptor was parsed already */
+	if (report_descriptor_cache_get(handle, interface_num, expected_report_descriptor_size, NULL, 0, &page, &usage) < 0) {
+		int res = hid_get_report_descriptor_libusb(handle, interface_num, expected_report_descriptor_size, hid_report_descriptor, sizeof(hid_report_descriptor), timeout);
+		if (res >= 0) {
+			/* Parse the usage and usage page
+			   out of the report descriptor. */
+			get_usage(hid_report_descriptor, res,  &page, &usage);
+		}
 	}
 
 	cur_dev->usage_page = page;
@@ -679,9 +1220,17 @@ static void fill_device_info_usage(struct hid_device_info *cur_dev, libusb_devic
 }
 
 #ifdef INVASIVE_GET_USAGE
-static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t report_descriptor_size)
+/* The deadline of the probe (0 for none, see probe_deadline()) bounds
+   the transfer of the report descriptor only: neither libusb_open()
+   nor the claim of the interface can be given a timeout. */
+static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t report_descriptor_size, uint64_t deadline)
 {
 	int res = 0;
+	unsigned int timeout;
+
+	/* A cached descriptor needs no claim of the interface */
+	if (report_descriptor_cache_get(handle, interface_num, report_descriptor_size, NULL, 0, &cur_dev->usage_page, &cur_dev->usage) >= 0)
+		return;
 
 #ifdef DETACH_KERNEL_DRIVER
 	int detached = 0;
@@ -698,7 +1247,9 @@ static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, lib
 
 	res = libusb_claim_interface(handle, interface_num);
 	if (res >= 0) {
-		fill_device_info_usage(cur_dev, handle, interface_num, report_descriptor_size);
+		timeout = deadline? probe_timeout(deadline): HIDAPI_REPORT_DESCRIPTOR_TIMEOUT;
+		if (timeout != 0)
+			fill_device_info_usage(cur_dev, handle, interface_num, report_descriptor_size, timeout);
 
 		/* Release the interface */
 		res = libusb_release_interface(handle, interface_num);
@@ -722,10 +1273,13 @@ static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, lib
 /**
  * Create and fill up most of hid_device_info fields.
  * usage_page/usage is not filled up.
+ * Returns NULL if the serial number doesn't match the filter.
+ * The strings are left NULL once the deadline (0 for none) passed.
  */
-static struct hid_device_info * create_device_info_for_device(libusb_device *device, libusb_device_handle *handle, struct libusb_device_descriptor *desc, int config_number, int interface_num)
+static struct hid_device_info * create_device_info_for_device(libusb_device *device, libusb_device_handle *handle, struct libusb_device_descriptor *desc, int config_number, int interface_num, const struct hid_enumerate_filter *filter, uint64_t deadline)
 {
 	int res = 0;
+	int fields = enumerate_filter_fields(filter);
 	struct hid_device_info *cur_dev = (struct hid_device_info *) calloc(1, sizeof(struct hid_device_info));
 	if (cur_dev == NULL) {
 		return NULL;
@@ -743,18 +1297,23 @@ static struct hid_device_info * create_device_info_for_device(libusb_device *dev
 
 	cur_dev->path = make_path(device, config_number, interface_num);
 
+	if (handle && desc->iSerialNumber > 0 && (fields & HID_API_DEVICE_INFO_SERIAL_NUMBER))
+		cur_dev->serial_number = get_usb_string(handle, desc->iSerialNumber, deadline, &res);
+
+	if (!enumerate_filter_match_serial_number(filter, cur_dev->serial_number)) {
+		hid_free_enumeration(cur_dev);
+		return NULL;
+	}
+
 	if (!handle) {
 		return cur_dev;
 	}
 
-	if (desc->iSerialNumber > 0)
-		cur_dev->serial_number = get_usb_string(handle, desc->iSerialNumber, &res);
-
 	/* Manufacturer and Product strings */
-	if (desc->iManufacturer > 0)
-		cur_dev->manufacturer_string = get_usb_string(handle, desc->iManufacturer, &res);
-	if (desc->iProduct > 0)
-		cur_dev->product_string = get_usb_string(handle, desc->iProduct, &res);
+	if (desc->iManufacturer > 0 && (fields & HID_API_DEVICE_INFO_MANUFACTURER_STRING))
+		cur_dev->manufacturer_string = get_usb_string(handle, desc->iManufacturer, deadline, &res);
+	if (desc->iProduct > 0 && (fields & HID_API_DEVICE_INFO_PRODUCT_STRING))
+		cur_dev->product_string = get_usb_string(handle, desc->iProduct, deadline, &res);
 
 	return cur_dev;
 }
@@ -913,122 +1472,688 @@ static int should_enumerate_interface(unsigned short vendor_id, const struct lib
 	return 0;
 }
 
-struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+/* Creates the records of the HID interfaces of a USB device
+   which match the filter (NULL for all of them). The bus type
+   (always USB) is not checked. The device is given up on (the
+   records are left without their strings) by the deadline,
+   see probe_deadline(). */
+static struct hid_device_info *enumerate_device(libusb_device *dev, const struct hid_enumerate_filter *filter, uint64_t deadline)
 {
-	libusb_device **devs;
-	libusb_device *dev;
 	libusb_device_handle *handle = NULL;
-	ssize_t num_devs;
-	int i = 0;
-
-	struct hid_device_info *root = NULL; /* return object */
+	struct hid_device_info *root = NULL;
 	struct hid_device_info *cur_dev = NULL;
+	struct libusb_device_descriptor desc;
+	struct libusb_config_descriptor *conf_desc = NULL;
+	int j, k;
 
-	if(hid_init() < 0)
-		/* register_global_error: global error is set by hid_init */
+	int res = libusb_get_device_descriptor(dev, &desc);
+	if (res < 0)
 		return NULL;
 
-	num_devs = libusb_get_device_list(usb_context, &devs);
-	if (num_devs < 0) {
-		register_libusb_error(&last_global_error, num_devs, "libusb_get_device_list");
+	unsigned short dev_vid = desc.idVendor;
+	unsigned short dev_pid = desc.idProduct;
+
+	if (filter &&
+	    ((filter->vendor_id != 0x0 && filter->vendor_id != dev_vid) ||
+	     (filter->product_id != 0x0 && filter->product_id != dev_pid))) {
 		return NULL;
 	}
-	while ((dev = devs[i++]) != NULL) {
-		struct libusb_device_descriptor desc;
-		struct libusb_config_descriptor *conf_desc = NULL;
-		int j, k;
 
-		int res = libusb_get_device_descriptor(dev, &desc);
-		if (res < 0)
-			continue;
-
-		unsigned short dev_vid = desc.idVendor;
-		unsigned short dev_pid = desc.idProduct;
-
-		if ((vendor_id != 0x0 && vendor_id != dev_vid) ||
-		    (product_id != 0x0 && product_id != dev_pid)) {
-			continue;
-		}
+	res = libusb_get_active_config_descriptor(dev, &conf_desc);
+	if (res < 0)
+		libusb_get_config_descriptor(dev, 0, &conf_desc);
+	if (conf_desc) {
+		for (j = 0; j < conf_desc->bNumInterfaces; j++) {
+			const struct libusb_interface *intf = &conf_desc->interface[j];
+			for (k = 0; k < intf->num_altsetting; k++) {
+				const struct libusb_interface_descriptor *intf_desc;
+				intf_desc = &intf->altsetting[k];
+				if (should_enumerate_interface(dev_vid, intf_desc)) {
+					struct hid_device_info *tmp;
+#ifdef INVASIVE_GET_USAGE
+					int open_device = 1;
+#else
+					/* The device is only opened to get the strings */
+					int open_device = (enumerate_filter_fields(filter) & HID_API_DEVICE_INFO_ALL_STRINGS) != 0;
+#endif
 
-		res = libusb_get_active_config_descriptor(dev, &conf_desc);
-		if (res < 0)
-			libusb_get_config_descriptor(dev, 0, &conf_desc);
-		if (conf_desc) {
-			for (j = 0; j < conf_desc->bNumInterfaces; j++) {
-				const struct libusb_interface *intf = &conf_desc->interface[j];
-				for (k = 0; k < intf->num_altsetting; k++) {
-					const struct libusb_interface_descriptor *intf_desc;
-					intf_desc = &intf->altsetting[k];
-					if (should_enumerate_interface(dev_vid, intf_desc)) {
-						struct hid_device_info *tmp;
+					if (filter && (filter->match & HID_API_FILTER_INTERFACE_NUMBER) &&
+					    filter->interface_number != intf_desc->bInterfaceNumber) {
+						break;
+					}
 
-						res = libusb_open(dev, &handle);
+					res = open_device? libusb_open(dev, &handle): LIBUSB_ERROR_NOT_SUPPORTED;
 
 #ifdef __ANDROID__
-						if (handle) {
-							/* There is (a potential) libusb Android backend, in which
-							   device descriptor is not accurate up until the device is opened.
-							   https://github.com/libusb/libusb/pull/874#discussion_r632801373
-							   A workaround is to re-read the descriptor again.
-							   Even if it is not going to be accepted into libusb master,
-							   having it here won't do any harm, since reading the device descriptor
-							   is as cheap as copy 18 bytes of data. */
-							libusb_get_device_descriptor(dev, &desc);
-						}
+					if (handle) {
+						/* There is (a potential) libusb Android backend, in which
+						   device descriptor is not accurate up until the device is opened.
+						   https://github.com/libusb/libusb/pull/874#discussion_r632801373
+						   A workaround is to re-read the descriptor again.
+						   Even if it is not going to be accepted into libusb master,
+						   having it here won't do any harm, since reading the device descriptor
+						   is as cheap as copy 18 bytes of data. */
+						libusb_get_device_descriptor(dev, &desc);
+					}
 #endif
 
-						tmp = create_device_info_for_device(dev, handle, &desc, conf_desc->bConfigurationValue, intf_desc->bInterfaceNumber);
-						if (tmp) {
+					tmp = create_device_info_for_device(dev, handle, &desc, conf_desc->bConfigurationValue, intf_desc->bInterfaceNumber, filter, deadline);
 #ifdef INVASIVE_GET_USAGE
-							/* TODO: have a runtime check for this section. */
-
-							/*
-							This section is removed because it is too
-							invasive on the system. Getting a Usage Page
-							and Usage requires parsing the HID Report
-							descriptor. Getting a HID Report descriptor
-							involves claiming the interface. Claiming the
-							interface involves detaching the kernel driver.
-							Detaching the kernel driver is hard on the system
-							because it will unclaim interfaces (if another
-							app has them claimed) and the re-attachment of
-							the driver will sometimes change /dev entry names.
-							It is for these reasons that this section is
-							optional. For composite devices, use the interface
-							field in the hid_device_info struct to distinguish
-							between interfaces. */
-							if (handle) {
-								uint16_t report_descriptor_size = get_report_descriptor_size_from_interface_descriptors(intf_desc);
-
-								invasive_fill_device_info_usage(tmp, handle, intf_desc->bInterfaceNumber, report_descriptor_size);
-							}
-#endif /* INVASIVE_GET_USAGE */
+					if (tmp) {
+						/* TODO: have a runtime check for this section. */
+
+						/*
+						This section is removed because it is too
+						invasive on the system. Getting a Usage Page
+						and Usage requires parsing the HID Report
+						descriptor. Getting a HID Report descriptor
+						involves claiming the interface. Claiming the
+						interface involves detaching the kernel driver.
+						Detaching the kernel driver is hard on the system
+						because it will unclaim interfaces (if another
+						app has them claimed) and the re-attachment of
+						the driver will sometimes change /dev entry names.
+						It is for these reasons that this section is
+						optional. For composite devices, use the interface
+						field in the hid_device_info struct to distinguish
+						between interfaces. */
+						if (handle && probe_timeout(deadline) != 0) {
+							uint16_t report_descriptor_size = get_report_descriptor_size_from_interface_descriptors(intf_desc);
+
+							invasive_fill_device_info_usage(tmp, handle, intf_desc->bInterfaceNumber, report_descriptor_size, deadline);
+						}
 
-							if (cur_dev) {
-								cur_dev->next = tmp;
-							}
-							else {
-								root = tmp;
-							}
-							cur_dev = tmp;
+						if (!enumerate_filter_match_usage(filter, tmp->usage_page, tmp->usage)) {
+							hid_free_enumeration(tmp);
+							tmp = NULL;
 						}
+					}
+#endif /* INVASIVE_GET_USAGE */
 
-						if (res >= 0) {
-							libusb_close(handle);
-							handle = NULL;
+					if (tmp) {
+						if (cur_dev) {
+							cur_dev->next = tmp;
 						}
-						break;
+						else {
+							root = tmp;
+						}
+						cur_dev = tmp;
 					}
-				} /* altsettings */
-			} /* interfaces */
-			libusb_free_config_descriptor(conf_desc);
-		}
+
+					if (res >= 0) {
+						libusb_close(handle);
+						handle = NULL;
+					}
+					break;
+				}
+			} /* altsettings */
+		} /* interfaces */
+		libusb_free_config_descriptor(conf_desc);
 	}
 
-	libusb_free_device_list(devs, 1);
+	return root;
+}
 
+/* Probes the devices of hid_enumerate() on several threads,
+   see hid_libusb_set_enumerate_threads() */
+struct enumerate_pool {
+	hidapi_thread_state state; /* mutex protects next */
+	libusb_device **devs;
+	ssize_t num_devs;
+	ssize_t next;
+	const struct hid_enumerate_filter *filter;
+	/* The records of each device, by index in devs */
+	struct hid_device_info **results;
+};
+
+static void *enumerate_pool_thread(void *param)
+{
+	struct enumerate_pool *pool = (struct enumerate_pool *) param;
+
+	for (;;) {
+		ssize_t i;
+
+		hidapi_thread_mutex_lock(&pool->state);
+		i = pool->next < pool->num_devs? pool->next++: -1;
+		hidapi_thread_mutex_unlock(&pool->state);
+
+		if (i < 0)
+			break;
+
+		pool->results[i] = enumerate_device(pool->devs[i], pool->filter, probe_deadline());
+	}
+
+	return NULL;
+}
+
+/* Returns the records of the devices which match the filter, in the
+   order of devs, however many threads probed them. */
+static struct hid_device_info *enumerate_devices(libusb_device **devs, ssize_t num_devs, const struct hid_enumerate_filter *filter)
+{
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur_dev = NULL;
+	struct enumerate_pool pool;
+	hidapi_thread_state *threads = NULL;
+	int num_threads = enumerate_threads;
+	ssize_t i;
+
+	if (num_threads > num_devs)
+		num_threads = (int)num_devs;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.devs = devs;
+	pool.num_devs = num_devs;
+	pool.filter = filter;
+
+	if (num_threads > 1) {
+		pool.results = (struct hid_device_info **) calloc((size_t)num_devs, sizeof(struct hid_device_info *));
+		threads = (hidapi_thread_state *) calloc((size_t)num_threads - 1, sizeof(hidapi_thread_state));
+	}
+
+	if (pool.results && threads) {
+		int t;
+		int num_started;
+
+		hidapi_thread_state_init(&pool.state);
+		for (num_started = 0; num_started < num_threads - 1; num_started++) {
+			hidapi_thread_state_init(&threads[num_started]);
+			if (hidapi_thread_create(&threads[num_started], enumerate_pool_thread, &pool) != 0) {
+				/* Whatever the threads which did start don't
+				   take is probed by the calling thread */
+				LOG("enumerate_devices(): only %d of %d threads started\n", num_started, num_threads - 1);
+				hidapi_thread_state_destroy(&threads[num_started]);
+				break;
+			}
+		}
+
+		/* The calling thread is one of the workers */
+		enumerate_pool_thread(&pool);
+
+		for (t = 0; t < num_started; t++) {
+			hidapi_thread_join(&threads[t]);
+			hidapi_thread_state_destroy(&threads[t]);
+		}
+		hidapi_thread_state_destroy(&pool.state);
+	}
+	else {
+		/* A single thread, or out of memory: probe one device at a time */
+		free(pool.results);
+		pool.results = NULL;
+	}
+
+	for (i = 0; i < num_devs; i++) {
+		struct hid_device_info *tmp = pool.results? pool.results[i]: enumerate_device(devs[i], filter, probe_deadline());
+		if (tmp) {
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
+			}
+			cur_dev = tmp;
+
+			/* move the pointer to the tail of returned list */
+			while (cur_dev->next != NULL) {
+				cur_dev = cur_dev->next;
+			}
+		}
+	}
+
+	free(pool.results);
+	free(threads);
+
+	return root;
+}
+
+#ifdef HIDAPI_HAS_HOTPLUG
+static void free_enumeration_cache_entry(struct enumeration_cache_entry *entry)
+{
+	hid_free_enumeration(entry->info);
+	libusb_unref_device(entry->device);
+	free(entry);
+}
+
+/* Called on the event thread (and, for the devices already connected,
+   from libusb_hotplug_register_callback()). It only records the change:
+   the devices are probed by the next hid_enumerate(). */
+static int LIBUSB_CALL enumeration_cache_hotplug_callback(libusb_context *ctx, libusb_device *device, libusb_hotplug_event event, void *user_data)
+{
+	struct enumeration_cache_entry **entry_ptr;
+	struct enumeration_cache_entry *entry;
+
+	(void)ctx;
+	(void)user_data;
+
+	hidapi_thread_mutex_lock(&enumeration_cache_state);
+
+	entry_ptr = &enumeration_cache;
+	while (*entry_ptr && (*entry_ptr)->device != device)
+		entry_ptr = &(*entry_ptr)->next;
+	entry = *entry_ptr;
+
+	if (enumeration_cache_enabled) {
+		if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+			if (!entry) {
+				entry = (struct enumeration_cache_entry*) calloc(1, sizeof(struct enumeration_cache_entry));
+				if (entry) {
+					entry->device = libusb_ref_device(device);
+					/* New devices are added at the end, so the records are
+					   listed in the order the devices were connected. */
+					*entry_ptr = entry;
+				}
+			}
+		}
+		else if (entry) {
+			*entry_ptr = entry->next;
+			free_enumeration_cache_entry(entry);
+		}
+	}
+
+	hidapi_thread_mutex_unlock(&enumeration_cache_state);
+
+	return 0;
+}
+
+static void enumeration_cache_disable(void)
+{
+	int enabled;
+
+	hidapi_thread_mutex_lock(&enumeration_cache_state);
+	enabled = enumeration_cache_enabled;
+	enumeration_cache_enabled = 0;
+	hidapi_thread_mutex_unlock(&enumeration_cache_state);
+
+	if (enabled)
+		libusb_hotplug_deregister_callback(usb_context, enumeration_cache_hotplug);
+
+	hidapi_thread_mutex_lock(&enumeration_cache_state);
+	while (enumeration_cache) {
+		struct enumeration_cache_entry *next = enumeration_cache->next;
+		free_enumeration_cache_entry(enumeration_cache);
+		enumeration_cache = next;
+	}
+	hidapi_thread_mutex_unlock(&enumeration_cache_state);
+}
+
+/* Returns 0 if the cache is disabled. Otherwise probes the devices
+   which arrived since the previous call, and sets *devs to a copy
+   of the matching records. */
+static int enumeration_cache_enumerate(const struct hid_enumerate_filter *filter, struct hid_device_info **devs)
+{
+	struct enumeration_cache_entry *entry;
+	struct hid_device_info *info;
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur_dev = NULL;
+
+	hidapi_thread_mutex_lock(&enumeration_cache_state);
+
+	if (!enumeration_cache_enabled) {
+		hidapi_thread_mutex_unlock(&enumeration_cache_state);
+		return 0;
+	}
+
+	for (;;) {
+		libusb_device *device;
+
+		for (entry = enumeration_cache; entry && entry->probed; entry = entry->next)
+			;
+		if (!entry)
+			break;
+
+		/* Probing opens the device, so it is done without holding the
+		   mutex, which the hotplug callback takes on the event thread.
+		   The entry may be gone (the device left) when it is done. */
+		device = libusb_ref_device(entry->device);
+		entry->probed = 1;
+		hidapi_thread_mutex_unlock(&enumeration_cache_state);
+
+		info = enumerate_device(device, NULL, probe_deadline());
+
+		hidapi_thread_mutex_lock(&enumeration_cache_state);
+		for (entry = enumeration_cache; entry && entry->device != device; entry = entry->next)
+			;
+		if (entry && !entry->info) {
+			entry->info = info;
+		}
+		else {
+			hid_free_enumeration(info);
+		}
+		libusb_unref_device(device);
+	}
+
+	for (entry = enumeration_cache; entry; entry = entry->next) {
+		for (info = entry->info; info; info = info->next) {
+			struct hid_device_info *tmp;
+
+			if (!enumerate_filter_match(filter, info))
+				continue;
+
+			tmp = copy_device_info(info);
+			if (!tmp) {
+				hid_free_enumeration(root);
+				root = NULL;
+				break;
+			}
+
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
+			}
+			cur_dev = tmp;
+		}
+		if (info)
+			break;
+	}
+
+	hidapi_thread_mutex_unlock(&enumeration_cache_state);
+
+	*devs = root;
+	return 1;
+}
+
+/* Called by the functions of core/hidapi_hotplug.c */
+static void hotplug_lock(void)
+{
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+}
+
+static void hotplug_unlock(void)
+{
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+}
+
+static void hotplug_device_arrived(struct hid_device_info *infos)
+{
+	while (infos) {
+		struct hid_device_info *info = infos;
+		struct hid_device_info **info_ptr = &hotplug_devices;
+		infos = info->next;
+		info->next = NULL;
+
+		/* Skip the interfaces already known, e.g. from
+		   the scan done when the thread was started */
+		while (*info_ptr && strcmp((*info_ptr)->path, info->path) != 0)
+			info_ptr = &(*info_ptr)->next;
+		if (*info_ptr) {
+			hid_free_enumeration(info);
+			continue;
+		}
+
+		*info_ptr = info;
+		hotplug_dispatch(hotplug_callbacks, info, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED);
+	}
+}
+
+static void hotplug_device_left(const char *path_prefix)
+{
+	struct hid_device_info **info_ptr = &hotplug_devices;
+	size_t prefix_len = strlen(path_prefix);
+
+	while (*info_ptr) {
+		struct hid_device_info *info = *info_ptr;
+		if (strncmp(info->path, path_prefix, prefix_len) == 0) {
+			*info_ptr = info->next;
+			info->next = NULL;
+			hotplug_dispatch(hotplug_callbacks, info, HID_API_HOTPLUG_EVENT_DEVICE_LEFT);
+			hid_free_enumeration(info);
+		}
+		else {
+			info_ptr = &info->next;
+		}
+	}
+}
+
+/* Called on the event thread. The device can't be probed here (the
+   probing needs the event thread), so the event is queued for the
+   hotplug thread. */
+static int LIBUSB_CALL hotplug_libusb_callback(libusb_context *ctx, libusb_device *device, libusb_hotplug_event event, void *user_data)
+{
+	struct hotplug_event *hotplug_ev;
+	struct hotplug_event **hotplug_ev_ptr;
+
+	(void)ctx;
+	(void)user_data;
+
+	hotplug_ev = (struct hotplug_event*) calloc(1, sizeof(struct hotplug_event));
+	if (!hotplug_ev)
+		return 0;
+
+	hotplug_ev->device = libusb_ref_device(device);
+	hotplug_ev->event = event;
+
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+	for (hotplug_ev_ptr = &hotplug_events; *hotplug_ev_ptr; hotplug_ev_ptr = &(*hotplug_ev_ptr)->next)
+		;
+	*hotplug_ev_ptr = hotplug_ev;
+	hidapi_thread_cond_broadcast(&hotplug_thread_state);
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+
+	return 0;
+}
+
+/* Calls the callbacks registered with hid_hotplug_register_callback(),
+   from the time the first one is registered until hid_exit(). */
+static void *hotplug_thread(void *param)
+{
+	(void)param;
+
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+
+	while (!hotplug_thread_shutdown) {
+		struct hotplug_event *hotplug_ev;
+
+		hotplug_callbacks_changed = 0;
+		hotplug_enumerate(hotplug_callbacks, hotplug_devices);
+		hotplug_remove_deregistered(&hotplug_callbacks);
+
+		hotplug_ev = hotplug_events;
+		if (!hotplug_ev) {
+			if (!hotplug_callbacks_changed && !hotplug_thread_shutdown)
+				hidapi_thread_cond_wait(&hotplug_thread_state);
+			continue;
+		}
+		hotplug_events = hotplug_ev->next;
+
+		/* Probing opens the device, and the path of a device which
+		   left can still be made from its bus and port numbers. */
+		hidapi_thread_mutex_unlock(&hotplug_thread_state);
+		if (hotplug_ev->event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+			struct hid_device_info *infos = enumerate_device(hotplug_ev->device, NULL, probe_deadline());
+
+			hidapi_thread_mutex_lock(&hotplug_thread_state);
+			hotplug_device_arrived(infos);
+		}
+		else {
+			char path_prefix[64];
+			char *separator;
+
+			/* All of the interfaces of the device: "<bus>-<ports>:" */
+			get_path(&path_prefix, hotplug_ev->device, 0, 0);
+			separator = strchr(path_prefix, ':');
+
+			hidapi_thread_mutex_lock(&hotplug_thread_state);
+			if (separator) {
+				separator[1] = '\0';
+				hotplug_device_left(path_prefix);
+			}
+		}
+
+		libusb_unref_device(hotplug_ev->device);
+		free(hotplug_ev);
+	}
+
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+
+	return NULL;
+}
+
+static void hotplug_stop(void)
+{
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+	if (!hotplug_thread_running) {
+		hidapi_thread_mutex_unlock(&hotplug_thread_state);
+		return;
+	}
+	hotplug_thread_shutdown = 1;
+	hidapi_thread_cond_broadcast(&hotplug_thread_state);
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+
+	libusb_hotplug_deregister_callback(usb_context, hotplug_libusb_handle);
+	hidapi_thread_join(&hotplug_thread_state);
+
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+	while (hotplug_events) {
+		struct hotplug_event *next = hotplug_events->next;
+		libusb_unref_device(hotplug_events->device);
+		free(hotplug_events);
+		hotplug_events = next;
+	}
+	while (hotplug_callbacks) {
+		struct hid_hotplug_callback *next = hotplug_callbacks->next;
+		free(hotplug_callbacks);
+		hotplug_callbacks = next;
+	}
+	hid_free_enumeration(hotplug_devices);
+	hotplug_devices = NULL;
+	hotplug_thread_running = 0;
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+}
+
+/* Called with the mutex of hotplug_thread_state locked */
+static int hotplug_start(void)
+{
+	struct hid_device_info *devs;
+	int res;
+
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		register_string_error(&last_global_error, "hid_hotplug_register_callback: hotplug is not supported by libusb on this platform");
+		return -1;
+	}
+
+	/* The libusb callback takes the mutex on the event thread, and
+	   the scan below needs the event thread: the mutex is released,
+	   with the other registrations waiting for the start to be done. */
+	hotplug_thread_starting = 1;
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+
+	/* The callback is registered before the scan, so no device is
+	   missed. An interface which is seen by both is only reported once. */
+	res = libusb_hotplug_register_callback(usb_context,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		LIBUSB_HOTPLUG_NO_FLAGS,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		hotplug_libusb_callback, NULL, &hotplug_libusb_handle);
+	if (res != LIBUSB_SUCCESS) {
+		register_libusb_error(&last_global_error, res, "libusb_hotplug_register_callback");
+		devs = NULL;
+	}
+	else {
+		devs = hid_enumerate(0, 0);
+		register_libusb_error(&last_global_error, LIBUSB_SUCCESS, NULL);
+	}
+
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+	hotplug_thread_starting = 0;
+	hidapi_thread_cond_broadcast(&hotplug_thread_state);
+
+	if (res != LIBUSB_SUCCESS)
+		return -1;
+
+	hotplug_devices = devs;
+	hotplug_thread_shutdown = 0;
+	if (hidapi_thread_create(&hotplug_thread_state, hotplug_thread, NULL) != 0) {
+		/* Undo the registration the same way as the start: without
+		   the mutex, the other registrations waiting */
+		hotplug_thread_starting = 1;
+		hidapi_thread_mutex_unlock(&hotplug_thread_state);
+		libusb_hotplug_deregister_callback(usb_context, hotplug_libusb_handle);
+		hidapi_thread_mutex_lock(&hotplug_thread_state);
+		hotplug_thread_starting = 0;
+		hidapi_thread_cond_broadcast(&hotplug_thread_state);
+
+		/* Drop the events which came in meanwhile */
+		while (hotplug_events) {
+			struct hotplug_event *next = hotplug_events->next;
+			libusb_unref_device(hotplug_events->device);
+			free(hotplug_events);
+			hotplug_events = next;
+		}
+		hid_free_enumeration(hotplug_devices);
+		hotplug_devices = NULL;
+
+		register_string_error(&last_global_error, "hid_hotplug_register_callback: couldn't start the hotplug thread");
+		return -1;
+	}
+	hotplug_thread_running = 1;
+
+	return 0;
+}
+#endif /* HIDAPI_HAS_HOTPLUG */
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	return hid_enumerate_fields(vendor_id, product_id, HID_API_DEVICE_INFO_ALL_STRINGS);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_fields(unsigned short vendor_id, unsigned short product_id, int fields)
+{
+	struct hid_enumerate_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.fields = fields;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_ex(const struct hid_enumerate_filter *filter)
+{
+	libusb_device **devs;
+	ssize_t num_devs;
+
+	struct hid_device_info *root = NULL; /* return object */
+
+	if(hid_init() < 0)
+		/* register_global_error: global error is set by hid_init */
+		return NULL;
+
+	if (!filter) {
+		register_string_error(&last_global_error, "hid_enumerate_ex: filter is NULL");
+		return NULL;
+	}
+
+	/* Only USB devices are handled, and without INVASIVE_GET_USAGE
+	   the usage of all of them is left 0. */
+	if (((filter->match & HID_API_FILTER_BUS_TYPE) && filter->bus_type != HID_API_BUS_USB)
+#ifndef INVASIVE_GET_USAGE
+	    || !enumerate_filter_match_usage(filter, 0, 0)
+#endif
+	    ) {
+		goto end;
+	}
+
+#ifdef HIDAPI_HAS_HOTPLUG
+	if (enumeration_cache_enumerate(filter, &root))
+		goto end;
+#endif
+
+	num_devs = libusb_get_device_list(usb_context, &devs);
+	if (num_devs < 0) {
+		register_libusb_error(&last_global_error, num_devs, "libusb_get_device_list");
+		return NULL;
+	}
+	root = enumerate_devices(devs, num_devs, filter);
+
+	libusb_free_device_list(devs, 1);
+
+end:
 	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
+		if (filter->match != 0 || filter->serial_number_prefix) {
+			register_string_error(&last_global_error, "No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
 			register_string_error(&last_global_error, "No HID devices found in the system.");
 		} else {
 			register_string_error(&last_global_error, "No HID devices with requested VID/PID found in the system.");
@@ -1052,48 +2177,531 @@ void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
 	}
 }
 
-hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+int HID_API_EXPORT hid_set_enumeration_cache(int enable)
 {
-	struct hid_device_info *devs, *cur_dev;
-	const char *path_to_open = NULL;
-	hid_device *handle = NULL;
+#ifdef HIDAPI_HAS_HOTPLUG
+	int res;
 
-	/* register_global_error: global error is reset by hid_enumerate/hid_init */
-	devs = hid_enumerate(vendor_id, product_id);
-	if (!devs) {
-		/* register_global_error: global error is already set by hid_enumerate */
-		return NULL;
+	if (!enable) {
+		register_libusb_error(&last_global_error, LIBUSB_SUCCESS, NULL);
+		if (usb_context)
+			enumeration_cache_disable();
+		return 0;
+	}
+
+	if (hid_init() < 0)
+		/* register_global_error: global error is set by hid_init */
+		return -1;
+
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		register_string_error(&last_global_error, "hid_set_enumeration_cache: hotplug is not supported by libusb on this platform");
+		return -1;
+	}
+
+	hidapi_thread_mutex_lock(&enumeration_cache_state);
+	if (enumeration_cache_enabled) {
+		hidapi_thread_mutex_unlock(&enumeration_cache_state);
+		return 0;
+	}
+	enumeration_cache_enabled = 1;
+	hidapi_thread_mutex_unlock(&enumeration_cache_state);
+
+	/* The callback is called for each of the devices already connected
+	   before this returns, which fills the cache. */
+	res = libusb_hotplug_register_callback(usb_context,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		LIBUSB_HOTPLUG_ENUMERATE,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		enumeration_cache_hotplug_callback, NULL, &enumeration_cache_hotplug);
+	if (res != LIBUSB_SUCCESS) {
+		hidapi_thread_mutex_lock(&enumeration_cache_state);
+		enumeration_cache_enabled = 0;
+		hidapi_thread_mutex_unlock(&enumeration_cache_state);
+		enumeration_cache_disable();
+		register_libusb_error(&last_global_error, res, "libusb_hotplug_register_callback");
+		return -1;
+	}
+
+	return 0;
+#else
+	if (!enable)
+		return 0;
+
+	register_string_error(&last_global_error, "hid_set_enumeration_cache: not supported by the libusb version HIDAPI was built with");
+	return -1;
+#endif
+}
+
+int HID_API_EXPORT hid_set_report_descriptor_cache(int enable, const char *path)
+{
+	char *path_copy = NULL;
+	int res = 0;
+
+	if (!enable) {
+		register_libusb_error(&last_global_error, LIBUSB_SUCCESS, NULL);
+		if (usb_context)
+			report_descriptor_cache_disable();
+		return 0;
+	}
+
+	if (hid_init() < 0)
+		/* register_global_error: global error is set by hid_init */
+		return -1;
+
+	if (path) {
+		path_copy = strdup(path);
+		if (!path_copy) {
+			register_string_error(&last_global_error, "hid_set_report_descriptor_cache: Couldn't allocate memory");
+			return -1;
+		}
+	}
+
+	hidapi_thread_mutex_lock(&report_descriptor_cache_state);
+	if (report_descriptor_cache_enabled) {
+		/* Only the file changes, the cached descriptors are kept */
+		free(report_descriptor_cache_path);
+	}
+	report_descriptor_cache_enabled = 1;
+	report_descriptor_cache_path = path_copy;
+	if (path_copy)
+		res = report_descriptor_cache_load(path_copy);
+	hidapi_thread_mutex_unlock(&report_descriptor_cache_state);
+
+	if (res < 0) {
+		register_string_error(&last_global_error, "hid_set_report_descriptor_cache: Couldn't read the file");
+		return -1;
+	}
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+#ifdef HIDAPI_HAS_HOTPLUG
+	struct hid_hotplug_callback *hotplug_cb;
+	struct hid_hotplug_callback **hotplug_cb_ptr;
+
+	if (hid_init() < 0)
+		/* register_global_error: global error is set by hid_init */
+		return -1;
+
+	if (!callback ||
+	    !(events & (HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED | HID_API_HOTPLUG_EVENT_DEVICE_LEFT)) ||
+	    (events & ~(HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED | HID_API_HOTPLUG_EVENT_DEVICE_LEFT)) ||
+	    (flags & ~HID_API_HOTPLUG_ENUMERATE)) {
+		register_string_error(&last_global_error, "hid_hotplug_register_callback: invalid argument");
+		return -1;
+	}
+
+	hotplug_cb = (struct hid_hotplug_callback*) calloc(1, sizeof(struct hid_hotplug_callback));
+	if (!hotplug_cb) {
+		register_string_error(&last_global_error, "hid_hotplug_register_callback: couldn't allocate memory");
+		return -1;
+	}
+
+	hotplug_cb->vendor_id = vendor_id;
+	hotplug_cb->product_id = product_id;
+	hotplug_cb->events = events;
+	hotplug_cb->enumerate = (flags & HID_API_HOTPLUG_ENUMERATE) != 0;
+	hotplug_cb->callback = callback;
+	hotplug_cb->user_data = user_data;
+
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+
+	while (hotplug_thread_starting)
+		hidapi_thread_cond_wait(&hotplug_thread_state);
+
+	if (!hotplug_thread_running && hotplug_start() < 0) {
+		/* register_global_error: global error is set by hotplug_start */
+		hidapi_thread_mutex_unlock(&hotplug_thread_state);
+		free(hotplug_cb);
+		return -1;
 	}
 
-	cur_dev = devs;
-	while (cur_dev) {
-		if (cur_dev->vendor_id == vendor_id &&
-		    cur_dev->product_id == product_id) {
-			if (serial_number) {
-				if (cur_dev->serial_number &&
-				    wcscmp(serial_number, cur_dev->serial_number) == 0) {
-					path_to_open = cur_dev->path;
+	hotplug_cb->handle = hotplug_next_handle++;
+	if (hotplug_next_handle == INT_MAX)
+		hotplug_next_handle = 1;
+
+	/* Callbacks are called in the order they were registered */
+	for (hotplug_cb_ptr = &hotplug_callbacks; *hotplug_cb_ptr; hotplug_cb_ptr = &(*hotplug_cb_ptr)->next)
+		;
+	*hotplug_cb_ptr = hotplug_cb;
+
+	if (hotplug_cb->enumerate) {
+		hotplug_callbacks_changed = 1;
+		hidapi_thread_cond_broadcast(&hotplug_thread_state);
+	}
+
+	if (callback_handle)
+		*callback_handle = hotplug_cb->handle;
+
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+
+	return 0;
+#else
+	(void)vendor_id;
+	(void)product_id;
+	(void)events;
+	(void)flags;
+	(void)callback;
+	(void)user_data;
+	(void)callback_handle;
+
+	register_string_error(&last_global_error, "hid_hotplug_register_callback: not supported by the libusb version HIDAPI was built with");
+	return -1;
+#endif
+}
+
+int HID_API_EXPORT hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+#ifdef HIDAPI_HAS_HOTPLUG
+	struct hid_hotplug_callback *hotplug_cb;
+
+	register_libusb_error(&last_global_error, LIBUSB_SUCCESS, NULL);
+
+	if (!usb_context) {
+		register_string_error(&last_global_error, "hid_hotplug_deregister_callback: no such callback");
+		return -1;
+	}
+
+	hidapi_thread_mutex_lock(&hotplug_thread_state);
+
+	for (hotplug_cb = hotplug_callbacks; hotplug_cb; hotplug_cb = hotplug_cb->next) {
+		if (hotplug_cb->handle == callback_handle && hotplug_cb->events != 0)
+			break;
+	}
+
+	if (!hotplug_cb) {
+		hidapi_thread_mutex_unlock(&hotplug_thread_state);
+		register_string_error(&last_global_error, "hid_hotplug_deregister_callback: no such callback");
+		return -1;
+	}
+
+	/* The hotplug thread frees it */
+	hotplug_cb->events = 0;
+	hotplug_callbacks_changed = 1;
+	hidapi_thread_cond_broadcast(&hotplug_thread_state);
+
+	hidapi_thread_mutex_unlock(&hotplug_thread_state);
+
+	return 0;
+#else
+	(void)callback_handle;
+
+	register_string_error(&last_global_error, "hid_hotplug_deregister_callback: not supported by the libusb version HIDAPI was built with");
+	return -1;
+#endif
+}
+
+/* Returns the path of the first HID interface of the first device with
+   the VID/PID and serial number (NULL for any), the one hid_enumerate()
+   would list first, or NULL. The devices are probed one at a time, and
+   only until one matches: a device is only opened to compare its serial
+   number, and none of its other strings are read. */
+static char *find_device_path(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+{
+	libusb_device **devs;
+	libusb_device *dev;
+	ssize_t num_devs;
+	char *path = NULL;
+	int i = 0;
+
+	num_devs = libusb_get_device_list(usb_context, &devs);
+	if (num_devs < 0)
+		return NULL;
+
+	while (!path && (dev = devs[i++]) != NULL) {
+		struct libusb_device_descriptor desc;
+		struct libusb_config_descriptor *conf_desc = NULL;
+		int config_number = 0;
+		int interface_num = -1;
+		int j, k;
+
+		if (libusb_get_device_descriptor(dev, &desc) < 0)
+			continue;
+
+		if (desc.idVendor != vendor_id || desc.idProduct != product_id)
+			continue;
+
+		if (libusb_get_active_config_descriptor(dev, &conf_desc) < 0)
+			libusb_get_config_descriptor(dev, 0, &conf_desc);
+		if (!conf_desc)
+			continue;
+
+		for (j = 0; j < conf_desc->bNumInterfaces && interface_num < 0; j++) {
+			const struct libusb_interface *intf = &conf_desc->interface[j];
+			for (k = 0; k < intf->num_altsetting; k++) {
+				if (should_enumerate_interface(desc.idVendor, &intf->altsetting[k])) {
+					config_number = conf_desc->bConfigurationValue;
+					interface_num = intf->altsetting[k].bInterfaceNumber;
 					break;
 				}
 			}
-			else {
-				path_to_open = cur_dev->path;
-				break;
+		}
+		libusb_free_config_descriptor(conf_desc);
+
+		if (interface_num < 0)
+			continue;
+
+		if (serial_number) {
+			libusb_device_handle *handle = NULL;
+			int match = 0;
+
+			if (libusb_open(dev, &handle) < 0)
+				continue;
+
+#ifdef __ANDROID__
+			/* See enumerate_device() */
+			libusb_get_device_descriptor(dev, &desc);
+#endif
+
+			if (desc.iSerialNumber > 0)
+				match = usb_string_equals(handle, desc.iSerialNumber, serial_number);
+			libusb_close(handle);
+
+			if (!match)
+				continue;
+		}
+
+		path = make_path(dev, config_number, interface_num);
+	}
+
+	libusb_free_device_list(devs, 1);
+
+	return path;
+}
+
+hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+{
+	char *path_to_open;
+	hid_device *handle = NULL;
+
+	if(hid_init() < 0)
+		/* register_global_error: global error is set by hid_init */
+		return NULL;
+
+	path_to_open = find_device_path(vendor_id, product_id, serial_number);
+
+	if (path_to_open) {
+		/* Open the device */
+		handle = hid_open_path(path_to_open);
+	} else {
+		register_string_error(&last_global_error, "Device with requested VID/PID/(SerialNumber) not found");
+	}
+
+	free(path_to_open);
+
+	return handle;
+}
+
+/* Makes the pollable fd readable if, and only if, there is something for
+   hid_read() to return: a report or the error of a stopping transfer loop.
+   Costs a system call only when that changes.
+   This should be called with dev->mutex locked. */
+static void update_pollable_fd(hid_device *dev)
+{
+	uint64_t value = 1;
+	ssize_t res;
+	int ready;
+
+	if (dev->pollable_fd[0] < 0)
+		return;
+
+	ready = (dev->input_reports_count > 0 || dev->shutdown_thread);
+	if (ready == dev->pollable_fd_signaled)
+		return;
+
+	/* An eventfd takes and returns a 64-bit counter, which is
+	   reset by the read. The same works for the pipe, which only
+	   ever holds the one value. */
+	if (ready)
+		res = write(dev->pollable_fd[1], &value, sizeof(value));
+	else
+		res = read(dev->pollable_fd[0], &value, sizeof(value));
+	if (res != (ssize_t)sizeof(value)) {
+		LOG("Couldn't update the pollable fd: %s\n", strerror(errno));
+		return;
+	}
+
+	dev->pollable_fd_signaled = ready;
+}
+
+/* Parked transfers are not going to be resubmitted once the transfer
+   loop is stopping. Marks the transfer loop finished if no transfer is
+   left. This should be called with dev->mutex locked. */
+static void drop_parked_transfers(hid_device *dev)
+{
+	dev->transfers_in_flight -= dev->num_parked_transfers;
+	dev->num_parked_transfers = 0;
+
+	if (dev->transfers_in_flight == 0) {
+		dev->transfer_loop_finished = 1;
+
+		/* Wake any threads which are waiting on data (in hid_read_timeout())
+		   or on the transfers to finish (in hid_close()). This is done under
+		   the mutex to make sure that a thread which is about to go to sleep
+		   waiting on the condition actually will go to sleep before the
+		   condition is signaled. */
+		hidapi_thread_cond_broadcast(&dev->thread_state);
+		update_pollable_fd(dev);
+	}
+}
+
+/* Called once for each transfer which is not going to be (re)submitted
+   anymore. The transfer loop is finished after the last one.
+   This should be called with dev->mutex locked. */
+static void finish_transfer_locked(hid_device *dev)
+{
+	int i;
+
+	dev->transfers_in_flight--;
+	drop_parked_transfers(dev);
+
+	if (!dev->transfer_loop_finished) {
+		/* The transfer loop is stopping, e.g. the device was disconnected
+		   or a transfer couldn't be resubmitted. Don't wait for the other
+		   transfers to time out. This call fails for transfers which are
+		   not pending, but that's OK. */
+		for (i = 0; i < dev->num_transfers; i++)
+			libusb_cancel_transfer(dev->transfers[i]);
+	}
+}
+
+static void finish_transfer(hid_device *dev)
+{
+	hidapi_thread_mutex_lock(&dev->thread_state);
+	finish_transfer_locked(dev);
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+}
+
+/* Finds a queued report with the same Report ID as data,
+   for HID_API_INPUT_QUEUE_CONFLATE.
+   This should be called with dev->mutex locked. */
+static struct input_report *find_queued_report(hid_device *dev, const uint8_t *data, size_t length)
+{
+	struct input_report *rpt;
+	size_t i, slot;
+
+	for (i = 0; i < dev->input_reports_count; i++) {
+		slot = dev->input_reports_head + i;
+		if (slot >= dev->input_reports_capacity)
+			slot -= dev->input_reports_capacity;
+		rpt = &dev->input_reports[slot];
+
+		/* Without numbered reports, all of the reports have the same ID */
+		if (!dev->uses_numbered_reports)
+			return rpt;
+		if (length > 0 && rpt->len > 0 && rpt->data[0] == data[0])
+			return rpt;
+	}
+
+	return NULL;
+}
+
+/* Queues the report received by a completed transfer, handling a full
+   queue according to dev->input_queue_policy. Returns 1 if the transfer
+   can be resubmitted right away, and 0 if it was parked until there is
+   room in the queue.
+   This should be called with dev->mutex locked. */
+static int queue_input_report(hid_device *dev, struct libusb_transfer *transfer, uint64_t timestamp)
+{
+	struct input_report *rpt;
+	uint8_t *buf;
+	size_t tail;
+	size_t length = (size_t)transfer->actual_length;
+
+	if (dev->input_queue_policy == HID_API_INPUT_QUEUE_CONFLATE) {
+		rpt = find_queued_report(dev, transfer->buffer, length);
+		if (rpt) {
+			/* Replace the queued report in place */
+			buf = rpt->data;
+			rpt->data = transfer->buffer;
+			rpt->len = length;
+			rpt->timestamp = timestamp;
+			transfer->buffer = buf;
+			dev->input_reports_dropped++;
+			return 1;
+		}
+	}
+
+	if (dev->input_reports_count == dev->input_reports_capacity) {
+		switch (dev->input_queue_policy) {
+		case HID_API_INPUT_QUEUE_DROP_NEWEST:
+			/* Keep the transfer buffer for the next submission */
+			dev->input_reports_dropped++;
+			return 1;
+		case HID_API_INPUT_QUEUE_BLOCK:
+			if (!dev->shutdown_thread) {
+				/* Resubmitted by resume_parked_transfers() */
+				dev->parked_timestamps[dev->num_parked_transfers] = timestamp;
+				dev->parked_transfers[dev->num_parked_transfers++] = transfer;
+				return 0;
 			}
+			/* The transfer loop is stopping, nothing would resume it */
+			dev->input_reports_dropped++;
+			return 1;
+		default:
+			/* Pop one off if the queue is full. This way we don't
+			   grow forever if the user never reads anything from
+			   the device. */
+			return_data(dev, NULL, 0);
+			dev->input_reports_dropped++;
+			break;
 		}
-		cur_dev = cur_dev->next;
 	}
 
-	if (path_to_open) {
-		/* Open the device */
-		handle = hid_open_path(path_to_open);
-	} else {
-		register_string_error(&last_global_error, "Device with requested VID/PID/(SerialNumber) not found");
+	/* Queue the transfer buffer itself and hand a free
+	   buffer to the transfer for the next submission. */
+	tail = dev->input_reports_head + dev->input_reports_count;
+	if (tail >= dev->input_reports_capacity)
+		tail -= dev->input_reports_capacity;
+	rpt = &dev->input_reports[tail];
+	rpt->data = transfer->buffer;
+	rpt->len = length;
+	rpt->timestamp = timestamp;
+	transfer->buffer = dev->free_report_buffers[--dev->free_report_buffers_count];
+
+	if (dev->input_reports_count++ == 0) {
+		/* The queue was empty. Wake up a waiting reader. */
+		hidapi_thread_cond_signal(&dev->thread_state);
+		update_pollable_fd(dev);
 	}
 
-	hid_free_enumeration(devs);
+	return 1;
+}
 
-	return handle;
+/* Queues the reports of the parked transfers and resubmits them, as far
+   as there is room in the queue or the policy doesn't block anymore.
+   This should be called with dev->mutex locked. */
+static void resume_parked_transfers(hid_device *dev)
+{
+	struct libusb_transfer *transfer;
+	uint64_t timestamp;
+	int res;
+	int i;
+
+	while (dev->num_parked_transfers > 0 && !dev->shutdown_thread) {
+		if (dev->input_queue_policy == HID_API_INPUT_QUEUE_BLOCK &&
+		    dev->input_reports_count == dev->input_reports_capacity)
+			break;
+
+		transfer = dev->parked_transfers[0];
+		timestamp = dev->parked_timestamps[0];
+		dev->num_parked_transfers--;
+		for (i = 0; i < dev->num_parked_transfers; i++) {
+			dev->parked_transfers[i] = dev->parked_transfers[i + 1];
+			dev->parked_timestamps[i] = dev->parked_timestamps[i + 1];
+		}
+
+		queue_input_report(dev, transfer, timestamp);
+
+		res = libusb_submit_transfer(transfer);
+		if (res != 0) {
+			LOG("Unable to submit URB: (%d) %s\n", res, libusb_error_name(res));
+			dev->shutdown_thread = 1;
+			finish_transfer_locked(dev);
+		}
+	}
 }
 
 static void LIBUSB_CALL read_callback(struct libusb_transfer *transfer)
@@ -1102,39 +2710,35 @@ static void LIBUSB_CALL read_callback(struct libusb_transfer *transfer)
 	int res;
 
 	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
-
-		struct input_report *rpt = (struct input_report*) malloc(sizeof(*rpt));
-		rpt->data = (uint8_t*) malloc(transfer->actual_length);
-		memcpy(rpt->data, transfer->buffer, transfer->actual_length);
-		rpt->len = transfer->actual_length;
-		rpt->next = NULL;
+		hid_input_callback callback;
+		void *user_data;
+		uint64_t timestamp = get_timestamp();
 
 		hidapi_thread_mutex_lock(&dev->thread_state);
+		callback = dev->input_callback;
+		user_data = dev->input_callback_user_data;
+		res = 1;
+		if (callback)
+			dev->input_callback_running = 1;
+		else
+			res = queue_input_report(dev, transfer, timestamp);
+		hidapi_thread_mutex_unlock(&dev->thread_state);
 
-		/* Attach the new report object to the end of the list. */
-		if (dev->input_reports == NULL) {
-			/* The list is empty. Put it at the root. */
-			dev->input_reports = rpt;
-			hidapi_thread_cond_signal(&dev->thread_state);
-		}
-		else {
-			/* Find the end of the list and attach. */
-			struct input_report *cur = dev->input_reports;
-			int num_queued = 0;
-			while (cur->next != NULL) {
-				cur = cur->next;
-				num_queued++;
-			}
-			cur->next = rpt;
+		if (callback) {
+			/* Hand the report over right from the transfer buffer,
+			   which is resubmitted once the callback returns */
+			callback(dev, transfer->buffer, (size_t)transfer->actual_length, user_data);
 
-			/* Pop one off if we've reached 30 in the queue. This
-			   way we don't grow forever if the user never reads
-			   anything from the device. */
-			if (num_queued > 30) {
-				return_data(dev, NULL, 0);
-			}
+			hidapi_thread_mutex_lock(&dev->thread_state);
+			dev->input_callback_running = 0;
+			if (dev->input_callback_waiting)
+				hidapi_thread_cond_broadcast(&dev->thread_state);
+			hidapi_thread_mutex_unlock(&dev->thread_state);
+		}
+		else if (!res) {
+			/* Parked until the queue has room */
+			return;
 		}
-		hidapi_thread_mutex_unlock(&dev->thread_state);
 	}
 	else if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
 		dev->shutdown_thread = 1;
@@ -1150,7 +2754,7 @@ static void LIBUSB_CALL read_callback(struct libusb_transfer *transfer)
 	}
 
 	if (dev->shutdown_thread) {
-		dev->transfer_loop_finished = 1;
+		finish_transfer(dev);
 		return;
 	}
 
@@ -1159,85 +2763,163 @@ static void LIBUSB_CALL read_callback(struct libusb_transfer *transfer)
 	if (res != 0) {
 		LOG("Unable to submit URB: (%d) %s\n", res, libusb_error_name(res));
 		dev->shutdown_thread = 1;
-		dev->transfer_loop_finished = 1;
+		finish_transfer(dev);
 	}
 }
 
 
-static void *read_thread(void *param)
+/* Sets up and submits the interrupt IN transfers of a device.
+   Further submissions are made from inside read_callback(),
+   which runs on the event thread. */
+static void start_input_transfers(hid_device *dev)
 {
 	int res;
-	hid_device *dev = (hid_device *) param;
-	uint8_t *buf;
+	int i;
 	const size_t length = dev->input_ep_max_packet_size;
 
-	/* Set up the transfer object. */
-	buf = (uint8_t*) malloc(length);
-	dev->transfer = libusb_alloc_transfer(0);
-	libusb_fill_interrupt_transfer(dev->transfer,
-		dev->device_handle,
-		dev->input_endpoint,
-		buf,
-		(int)length,
-		read_callback,
-		dev,
-		5000/*timeout*/);
+	/* Set up the transfer objects. */
+	for (i = 0; i < dev->num_transfers; i++) {
+		uint8_t *buf = dev->free_report_buffers[--dev->free_report_buffers_count];
+		dev->transfers[i] = libusb_alloc_transfer(0);
+		if (!dev->transfers[i]) {
+			/* free_hid_device() takes care of the buffer */
+			dev->num_transfers = i;
+			break;
+		}
+		libusb_fill_interrupt_transfer(dev->transfers[i],
+			dev->device_handle,
+			dev->input_endpoint,
+			buf,
+			(int)length,
+			read_callback,
+			dev,
+			5000/*timeout*/);
+	}
+
+	/* All of the transfers are counted as in flight before the first
+	   one is submitted, since its callback may run on the event thread
+	   right away. */
+	hidapi_thread_mutex_lock(&dev->thread_state);
+	dev->transfers_in_flight = dev->num_transfers;
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+
+	if (dev->num_transfers == 0) {
+		LOG("libusb_alloc_transfer failed. No input reports will be received\n");
+		dev->shutdown_thread = 1;
+		dev->transfer_loop_finished = 1;
+		return;
+	}
 
-	/* Make the first submission. Further submissions are made
-	   from inside read_callback() */
-	res = libusb_submit_transfer(dev->transfer);
-	if(res < 0) {
-                LOG("libusb_submit_transfer failed: %d %s. Stopping read_thread from running\n", res, libusb_error_name(res));
-                dev->shutdown_thread = 1;
-                dev->transfer_loop_finished = 1;
+	for (i = 0; i < dev->num_transfers; i++) {
+		res = libusb_submit_transfer(dev->transfers[i]);
+		if (res < 0) {
+			LOG("libusb_submit_transfer failed: %d %s. No input reports will be received\n", res, libusb_error_name(res));
+			dev->shutdown_thread = 1;
+			/* Neither this transfer nor the ones after it are in flight */
+			while (i++ < dev->num_transfers)
+				finish_transfer(dev);
+			break;
+		}
 	}
+}
+
+/* Handles the events of the whole libusb context, i.e. the completions of
+   the transfers of all of the open devices, for as long as the library is
+   initialized. A single thread is used no matter how many devices are open,
+   so the number of threads contending for the libusb event lock, and the
+   number of wakeups, don't grow with the number of devices. */
+static void *event_thread(void *param)
+{
+	int res;
+	hid_device *dev;
 
-	/* Notify the main thread that the read thread is up and running. */
-	hidapi_thread_barrier_wait(&dev->thread_state);
+	(void)param;
 
-	/* Handle all the events. */
-	while (!dev->shutdown_thread) {
-		res = libusb_handle_events(usb_context);
+	/* Notify hid_init() that the event thread is up and running. */
+	hidapi_thread_barrier_wait(&event_thread_state);
+
+	while (!event_thread_shutdown) {
+#ifdef HIDAPI_HAS_INTERRUPT_EVENT_HANDLER
+		/* hid_exit() interrupts the event handling to stop the thread */
+		res = libusb_handle_events_completed(usb_context, &event_thread_shutdown);
+#else
+		struct timeval tv;
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		res = libusb_handle_events_timeout_completed(usb_context, &tv, &event_thread_shutdown);
+#endif
 		if (res < 0) {
 			/* There was an error. */
-			LOG("read_thread(): (%d) %s\n", res, libusb_error_name(res));
+			LOG("event_thread(): (%d) %s\n", res, libusb_error_name(res));
 
 			/* Break out of this loop only on fatal error.*/
 			if (res != LIBUSB_ERROR_BUSY &&
 			    res != LIBUSB_ERROR_TIMEOUT &&
 			    res != LIBUSB_ERROR_OVERFLOW &&
 			    res != LIBUSB_ERROR_INTERRUPTED) {
-				dev->shutdown_thread = 1;
 				break;
 			}
 		}
 	}
 
-	/* Cancel any transfer that may be pending. This call will fail
-	   if no transfers are pending, but that's OK. */
-	libusb_cancel_transfer(dev->transfer);
+	if (!event_thread_shutdown) {
+		/* No completions will be handled from now on. Stop the
+		   transfer loops of the open devices, cancel their writes and
+		   wake any threads which are waiting on data (in hid_read_timeout())
+		   or on the writes. The transfers are still in flight until their
+		   cancellation is handled, which hid_close() does itself,
+		   see event_thread_gone. */
+		hidapi_thread_mutex_lock(&event_thread_state);
+		for (dev = open_devices; dev; dev = dev->next_open) {
+			int i;
+
+			hidapi_thread_mutex_lock(&dev->thread_state);
+			hidapi_thread_mutex_lock(&dev->write_state);
+			dev->shutdown_thread = 1;
+			dev->event_thread_gone = 1;
+			for (i = 0; i < dev->num_transfers; i++)
+				libusb_cancel_transfer(dev->transfers[i]);
+			for (i = 0; i < dev->num_output_transfers; i++)
+				libusb_cancel_transfer(dev->output_transfers[i].transfer);
+			drop_parked_transfers(dev);
+			hidapi_thread_cond_broadcast(&dev->write_state);
+			hidapi_thread_mutex_unlock(&dev->write_state);
+			hidapi_thread_cond_broadcast(&dev->thread_state);
+			update_pollable_fd(dev);
+			hidapi_thread_mutex_unlock(&dev->thread_state);
+		}
+		event_thread_failed = 1;
+		hidapi_thread_mutex_unlock(&event_thread_state);
+	}
 
-	while (!dev->transfer_loop_finished)
-		libusb_handle_events_completed(usb_context, &dev->transfer_loop_finished);
+	return NULL;
+}
 
-	/* Now that the read thread is stopping, Wake any threads which are
-	   waiting on data (in hid_read_timeout()). Do this under a mutex to
-	   make sure that a thread which is about to go to sleep waiting on
-	   the condition actually will go to sleep before the condition is
-	   signaled. */
-	hidapi_thread_mutex_lock(&dev->thread_state);
-	hidapi_thread_cond_broadcast(&dev->thread_state);
-	hidapi_thread_mutex_unlock(&dev->thread_state);
+/* Handles the events of usb_context on the calling thread for at most
+   milliseconds, or until *completed is set (completed may be NULL).
+   Used once the event thread is gone (see event_thread_gone), as the
+   transfers of a device in flight have to be finished before it is closed.
+   Returns -1 on a fatal error: the transfers still in flight can't be
+   finished anymore. */
+static int handle_events_in_place(int *completed, int milliseconds)
+{
+	struct timeval tv;
+	int res;
 
-	/* The dev->transfer->buffer and dev->transfer objects are cleaned up
-	   in hid_close(). They are not cleaned up here because this thread
-	   could end either due to a disconnect or due to a user
-	   call to hid_close(). In both cases the objects can be safely
-	   cleaned up after the call to hidapi_thread_join() (in hid_close()), but
-	   since hid_close() calls libusb_cancel_transfer(), on these objects,
-	   they can not be cleaned up here. */
+	tv.tv_sec = milliseconds / 1000;
+	tv.tv_usec = (milliseconds % 1000) * 1000;
+	res = libusb_handle_events_timeout_completed(usb_context, &tv, completed);
 
-	return NULL;
+	if (res < 0 &&
+	    res != LIBUSB_ERROR_BUSY &&
+	    res != LIBUSB_ERROR_TIMEOUT &&
+	    res != LIBUSB_ERROR_OVERFLOW &&
+	    res != LIBUSB_ERROR_INTERRUPTED) {
+		LOG("handle_events_in_place(): (%d) %s\n", res, libusb_error_name(res));
+		return -1;
+	}
+
+	return 0;
 }
 
 static void init_xbox360(libusb_device_handle *device_handle, unsigned short idVendor, unsigned short idProduct, const struct libusb_config_descriptor *conf_desc)
@@ -1304,6 +2986,21 @@ static void init_xboxone(libusb_device_handle *device_handle, unsigned short idV
 	}
 }
 
+/* Releases the interface claimed by hidapi_initialize_device()
+   and reattaches the kernel driver if it was detached. */
+static void release_interface(hid_device *dev)
+{
+	libusb_release_interface(dev->device_handle, dev->interface);
+
+#ifdef DETACH_KERNEL_DRIVER
+	if (dev->is_driver_detached) {
+		int res = libusb_attach_kernel_driver(dev->device_handle, dev->interface);
+		if (res < 0)
+			LOG("Failed to reattach the driver to kernel.\n");
+	}
+#endif
+}
+
 static int hidapi_initialize_device(hid_device *dev, const struct libusb_interface_descriptor *intf_desc, const struct libusb_config_descriptor *conf_desc)
 {
 	int i =0;
@@ -1398,86 +3095,411 @@ static int hidapi_initialize_device(hid_device *dev, const struct libusb_interfa
 		}
 	}
 
-	hidapi_thread_create(&dev->thread_state, read_thread, dev);
+	dev->num_transfers = input_transfers;
+	if (alloc_input_reports(dev, HIDAPI_INPUT_REPORT_QUEUE_SIZE, (size_t)dev->num_transfers, (size_t)dev->input_ep_max_packet_size) < 0) {
+		LOG("Unable to allocate the input report queue\n");
+		release_interface(dev);
+		return 0;
+	}
+
+	hidapi_thread_mutex_lock(&event_thread_state);
+	if (event_thread_failed) {
+		/* Nothing would handle the completions of the transfers */
+		hidapi_thread_mutex_unlock(&event_thread_state);
+		LOG("The event thread is not running\n");
+		release_interface(dev);
+		return 0;
+	}
+	dev->next_open = open_devices;
+	open_devices = dev;
+	hidapi_thread_mutex_unlock(&event_thread_state);
 
-	/* Wait here for the read thread to be initialized. */
-	hidapi_thread_barrier_wait(&dev->thread_state);
+	start_input_transfers(dev);
 	return 1;
 }
 
 
-hid_device * HID_API_EXPORT hid_open_path(const char *path)
+/* Parses a path made by get_path() back into the location of the device,
+   its configuration and its interface. Returns non-zero on success. */
+static int parse_path(const char *path, struct usb_port_path *port_path, int *config_number, int *interface_number)
 {
-	hid_device *dev = NULL;
+	unsigned long values[2 + 8 + 2]; /* bus, ports, config, interface */
+	char separators[2 + 8 + 2];
+	int num_values = 0;
+	int num_ports;
+	int i;
 
-	libusb_device **devs = NULL;
-	libusb_device *usb_dev = NULL;
-	int res = 0;
-	int d = 0;
-	int good_open = 0;
+	while (num_values < (int)(sizeof(values) / sizeof(values[0]))) {
+		char *end;
 
-	if(hid_init() < 0)
-		/* register_global_error: global error is set by hid_init */
-		return NULL;
+		if (*path < '0' || *path > '9')
+			return 0;
+		values[num_values] = strtoul(path, &end, 10);
+		if (values[num_values] > 255)
+			return 0;
+		separators[num_values++] = *end;
+		path = end;
+		if (*path == '\0')
+			break;
+		path++;
+	}
 
-	dev = new_hid_device();
-	if (!dev) {
-		LOG("hid_open_path failed: Couldn't allocate memory\n");
-		register_string_error(&last_global_error, "hid_open_path: Couldn't allocate memory");
-		return NULL;
+	/* "bus-port[.port...]:config.interface" */
+	num_ports = num_values - 3;
+	if (num_ports < 1 || num_ports > 7 || *path != '\0')
+		return 0;
+	if (separators[0] != '-' || separators[num_values - 3] != ':' || separators[num_values - 2] != '.')
+		return 0;
+	for (i = 1; i < num_ports; i++) {
+		if (separators[i] != '.')
+			return 0;
 	}
 
-	res = libusb_get_device_list(usb_context, &devs);
-	if (res < 0) {
-		register_libusb_error(&last_global_error, res, "hid_open_path/libusb_get_device_list");
-		free_hid_device(dev);
+	memset(port_path, 0, sizeof(*port_path));
+	port_path->bus = (uint8_t)values[0];
+	port_path->num_ports = (uint8_t)num_ports;
+	for (i = 0; i < num_ports; i++)
+		port_path->port_numbers[i] = (uint8_t)values[1 + i];
+	*config_number = (int)values[num_values - 2];
+	*interface_number = (int)values[num_values - 1];
+
+	return 1;
+}
+
+/* Returns non-zero if the location of the device is known */
+static int get_port_path(libusb_device *dev, struct usb_port_path *port_path)
+{
+	int num_ports;
+
+	memset(port_path, 0, sizeof(*port_path));
+	num_ports = libusb_get_port_numbers(dev, port_path->port_numbers, sizeof(port_path->port_numbers));
+	if (num_ports <= 0)
+		return 0;
+
+	port_path->bus = libusb_get_bus_number(dev);
+	port_path->num_ports = (uint8_t)num_ports;
+	return 1;
+}
+
+static int port_path_equal(const struct usb_port_path *a, const struct usb_port_path *b)
+{
+	return a->bus == b->bus && a->num_ports == b->num_ports &&
+	       memcmp(a->port_numbers, b->port_numbers, a->num_ports) == 0;
+}
+
+#ifdef HIDAPI_HAS_HOTPLUG
+static unsigned int port_path_hash(const struct usb_port_path *port_path)
+{
+	unsigned int hash = port_path->bus;
+	int i;
+
+	for (i = 0; i < port_path->num_ports; i++)
+		hash = hash * 31 + port_path->port_numbers[i];
+
+	return hash % HIDAPI_DEVICE_CACHE_BUCKETS;
+}
+
+/* Called on the event thread (and, for the devices already connected,
+   from libusb_hotplug_register_callback()). */
+static int LIBUSB_CALL device_cache_hotplug_callback(libusb_context *ctx, libusb_device *device, libusb_hotplug_event event, void *user_data)
+{
+	struct usb_port_path port_path;
+	struct device_cache_entry **entry_ptr;
+	struct device_cache_entry *entry;
+
+	(void)ctx;
+	(void)user_data;
+
+	if (!get_port_path(device, &port_path))
+		return 0;
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+
+	entry_ptr = &device_cache[port_path_hash(&port_path)];
+	while (*entry_ptr && (*entry_ptr)->device != device)
+		entry_ptr = &(*entry_ptr)->next;
+	entry = *entry_ptr;
+
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+		if (!entry) {
+			entry = (struct device_cache_entry*) calloc(1, sizeof(struct device_cache_entry));
+			if (entry) {
+				entry->device = libusb_ref_device(device);
+				entry->port_path = port_path;
+				*entry_ptr = entry;
+			}
+		}
+	}
+	else if (entry) {
+		*entry_ptr = entry->next;
+		libusb_unref_device(entry->device);
+		free(entry);
+	}
+
+	hidapi_thread_mutex_unlock(&device_cache_state);
+
+	return 0;
+}
+
+/* Starts keeping track of the connected devices by port path, if libusb
+   supports hotplug on this platform. Until it is started, and for the
+   devices it misses, find_usb_device() looks at the device list. */
+static void device_cache_start(void)
+{
+	int res;
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+	if (device_cache_started) {
+		hidapi_thread_mutex_unlock(&device_cache_state);
+		return;
+	}
+	device_cache_started = 1;
+	hidapi_thread_mutex_unlock(&device_cache_state);
+
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+		return;
+
+	/* The callback is called for each of the devices already connected
+	   before this returns, which fills the cache. */
+	res = libusb_hotplug_register_callback(usb_context,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		LIBUSB_HOTPLUG_ENUMERATE,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		device_cache_hotplug_callback, NULL, &device_cache_hotplug);
+	if (res != LIBUSB_SUCCESS) {
+		LOG("libusb_hotplug_register_callback() for the device cache failed with %d: %s\n", res, libusb_error_name(res));
+		return;
+	}
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+	device_cache_started = 2;
+	hidapi_thread_mutex_unlock(&device_cache_state);
+}
+
+static void device_cache_stop(void)
+{
+	int registered;
+	int i;
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+	registered = device_cache_started == 2;
+	device_cache_started = 0;
+	hidapi_thread_mutex_unlock(&device_cache_state);
+
+	if (registered)
+		libusb_hotplug_deregister_callback(usb_context, device_cache_hotplug);
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+	for (i = 0; i < HIDAPI_DEVICE_CACHE_BUCKETS; i++) {
+		while (device_cache[i]) {
+			struct device_cache_entry *next = device_cache[i]->next;
+			libusb_unref_device(device_cache[i]->device);
+			free(device_cache[i]);
+			device_cache[i] = next;
+		}
+	}
+	hidapi_thread_mutex_unlock(&device_cache_state);
+}
+
+/* Returns a reference to the cached device at the location, or NULL */
+static libusb_device *device_cache_lookup(const struct usb_port_path *port_path)
+{
+	struct device_cache_entry *entry;
+	libusb_device *device = NULL;
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+	for (entry = device_cache[port_path_hash(port_path)]; entry; entry = entry->next) {
+		if (port_path_equal(&entry->port_path, port_path)) {
+			device = libusb_ref_device(entry->device);
+			break;
+		}
+	}
+	hidapi_thread_mutex_unlock(&device_cache_state);
+
+	return device;
+}
+
+/* Drops a cached device which turned out to be gone: the event thread
+   hasn't handled its hotplug event yet. */
+static void device_cache_remove(libusb_device *device)
+{
+	struct usb_port_path port_path;
+	struct device_cache_entry **entry_ptr;
+
+	if (!get_port_path(device, &port_path))
+		return;
+
+	hidapi_thread_mutex_lock(&device_cache_state);
+	entry_ptr = &device_cache[port_path_hash(&port_path)];
+	while (*entry_ptr && (*entry_ptr)->device != device)
+		entry_ptr = &(*entry_ptr)->next;
+	if (*entry_ptr) {
+		struct device_cache_entry *entry = *entry_ptr;
+		*entry_ptr = entry->next;
+		libusb_unref_device(entry->device);
+		free(entry);
+	}
+	hidapi_thread_mutex_unlock(&device_cache_state);
+}
+#endif /* HIDAPI_HAS_HOTPLUG */
+
+/* Returns a reference to the device at the location, or NULL.
+   With use_cache, *cached tells whether it came from the device cache. */
+static libusb_device *find_usb_device(const struct usb_port_path *port_path, int use_cache, int *cached)
+{
+	libusb_device **devs;
+	libusb_device *usb_dev;
+	libusb_device *found = NULL;
+	ssize_t num_devs;
+	int d = 0;
+
+	if (cached)
+		*cached = 0;
+
+#ifdef HIDAPI_HAS_HOTPLUG
+	if (use_cache) {
+		device_cache_start();
+		found = device_cache_lookup(port_path);
+		if (found) {
+			if (cached)
+				*cached = 1;
+			return found;
+		}
+	}
+#else
+	(void)use_cache;
+#endif
+
+	num_devs = libusb_get_device_list(usb_context, &devs);
+	if (num_devs < 0) {
+		register_libusb_error(&last_global_error, (int)num_devs, "hid_open_path/libusb_get_device_list");
 		return NULL;
 	}
-	while ((usb_dev = devs[d++]) != NULL && !good_open) {
-		struct libusb_device_descriptor desc;
-		struct libusb_config_descriptor *conf_desc = NULL;
-		int j,k;
 
-		res = libusb_get_device_descriptor(usb_dev, &desc);
-		if (res < 0)
+	while ((usb_dev = devs[d++]) != NULL) {
+		struct usb_port_path dev_port_path;
+
+		/* Only numbers are compared, no path is made */
+		if (libusb_get_bus_number(usb_dev) != port_path->bus)
 			continue;
 
+		if (get_port_path(usb_dev, &dev_port_path) && port_path_equal(&dev_port_path, port_path)) {
+			found = libusb_ref_device(usb_dev);
+			break;
+		}
+	}
+
+	libusb_free_device_list(devs, 1);
+
+	return found;
+}
+
+/* Opens the interface of the device at the path. Returns 1 on success.
+   *error is set to LIBUSB_ERROR_NO_DEVICE or LIBUSB_ERROR_NOT_FOUND when
+   the device is gone, to LIBUSB_SUCCESS otherwise. */
+static int open_usb_device(hid_device *dev, libusb_device *usb_dev, const char *path, int config_number, int interface_number, int *error)
+{
+	struct libusb_device_descriptor desc;
+	struct libusb_config_descriptor *conf_desc = NULL;
+	int good_open = 0;
+	int res;
+	int j,k;
+
+	*error = LIBUSB_SUCCESS;
+
+	res = libusb_get_device_descriptor(usb_dev, &desc);
+	if (res >= 0) {
 		res = libusb_get_active_config_descriptor(usb_dev, &conf_desc);
+		if (res == LIBUSB_ERROR_NO_DEVICE) {
+			*error = res;
+			return 0;
+		}
 		if (res < 0)
 			libusb_get_config_descriptor(usb_dev, 0, &conf_desc);
-		if (!conf_desc)
-			continue;
+	}
 
+	if (conf_desc && conf_desc->bConfigurationValue == config_number) {
 		for (j = 0; j < conf_desc->bNumInterfaces && !good_open; j++) {
 			const struct libusb_interface *intf = &conf_desc->interface[j];
 			for (k = 0; k < intf->num_altsetting && !good_open; k++) {
 				const struct libusb_interface_descriptor *intf_desc = &intf->altsetting[k];
-				if (should_enumerate_interface(desc.idVendor, intf_desc)) {
+				if (intf_desc->bInterfaceNumber == interface_number &&
+				    should_enumerate_interface(desc.idVendor, intf_desc)) {
 					char dev_path[64];
 					get_path(&dev_path, usb_dev, conf_desc->bConfigurationValue, intf_desc->bInterfaceNumber);
 					if (!strcmp(dev_path, path)) {
 						/* Matched Paths. Open this device */
 
-						/* OPEN HERE */
-						res = libusb_open(usb_dev, &dev->device_handle);
-						if (res < 0) {
-							LOG("can't open device\n");
-							register_libusb_error(&last_global_error, res, "hid_open_path/libusb_open");
-							break;
-						}
-						good_open = hidapi_initialize_device(dev, intf_desc, conf_desc);
-						if (!good_open) {
-							register_string_error(&last_global_error, "hid_open_path: failed to initialize device");
-							libusb_close(dev->device_handle);
-						}
-					}
-				}
-			}
+						/* OPEN HERE */
+						res = libusb_open(usb_dev, &dev->device_handle);
+						if (res < 0) {
+							LOG("can't open device\n");
+							register_libusb_error(&last_global_error, res, "hid_open_path/libusb_open");
+							if (res == LIBUSB_ERROR_NO_DEVICE || res == LIBUSB_ERROR_NOT_FOUND)
+								*error = res;
+							break;
+						}
+						good_open = hidapi_initialize_device(dev, intf_desc, conf_desc);
+						if (!good_open) {
+							register_string_error(&last_global_error, "hid_open_path: failed to initialize device");
+							libusb_close(dev->device_handle);
+						}
+					}
+				}
+			}
+		}
+	}
+	libusb_free_config_descriptor(conf_desc);
+
+	return good_open;
+}
+
+hid_device * HID_API_EXPORT hid_open_path(const char *path)
+{
+	hid_device *dev = NULL;
+
+	libusb_device *usb_dev = NULL;
+	struct usb_port_path port_path;
+	int config_number = 0;
+	int interface_number = 0;
+	int cached = 0;
+	int error = LIBUSB_SUCCESS;
+	int good_open = 0;
+
+	if(hid_init() < 0)
+		/* register_global_error: global error is set by hid_init */
+		return NULL;
+
+	dev = new_hid_device();
+	if (!dev) {
+		LOG("hid_open_path failed: Couldn't allocate memory\n");
+		register_string_error(&last_global_error, "hid_open_path: Couldn't allocate memory");
+		return NULL;
+	}
+
+	/* The device is looked up by its location instead of making
+	   the path of each interface of each device */
+	if (path && parse_path(path, &port_path, &config_number, &interface_number))
+		usb_dev = find_usb_device(&port_path, 1, &cached);
+
+	if (usb_dev) {
+		good_open = open_usb_device(dev, usb_dev, path, config_number, interface_number, &error);
+
+#ifdef HIDAPI_HAS_HOTPLUG
+		/* The cached device left, and another one may be at its location
+		   already: the cache only learns about it on the event thread */
+		if (!good_open && cached && error != LIBUSB_SUCCESS) {
+			device_cache_remove(usb_dev);
+			libusb_unref_device(usb_dev);
+			usb_dev = find_usb_device(&port_path, 0, NULL);
+			if (usb_dev)
+				good_open = open_usb_device(dev, usb_dev, path, config_number, interface_number, &error);
 		}
-		libusb_free_config_descriptor(conf_desc);
-	}
+#endif
 
-	libusb_free_device_list(devs, 1);
+		if (usb_dev)
+			libusb_unref_device(usb_dev);
+	}
 
 	/* If we have a good handle, return it. */
 	if (good_open) {
@@ -1619,46 +3641,464 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
 		return -1;
 	}
 
-	if (skipped_report_id)
-		actual_length++;
+	if (skipped_report_id)
+		actual_length++;
+
+	return actual_length;
+}
+
+/* Makes an output transfer available to hid_libusb_write_async() again. */
+static void release_output_transfer(hid_device *dev, struct output_transfer *out)
+{
+	hidapi_thread_mutex_lock(&dev->write_state);
+	dev->free_output_transfers[dev->free_output_transfers_count++] = out;
+	dev->writes_in_flight--;
+
+	/* Wake any threads waiting for a free transfer (in hid_libusb_write_async())
+	   or for the writes to complete (in hid_libusb_write_flush() or hid_close()) */
+	hidapi_thread_cond_broadcast(&dev->write_state);
+	hidapi_thread_mutex_unlock(&dev->write_state);
+}
+
+static void LIBUSB_CALL write_callback(struct libusb_transfer *transfer)
+{
+	struct output_transfer *out = (struct output_transfer *) transfer->user_data;
+	int res = -1;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		res = transfer->actual_length;
+		/* Account for the report ID */
+		if (out->skipped_report_id)
+			res++;
+	}
+	else {
+		LOG("Asynchronous write failed: %d\n", transfer->status);
+	}
+
+	/* Call back before the transfer is released, so that
+	   hid_libusb_write_flush() returns after all of the callbacks */
+	if (out->callback)
+		out->callback(out->dev, res, out->user_data);
+
+	release_output_transfer(out->dev, out);
+}
+
+static void cleanup_write_mutex(void *param)
+{
+	hid_device *dev = (hid_device *) param;
+	hidapi_thread_mutex_unlock(&dev->write_state);
+}
+
+/* Takes a free output transfer, or waits for one when all of them are
+   in flight. Returns NULL if a transfer couldn't be allocated, or once
+   the event thread is gone, with *gone set then: nothing would handle
+   the completion of the transfer. */
+static struct output_transfer *take_output_transfer(hid_device *dev, int *gone)
+{
+	/* by initialising this variable right here, GCC gives a compilation warning/error: */
+	/* error: variable 'out' might be clobbered by 'longjmp' or 'vfork' [-Werror=clobbered] */
+	struct output_transfer *out; /* = NULL; */
+
+	hidapi_thread_mutex_lock(&dev->write_state);
+	hidapi_thread_cleanup_push(cleanup_write_mutex, dev);
+
+	out = NULL;
+	while (!dev->event_thread_gone && dev->free_output_transfers_count == 0 && dev->num_output_transfers == HIDAPI_MAX_OUTPUT_TRANSFERS) {
+		hidapi_thread_cond_wait(&dev->write_state);
+	}
+	*gone = dev->event_thread_gone;
+	if (*gone) {
+		/* no transfer */
+	}
+	else if (dev->free_output_transfers_count > 0) {
+		out = dev->free_output_transfers[--dev->free_output_transfers_count];
+		dev->writes_in_flight++;
+	}
+	else {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		if (transfer) {
+			out = &dev->output_transfers[dev->num_output_transfers++];
+			out->dev = dev;
+			out->transfer = transfer;
+			dev->writes_in_flight++;
+		}
+	}
+
+	hidapi_thread_mutex_unlock(&dev->write_state);
+	hidapi_thread_cleanup_pop(0);
+
+	return out;
+}
+
+int HID_API_EXPORT_CALL hid_libusb_write_async(hid_device *dev, const unsigned char *data, size_t length, hid_libusb_write_callback callback, void *user_data)
+{
+	struct output_transfer *out;
+	size_t buffer_size;
+	int report_number;
+	int skipped_report_id = 0;
+	int gone;
+	int res;
+
+	if (!data || !length) {
+		register_string_error(&dev->error, "Zero buffer/length");
+		return -1;
+	}
+
+	register_libusb_error(&dev->error, LIBUSB_SUCCESS, NULL);
+
+	report_number = data[0];
+
+	if (report_number == 0x0) {
+		data++;
+		length--;
+		skipped_report_id = 1;
+	}
+
+	/* Without an interrupt out endpoint, the report
+	   is sent over the Control Endpoint as a Set_Report */
+	buffer_size = length;
+	if (dev->output_endpoint <= 0)
+		buffer_size += LIBUSB_CONTROL_SETUP_SIZE;
+
+	out = take_output_transfer(dev, &gone);
+	if (gone) {
+		register_string_error(&dev->error, "hid_libusb_write_async: the event thread is not running");
+		return -1;
+	}
+	if (!out) {
+		register_string_error(&dev->error, "hid_libusb_write_async: libusb_alloc_transfer failed");
+		return -1;
+	}
+
+	/* The buffers only ever grow, to fit the largest report written */
+	if (out->buffer_size < buffer_size) {
+		uint8_t *buffer = (uint8_t*) realloc(out->buffer, buffer_size);
+		if (!buffer) {
+			release_output_transfer(dev, out);
+			register_string_error(&dev->error, "hid_libusb_write_async: Couldn't allocate memory");
+			return -1;
+		}
+		out->buffer = buffer;
+		out->buffer_size = buffer_size;
+	}
+
+	out->skipped_report_id = skipped_report_id;
+	out->callback = callback;
+	out->user_data = user_data;
+
+	if (dev->output_endpoint > 0) {
+		memcpy(out->buffer, data, length);
+		libusb_fill_interrupt_transfer(out->transfer,
+			dev->device_handle,
+			dev->output_endpoint,
+			out->buffer,
+			(int)length,
+			write_callback,
+			out,
+			1000/*timeout millis*/);
+	}
+	else {
+		libusb_fill_control_setup(out->buffer,
+			LIBUSB_REQUEST_TYPE_CLASS|LIBUSB_RECIPIENT_INTERFACE|LIBUSB_ENDPOINT_OUT,
+			0x09/*HID set_report*/,
+			(2/*HID output*/ << 8) | report_number,
+			dev->interface,
+			(uint16_t)length);
+		memcpy(out->buffer + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+		libusb_fill_control_transfer(out->transfer,
+			dev->device_handle,
+			out->buffer,
+			write_callback,
+			out,
+			1000/*timeout millis*/);
+	}
+
+	res = libusb_submit_transfer(out->transfer);
+	if (res < 0) {
+		release_output_transfer(dev, out);
+		register_libusb_error(&dev->error, res, "hid_libusb_write_async");
+		return -1;
+	}
+
+	return 0;
+}
+
+int HID_API_EXPORT_CALL hid_libusb_write_flush(hid_device *dev, int milliseconds)
+{
+	/* by initialising this variable right here, GCC gives a compilation warning/error: */
+	/* error: variable 'res' might be clobbered by 'longjmp' or 'vfork' [-Werror=clobbered] */
+	int res; /* = 0; */
+
+	hidapi_thread_mutex_lock(&dev->write_state);
+	hidapi_thread_cleanup_push(cleanup_write_mutex, dev);
+
+	res = 0;
+
+	if (dev->event_thread_gone && milliseconds != 0) {
+		/* Finish the writes here, as the event thread won't */
+		uint64_t deadline = get_timestamp() + (uint64_t)milliseconds * 1000000;
+
+		while (dev->writes_in_flight) {
+			uint64_t now = get_timestamp();
+			int timeout = 1000;
+
+			if (milliseconds > 0) {
+				if (now >= deadline)
+					break;
+				if (deadline - now < (uint64_t)timeout * 1000000)
+					timeout = (int)((deadline - now + 999999) / 1000000);
+			}
+
+			hidapi_thread_mutex_unlock(&dev->write_state);
+			res = handle_events_in_place(NULL, timeout);
+			hidapi_thread_mutex_lock(&dev->write_state);
+
+			if (res < 0) {
+				register_string_error(&dev->error, "hid_libusb_write_flush: error handling the events of the writes");
+				break;
+			}
+		}
+	}
+	else if (milliseconds == -1) {
+		while (dev->writes_in_flight) {
+			hidapi_thread_cond_wait(&dev->write_state);
+		}
+	}
+	else if (milliseconds > 0) {
+		hidapi_timespec ts;
+		hidapi_thread_gettime(&ts);
+		hidapi_thread_addtime(&ts, milliseconds);
+
+		while (dev->writes_in_flight) {
+			res = hidapi_thread_cond_timedwait(&dev->write_state, &ts);
+			if (res == HIDAPI_THREAD_TIMED_OUT) {
+				res = 0;
+				break;
+			}
+			if (res != 0) {
+				register_string_error(&dev->error, "hid_libusb_write_flush: error waiting for the writes");
+				res = -1;
+				break;
+			}
+		}
+	}
+
+	if (res == 0)
+		res = dev->writes_in_flight;
+
+	hidapi_thread_mutex_unlock(&dev->write_state);
+	hidapi_thread_cleanup_pop(0);
+
+	return res;
+}
+
+/* Helper function, to simplify hid_read().
+   This should be called with dev->mutex locked. */
+static int return_data(hid_device *dev, unsigned char *data, size_t length)
+{
+	/* Copy the data out of the oldest queued report (rpt) into the
+	   return buffer (data), and give its buffer back to the pool. */
+	struct input_report *rpt = &dev->input_reports[dev->input_reports_head];
+	size_t len = (length < rpt->len)? length: rpt->len;
+	if (len > 0)
+		memcpy(data, rpt->data, len);
+	dev->free_report_buffers[dev->free_report_buffers_count++] = rpt->data;
+	rpt->data = NULL;
+	if (++dev->input_reports_head == dev->input_reports_capacity)
+		dev->input_reports_head = 0;
+	if (--dev->input_reports_count == 0)
+		update_pollable_fd(dev);
+	return (int)len;
+}
+
+static void cleanup_mutex(void *param)
+{
+	hid_device *dev = (hid_device *) param;
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+}
+
+
+/* Copies as many queued reports as fit into reports.
+   This should be called with dev->mutex locked. */
+static int return_reports(hid_device *dev, struct hid_input_report_buffer *reports, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count && dev->input_reports_count; i++) {
+		reports[i].timestamp = dev->input_reports[dev->input_reports_head].timestamp;
+		reports[i].bytes_read = (size_t)return_data(dev, reports[i].data, reports[i].length);
+	}
+
+	return (int)i;
+}
+
+/* Waits for an input report to be queued, the way hid_read_timeout()
+   documents it. Returns 1 if there is a report in the queue, 0 on timeout
+   and -1 on error.
+   This should be called with dev->mutex locked. */
+static int wait_for_input_report(hid_device *dev, int milliseconds)
+{
+	/* There's an input report queued up. */
+	if (dev->input_reports_count)
+		return 1;
+
+	if (dev->shutdown_thread) {
+		/* The transfer loop is no longer running (device disconnected,
+		   event loop failure, etc.).
+		   An error code of -1 should be returned. */
+		register_read_error(dev, "hid_read(_timeout): read thread terminated");
+		return -1;
+	}
+
+	if (milliseconds == -1) {
+		/* Blocking */
+		while (!dev->input_reports_count && !dev->shutdown_thread) {
+			hidapi_thread_cond_wait(&dev->thread_state);
+		}
+		if (dev->input_reports_count)
+			return 1;
+
+		/* Woken up by shutdown_thread without data. */
+		register_read_error(dev, "hid_read(_timeout): read thread terminated");
+		return -1;
+	}
+	else if (milliseconds > 0) {
+		/* Non-blocking, but called with timeout. */
+		int res;
+		hidapi_timespec ts;
+		hidapi_thread_gettime(&ts);
+		hidapi_thread_addtime(&ts, milliseconds);
+
+		while (1) {
+			res = hidapi_thread_cond_timedwait(&dev->thread_state, &ts);
+			if (res == 0) {
+				if (dev->input_reports_count)
+					return 1;
+				if (dev->shutdown_thread) {
+					register_read_error(dev, "hid_read(_timeout): read thread terminated");
+					return -1;
+				}
+
+				/* Spurious wake up. Loop again. */
+			}
+			else if (res == HIDAPI_THREAD_TIMED_OUT) {
+				/* Timed out. */
+				return 0;
+			}
+			else {
+				/* Error. */
+				register_read_error(dev, "hid_read(_timeout): error waiting for data");
+				return -1;
+			}
+		}
+	}
+
+	/* Purely non-blocking */
+	return 0;
+}
+
+/* Waits for input reports and returns up to count of them
+   under a single lock of the mutex.
+   Returns the number of reports read, 0 on timeout and -1 on error. */
+static int read_input_reports(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds)
+{
+	/* by initialising this variable right here, GCC gives a compilation warning/error: */
+	/* error: variable 'num_read' might be clobbered by 'longjmp' or 'vfork' [-Werror=clobbered] */
+	int num_read; /* = -1; */
+
+	register_read_error(dev, NULL);
+
+	hidapi_thread_mutex_lock(&dev->thread_state);
+	hidapi_thread_cleanup_push(cleanup_mutex, dev);
+
+	num_read = wait_for_input_report(dev, milliseconds);
+	if (num_read > 0) {
+		num_read = return_reports(dev, reports, count);
+
+		/* Room was made for the reports of parked transfers */
+		resume_parked_transfers(dev);
+	}
+
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+	hidapi_thread_cleanup_pop(0);
+
+	return num_read;
+}
+
+
+int HID_API_EXPORT hid_read_timestamped(hid_device *dev, unsigned char *data, size_t length, int milliseconds, uint64_t *timestamp)
+{
+#if 0
+	int transferred;
+	int res = libusb_interrupt_transfer(dev->device_handle, dev->input_endpoint, data, length, &transferred, 5000);
+	LOG("transferred: %d\n", transferred);
+	return transferred;
+#endif
+	struct hid_input_report_buffer report;
+	int res;
+
+	if (!data || !length) {
+		register_read_error(dev, "Zero buffer/length");
+		return -1;
+	}
+
+	report.data = data;
+	report.length = length;
+	report.bytes_read = 0;
+	report.timestamp = 0;
+
+	res = read_input_reports(dev, &report, 1, milliseconds);
+	if (res > 0) {
+		if (timestamp)
+			*timestamp = report.timestamp;
+		return (int)report.bytes_read;
+	}
+	return res;
+}
+
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	return hid_read_timestamped(dev, data, length, milliseconds, NULL);
+}
+
+
+int HID_API_EXPORT hid_read_many(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds)
+{
+	size_t i;
+
+	if (!reports || !count) {
+		register_read_error(dev, "Zero buffer/length");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!reports[i].data || !reports[i].length) {
+			register_read_error(dev, "Zero buffer/length");
+			return -1;
+		}
+	}
 
-	return actual_length;
-}
+	/* The count of reports read is returned as an int */
+	if (count > INT_MAX)
+		count = INT_MAX;
 
-/* Helper function, to simplify hid_read().
-   This should be called with dev->mutex locked. */
-static int return_data(hid_device *dev, unsigned char *data, size_t length)
-{
-	/* Copy the data out of the linked list item (rpt) into the
-	   return buffer (data), and delete the liked list item. */
-	struct input_report *rpt = dev->input_reports;
-	size_t len = (length < rpt->len)? length: rpt->len;
-	if (len > 0)
-		memcpy(data, rpt->data, len);
-	dev->input_reports = rpt->next;
-	free(rpt->data);
-	free(rpt);
-	return (int)len;
+	return read_input_reports(dev, reports, count, milliseconds);
 }
 
-static void cleanup_mutex(void *param)
+
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
-	hid_device *dev = (hid_device *) param;
-	hidapi_thread_mutex_unlock(&dev->thread_state);
+	return hid_read_timeout(dev, data, length, dev->blocking ? -1 : 0);
 }
 
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+int HID_API_EXPORT_CALL hid_libusb_read_borrow(hid_device *dev, const unsigned char **data, size_t *length, uint64_t *timestamp, int milliseconds)
 {
-#if 0
-	int transferred;
-	int res = libusb_interrupt_transfer(dev->device_handle, dev->input_endpoint, data, length, &transferred, 5000);
-	LOG("transferred: %d\n", transferred);
-	return transferred;
-#endif
 	/* by initialising this variable right here, GCC gives a compilation warning/error: */
-	/* error: variable 'bytes_read' might be clobbered by 'longjmp' or 'vfork' [-Werror=clobbered] */
-	int bytes_read; /* = -1; */
+	/* error: variable 'res' might be clobbered by 'longjmp' or 'vfork' [-Werror=clobbered] */
+	int res; /* = -1; */
+	struct input_report *rpt;
 
 	if (!data || !length) {
 		register_read_error(dev, "Zero buffer/length");
@@ -1670,101 +4110,234 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 	hidapi_thread_mutex_lock(&dev->thread_state);
 	hidapi_thread_cleanup_push(cleanup_mutex, dev);
 
-	bytes_read = -1;
+	if (dev->borrowed_report) {
+		res = -1;
+		register_read_error(dev, "hid_libusb_read_borrow: the previous report was not released");
+	}
+	else {
+		res = wait_for_input_report(dev, milliseconds);
+	}
 
-	/* There's an input report queued up. Return it. */
-	if (dev->input_reports) {
-		/* Return the first one */
-		bytes_read = return_data(dev, data, length);
-		goto ret;
+	if (res > 0) {
+		/* Take the oldest queued report out of the queue,
+		   leaving its buffer with the user until it's released */
+		rpt = &dev->input_reports[dev->input_reports_head];
+		dev->borrowed_report = rpt->data;
+		*data = rpt->data;
+		*length = rpt->len;
+		if (timestamp)
+			*timestamp = rpt->timestamp;
+		rpt->data = NULL;
+		if (++dev->input_reports_head == dev->input_reports_capacity)
+			dev->input_reports_head = 0;
+		if (--dev->input_reports_count == 0)
+			update_pollable_fd(dev);
+
+		/* Room was made for the reports of parked transfers */
+		resume_parked_transfers(dev);
 	}
 
-	if (dev->shutdown_thread) {
-		/* The read thread is no longer running (device disconnected,
-		   event loop failure, etc.).
-		   An error code of -1 should be returned. */
-		bytes_read = -1;
-		register_read_error(dev, "hid_read(_timeout): read thread terminated");
-		goto ret;
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+	hidapi_thread_cleanup_pop(0);
+
+	return res;
+}
+
+
+int HID_API_EXPORT_CALL hid_libusb_read_release(hid_device *dev)
+{
+	hidapi_thread_mutex_lock(&dev->thread_state);
+
+	if (!dev->borrowed_report) {
+		hidapi_thread_mutex_unlock(&dev->thread_state);
+		register_read_error(dev, "hid_libusb_read_release: no report is borrowed");
+		return -1;
 	}
 
-	if (milliseconds == -1) {
-		/* Blocking */
-		while (!dev->input_reports && !dev->shutdown_thread) {
-			hidapi_thread_cond_wait(&dev->thread_state);
-		}
-		if (dev->input_reports) {
-			bytes_read = return_data(dev, data, length);
+	dev->free_report_buffers[dev->free_report_buffers_count++] = dev->borrowed_report;
+	dev->borrowed_report = NULL;
+
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+
+	return 0;
+}
+
+
+HID_API_EXPORT const wchar_t * HID_API_CALL hid_read_error(hid_device *dev)
+{
+	if (dev->last_read_error_str == NULL)
+		return L"Success";
+	return dev->last_read_error_str;
+}
+
+
+int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
+{
+	dev->blocking = !nonblock;
+
+	return 0;
+}
+
+
+int HID_API_EXPORT hid_set_input_queue(hid_device *dev, size_t max_reports, hid_input_queue_policy policy)
+{
+	struct input_report *reports;
+	size_t queue_buffers;
+	size_t i, slot;
+
+	if (max_reports == 0) {
+		register_string_error(&dev->error, "hid_set_input_queue: the queue must hold at least one report");
+		return -1;
+	}
+
+	switch (policy) {
+	case HID_API_INPUT_QUEUE_DROP_OLDEST:
+	case HID_API_INPUT_QUEUE_DROP_NEWEST:
+	case HID_API_INPUT_QUEUE_BLOCK:
+	case HID_API_INPUT_QUEUE_CONFLATE:
+		break;
+	default:
+		register_string_error(&dev->error, "hid_set_input_queue: unknown policy");
+		return -1;
+	}
+
+	if (policy == HID_API_INPUT_QUEUE_CONFLATE && dev->uses_numbered_reports < 0) {
+		unsigned char report_descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+		int res = hid_get_report_descriptor_libusb(dev->device_handle, dev->interface, dev->report_descriptor_size, report_descriptor, sizeof(report_descriptor), HIDAPI_REPORT_DESCRIPTOR_TIMEOUT);
+		if (res < 0) {
+			register_libusb_error(&dev->error, res, "hid_set_input_queue/libusb_control_transfer");
+			return -1;
 		}
-		else {
-			/* Woken up by shutdown_thread without data. */
-			register_read_error(dev, "hid_read(_timeout): read thread terminated");
+		struct report_layout_summary summary;
+		if (report_layout_scan(report_descriptor, (size_t)res, &summary) < 0) {
+			register_string_error(&dev->error, "hid_set_input_queue: Couldn't allocate memory");
+			return -1;
 		}
+		free(summary.usage_pairs);
+		dev->uses_numbered_reports = summary.numbered_reports;
 	}
-	else if (milliseconds > 0) {
-		/* Non-blocking, but called with timeout. */
-		int res;
-		hidapi_timespec ts;
-		hidapi_thread_gettime(&ts);
-		hidapi_thread_addtime(&ts, milliseconds);
 
-		while (!dev->input_reports && !dev->shutdown_thread) {
-			res = hidapi_thread_cond_timedwait(&dev->thread_state, &ts);
-			if (res == 0) {
-				if (dev->input_reports) {
-					bytes_read = return_data(dev, data, length);
-					break;
-				}
-				if (dev->shutdown_thread) {
-					register_read_error(dev, "hid_read(_timeout): read thread terminated");
-					break;
-				}
+	reports = (struct input_report*) calloc(max_reports, sizeof(struct input_report));
+	if (!reports) {
+		register_string_error(&dev->error, "hid_set_input_queue: Couldn't allocate memory");
+		return -1;
+	}
 
-				/* Spurious wake up. Loop again. */
-			}
-			else if (res == HIDAPI_THREAD_TIMED_OUT) {
-				/* Timed out. */
-				bytes_read = 0;
-				break;
-			}
-			else {
-				/* Error. */
-				bytes_read = -1;
-				register_read_error(dev, "hid_read(_timeout): error waiting for data");
-				break;
-			}
-		}
+	hidapi_thread_mutex_lock(&dev->thread_state);
+
+	/* A deeper queue needs more report buffers. They are
+	   kept when the queue is made shallower again. */
+	queue_buffers = dev->num_report_buffers - (size_t)dev->num_transfers - 1;
+	if (max_reports > queue_buffers && add_report_buffers(dev, max_reports - queue_buffers) < 0) {
+		hidapi_thread_mutex_unlock(&dev->thread_state);
+		free(reports);
+		register_string_error(&dev->error, "hid_set_input_queue: Couldn't allocate memory");
+		return -1;
 	}
-	else {
-		/* Purely non-blocking */
-		bytes_read = 0;
+
+	/* Discard the oldest reports which don't fit anymore */
+	while (dev->input_reports_count > max_reports) {
+		return_data(dev, NULL, 0);
+		dev->input_reports_dropped++;
+	}
+
+	for (i = 0; i < dev->input_reports_count; i++) {
+		slot = dev->input_reports_head + i;
+		if (slot >= dev->input_reports_capacity)
+			slot -= dev->input_reports_capacity;
+		reports[i] = dev->input_reports[slot];
 	}
+	free(dev->input_reports);
+	dev->input_reports = reports;
+	dev->input_reports_capacity = max_reports;
+	dev->input_reports_head = 0;
+	dev->input_queue_policy = policy;
+
+	/* Room may have been made for the reports of parked transfers,
+	   or the policy may not block anymore */
+	resume_parked_transfers(dev);
 
-ret:
 	hidapi_thread_mutex_unlock(&dev->thread_state);
-	hidapi_thread_cleanup_pop(0);
 
-	return bytes_read;
+	return 0;
 }
 
 
-int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+int HID_API_EXPORT hid_set_input_callback(hid_device *dev, hid_input_callback callback, void *user_data)
 {
-	return hid_read_timeout(dev, data, length, dev->blocking ? -1 : 0);
+	hidapi_thread_mutex_lock(&dev->thread_state);
+	dev->input_callback = callback;
+	dev->input_callback_user_data = user_data;
+
+	/* Wait for the previous callback to return, unless this is called
+	   from a callback, i.e. on the event thread, which is the only
+	   one calling them. */
+	if (!hidapi_thread_is_current(&event_thread_state)) {
+		dev->input_callback_waiting++;
+		while (dev->input_callback_running)
+			hidapi_thread_cond_wait(&dev->thread_state);
+		dev->input_callback_waiting--;
+	}
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+
+	return 0;
 }
 
 
-HID_API_EXPORT const wchar_t * HID_API_CALL hid_read_error(hid_device *dev)
+int HID_API_EXPORT hid_get_pollable_fd(hid_device *dev)
 {
-	if (dev->last_read_error_str == NULL)
-		return L"Success";
-	return dev->last_read_error_str;
+	int fd;
+
+	hidapi_thread_mutex_lock(&dev->thread_state);
+
+	if (dev->pollable_fd[0] < 0) {
+#ifdef __linux__
+		fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (fd >= 0) {
+			dev->pollable_fd[0] = fd;
+			dev->pollable_fd[1] = fd;
+		}
+#else
+		if (pipe(dev->pollable_fd) == 0) {
+			fcntl(dev->pollable_fd[0], F_SETFL, O_NONBLOCK);
+			fcntl(dev->pollable_fd[1], F_SETFL, O_NONBLOCK);
+			fcntl(dev->pollable_fd[0], F_SETFD, FD_CLOEXEC);
+			fcntl(dev->pollable_fd[1], F_SETFD, FD_CLOEXEC);
+		}
+		else {
+			dev->pollable_fd[0] = -1;
+			dev->pollable_fd[1] = -1;
+		}
+#endif
+		if (dev->pollable_fd[0] < 0) {
+			hidapi_thread_mutex_unlock(&dev->thread_state);
+			register_string_error(&dev->error, "hid_get_pollable_fd: couldn't create the file descriptor");
+			return -1;
+		}
+
+		dev->pollable_fd_signaled = 0;
+		update_pollable_fd(dev);
+	}
+	fd = dev->pollable_fd[0];
+
+	hidapi_thread_mutex_unlock(&dev->thread_state);
+
+	return fd;
 }
 
 
-int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
+int HID_API_EXPORT hid_get_input_reports_dropped(hid_device *dev, size_t *dropped, int reset)
 {
-	dev->blocking = !nonblock;
+	if (!dropped) {
+		register_string_error(&dev->error, "hid_get_input_reports_dropped: dropped is NULL");
+		return -1;
+	}
+
+	hidapi_thread_mutex_lock(&dev->thread_state);
+	*dropped = dev->input_reports_dropped;
+	if (reset)
+		dev->input_reports_dropped = 0;
+	hidapi_thread_mutex_unlock(&dev->thread_state);
 
 	return 0;
 }
@@ -1936,43 +4509,93 @@ int HID_API_EXPORT HID_API_CALL hid_get_input_report(hid_device *dev, unsigned c
 
 void HID_API_EXPORT hid_close(hid_device *dev)
 {
+	int i;
+	int leak_transfers = 0;
+	hid_device **prev;
+
 	if (!dev)
 		return;
 
-	/* Cause read_thread() to stop. */
-	dev->shutdown_thread = 1;
-	libusb_cancel_transfer(dev->transfer);
-
-	/* Wait for read_thread() to end. */
-	hidapi_thread_join(&dev->thread_state);
+	/* Cancel the asynchronous writes and wait for their callbacks. */
+	hidapi_thread_mutex_lock(&dev->write_state);
+	for (i = 0; i < dev->num_output_transfers; i++)
+		libusb_cancel_transfer(dev->output_transfers[i].transfer);
+	while (dev->writes_in_flight && !leak_transfers) {
+		if (dev->event_thread_gone) {
+			/* Handle the completions here instead, the callbacks
+			   take the mutex. */
+			hidapi_thread_mutex_unlock(&dev->write_state);
+			if (handle_events_in_place(NULL, 1000) < 0)
+				leak_transfers = 1;
+			hidapi_thread_mutex_lock(&dev->write_state);
+		}
+		else {
+			hidapi_thread_cond_wait(&dev->write_state);
+		}
+	}
+	hidapi_thread_mutex_unlock(&dev->write_state);
 
-	/* Clean up the Transfer objects allocated in read_thread(). */
-	free(dev->transfer->buffer);
-	dev->transfer->buffer = NULL;
-	libusb_free_transfer(dev->transfer);
+	/* A transfer still in flight can't be freed (see below) */
+	for (i = 0; i < dev->num_output_transfers && !leak_transfers; i++) {
+		libusb_free_transfer(dev->output_transfers[i].transfer);
+		free(dev->output_transfers[i].buffer);
+	}
 
-	/* release the interface */
-	libusb_release_interface(dev->device_handle, dev->interface);
+	/* Stop the transfer loop. */
+	hidapi_thread_mutex_lock(&dev->thread_state);
+	dev->shutdown_thread = 1;
+	for (i = 0; i < dev->num_transfers; i++)
+		libusb_cancel_transfer(dev->transfers[i]);
+	drop_parked_transfers(dev);
+
+	/* Wait for all of the transfers to finish on the event thread. */
+	while (!dev->transfer_loop_finished && !leak_transfers) {
+		if (dev->event_thread_gone) {
+			/* Handle the completions here instead, the callbacks
+			   take the mutex. */
+			hidapi_thread_mutex_unlock(&dev->thread_state);
+			/* The remaining transfers can't be finished on a fatal
+			   error. Freeing them would leave libusb with dangling
+			   pointers: leak them, and their buffers, instead. */
+			if (handle_events_in_place(&dev->transfer_loop_finished, 1000) < 0)
+				leak_transfers = 1;
+			hidapi_thread_mutex_lock(&dev->thread_state);
+		}
+		else {
+			hidapi_thread_cond_wait(&dev->thread_state);
+		}
+	}
+	hidapi_thread_mutex_unlock(&dev->thread_state);
 
-	/* reattach the kernel driver if it was detached */
-#ifdef DETACH_KERNEL_DRIVER
-	if (dev->is_driver_detached) {
-		int res = libusb_attach_kernel_driver(dev->device_handle, dev->interface);
-		if (res < 0)
-			LOG("Failed to reattach the driver to kernel.\n");
+	/* The event thread doesn't touch this device anymore. */
+	hidapi_thread_mutex_lock(&event_thread_state);
+	for (prev = &open_devices; *prev; prev = &(*prev)->next_open) {
+		if (*prev == dev) {
+			*prev = dev->next_open;
+			break;
+		}
 	}
-#endif
+	hidapi_thread_mutex_unlock(&event_thread_state);
 
-	/* Close the handle */
-	libusb_close(dev->device_handle);
+	/* Clean up the Transfer objects allocated in start_input_transfers().
+	   Their buffers belong to the report buffer pool. */
+	if (!leak_transfers) {
+		for (i = 0; i < dev->num_transfers; i++)
+			libusb_free_transfer(dev->transfers[i]);
 
-	/* Clear out the queue of received reports. */
-	hidapi_thread_mutex_lock(&dev->thread_state);
-	while (dev->input_reports) {
-		return_data(dev, NULL, 0);
+		/* release the interface and reattach the kernel driver */
+		release_interface(dev);
+
+		/* Close the handle */
+		libusb_close(dev->device_handle);
+	}
+	else {
+		/* Neither may the handle be closed with transfers in flight,
+		   nor the report buffers of those transfers freed. */
+		dev->report_buffer_pools_count = 0;
 	}
-	hidapi_thread_mutex_unlock(&dev->thread_state);
 
+	/* Free the queue of received reports along with the device. */
 	free_hid_device(dev);
 }
 
@@ -2000,10 +4623,10 @@ HID_API_EXPORT struct hid_device_info *HID_API_CALL hid_get_device_info(hid_devi
 		libusb_device *usb_device = libusb_get_device(dev->device_handle);
 		libusb_get_device_descriptor(usb_device, &desc);
 
-		dev->device_info = create_device_info_for_device(usb_device, dev->device_handle, &desc, dev->config_number, dev->interface);
+		dev->device_info = create_device_info_for_device(usb_device, dev->device_handle, &desc, dev->config_number, dev->interface, NULL, 0);
 
 		if (dev->device_info) {
-			fill_device_info_usage(dev->device_info, dev->device_handle, dev->interface, dev->report_descriptor_size);
+			fill_device_info_usage(dev->device_info, dev->device_handle, dev->interface, dev->report_descriptor_size, HIDAPI_REPORT_DESCRIPTOR_TIMEOUT);
 		}
 		else {
 			register_string_error(&dev->error, "hid_get_device_info: failed to allocate device info");
@@ -2025,7 +4648,7 @@ int HID_API_EXPORT_CALL hid_get_indexed_string(hid_device *dev, int string_index
 
 	register_libusb_error(&dev->error, LIBUSB_SUCCESS, NULL);
 
-	str = get_usb_string(dev->device_handle, string_index, &res);
+	str = get_usb_string(dev->device_handle, string_index, 0, &res);
 	if (str) {
 		wcsncpy(string, str, maxlen);
 		string[maxlen-1] = L'\0';
@@ -2055,7 +4678,7 @@ int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char
 
 	register_libusb_error(&dev->error, LIBUSB_SUCCESS, NULL);
 
-	res = hid_get_report_descriptor_libusb(dev->device_handle, dev->interface, dev->report_descriptor_size, buf, buf_size);
+	res = hid_get_report_descriptor_libusb(dev->device_handle, dev->interface, dev->report_descriptor_size, buf, buf_size, HIDAPI_REPORT_DESCRIPTOR_TIMEOUT);
 
 	if (res < 0) {
 		register_libusb_error(&dev->error, res, "hid_get_report_descriptor");
@@ -2065,6 +4688,50 @@ int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char
 	return res;
 }
 
+struct hid_report_layout HID_API_EXPORT * HID_API_CALL hid_parse_report_descriptor(const unsigned char *descriptor, size_t length)
+{
+	struct hid_report_layout *layout;
+	const char *error;
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		register_string_error(&last_global_error, error);
+		return NULL;
+	}
+
+	register_libusb_error(&last_global_error, LIBUSB_SUCCESS, NULL);
+	return layout;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_free_report_layout(struct hid_report_layout *layout)
+{
+	report_layout_free(layout);
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	const char *error;
+	int res;
+
+	if (dev->report_layout) {
+		register_libusb_error(&dev->error, LIBUSB_SUCCESS, NULL);
+		return dev->report_layout;
+	}
+
+	res = hid_get_report_descriptor(dev, descriptor, sizeof(descriptor));
+	if (res < 0)
+		return NULL;
+
+	dev->report_layout = report_layout_parse(descriptor, (size_t)res, &error);
+	if (!dev->report_layout) {
+		register_string_error(&dev->error, error);
+		return NULL;
+	}
+
+	return dev->report_layout;
+}
+
 HID_API_EXPORT const wchar_t * HID_API_CALL hid_error(hid_device *dev)
 {
 	const char *name, *description, *context;
@@ -2147,6 +4814,60 @@ HID_API_EXPORT int HID_API_CALL hid_libusb_error(hid_device *dev)
 }
 
 
+int HID_API_EXPORT_CALL hid_libusb_set_input_transfers(int count)
+{
+	if (count < HIDAPI_MIN_INPUT_TRANSFERS || count > HIDAPI_MAX_INPUT_TRANSFERS) {
+		register_string_error(&last_global_error, "hid_libusb_set_input_transfers: count out of range");
+		return -1;
+	}
+
+	input_transfers = count;
+	return 0;
+}
+
+
+int HID_API_EXPORT_CALL hid_libusb_get_input_transfers(void)
+{
+	return input_transfers;
+}
+
+
+int HID_API_EXPORT_CALL hid_libusb_set_enumerate_threads(int count)
+{
+	if (count < 1 || count > HIDAPI_MAX_ENUMERATE_THREADS) {
+		register_string_error(&last_global_error, "hid_libusb_set_enumerate_threads: count out of range");
+		return -1;
+	}
+
+	enumerate_threads = count;
+	return 0;
+}
+
+
+int HID_API_EXPORT_CALL hid_libusb_get_enumerate_threads(void)
+{
+	return enumerate_threads;
+}
+
+
+int HID_API_EXPORT_CALL hid_libusb_set_enumerate_timeout(int milliseconds)
+{
+	if (milliseconds < -1) {
+		register_string_error(&last_global_error, "hid_libusb_set_enumerate_timeout: milliseconds out of range");
+		return -1;
+	}
+
+	enumerate_timeout = milliseconds;
+	return 0;
+}
+
+
+int HID_API_EXPORT_CALL hid_libusb_get_enumerate_timeout(void)
+{
+	return enumerate_timeout;
+}
+
+
 struct lang_map_entry {
 	const char *name;
 	const char *string_code;
@@ -66,6 +66,220 @@ extern "C" {
               */
               HID_API_EXPORT int HID_API_CALL hid_libusb_error(hid_device *dev);
 
+		/** @brief Changes the number of interrupt IN transfers kept in flight
+			by all further calls to @ref hid_open, @ref hid_open_path
+			or @ref hid_libusb_wrap_sys_device.
+
+			By default a single transfer is used, which is resubmitted
+			from its completion callback. Between a completion and the
+			next submission no request is queued for the endpoint,
+			so a device sending reports at a high rate may lose
+			polling intervals. With more transfers in flight the host
+			controller always holds an outstanding request.
+
+			Reports are still queued in the order they were received.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param count The number of transfers, from 1 to 16.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_set_input_transfers(int count);
+
+		/** @brief Getter for option set by @ref hid_libusb_set_input_transfers.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@return The number of interrupt IN transfers used for further opened devices.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_get_input_transfers(void);
+
+		/** @brief Changes the number of threads probing devices in
+			all further calls to @ref hid_enumerate and its variants.
+
+			Probing a device (opening it and getting its strings)
+			takes a few control transfers, and each of the devices
+			is probed in turn by default, so a slow device delays
+			the whole enumeration. With several threads, up to
+			that many devices are probed at the same time.
+
+			The records are returned in the same order either way.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param count The number of threads, from 1 to 32,
+				the calling thread being one of them.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_set_enumerate_threads(int count);
+
+		/** @brief Getter for option set by @ref hid_libusb_set_enumerate_threads.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@return The number of threads probing devices in @ref hid_enumerate.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_get_enumerate_threads(void);
+
+		/** @brief Changes the time given to the probe of each device
+			in all further calls to @ref hid_enumerate and its variants.
+
+			By default each control transfer getting a string of a
+			device may take up to 1 second. With a deadline, the
+			transfers of a device end by that time after its probe
+			started, and the records of a device which did not
+			make it are returned without the strings left to get.
+			The deadline doesn't cover opening the device, which
+			libusb_open() takes no timeout for. Built with
+			INVASIVE_GET_USAGE, it bounds the transfer of the report
+			descriptor too, but not the claim of the interface.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param milliseconds The deadline of each device in milliseconds,
+				or -1 for none.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_set_enumerate_timeout(int milliseconds);
+
+		/** @brief Getter for option set by @ref hid_libusb_set_enumerate_timeout.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@return The deadline of each device in milliseconds, or -1 for none.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_get_enumerate_timeout(void);
+
+		/** @brief Read an Input report from a HID device without copying it.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Waits for an Input report just like @ref hid_read_timeout does,
+			but instead of copying the report into a user buffer,
+			hands out the buffer the report was received into.
+			The buffer is taken out of the input report queue and
+			stays valid until it is given back with
+			@ref hid_libusb_read_release, which has to happen before
+			the next call to this function and before @ref hid_close.
+
+			The first byte will contain the Report number
+			if the device uses numbered reports.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param data Receives a pointer to the report.
+			@param length Receives the length of the report in bytes.
+			@param timestamp Receives the arrival time of the report
+				(see @ref hid_read_timestamped), may be NULL.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns 1 if a report was borrowed, 0 if no
+				report was available to be read within the timeout period,
+				and -1 on error (including a report not yet released).
+				Call hid_read_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_read_borrow(hid_device *dev, const unsigned char **data, size_t *length, uint64_t *timestamp, int milliseconds);
+
+		/** @brief Give back the report borrowed with @ref hid_libusb_read_borrow.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+
+			@returns
+				This function returns 0 on success and -1 if
+				no report is borrowed.
+				Call hid_read_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_read_release(hid_device *dev);
+
+		/** @brief Completion callback of @ref hid_libusb_write_async.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			Called on the HIDAPI event thread, which handles the
+			events of all of the devices: it should return quickly.
+			If that thread failed, the writes in flight are cancelled,
+			and their callbacks are called from @ref hid_libusb_write_flush
+			or @ref hid_close instead.
+			It must not call @ref hid_libusb_write_async,
+			@ref hid_libusb_write_flush or @ref hid_close.
+
+			@ingroup API
+			@param dev The device the report was written to.
+			@param result The actual number of bytes written
+				(as @ref hid_write would return it) or -1 on error.
+			@param user_data The pointer passed to @ref hid_libusb_write_async.
+		*/
+		typedef void (HID_API_CALL *hid_libusb_write_callback)(hid_device *dev, int result, void *user_data);
+
+		/** @brief Write an Output report to a HID device without waiting
+			for the transfer to complete.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			The report is copied and sent the same way @ref hid_write
+			sends it: over the interrupt OUT endpoint, or as a
+			Set_Report request over the Control Endpoint if the
+			device has no such endpoint. Up to 8 writes are in flight
+			at a time and complete in the order they were made;
+			when all of them are in flight, this function waits
+			for one to complete.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param data The data to send, including the report number as
+				the first byte.
+			@param length The length in bytes of the data to send.
+			@param callback Called once the write completed or failed,
+				may be NULL.
+			@param user_data Passed to @p callback.
+
+			@returns
+				This function returns 0 if the write was submitted and
+				-1 on error, in which case @p callback is not called.
+				It fails once the HIDAPI event thread failed, as nothing
+				would complete the write anymore.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_write_async(hid_device *dev, const unsigned char *data, size_t length, hid_libusb_write_callback callback, void *user_data);
+
+		/** @brief Wait for the writes made with @ref hid_libusb_write_async to complete.
+
+			Since version 0.16.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 16, 0)
+
+			When this function returns 0, the callbacks of all of the
+			writes have returned.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param milliseconds timeout in milliseconds, 0 to not wait
+				at all, or -1 for blocking wait.
+
+			@returns
+				This function returns the number of writes still in flight
+				(0 once all of them completed) and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_write_flush(hid_device *dev, int milliseconds);
+
 #ifdef __cplusplus
 }
 #endif
@@ -148,9 +148,9 @@ static void hidapi_thread_barrier_wait(hidapi_thread_state *state)
 	pthread_barrier_wait(&state->barrier);
 }
 
-static void hidapi_thread_create(hidapi_thread_state *state, void *(*func)(void*), void *func_arg)
+static int hidapi_thread_create(hidapi_thread_state *state, void *(*func)(void*), void *func_arg)
 {
-	pthread_create(&state->thread, NULL, func, func_arg);
+	return pthread_create(&state->thread, NULL, func, func_arg);
 }
 
 static void hidapi_thread_join(hidapi_thread_state *state)
@@ -158,6 +158,11 @@ static void hidapi_thread_join(hidapi_thread_state *state)
 	pthread_join(state->thread, NULL);
 }
 
+static int hidapi_thread_is_current(hidapi_thread_state *state)
+{
+	return pthread_equal(pthread_self(), state->thread);
+}
+
 static void hidapi_thread_gettime(hidapi_timespec *ts)
 {
 	clock_gettime(CLOCK_REALTIME, ts);
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <limits.h>
 #include <errno.h>
 
 /* Unix */
@@ -34,7 +35,10 @@
 #include <sys/ioctl.h>
 #include <sys/utsname.h>
 #include <fcntl.h>
+#include <dirent.h>
 #include <poll.h>
+#include <pthread.h>
+#include <time.h>
 
 /* Linux */
 #include <linux/hidraw.h>
@@ -43,6 +47,15 @@
 #include <libudev.h>
 
 #include "hidapi.h"
+#include "hidapi_hidraw.h"
+
+#define REPORT_LAYOUT_WITH_SCAN
+#include "../core/hidapi_report_layout.c"
+#include "../core/hidapi_timestamp.c"
+#include "../core/hidapi_enumerate_filter.c"
+#include "../core/hidapi_descriptor_cache.c"
+#include "../core/hidapi_device_info.c"
+#include "../core/hidapi_hotplug.c"
 
 #ifdef HIDAPI_ALLOW_BUILD_WORKAROUND_KERNEL_2_6_39
 /* This definitions first appeared in Linux Kernel 2.6.39 in linux/hidraw.h.
@@ -74,9 +87,19 @@
 struct hid_device_ {
 	int device_handle;
 	int blocking;
+
+	/* Reader thread passing the reports to the callback
+	   set by hid_set_input_callback() */
+	hid_input_callback input_callback;
+	void *input_callback_user_data;
+	int input_thread_running;
+	pthread_t input_thread;
+	int input_thread_pipe[2]; /* written to, to stop the thread */
 	wchar_t *last_error_str;
 	wchar_t *last_read_error_str;
 	struct hid_device_info* device_info;
+	/* See hid_get_report_layout(), compiled on the first call */
+	struct hid_report_layout *report_layout;
 };
 
 static struct hid_api_version api_version = {
@@ -87,6 +110,53 @@ static struct hid_api_version api_version = {
 
 static wchar_t *last_global_error_str = NULL;
 
+/* A hidraw node of the enumeration cache, see hid_set_enumeration_cache() */
+struct enumeration_cache_entry {
+	char *syspath;
+	/* The records of the node, NULL if the node is not handled */
+	struct hid_device_info *info;
+	struct enumeration_cache_entry *next;
+};
+
+static pthread_mutex_t enumeration_cache_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the fields below */
+static struct udev *enumeration_cache_udev = NULL;
+static struct udev_monitor *enumeration_cache_monitor = NULL; /* NULL while the cache is disabled */
+static struct enumeration_cache_entry *enumeration_cache = NULL;
+
+/* A report descriptor of the report descriptor cache,
+   see hid_set_report_descriptor_cache() */
+struct report_descriptor_cache_entry {
+	/* The identity of the device */
+	unsigned short bus_type;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	unsigned short release_number;
+	int interface_number;
+	__u8 *descriptor;
+	__u32 size;
+	/* Its top-level usage pairs, see parse_hid_usages() */
+	struct report_layout_usage_pair *usages;
+	size_t num_usages;
+	struct report_descriptor_cache_entry *next;
+};
+
+static pthread_mutex_t report_descriptor_cache_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the fields below */
+static int report_descriptor_cache_enabled = 0;
+static char *report_descriptor_cache_path = NULL;
+static struct report_descriptor_cache_entry *report_descriptor_cache = NULL;
+
+static pthread_mutex_t hotplug_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the fields below */
+static int hotplug_thread_running = 0;
+static int hotplug_thread_shutdown = 0;
+static pthread_t hotplug_thread;
+static int hotplug_thread_pipe[2]; /* written to, to wake the thread up */
+static struct udev *hotplug_udev = NULL;
+static struct udev_monitor *hotplug_monitor = NULL;
+static hid_hotplug_callback_handle hotplug_next_handle = 1;
+static struct hid_hotplug_callback *hotplug_callbacks = NULL;
+/* The connected devices, only changed by the hotplug thread */
+static struct hid_device_info *hotplug_devices = NULL;
+
 
 static hid_device *new_hid_device(void)
 {
@@ -185,228 +255,160 @@ static void register_device_error_format(hid_device *dev, const char *format, ..
 	va_end(args);
 }
 
-/* Get an attribute value from a udev_device and return it as a whar_t
-   string. The returned string must be freed with free() when done.*/
-static wchar_t *copy_udev_string(struct udev_device *dev, const char *udev_name)
+/* Returns the top-level usage pairs of a report descriptor, in a newly
+   allocated array, see report_layout_scan(). */
+static struct report_layout_usage_pair *parse_hid_usages(const __u8 *report_descriptor, __u32 size, size_t *num_usages)
 {
-	return utf8_to_wchar_t(udev_device_get_sysattr_value(dev, udev_name));
+	struct report_layout_summary summary;
+
+	*num_usages = 0;
+	if (report_layout_scan(report_descriptor, size, &summary) < 0)
+		return NULL;
+
+	*num_usages = summary.num_usage_pairs;
+	return summary.usage_pairs;
 }
 
-/*
- * Gets the size of the HID item at the given position
- * Returns 1 if successful, 0 if an invalid key
- * Sets data_len and key_size when successful
- */
-static int get_hid_item_size(const __u8 *report_descriptor, __u32 size, unsigned int pos, int *data_len, int *key_size)
+/* Looks a descriptor up in the report descriptor cache, with the lock held.
+   The cached descriptor has to be the very same. */
+static struct report_descriptor_cache_entry *report_descriptor_cache_find(const struct hid_device_info *info, const __u8 *descriptor, __u32 size)
 {
-	int key = report_descriptor[pos];
-	int size_code;
-
-	/*
-	 * This is a Long Item. The next byte contains the
-	 * length of the data section (value) for this key.
-	 * See the HID specification, version 1.11, section
-	 * 6.2.2.3, titled "Long Items."
-	 */
-	if ((key & 0xf0) == 0xf0) {
-		if (pos + 1 < size)
-		{
-			*data_len = report_descriptor[pos + 1];
-			*key_size = 3;
-			return 1;
-		}
-		*data_len = 0; /* malformed report */
-		*key_size = 0;
+	struct report_descriptor_cache_entry *entry;
+
+	for (entry = report_descriptor_cache; entry; entry = entry->next) {
+		if (entry->bus_type == info->bus_type &&
+		    entry->vendor_id == info->vendor_id &&
+		    entry->product_id == info->product_id &&
+		    entry->release_number == info->release_number &&
+		    entry->interface_number == info->interface_number &&
+		    entry->size == size &&
+		    memcmp(entry->descriptor, descriptor, size) == 0)
+			return entry;
 	}
 
-	/*
-	 * This is a Short Item. The bottom two bits of the
-	 * key contain the size code for the data section
-	 * (value) for this key. Refer to the HID
-	 * specification, version 1.11, section 6.2.2.2,
-	 * titled "Short Items."
-	 */
-	size_code = key & 0x3;
-	switch (size_code) {
-	case 0:
-	case 1:
-	case 2:
-		*data_len = size_code;
-		*key_size = 1;
-		return 1;
-	case 3:
-		*data_len = 4;
-		*key_size = 1;
-		return 1;
-	default:
-		/* Can't ever happen since size_code is & 0x3 */
-		*data_len = 0;
-		*key_size = 0;
-		break;
-	};
-
-	/* malformed report */
-	return 0;
+	return NULL;
 }
 
-/*
- * Get bytes from a HID Report Descriptor.
- * Only call with a num_bytes of 0, 1, 2, or 4.
- */
-static __u32 get_hid_report_bytes(const __u8 *rpt, size_t len, size_t num_bytes, size_t cur)
+/* Adds a descriptor to the report descriptor cache, parsing its usage
+   pairs, with the lock held. Returns the entry, or NULL. */
+static struct report_descriptor_cache_entry *report_descriptor_cache_add(const struct hid_device_info *info, const __u8 *descriptor, __u32 size)
 {
-	/* Return if there aren't enough bytes. */
-	if (cur + num_bytes >= len)
-		return 0;
+	struct report_descriptor_cache_entry *entry;
 
-	if (num_bytes == 0)
-		return 0;
-	else if (num_bytes == 1)
-		return rpt[cur + 1];
-	else if (num_bytes == 2)
-		return (rpt[cur + 2] * 256 + rpt[cur + 1]);
-	else if (num_bytes == 4)
-		return (
-			rpt[cur + 4] * 0x01000000 +
-			rpt[cur + 3] * 0x00010000 +
-			rpt[cur + 2] * 0x00000100 +
-			rpt[cur + 1] * 0x00000001
-		);
-	else
-		return 0;
-}
+	entry = report_descriptor_cache_find(info, descriptor, size);
+	if (entry)
+		return entry;
 
-/*
- * Iterates until the end of a Collection.
- * Assumes that *pos is exactly at the beginning of a Collection.
- * Skips all nested Collection, i.e. iterates until the end of current level Collection.
- *
- * The return value is non-0 when an end of current Collection is found,
- * 0 when error is occurred (broken Descriptor, end of a Collection is found before its begin,
- *  or no Collection is found at all).
- */
-static int hid_iterate_over_collection(const __u8 *report_descriptor, __u32 size, unsigned int *pos, int *data_len, int *key_size)
-{
-	int collection_level = 0;
+	entry = (struct report_descriptor_cache_entry*) calloc(1, sizeof(struct report_descriptor_cache_entry));
+	if (!entry)
+		return NULL;
 
-	while (*pos < size) {
-		int key = report_descriptor[*pos];
-		int key_cmd = key & 0xfc;
+	entry->descriptor = (__u8*) malloc(size? size: 1);
+	if (!entry->descriptor) {
+		free(entry);
+		return NULL;
+	}
 
-		/* Determine data_len and key_size */
-		if (!get_hid_item_size(report_descriptor, size, *pos, data_len, key_size))
-			return 0; /* malformed report */
+	entry->bus_type = (unsigned short) info->bus_type;
+	entry->vendor_id = info->vendor_id;
+	entry->product_id = info->product_id;
+	entry->release_number = info->release_number;
+	entry->interface_number = info->interface_number;
+	memcpy(entry->descriptor, descriptor, size);
+	entry->size = size;
+	entry->usages = parse_hid_usages(entry->descriptor, entry->size, &entry->num_usages);
 
-		switch (key_cmd) {
-		case 0xa0: /* Collection 6.2.2.4 (Main) */
-			collection_level++;
-			break;
-		case 0xc0: /* End Collection 6.2.2.4 (Main) */
-			collection_level--;
-			break;
-		}
+	entry->next = report_descriptor_cache;
+	report_descriptor_cache = entry;
 
-		if (collection_level < 0) {
-			/* Broken descriptor or someone is using this function wrong,
-			 * i.e. should be called exactly at the collection start */
-			return 0;
-		}
+	return entry;
+}
 
-		if (collection_level == 0) {
-			/* Found it!
-			 * Also possible when called not at the collection start, but should not happen if used correctly */
-			return 1;
-		}
+/* Returns the top-level usage pairs of the report descriptor of a device,
+   in a newly allocated array. While the report descriptor cache is enabled,
+   each distinct descriptor is only parsed once. */
+static struct report_layout_usage_pair *get_hid_usages(const struct hid_device_info *info, const struct hidraw_report_descriptor *rpt_desc, size_t *num_usages)
+{
+	struct report_descriptor_cache_entry *entry;
+	struct report_layout_usage_pair *usages = NULL;
 
-		*pos += *data_len + *key_size;
+	pthread_mutex_lock(&report_descriptor_cache_mutex);
+	if (!report_descriptor_cache_enabled) {
+		pthread_mutex_unlock(&report_descriptor_cache_mutex);
+		return parse_hid_usages(rpt_desc->value, rpt_desc->size, num_usages);
 	}
 
-	return 0; /* Did not find the end of a Collection */
-}
+	*num_usages = 0;
+	entry = report_descriptor_cache_add(info, rpt_desc->value, rpt_desc->size);
+	if (entry && entry->num_usages) {
+		usages = (struct report_layout_usage_pair*) malloc(entry->num_usages * sizeof(struct report_layout_usage_pair));
+		if (usages) {
+			memcpy(usages, entry->usages, entry->num_usages * sizeof(struct report_layout_usage_pair));
+			*num_usages = entry->num_usages;
+		}
+	}
+	pthread_mutex_unlock(&report_descriptor_cache_mutex);
 
-struct hid_usage_iterator {
-	unsigned int pos;
-	int usage_page_found;
-	unsigned short usage_page;
-};
+	return usages;
+}
 
-/*
- * Retrieves the device's Usage Page and Usage from the report descriptor.
- * The algorithm returns the current Usage Page/Usage pair whenever a new
- * Collection is found and a Usage Local Item is currently in scope.
- * Usage Local Items are consumed by each Main Item (See. 6.2.2.8).
- * The algorithm should give similar results as Apple's:
- *   https://developer.apple.com/documentation/iokit/kiohiddeviceusagepairskey?language=objc
- * Physical Collections are also matched (macOS does the same).
- *
- * This function can be called repeatedly until it returns non-0
- * Usage is found. pos is the starting point (initially 0) and will be updated
- * to the next search position.
- *
- * The return value is 0 when a pair is found.
- * 1 when finished processing descriptor.
- * -1 on a malformed report.
- */
-static int get_next_hid_usage(const __u8 *report_descriptor, __u32 size, struct hid_usage_iterator *ctx, unsigned short *usage_page, unsigned short *usage)
+static void report_descriptor_cache_add_record(const struct report_descriptor_cache_record *record)
 {
-	int data_len, key_size;
-	int initial = ctx->pos == 0; /* Used to handle case where no top-level application collection is defined */
-
-	int usage_found = 0;
+	struct hid_device_info info;
 
-	while (ctx->pos < size) {
-		int key = report_descriptor[ctx->pos];
-		int key_cmd = key & 0xfc;
+	/* The descriptors are looked up by their own length */
+	if (record->expected_size != record->size)
+		return;
 
-		/* Determine data_len and key_size */
-		if (!get_hid_item_size(report_descriptor, size, ctx->pos, &data_len, &key_size))
-			return -1; /* malformed report */
+	memset(&info, 0, sizeof(info));
+	info.bus_type = (hid_bus_type) record->bus_type;
+	info.vendor_id = record->vendor_id;
+	info.product_id = record->product_id;
+	info.release_number = record->release_number;
+	info.interface_number = record->interface_number;
+	report_descriptor_cache_add(&info, record->descriptor, (__u32) record->size);
+}
 
-		switch (key_cmd) {
-		case 0x4: /* Usage Page 6.2.2.7 (Global) */
-			ctx->usage_page = get_hid_report_bytes(report_descriptor, size, data_len, ctx->pos);
-			ctx->usage_page_found = 1;
-			break;
+static int report_descriptor_cache_next_record(void **iter, struct report_descriptor_cache_record *record)
+{
+	struct report_descriptor_cache_entry *entry = (struct report_descriptor_cache_entry*) *iter;
 
-		case 0x8: /* Usage 6.2.2.8 (Local) */
-			if (data_len == 4) { /* Usages 5.5 / Usage Page 6.2.2.7 */
-				ctx->usage_page = get_hid_report_bytes(report_descriptor, size, 2, ctx->pos + 2);
-				ctx->usage_page_found = 1;
-				*usage = get_hid_report_bytes(report_descriptor, size, 2, ctx->pos);
-				usage_found = 1;
-			}
-			else {
-				*usage = get_hid_report_bytes(report_descriptor, size, data_len, ctx->pos);
-				usage_found = 1;
-			}
-			break;
+	if (!entry)
+		return 0;
 
-		case 0xa0: /* Collection 6.2.2.4 (Main) */
-			if (!hid_iterate_over_collection(report_descriptor, size, &ctx->pos, &data_len, &key_size)) {
-				return -1;
-			}
+	record->bus_type = entry->bus_type;
+	record->vendor_id = entry->vendor_id;
+	record->product_id = entry->product_id;
+	record->release_number = entry->release_number;
+	record->interface_number = entry->interface_number;
+	record->expected_size = (unsigned short) entry->size;
+	record->descriptor = entry->descriptor;
+	record->size = entry->size;
+
+	*iter = entry->next;
+	return 1;
+}
 
-			/* A pair is valid - to be reported when Collection is found */
-			if (usage_found && ctx->usage_page_found) {
-				*usage_page = ctx->usage_page;
-				return 0;
-			}
+static void report_descriptor_cache_disable(void)
+{
+	pthread_mutex_lock(&report_descriptor_cache_mutex);
 
-			break;
-		}
+	if (report_descriptor_cache_enabled && report_descriptor_cache_path)
+		report_descriptor_cache_save(report_descriptor_cache_path, report_descriptor_cache);
 
-		/* Skip over this key and its associated data */
-		ctx->pos += data_len + key_size;
-	}
+	report_descriptor_cache_enabled = 0;
+	free(report_descriptor_cache_path);
+	report_descriptor_cache_path = NULL;
 
-	/* If no top-level application collection is found and usage page/usage pair is found, pair is valid
-	   https://docs.microsoft.com/en-us/windows-hardware/drivers/hid/top-level-collections */
-	if (initial && usage_found && ctx->usage_page_found) {
-		*usage_page = ctx->usage_page;
-		return 0; /* success */
+	while (report_descriptor_cache) {
+		struct report_descriptor_cache_entry *next = report_descriptor_cache->next;
+		free(report_descriptor_cache->descriptor);
+		free(report_descriptor_cache->usages);
+		free(report_descriptor_cache);
+		report_descriptor_cache = next;
 	}
 
-	return 1; /* finished processing */
+	pthread_mutex_unlock(&report_descriptor_cache_mutex);
 }
 
 /*
@@ -632,40 +634,59 @@ next_line:
 }
 
 
-static struct hid_device_info * create_device_info_for_device(struct udev_device *raw_dev)
+/* Access to the parent devices of a hidraw node, either through libudev
+   (udev_node_ops) or straight from sysfs (sysfs_node_ops), so both
+   create the very same records with create_device_info_for_node(). */
+struct hidraw_node_ops {
+	/* Returns non-zero if the node has a parent device
+	   of the given subsystem and devtype (NULL for any). */
+	int (*has_parent)(void *node, const char *subsystem, const char *devtype);
+
+	/* Returns the value of an attribute of that parent device, or NULL.
+	   The value is only valid until the next call. */
+	const char *(*get_parent_sysattr)(void *node, const char *subsystem, const char *devtype, const char *sysattr);
+};
+
+/* The strings of a device which is not a USB device,
+   only the HID layer tells its name */
+static void copy_hid_strings(struct hid_device_info *cur_dev, const char *product_name_utf8, int fields)
+{
+	if (fields & HID_API_DEVICE_INFO_MANUFACTURER_STRING)
+		cur_dev->manufacturer_string = wcsdup(L"");
+	if (fields & HID_API_DEVICE_INFO_PRODUCT_STRING)
+		cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
+}
+
+/* Creates the records of the usage pairs of a hidraw node which match
+   the filter (NULL for all of them). Each criterion is checked as soon
+   as it is known, before the strings and the report descriptor are read. */
+static struct hid_device_info * create_device_info_for_node(const char *sysfs_path, const char *dev_path, const struct hidraw_node_ops *ops, void *node, const struct hid_enumerate_filter *filter)
 {
 	struct hid_device_info *root = NULL;
 	struct hid_device_info *cur_dev = NULL;
+	struct hid_device_info info; /* the fields shared by all of the records */
 
-	const char *sysfs_path;
-	const char *dev_path;
 	const char *str;
-	struct udev_device *hid_dev; /* The device's HID udev node. */
-	struct udev_device *usb_dev; /* The device's USB udev node. */
-	struct udev_device *intf_dev; /* The device's interface (in the USB sense). */
 	unsigned short dev_vid;
 	unsigned short dev_pid;
 	char *serial_number_utf8 = NULL;
 	char *product_name_utf8 = NULL;
 	unsigned bus_type;
+	int fields = enumerate_filter_fields(filter);
 	int result;
 	struct hidraw_report_descriptor report_desc;
+	struct report_layout_usage_pair *usages = NULL;
+	size_t num_usages = 0;
+	struct report_layout_usage_pair no_usage;
+	const struct report_layout_usage_pair *usage_pairs;
+	size_t num_usage_pairs;
+	size_t i;
 
-	sysfs_path = udev_device_get_syspath(raw_dev);
-	dev_path = udev_device_get_devnode(raw_dev);
-
-	hid_dev = udev_device_get_parent_with_subsystem_devtype(
-		raw_dev,
-		"hid",
-		NULL);
-
-	if (!hid_dev) {
-		/* Unable to find parent hid device. */
-		goto end;
-	}
+	memset(&info, 0, sizeof(info));
 
+	/* Without a parent hid device, there is no uevent to parse. */
 	result = parse_uevent_info(
-		udev_device_get_sysattr_value(hid_dev, "uevent"),
+		ops->get_parent_sysattr(node, "hid", NULL, "uevent"),
 		&bus_type,
 		&dev_vid,
 		&dev_pid,
@@ -677,42 +698,11 @@ static struct hid_device_info * create_device_info_for_device(struct udev_device
 		goto end;
 	}
 
-	/* Filter out unhandled devices right away */
-	switch (bus_type) {
-		case BUS_BLUETOOTH:
-		case BUS_I2C:
-		case BUS_USB:
-		case BUS_SPI:
-		case BUS_VIRTUAL:
-			break;
-
-		default:
-			goto end;
-	}
-
-	/* Create the record. */
-	root = (struct hid_device_info*) calloc(1, sizeof(struct hid_device_info));
-	if (!root)
+	if (filter &&
+	    ((filter->vendor_id != 0x0 && filter->vendor_id != dev_vid) ||
+	     (filter->product_id != 0x0 && filter->product_id != dev_pid))) {
 		goto end;
-
-	cur_dev = root;
-
-	/* Fill out the record */
-	cur_dev->next = NULL;
-	cur_dev->path = dev_path? strdup(dev_path): NULL;
-
-	/* VID/PID */
-	cur_dev->vendor_id = dev_vid;
-	cur_dev->product_id = dev_pid;
-
-	/* Serial Number */
-	cur_dev->serial_number = utf8_to_wchar_t(serial_number_utf8);
-
-	/* Release Number */
-	cur_dev->release_number = 0x0;
-
-	/* Interface Number */
-	cur_dev->interface_number = -1;
+	}
 
 	switch (bus_type) {
 		case BUS_USB:
@@ -722,76 +712,74 @@ static struct hid_device_info * create_device_info_for_device(struct udev_device
 				subsystem/devtype pair of "usb"/"usb_device". This will
 				be several levels up the tree, but the function will find
 				it. */
-			usb_dev = udev_device_get_parent_with_subsystem_devtype(
-					raw_dev,
-					"usb",
-					"usb_device");
-
 			/* uhid USB devices
 			 * Since this is a virtual hid interface, no USB information will
 			 * be available. */
-			if (!usb_dev) {
-				/* Manufacturer and Product strings */
-				cur_dev->manufacturer_string = wcsdup(L"");
-				cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
-				break;
-			}
-
-			cur_dev->manufacturer_string = copy_udev_string(usb_dev, "manufacturer");
-			cur_dev->product_string = copy_udev_string(usb_dev, "product");
-
-			cur_dev->bus_type = HID_API_BUS_USB;
+			info.bus_type = ops->has_parent(node, "usb", "usb_device")? HID_API_BUS_USB: HID_API_BUS_UNKNOWN;
+			break;
 
-			str = udev_device_get_sysattr_value(usb_dev, "bcdDevice");
-			cur_dev->release_number = (str)? strtol(str, NULL, 16): 0x0;
+		case BUS_BLUETOOTH:
+			info.bus_type = HID_API_BUS_BLUETOOTH;
+			break;
 
-			/* Get a handle to the interface's udev node. */
-			intf_dev = udev_device_get_parent_with_subsystem_devtype(
-					raw_dev,
-					"usb",
-					"usb_interface");
-			if (intf_dev) {
-				str = udev_device_get_sysattr_value(intf_dev, "bInterfaceNumber");
-				cur_dev->interface_number = (str)? strtol(str, NULL, 16): -1;
-			}
+		case BUS_I2C:
+			info.bus_type = HID_API_BUS_I2C;
+			break;
 
+		case BUS_SPI:
+			info.bus_type = HID_API_BUS_SPI;
 			break;
 
-		case BUS_BLUETOOTH:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
+		case BUS_VIRTUAL:
+			info.bus_type = HID_API_BUS_VIRTUAL;
+			break;
 
-			cur_dev->bus_type = HID_API_BUS_BLUETOOTH;
+		default:
+			/* Filter out unhandled devices right away */
+			goto end;
+	}
 
-			break;
-		case BUS_I2C:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
+	if (filter && (filter->match & HID_API_FILTER_BUS_TYPE) && filter->bus_type != info.bus_type)
+		goto end;
 
-			cur_dev->bus_type = HID_API_BUS_I2C;
+	/* VID/PID */
+	info.vendor_id = dev_vid;
+	info.product_id = dev_pid;
 
-			break;
+	/* Release Number */
+	info.release_number = 0x0;
 
-		case BUS_SPI:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
+	/* Interface Number */
+	info.interface_number = -1;
 
-			cur_dev->bus_type = HID_API_BUS_SPI;
+	if (info.bus_type == HID_API_BUS_USB) {
+		/* The interface (in the USB sense) of the device. */
+		str = ops->get_parent_sysattr(node, "usb", "usb_interface", "bInterfaceNumber");
+		info.interface_number = (str)? strtol(str, NULL, 16): -1;
+	}
 
-			break;
+	if (filter && (filter->match & HID_API_FILTER_INTERFACE_NUMBER) && filter->interface_number != info.interface_number)
+		goto end;
 
-		case BUS_VIRTUAL:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
+	/* Serial Number */
+	if (fields & HID_API_DEVICE_INFO_SERIAL_NUMBER)
+		info.serial_number = utf8_to_wchar_t(serial_number_utf8);
 
-			cur_dev->bus_type = HID_API_BUS_VIRTUAL;
+	if (!enumerate_filter_match_serial_number(filter, info.serial_number))
+		goto end;
 
-			break;
+	/* Manufacturer and Product strings */
+	if (info.bus_type == HID_API_BUS_USB) {
+		if (fields & HID_API_DEVICE_INFO_MANUFACTURER_STRING)
+			info.manufacturer_string = utf8_to_wchar_t(ops->get_parent_sysattr(node, "usb", "usb_device", "manufacturer"));
+		if (fields & HID_API_DEVICE_INFO_PRODUCT_STRING)
+			info.product_string = utf8_to_wchar_t(ops->get_parent_sysattr(node, "usb", "usb_device", "product"));
 
-		default:
-			/* Unknown device type - this should never happen, as we
-			 * check for USB and Bluetooth devices above */
-			break;
+		str = ops->get_parent_sysattr(node, "usb", "usb_device", "bcdDevice");
+		info.release_number = (str)? strtol(str, NULL, 16): 0x0;
+	}
+	else {
+		copy_hid_strings(&info, product_name_utf8, fields);
 	}
 
 	/* Usage Page and Usage */
@@ -803,56 +791,223 @@ static struct hid_device_info * create_device_info_for_device(struct udev_device
 		result = -1;
 	}
 
-	if (result >= 0) {
-		unsigned short page = 0, usage = 0;
-		struct hid_usage_iterator usage_iterator;
-		memset(&usage_iterator, 0, sizeof(usage_iterator));
+	/*
+	 * Parse the usage and usage pages out of the report descriptor,
+	 * and create a record for each usage pair matching the filter.
+	 * Without one, there is a single record with 0/0.
+	 */
+	if (result >= 0)
+		usages = get_hid_usages(&info, &report_desc, &num_usages);
+	if (num_usages == 0) {
+		memset(&no_usage, 0, sizeof(no_usage));
+		usage_pairs = &no_usage;
+		num_usage_pairs = 1;
+	}
+	else {
+		usage_pairs = usages;
+		num_usage_pairs = num_usages;
+	}
+
+	for (i = 0; i < num_usage_pairs; i++) {
+		struct hid_device_info *tmp;
 
-		/*
-		 * Parse the first usage and usage page
-		 * out of the report descriptor.
-		 */
-		if (!get_next_hid_usage(report_desc.value, report_desc.size, &usage_iterator, &page, &usage)) {
-			cur_dev->usage_page = page;
-			cur_dev->usage = usage;
-		}
+		if (!enumerate_filter_match_usage(filter, usage_pairs[i].usage_page, usage_pairs[i].usage))
+			continue;
 
-		/*
-		 * Parse any additional usage and usage pages
-		 * out of the report descriptor.
-		 */
-		while (!get_next_hid_usage(report_desc.value, report_desc.size, &usage_iterator, &page, &usage)) {
-			/* Create new record for additional usage pairs */
-			struct hid_device_info *tmp = (struct hid_device_info*) calloc(1, sizeof(struct hid_device_info));
-			struct hid_device_info *prev_dev = cur_dev;
+		tmp = copy_device_info(&info);
+		if (!tmp)
+			break;
 
-			if (!tmp)
-				break;
-			cur_dev->next = tmp;
-			cur_dev = tmp;
+		tmp->path = dev_path? strdup(dev_path): NULL;
+		tmp->usage_page = usage_pairs[i].usage_page;
+		tmp->usage = usage_pairs[i].usage;
 
-			/* Update fields */
-			cur_dev->path = dev_path? strdup(dev_path): NULL;
-			cur_dev->vendor_id = dev_vid;
-			cur_dev->product_id = dev_pid;
-			cur_dev->serial_number = prev_dev->serial_number? wcsdup(prev_dev->serial_number): NULL;
-			cur_dev->release_number = prev_dev->release_number;
-			cur_dev->interface_number = prev_dev->interface_number;
-			cur_dev->manufacturer_string = prev_dev->manufacturer_string? wcsdup(prev_dev->manufacturer_string): NULL;
-			cur_dev->product_string = prev_dev->product_string? wcsdup(prev_dev->product_string): NULL;
-			cur_dev->usage_page = page;
-			cur_dev->usage = usage;
-			cur_dev->bus_type = prev_dev->bus_type;
+		if (cur_dev) {
+			cur_dev->next = tmp;
+		}
+		else {
+			root = tmp;
 		}
+		cur_dev = tmp;
 	}
 
 end:
+	free(info.serial_number);
+	free(info.manufacturer_string);
+	free(info.product_string);
 	free(serial_number_utf8);
 	free(product_name_utf8);
+	free(usages);
 
 	return root;
 }
 
+static int udev_node_has_parent(void *node, const char *subsystem, const char *devtype)
+{
+	return udev_device_get_parent_with_subsystem_devtype((struct udev_device*) node, subsystem, devtype) != NULL;
+}
+
+static const char *udev_node_get_parent_sysattr(void *node, const char *subsystem, const char *devtype, const char *sysattr)
+{
+	struct udev_device *parent = udev_device_get_parent_with_subsystem_devtype((struct udev_device*) node, subsystem, devtype);
+	return parent? udev_device_get_sysattr_value(parent, sysattr): NULL;
+}
+
+static const struct hidraw_node_ops udev_node_ops = {
+	udev_node_has_parent,
+	udev_node_get_parent_sysattr
+};
+
+/* A hidraw node found by hid_hidraw_enumerate_sysfs() */
+struct sysfs_node {
+	char path[PATH_MAX]; /* with the symlinks resolved */
+
+	/* The parent device looked up last: the attributes of a
+	   parent are read one after the other. */
+	char parent_subsystem[32];
+	char parent_devtype[32];
+	int parent_found;
+	char parent_path[PATH_MAX];
+
+	char value[4096]; /* the attribute value read last */
+};
+
+/* Reads an attribute of the device at dir_fd like libudev does:
+   without the trailing newline. Returns NULL on failure. */
+static const char *read_sysfs_attr(int dir_fd, const char *sysattr, char *buf, size_t buf_size)
+{
+	ssize_t len;
+	int fd = openat(dir_fd, sysattr, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	len = read(fd, buf, buf_size - 1);
+	close(fd);
+	if (len < 0)
+		return NULL;
+
+	while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+		len--;
+	buf[len] = '\0';
+
+	return buf;
+}
+
+/* Returns non-zero if the uevent attribute of the device at dir_fd
+   has the line DEVTYPE=<devtype> */
+static int sysfs_has_devtype(int dir_fd, const char *devtype, char *buf, size_t buf_size)
+{
+	const char *uevent = read_sysfs_attr(dir_fd, "uevent", buf, buf_size);
+	size_t devtype_len = strlen(devtype);
+
+	while (uevent) {
+		if (strncmp(uevent, "DEVTYPE=", 8) == 0 &&
+		    strncmp(uevent + 8, devtype, devtype_len) == 0 &&
+		    (uevent[8 + devtype_len] == '\n' || uevent[8 + devtype_len] == '\0'))
+			return 1;
+
+		uevent = strchr(uevent, '\n');
+		if (uevent)
+			uevent++;
+	}
+
+	return 0;
+}
+
+/* Finds the closest parent of the node with the given subsystem and
+   devtype, going up its path like udev_device_get_parent_with_subsystem_devtype()
+   goes up the device tree. */
+static int sysfs_node_find_parent(struct sysfs_node *node, const char *subsystem, const char *devtype)
+{
+	char link[PATH_MAX];
+
+	if (strcmp(node->parent_subsystem, subsystem) == 0 &&
+	    strcmp(node->parent_devtype, devtype? devtype: "") == 0)
+		return node->parent_found;
+
+	snprintf(node->parent_subsystem, sizeof(node->parent_subsystem), "%s", subsystem);
+	snprintf(node->parent_devtype, sizeof(node->parent_devtype), "%s", devtype? devtype: "");
+	node->parent_found = 0;
+	memcpy(node->parent_path, node->path, sizeof(node->parent_path));
+
+	for (;;) {
+		const char *name;
+		ssize_t len;
+		int dir_fd;
+		char *slash = strrchr(node->parent_path, '/');
+		if (!slash || slash == node->parent_path)
+			break;
+		*slash = '\0';
+
+		dir_fd = open(node->parent_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dir_fd < 0)
+			continue;
+
+		/* "subsystem" links to the directory of the subsystem */
+		len = readlinkat(dir_fd, "subsystem", link, sizeof(link) - 1);
+		if (len > 0) {
+			link[len] = '\0';
+			name = strrchr(link, '/');
+			name = name? name + 1: link;
+
+			if (strcmp(name, subsystem) == 0 &&
+			    (!devtype || sysfs_has_devtype(dir_fd, devtype, node->value, sizeof(node->value)))) {
+				node->parent_found = 1;
+				close(dir_fd);
+				break;
+			}
+		}
+
+		close(dir_fd);
+	}
+
+	return node->parent_found;
+}
+
+static int sysfs_node_has_parent(void *node, const char *subsystem, const char *devtype)
+{
+	return sysfs_node_find_parent((struct sysfs_node*) node, subsystem, devtype);
+}
+
+static const char *sysfs_node_get_parent_sysattr(void *node, const char *subsystem, const char *devtype, const char *sysattr)
+{
+	struct sysfs_node *sysfs_node = (struct sysfs_node*) node;
+	const char *value;
+	int dir_fd;
+
+	if (!sysfs_node_find_parent(sysfs_node, subsystem, devtype))
+		return NULL;
+
+	dir_fd = open(sysfs_node->parent_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd < 0)
+		return NULL;
+
+	value = read_sysfs_attr(dir_fd, sysattr, sysfs_node->value, sizeof(sysfs_node->value));
+	close(dir_fd);
+
+	return value;
+}
+
+static const struct hidraw_node_ops sysfs_node_ops = {
+	sysfs_node_has_parent,
+	sysfs_node_get_parent_sysattr
+};
+
+static int compare_strings(const void *a, const void *b)
+{
+	return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+static struct hid_device_info * create_device_info_for_device(struct udev_device *raw_dev, const struct hid_enumerate_filter *filter)
+{
+	return create_device_info_for_node(
+		udev_device_get_syspath(raw_dev),
+		udev_device_get_devnode(raw_dev),
+		&udev_node_ops,
+		raw_dev,
+		filter);
+}
+
 static struct hid_device_info * create_device_info_for_hid_device(hid_device *dev) {
 	struct udev *udev;
 	struct udev_device *udev_dev;
@@ -880,7 +1035,7 @@ static struct hid_device_info * create_device_info_for_hid_device(hid_device *de
 	/* Open a udev device from the dev_t. 'c' means character device. */
 	udev_dev = udev_device_new_from_devnum(udev, 'c', s.st_rdev);
 	if (udev_dev) {
-		root = create_device_info_for_device(udev_dev);
+		root = create_device_info_for_device(udev_dev, NULL);
 	}
 
 	if (!root) {
@@ -895,170 +1050,993 @@ static struct hid_device_info * create_device_info_for_hid_device(hid_device *de
 	return root;
 }
 
-HID_API_EXPORT const struct hid_api_version* HID_API_CALL hid_version(void)
-{
-	return &api_version;
-}
+/* The enumeration_cache_* functions are called with
+   enumeration_cache_mutex locked. */
 
-HID_API_EXPORT const char* HID_API_CALL hid_version_str(void)
+/* (Re-)probes the hidraw node raw_dev, or drops it from the cache. */
+static void enumeration_cache_update(struct udev_device *raw_dev, int removed)
 {
-	return HID_API_VERSION_STR;
-}
+	struct enumeration_cache_entry **entry_ptr = &enumeration_cache;
+	struct enumeration_cache_entry *entry;
+	const char *syspath = udev_device_get_syspath(raw_dev);
 
-int HID_API_EXPORT hid_init(void)
-{
-	const char *locale;
+	if (!syspath)
+		return;
 
-	/* indicate no error */
-	register_global_error(NULL);
+	while (*entry_ptr && strcmp((*entry_ptr)->syspath, syspath) != 0)
+		entry_ptr = &(*entry_ptr)->next;
+	entry = *entry_ptr;
 
-	/* Set the locale if it's not set. */
-	locale = setlocale(LC_CTYPE, NULL);
-	if (!locale)
-		setlocale(LC_CTYPE, "");
+	if (entry) {
+		hid_free_enumeration(entry->info);
+		entry->info = NULL;
 
-	return 0;
+		if (removed) {
+			*entry_ptr = entry->next;
+			free(entry->syspath);
+			free(entry);
+			return;
+		}
+	}
+	else {
+		if (removed)
+			return;
+
+		entry = (struct enumeration_cache_entry*) calloc(1, sizeof(struct enumeration_cache_entry));
+		if (!entry)
+			return;
+		entry->syspath = strdup(syspath);
+		if (!entry->syspath) {
+			free(entry);
+			return;
+		}
+
+		/* New nodes are added at the end, so the records are
+		   listed in the order the nodes were discovered. */
+		*entry_ptr = entry;
+	}
+
+	entry->info = create_device_info_for_device(raw_dev, NULL);
 }
 
-int HID_API_EXPORT hid_exit(void)
+static void enumeration_cache_clear(void)
 {
-	/* Free global error message */
-	register_global_error(NULL);
-
-	return 0;
+	while (enumeration_cache) {
+		struct enumeration_cache_entry *next = enumeration_cache->next;
+		hid_free_enumeration(enumeration_cache->info);
+		free(enumeration_cache->syspath);
+		free(enumeration_cache);
+		enumeration_cache = next;
+	}
 }
 
-struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+static void enumeration_cache_scan(void)
 {
-	struct udev *udev;
 	struct udev_enumerate *enumerate;
 	struct udev_list_entry *devices, *dev_list_entry;
 
-	struct hid_device_info *root = NULL; /* return object */
-	struct hid_device_info *cur_dev = NULL;
+	enumeration_cache_clear();
 
-	hid_init();
-	/* register_global_error: global error is reset by hid_init */
+	enumerate = udev_enumerate_new(enumeration_cache_udev);
+	if (!enumerate)
+		return;
+
+	udev_enumerate_add_match_subsystem(enumerate, "hidraw");
+	udev_enumerate_scan_devices(enumerate);
+	devices = udev_enumerate_get_list_entry(enumerate);
+	udev_list_entry_foreach(dev_list_entry, devices) {
+		struct udev_device *raw_dev;
+		const char *sysfs_path = udev_list_entry_get_name(dev_list_entry);
+		if (!sysfs_path)
+			continue;
+
+		raw_dev = udev_device_new_from_syspath(enumeration_cache_udev, sysfs_path);
+		if (!raw_dev)
+			continue;
+
+		enumeration_cache_update(raw_dev, 0);
+		udev_device_unref(raw_dev);
+	}
+
+	udev_enumerate_unref(enumerate);
+}
+
+/* Applies the udev events received since the previous call,
+   so only the nodes which were added, changed or removed are probed. */
+static void enumeration_cache_process_events(void)
+{
+	struct pollfd fds;
+	int rescan = 0;
+
+	fds.fd = udev_monitor_get_fd(enumeration_cache_monitor);
+	fds.events = POLLIN;
+
+	for (;;) {
+		struct udev_device *raw_dev;
+		const char *action;
+
+		fds.revents = 0;
+		if (poll(&fds, 1, 0) <= 0 || !(fds.revents & (POLLIN | POLLERR)))
+			break;
+
+		if (fds.revents & POLLERR) {
+			/* The socket buffer overflowed and events were lost.
+			   Receiving clears the error; the cache is rebuilt
+			   once the remaining events are drained. */
+			rescan = 1;
+		}
+
+		raw_dev = udev_monitor_receive_device(enumeration_cache_monitor);
+		if (!raw_dev)
+			continue;
+
+		action = udev_device_get_action(raw_dev);
+		if (!rescan)
+			enumeration_cache_update(raw_dev, action && strcmp(action, "remove") == 0);
+		udev_device_unref(raw_dev);
+	}
+
+	if (rescan)
+		enumeration_cache_scan();
+}
+
+static struct hid_device_info *enumeration_cache_copy(const struct hid_enumerate_filter *filter)
+{
+	struct enumeration_cache_entry *entry;
+	struct hid_device_info *info;
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur_dev = NULL;
+
+	for (entry = enumeration_cache; entry; entry = entry->next) {
+		for (info = entry->info; info; info = info->next) {
+			struct hid_device_info *tmp;
+
+			if (!enumerate_filter_match(filter, info))
+				continue;
+
+			tmp = copy_device_info(info);
+			if (!tmp) {
+				hid_free_enumeration(root);
+				return NULL;
+			}
+
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
+			}
+			cur_dev = tmp;
+		}
+	}
+
+	return root;
+}
+
+static void enumeration_cache_disable(void)
+{
+	enumeration_cache_clear();
+
+	if (enumeration_cache_monitor) {
+		udev_monitor_unref(enumeration_cache_monitor);
+		enumeration_cache_monitor = NULL;
+	}
+	if (enumeration_cache_udev) {
+		udev_unref(enumeration_cache_udev);
+		enumeration_cache_udev = NULL;
+	}
+}
+
+/* Called by the functions of core/hidapi_hotplug.c */
+static void hotplug_lock(void)
+{
+	pthread_mutex_lock(&hotplug_mutex);
+}
+
+static void hotplug_unlock(void)
+{
+	pthread_mutex_unlock(&hotplug_mutex);
+}
+
+static void hotplug_process_event(struct udev_device *raw_dev)
+{
+	const char *action = udev_device_get_action(raw_dev);
+
+	if (action && strcmp(action, "remove") == 0) {
+		/* The node is gone from sysfs already: its records
+		   are the ones kept since it arrived. */
+		const char *dev_path = udev_device_get_devnode(raw_dev);
+		struct hid_device_info **info_ptr = &hotplug_devices;
+
+		if (!dev_path)
+			return;
+
+		while (*info_ptr) {
+			struct hid_device_info *info = *info_ptr;
+			if (info->path && strcmp(info->path, dev_path) == 0) {
+				*info_ptr = info->next;
+				info->next = NULL;
+				hotplug_dispatch(hotplug_callbacks, info, HID_API_HOTPLUG_EVENT_DEVICE_LEFT);
+				hid_free_enumeration(info);
+			}
+			else {
+				info_ptr = &info->next;
+			}
+		}
+	}
+	else {
+		struct hid_device_info *infos = create_device_info_for_device(raw_dev, NULL);
+
+		while (infos) {
+			struct hid_device_info *info = infos;
+			struct hid_device_info **info_ptr = &hotplug_devices;
+			infos = info->next;
+			info->next = NULL;
+
+			/* Skip the records of the nodes already known, e.g. from
+			   the scan done when the monitor was started */
+			while (*info_ptr && !((*info_ptr)->path && info->path && strcmp((*info_ptr)->path, info->path) == 0 &&
+			                      (*info_ptr)->usage_page == info->usage_page && (*info_ptr)->usage == info->usage))
+				info_ptr = &(*info_ptr)->next;
+			if (*info_ptr) {
+				hid_free_enumeration(info);
+				continue;
+			}
+
+			*info_ptr = info;
+			hotplug_dispatch(hotplug_callbacks, info, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED);
+		}
+	}
+}
+
+static void *hotplug_thread_func(void *param)
+{
+	struct pollfd fds[2];
+	char buf[16];
+
+	(void)param;
+
+	fds[0].fd = udev_monitor_get_fd(hotplug_monitor);
+	fds[0].events = POLLIN;
+	fds[1].fd = hotplug_thread_pipe[0];
+	fds[1].events = POLLIN;
+
+	pthread_mutex_lock(&hotplug_mutex);
+
+	while (!hotplug_thread_shutdown) {
+		int ret;
+
+		hotplug_enumerate(hotplug_callbacks, hotplug_devices);
+		hotplug_remove_deregistered(&hotplug_callbacks);
+
+		pthread_mutex_unlock(&hotplug_mutex);
+
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		ret = poll(fds, 2, -1);
+
+		if (ret > 0 && fds[1].revents) {
+			/* Woken up by hid_hotplug_register_callback(),
+			   hid_hotplug_deregister_callback() or hid_exit() */
+			while (read(hotplug_thread_pipe[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		pthread_mutex_lock(&hotplug_mutex);
+
+		if (ret > 0 && (fds[0].revents & POLLIN) && !hotplug_thread_shutdown) {
+			struct udev_device *raw_dev = udev_monitor_receive_device(hotplug_monitor);
+			if (raw_dev) {
+				hotplug_process_event(raw_dev);
+				udev_device_unref(raw_dev);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&hotplug_mutex);
+
+	return NULL;
+}
+
+static void hotplug_wake_thread(void)
+{
+	/* The pipe is non-blocking: if it is full,
+	   the thread is going to wake up anyway. */
+	ssize_t bytes_written = write(hotplug_thread_pipe[1], "", 1);
+	(void)bytes_written;
+}
+
+static void hotplug_cleanup(void)
+{
+	while (hotplug_callbacks) {
+		struct hid_hotplug_callback *next = hotplug_callbacks->next;
+		free(hotplug_callbacks);
+		hotplug_callbacks = next;
+	}
+
+	hid_free_enumeration(hotplug_devices);
+	hotplug_devices = NULL;
+
+	if (hotplug_monitor) {
+		udev_monitor_unref(hotplug_monitor);
+		hotplug_monitor = NULL;
+	}
+	if (hotplug_udev) {
+		udev_unref(hotplug_udev);
+		hotplug_udev = NULL;
+	}
+}
+
+static int hotplug_start(void)
+{
+	int res;
+
+	hotplug_udev = udev_new();
+	if (hotplug_udev)
+		hotplug_monitor = udev_monitor_new_from_netlink(hotplug_udev, "udev");
+
+	if (!hotplug_monitor ||
+	    udev_monitor_filter_add_match_subsystem_devtype(hotplug_monitor, "hidraw", NULL) < 0 ||
+	    udev_monitor_enable_receiving(hotplug_monitor) < 0) {
+		register_global_error("Couldn't create udev monitor");
+		hotplug_cleanup();
+		return -1;
+	}
+
+	if (pipe(hotplug_thread_pipe) == -1) {
+		register_global_error_format("hid_hotplug_register_callback: pipe: %s", strerror(errno));
+		hotplug_cleanup();
+		return -1;
+	}
+	fcntl(hotplug_thread_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(hotplug_thread_pipe[1], F_SETFL, O_NONBLOCK);
+
+	/* The monitor is started before the scan, so no device is missed.
+	   A node which is seen by both is only reported once. */
+	hotplug_devices = hid_enumerate(0, 0);
+	register_global_error(NULL);
+
+	hotplug_thread_shutdown = 0;
+	res = pthread_create(&hotplug_thread, NULL, hotplug_thread_func, NULL);
+	if (res != 0) {
+		close(hotplug_thread_pipe[0]);
+		close(hotplug_thread_pipe[1]);
+		errno = res;
+		register_global_error_format("hid_hotplug_register_callback: pthread_create: %s", strerror(res));
+		hotplug_cleanup();
+		return -1;
+	}
+	hotplug_thread_running = 1;
+
+	return 0;
+}
+
+static void hotplug_stop(void)
+{
+	pthread_mutex_lock(&hotplug_mutex);
+
+	if (!hotplug_thread_running) {
+		pthread_mutex_unlock(&hotplug_mutex);
+		return;
+	}
+
+	hotplug_thread_shutdown = 1;
+	hotplug_wake_thread();
+	pthread_mutex_unlock(&hotplug_mutex);
+
+	pthread_join(hotplug_thread, NULL);
+
+	pthread_mutex_lock(&hotplug_mutex);
+	close(hotplug_thread_pipe[0]);
+	close(hotplug_thread_pipe[1]);
+	hotplug_thread_running = 0;
+	hotplug_cleanup();
+	pthread_mutex_unlock(&hotplug_mutex);
+}
+
+HID_API_EXPORT const struct hid_api_version* HID_API_CALL hid_version(void)
+{
+	return &api_version;
+}
+
+HID_API_EXPORT const char* HID_API_CALL hid_version_str(void)
+{
+	return HID_API_VERSION_STR;
+}
+
+int HID_API_EXPORT hid_init(void)
+{
+	const char *locale;
+
+	/* indicate no error */
+	register_global_error(NULL);
+
+	/* Set the locale if it's not set. */
+	locale = setlocale(LC_CTYPE, NULL);
+	if (!locale)
+		setlocale(LC_CTYPE, "");
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_exit(void)
+{
+	hotplug_stop();
+
+	pthread_mutex_lock(&enumeration_cache_mutex);
+	enumeration_cache_disable();
+	pthread_mutex_unlock(&enumeration_cache_mutex);
+
+	report_descriptor_cache_disable();
+
+	/* Free global error message */
+	register_global_error(NULL);
+
+	return 0;
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	return hid_enumerate_fields(vendor_id, product_id, HID_API_DEVICE_INFO_ALL_STRINGS);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_fields(unsigned short vendor_id, unsigned short product_id, int fields)
+{
+	struct hid_enumerate_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.fields = fields;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_ex(const struct hid_enumerate_filter *filter)
+{
+	struct udev *udev;
+	struct udev_enumerate *enumerate;
+	struct udev_list_entry *devices, *dev_list_entry;
+
+	struct hid_device_info *root = NULL; /* return object */
+	struct hid_device_info *cur_dev = NULL;
+
+	hid_init();
+	/* register_global_error: global error is reset by hid_init */
+
+	if (!filter) {
+		register_global_error("hid_enumerate_ex: filter is NULL");
+		return NULL;
+	}
+
+	pthread_mutex_lock(&enumeration_cache_mutex);
+	if (enumeration_cache_monitor) {
+		enumeration_cache_process_events();
+		root = enumeration_cache_copy(filter);
+		pthread_mutex_unlock(&enumeration_cache_mutex);
+		goto end;
+	}
+	pthread_mutex_unlock(&enumeration_cache_mutex);
 
 	/* Create the udev object */
 	udev = udev_new();
 	if (!udev) {
-		register_global_error("Couldn't create udev context");
+		register_global_error("Couldn't create udev context");
+		return NULL;
+	}
+
+	/* Create a list of the devices in the 'hidraw' subsystem. */
+	enumerate = udev_enumerate_new(udev);
+	udev_enumerate_add_match_subsystem(enumerate, "hidraw");
+	udev_enumerate_scan_devices(enumerate);
+	devices = udev_enumerate_get_list_entry(enumerate);
+	/* For each item, see if it matches the vid/pid, and if so
+	   create a udev_device record for it */
+	udev_list_entry_foreach(dev_list_entry, devices) {
+		const char *sysfs_path;
+		unsigned short dev_vid = 0;
+		unsigned short dev_pid = 0;
+		unsigned bus_type = 0;
+		struct udev_device *raw_dev; /* The device's hidraw udev node. */
+		struct hid_device_info * tmp;
+
+		/* Get the filename of the /sys entry for the device
+		   and create a udev_device object (dev) representing it */
+		sysfs_path = udev_list_entry_get_name(dev_list_entry);
+		if (!sysfs_path)
+			continue;
+
+		if (filter->vendor_id != 0 || filter->product_id != 0) {
+			if (!parse_hid_vid_pid_from_sysfs(sysfs_path, &bus_type, &dev_vid, &dev_pid))
+				continue;
+
+			if (filter->vendor_id != 0 && filter->vendor_id != dev_vid)
+				continue;
+			if (filter->product_id != 0 && filter->product_id != dev_pid)
+				continue;
+		}
+
+		raw_dev = udev_device_new_from_syspath(udev, sysfs_path);
+		if (!raw_dev)
+			continue;
+
+		tmp = create_device_info_for_device(raw_dev, filter);
+		if (tmp) {
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
+			}
+			cur_dev = tmp;
+
+			/* move the pointer to the tail of returned list */
+			while (cur_dev->next != NULL) {
+				cur_dev = cur_dev->next;
+			}
+		}
+
+		udev_device_unref(raw_dev);
+	}
+	/* Free the enumerator and udev objects. */
+	udev_enumerate_unref(enumerate);
+	udev_unref(udev);
+
+end:
+	if (root == NULL) {
+		if (filter->match != 0 || filter->serial_number_prefix) {
+			register_global_error("No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
+			register_global_error("No HID devices found in the system.");
+		} else {
+			register_global_error("No HID devices with requested VID/PID found in the system.");
+		}
+	}
+
+	return root;
+}
+
+struct hid_device_info *hid_hidraw_enumerate_sysfs(const char *sysfs_root, unsigned short vendor_id, unsigned short product_id)
+{
+	char class_path[PATH_MAX];
+	char link_path[PATH_MAX];
+	int class_fd;
+	DIR *class_dir;
+	struct dirent *entry;
+	char **node_paths = NULL;
+	size_t num_nodes = 0;
+	size_t nodes_capacity = 0;
+	size_t i;
+	struct sysfs_node *node;
+
+	struct hid_device_info *root = NULL; /* return object */
+	struct hid_device_info *cur_dev = NULL;
+
+	hid_init();
+	/* register_global_error: global error is reset by hid_init */
+
+	if (!sysfs_root)
+		sysfs_root = "/sys";
+
+	snprintf(class_path, sizeof(class_path), "%s/class/hidraw", sysfs_root);
+	class_fd = open(class_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (class_fd < 0) {
+		register_global_error_format("open failed (%s): %s", class_path, strerror(errno));
+		return NULL;
+	}
+
+	class_dir = fdopendir(class_fd);
+	if (!class_dir) {
+		register_global_error_format("fdopendir failed (%s): %s", class_path, strerror(errno));
+		close(class_fd);
+		return NULL;
+	}
+
+	/* The entries of the class directory link to the nodes in the device tree */
+	while ((entry = readdir(class_dir)) != NULL) {
+		char *node_path;
+
+		if (entry->d_name[0] == '.')
+			continue;
+
+		if (snprintf(link_path, sizeof(link_path), "%s/%s", class_path, entry->d_name) >= (int) sizeof(link_path))
+			continue;
+		node_path = realpath(link_path, NULL);
+		if (!node_path)
+			continue;
+
+		if (num_nodes == nodes_capacity) {
+			size_t new_capacity = nodes_capacity? nodes_capacity * 2: 64;
+			char **new_paths = (char**) realloc(node_paths, new_capacity * sizeof(char*));
+			if (!new_paths) {
+				free(node_path);
+				break;
+			}
+			node_paths = new_paths;
+			nodes_capacity = new_capacity;
+		}
+		node_paths[num_nodes++] = node_path;
+	}
+	closedir(class_dir);
+
+	/* Same order as udev_enumerate_get_list_entry(): sorted by syspath */
+	if (num_nodes > 0)
+		qsort(node_paths, num_nodes, sizeof(char*), compare_strings);
+
+	node = (struct sysfs_node*) malloc(sizeof(struct sysfs_node));
+
+	for (i = 0; node && i < num_nodes; i++) {
+		const char *sysfs_path = node_paths[i];
+		unsigned short dev_vid = 0;
+		unsigned short dev_pid = 0;
+		unsigned bus_type = 0;
+		const char *str;
+		char dev_path[PATH_MAX];
+		int has_dev_path = 0;
+		int dir_fd;
+		struct hid_device_info *tmp;
+
+		if (vendor_id != 0 || product_id != 0) {
+			if (!parse_hid_vid_pid_from_sysfs(sysfs_path, &bus_type, &dev_vid, &dev_pid))
+				continue;
+
+			if (vendor_id != 0 && vendor_id != dev_vid)
+				continue;
+			if (product_id != 0 && product_id != dev_pid)
+				continue;
+		}
+
+		if (strlen(sysfs_path) >= sizeof(node->path))
+			continue;
+		memcpy(node->path, sysfs_path, strlen(sysfs_path) + 1);
+		node->parent_subsystem[0] = '\0';
+		node->parent_devtype[0] = '\0';
+		node->parent_found = 0;
+
+		/* The device node, as libudev gets it: /dev/<DEVNAME> */
+		dir_fd = open(sysfs_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dir_fd < 0)
+			continue;
+		str = read_sysfs_attr(dir_fd, "uevent", node->value, sizeof(node->value));
+		close(dir_fd);
+		while (str) {
+			if (strncmp(str, "DEVNAME=", 8) == 0) {
+				size_t len = strcspn(str + 8, "\n");
+				if (len + 6 <= sizeof(dev_path)) {
+					snprintf(dev_path, sizeof(dev_path), "/dev/%.*s", (int) len, str + 8);
+					has_dev_path = 1;
+				}
+				break;
+			}
+			str = strchr(str, '\n');
+			if (str)
+				str++;
+		}
+
+		tmp = create_device_info_for_node(sysfs_path, has_dev_path? dev_path: NULL, &sysfs_node_ops, node, NULL);
+		if (tmp) {
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
+			}
+			cur_dev = tmp;
+
+			/* move the pointer to the tail of returned list */
+			while (cur_dev->next != NULL) {
+				cur_dev = cur_dev->next;
+			}
+		}
+	}
+
+	free(node);
+	for (i = 0; i < num_nodes; i++)
+		free(node_paths[i]);
+	free(node_paths);
+
+	if (root == NULL) {
+		if (vendor_id == 0 && product_id == 0) {
+			register_global_error("No HID devices found in the system.");
+		} else {
+			register_global_error("No HID devices with requested VID/PID found in the system.");
+		}
+	}
+
+	return root;
+}
+
+void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+{
+	struct hid_device_info *d = devs;
+	while (d) {
+		struct hid_device_info *next = d->next;
+		free(d->path);
+		free(d->serial_number);
+		free(d->manufacturer_string);
+		free(d->product_string);
+		free(d);
+		d = next;
+	}
+}
+
+int HID_API_EXPORT hid_set_enumeration_cache(int enable)
+{
+	int res = 0;
+
+	register_global_error(NULL);
+
+	pthread_mutex_lock(&enumeration_cache_mutex);
+
+	if (!enable) {
+		enumeration_cache_disable();
+	}
+	else if (!enumeration_cache_monitor) {
+		enumeration_cache_udev = udev_new();
+		if (enumeration_cache_udev)
+			enumeration_cache_monitor = udev_monitor_new_from_netlink(enumeration_cache_udev, "udev");
+
+		if (!enumeration_cache_monitor ||
+		    udev_monitor_filter_add_match_subsystem_devtype(enumeration_cache_monitor, "hidraw", NULL) < 0 ||
+		    udev_monitor_enable_receiving(enumeration_cache_monitor) < 0) {
+			register_global_error("Couldn't create udev monitor");
+			enumeration_cache_disable();
+			res = -1;
+		}
+		else {
+			/* The monitor is started before the scan, so the nodes
+			   which are added or removed meanwhile are probed again
+			   by the next hid_enumerate(). */
+			enumeration_cache_scan();
+		}
+	}
+
+	pthread_mutex_unlock(&enumeration_cache_mutex);
+
+	return res;
+}
+
+int HID_API_EXPORT hid_set_report_descriptor_cache(int enable, const char *path)
+{
+	char *path_copy = NULL;
+	int res = 0;
+
+	hid_init();
+	/* register_global_error: global error is reset by hid_init */
+
+	if (!enable) {
+		report_descriptor_cache_disable();
+		return 0;
+	}
+
+	if (path) {
+		path_copy = strdup(path);
+		if (!path_copy) {
+			register_global_error("hid_set_report_descriptor_cache: Couldn't allocate memory");
+			return -1;
+		}
+	}
+
+	pthread_mutex_lock(&report_descriptor_cache_mutex);
+	if (report_descriptor_cache_enabled) {
+		/* Only the file changes, the cached descriptors are kept */
+		free(report_descriptor_cache_path);
+	}
+	report_descriptor_cache_enabled = 1;
+	report_descriptor_cache_path = path_copy;
+	if (path_copy)
+		res = report_descriptor_cache_load(path_copy);
+	pthread_mutex_unlock(&report_descriptor_cache_mutex);
+
+	if (res < 0) {
+		register_global_error_format("hid_set_report_descriptor_cache: Couldn't read %s", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+	struct hid_hotplug_callback **hotplug_cb_ptr;
+
+	register_global_error(NULL);
+
+	if (!callback ||
+	    !(events & (HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED | HID_API_HOTPLUG_EVENT_DEVICE_LEFT)) ||
+	    (events & ~(HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED | HID_API_HOTPLUG_EVENT_DEVICE_LEFT)) ||
+	    (flags & ~HID_API_HOTPLUG_ENUMERATE)) {
+		register_global_error("hid_hotplug_register_callback: invalid argument");
+		return -1;
+	}
+
+	hotplug_cb = (struct hid_hotplug_callback*) calloc(1, sizeof(struct hid_hotplug_callback));
+	if (!hotplug_cb) {
+		register_global_error("hid_hotplug_register_callback: couldn't allocate memory");
+		return -1;
+	}
+
+	hotplug_cb->vendor_id = vendor_id;
+	hotplug_cb->product_id = product_id;
+	hotplug_cb->events = events;
+	hotplug_cb->enumerate = (flags & HID_API_HOTPLUG_ENUMERATE) != 0;
+	hotplug_cb->callback = callback;
+	hotplug_cb->user_data = user_data;
+
+	pthread_mutex_lock(&hotplug_mutex);
+
+	if (!hotplug_thread_running && hotplug_start() < 0) {
+		/* register_global_error: global error is set by hotplug_start */
+		pthread_mutex_unlock(&hotplug_mutex);
+		free(hotplug_cb);
+		return -1;
+	}
+
+	hotplug_cb->handle = hotplug_next_handle++;
+	if (hotplug_next_handle == INT_MAX)
+		hotplug_next_handle = 1;
+
+	/* Callbacks are called in the order they were registered */
+	for (hotplug_cb_ptr = &hotplug_callbacks; *hotplug_cb_ptr; hotplug_cb_ptr = &(*hotplug_cb_ptr)->next)
+		;
+	*hotplug_cb_ptr = hotplug_cb;
+
+	if (hotplug_cb->enumerate)
+		hotplug_wake_thread();
+
+	if (callback_handle)
+		*callback_handle = hotplug_cb->handle;
+
+	pthread_mutex_unlock(&hotplug_mutex);
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+
+	register_global_error(NULL);
+
+	pthread_mutex_lock(&hotplug_mutex);
+
+	for (hotplug_cb = hotplug_callbacks; hotplug_cb; hotplug_cb = hotplug_cb->next) {
+		if (hotplug_cb->handle == callback_handle && hotplug_cb->events != 0)
+			break;
+	}
+
+	if (!hotplug_cb) {
+		pthread_mutex_unlock(&hotplug_mutex);
+		register_global_error("hid_hotplug_deregister_callback: no such callback");
+		return -1;
+	}
+
+	/* The hotplug thread frees it */
+	hotplug_cb->events = 0;
+	hotplug_wake_thread();
+
+	pthread_mutex_unlock(&hotplug_mutex);
+
+	return 0;
+}
+
+/* Returns non-zero if a device on the bus is listed by hid_enumerate() */
+static int is_bus_type_handled(unsigned bus_type)
+{
+	switch (bus_type) {
+		case BUS_USB:
+		case BUS_BLUETOOTH:
+		case BUS_I2C:
+		case BUS_SPI:
+		case BUS_VIRTUAL:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* Returns the path of the first hidraw node with the VID/PID and serial
+   number (NULL for any), the one hid_enumerate() would list first,
+   or NULL. The nodes are looked at one at a time, and only until one
+   matches: the serial number is compared as the kernel reports it
+   (HID_UNIQ of the uevent of the hid device), to the requested one
+   converted once, and no other string nor report descriptor is read. */
+static char *find_device_path(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+{
+	struct udev *udev;
+	struct udev_enumerate *enumerate;
+	struct udev_list_entry *devices, *dev_list_entry;
+	char *serial_number_mb = NULL;
+	char *path = NULL;
+
+	if (serial_number) {
+		size_t len = wcstombs(NULL, serial_number, 0);
+		if (len == (size_t) -1) {
+			/* Not representable in the locale the serial numbers of the
+			   devices are converted with, so none of them can match */
+			return NULL;
+		}
+		serial_number_mb = (char*) malloc(len + 1);
+		if (!serial_number_mb)
+			return NULL;
+		wcstombs(serial_number_mb, serial_number, len + 1);
+	}
+
+	udev = udev_new();
+	if (!udev) {
+		free(serial_number_mb);
 		return NULL;
 	}
 
-	/* Create a list of the devices in the 'hidraw' subsystem. */
 	enumerate = udev_enumerate_new(udev);
 	udev_enumerate_add_match_subsystem(enumerate, "hidraw");
 	udev_enumerate_scan_devices(enumerate);
 	devices = udev_enumerate_get_list_entry(enumerate);
-	/* For each item, see if it matches the vid/pid, and if so
-	   create a udev_device record for it */
 	udev_list_entry_foreach(dev_list_entry, devices) {
 		const char *sysfs_path;
 		unsigned short dev_vid = 0;
 		unsigned short dev_pid = 0;
 		unsigned bus_type = 0;
 		struct udev_device *raw_dev; /* The device's hidraw udev node. */
-		struct hid_device_info * tmp;
+		struct udev_device *hid_dev;
+		char *serial_number_utf8 = NULL;
+		char *product_name_utf8 = NULL;
+		int match;
 
-		/* Get the filename of the /sys entry for the device
-		   and create a udev_device object (dev) representing it */
 		sysfs_path = udev_list_entry_get_name(dev_list_entry);
 		if (!sysfs_path)
 			continue;
 
-		if (vendor_id != 0 || product_id != 0) {
-			if (!parse_hid_vid_pid_from_sysfs(sysfs_path, &bus_type, &dev_vid, &dev_pid))
-				continue;
+		if (!parse_hid_vid_pid_from_sysfs(sysfs_path, &bus_type, &dev_vid, &dev_pid))
+			continue;
 
-			if (vendor_id != 0 && vendor_id != dev_vid)
-				continue;
-			if (product_id != 0 && product_id != dev_pid)
-				continue;
-		}
+		if (dev_vid != vendor_id || dev_pid != product_id || !is_bus_type_handled(bus_type))
+			continue;
 
 		raw_dev = udev_device_new_from_syspath(udev, sysfs_path);
 		if (!raw_dev)
 			continue;
 
-		tmp = create_device_info_for_device(raw_dev);
-		if (tmp) {
-			if (cur_dev) {
-				cur_dev->next = tmp;
-			}
-			else {
-				root = tmp;
-			}
-			cur_dev = tmp;
+		hid_dev = udev_device_get_parent_with_subsystem_devtype(raw_dev, "hid", NULL);
+		match = hid_dev && parse_uevent_info(
+			udev_device_get_sysattr_value(hid_dev, "uevent"),
+			&bus_type,
+			&dev_vid,
+			&dev_pid,
+			&serial_number_utf8,
+			&product_name_utf8);
 
-			/* move the pointer to the tail of returned list */
-			while (cur_dev->next != NULL) {
-				cur_dev = cur_dev->next;
-			}
-		}
+		if (match && serial_number_mb)
+			match = strcmp(serial_number_mb, serial_number_utf8) == 0;
+
+		if (match && udev_device_get_devnode(raw_dev))
+			path = strdup(udev_device_get_devnode(raw_dev));
 
+		free(serial_number_utf8);
+		free(product_name_utf8);
 		udev_device_unref(raw_dev);
-	}
-	/* Free the enumerator and udev objects. */
-	udev_enumerate_unref(enumerate);
-	udev_unref(udev);
 
-	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
-			register_global_error("No HID devices found in the system.");
-		} else {
-			register_global_error("No HID devices with requested VID/PID found in the system.");
-		}
+		if (path)
+			break;
 	}
 
-	return root;
-}
+	udev_enumerate_unref(enumerate);
+	udev_unref(udev);
+	free(serial_number_mb);
 
-void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
-{
-	struct hid_device_info *d = devs;
-	while (d) {
-		struct hid_device_info *next = d->next;
-		free(d->path);
-		free(d->serial_number);
-		free(d->manufacturer_string);
-		free(d->product_string);
-		free(d);
-		d = next;
-	}
+	return path;
 }
 
 hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
 {
-	struct hid_device_info *devs, *cur_dev;
-	const char *path_to_open = NULL;
+	char *path_to_open;
 	hid_device *handle = NULL;
 
-	/* register_global_error: global error is reset by hid_enumerate/hid_init */
-	devs = hid_enumerate(vendor_id, product_id);
-	if (devs == NULL) {
-		/* register_global_error: global error is already set by hid_enumerate */
-		return NULL;
-	}
+	hid_init();
+	/* register_global_error: global error is reset by hid_init */
 
-	cur_dev = devs;
-	while (cur_dev) {
-		if (cur_dev->vendor_id == vendor_id &&
-		    cur_dev->product_id == product_id) {
-			if (serial_number) {
-				if (wcscmp(serial_number, cur_dev->serial_number) == 0) {
-					path_to_open = cur_dev->path;
-					break;
-				}
-			}
-			else {
-				path_to_open = cur_dev->path;
-				break;
-			}
-		}
-		cur_dev = cur_dev->next;
-	}
+	path_to_open = find_device_path(vendor_id, product_id, serial_number);
 
 	if (path_to_open) {
 		/* Open the device */
@@ -1067,7 +2045,7 @@ hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const
 		register_global_error("Device with requested VID/PID/(SerialNumber) not found");
 	}
 
-	hid_free_enumeration(devs);
+	free(path_to_open);
 
 	return handle;
 }
@@ -1147,7 +2125,7 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 		   and wait for data to arrive.  Don't rely on non-blocking
 		   operation (O_NONBLOCK) since some kernels don't seem to
 		   properly report device disconnection through read() when
-		   in non-blocking mode.  */
+		   in non-blocking mode. */
 		int ret;
 		struct pollfd fds;
 
@@ -1187,6 +2165,76 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 	return bytes_read;
 }
 
+int HID_API_EXPORT hid_read_timestamped(hid_device *dev, unsigned char *data, size_t length, int milliseconds, uint64_t *timestamp)
+{
+	int bytes_read = hid_read_timeout(dev, data, length, milliseconds);
+
+	/* The kernel doesn't tell when it queued the report,
+	   so this is as close as it gets */
+	if (bytes_read > 0 && timestamp)
+		*timestamp = get_timestamp();
+
+	return bytes_read;
+}
+
+int HID_API_EXPORT hid_read_many(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds)
+{
+	size_t i;
+	ssize_t bytes_read;
+	struct pollfd fds;
+
+	if (!reports || count == 0) {
+		errno = EINVAL;
+		register_error_str(&dev->last_read_error_str, "Zero buffer/length");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!reports[i].data || reports[i].length == 0) {
+			errno = EINVAL;
+			register_error_str(&dev->last_read_error_str, "Zero buffer/length");
+			return -1;
+		}
+	}
+
+	/* The count of reports read is returned as an int */
+	if (count > INT_MAX)
+		count = INT_MAX;
+
+	/* The first report is waited for with poll(), like any other read */
+	bytes_read = hid_read_timeout(dev, reports[0].data, reports[0].length, milliseconds);
+	if (bytes_read <= 0)
+		return (int)bytes_read;
+	reports[0].bytes_read = (size_t)bytes_read;
+	reports[0].timestamp = get_timestamp();
+
+	if (count == 1)
+		return 1;
+
+	/* The rest of the reports are only taken if the kernel already
+	   has them queued, which a poll() without a timeout tells.
+	   The file status flags of the device are left alone. */
+	fds.fd = dev->device_handle;
+	fds.events = POLLIN;
+
+	for (i = 1; i < count; i++) {
+		fds.revents = 0;
+		if (poll(&fds, 1, 0) != 1 || (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) || !(fds.revents & POLLIN)) {
+			/* Nothing more is queued, or an error,
+			   which the next read will run into and report */
+			break;
+		}
+
+		bytes_read = read(dev->device_handle, reports[i].data, reports[i].length);
+		if (bytes_read < 0)
+			break;
+		reports[i].bytes_read = (size_t)bytes_read;
+		reports[i].timestamp = get_timestamp();
+	}
+
+	return (int)i;
+}
+
 int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
@@ -1210,6 +2258,156 @@ int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 }
 
 
+int HID_API_EXPORT hid_set_input_queue(hid_device *dev, size_t max_reports, hid_input_queue_policy policy)
+{
+	(void)max_reports;
+	(void)policy;
+
+	/* Input reports are queued by the hidraw kernel driver,
+	   in a queue of fixed size */
+	errno = ENOSYS;
+	register_device_error(dev, "hid_set_input_queue: not supported by hidraw");
+
+	return -1;
+}
+
+
+/* hidraw returns at most this many bytes per report
+   (HID_MAX_BUFFER_SIZE in the kernel) */
+#define HIDAPI_MAX_HIDRAW_REPORT_SIZE 16384
+
+static void *input_callback_thread(void *param)
+{
+	hid_device *dev = (hid_device*) param;
+	unsigned char *buf;
+	struct pollfd fds[2];
+	ssize_t bytes_read;
+	int ret;
+
+	buf = (unsigned char*) malloc(HIDAPI_MAX_HIDRAW_REPORT_SIZE);
+	if (!buf)
+		return NULL;
+
+	fds[0].fd = dev->device_handle;
+	fds[0].events = POLLIN;
+	fds[1].fd = dev->input_thread_pipe[0];
+	fds[1].events = POLLIN;
+
+	while (1) {
+		/* Wait in poll() rather than in read(), see hid_read_timeout() */
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		ret = poll(fds, 2, -1);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[1].revents) {
+			/* Stopped by hid_set_input_callback() or hid_close() */
+			break;
+		}
+
+		if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			/* The device was disconnected. hid_read() reports it. */
+			break;
+		}
+
+		bytes_read = read(dev->device_handle, buf, HIDAPI_MAX_HIDRAW_REPORT_SIZE);
+		if (bytes_read < 0) {
+			if (errno == EAGAIN || errno == EINPROGRESS || errno == EINTR)
+				continue;
+			break;
+		}
+
+		dev->input_callback(dev, buf, (size_t)bytes_read, dev->input_callback_user_data);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static void stop_input_callback_thread(hid_device *dev)
+{
+	ssize_t bytes_written;
+
+	if (!dev->input_thread_running)
+		return;
+
+	/* Wake the thread up from poll() and wait for it to end.
+	   The pipe is empty, so the write can't fail. */
+	bytes_written = write(dev->input_thread_pipe[1], "", 1);
+	(void)bytes_written;
+	pthread_join(dev->input_thread, NULL);
+
+	close(dev->input_thread_pipe[0]);
+	close(dev->input_thread_pipe[1]);
+	dev->input_thread_running = 0;
+}
+
+int HID_API_EXPORT hid_set_input_callback(hid_device *dev, hid_input_callback callback, void *user_data)
+{
+	int res;
+
+	if (dev->input_thread_running && pthread_equal(pthread_self(), dev->input_thread)) {
+		errno = EDEADLK;
+		register_device_error(dev, "hid_set_input_callback: cannot be called from the callback");
+		return -1;
+	}
+
+	stop_input_callback_thread(dev);
+
+	dev->input_callback = callback;
+	dev->input_callback_user_data = user_data;
+
+	if (!callback) {
+		register_device_error(dev, NULL);
+		return 0;
+	}
+
+	if (pipe(dev->input_thread_pipe) == -1) {
+		register_device_error_format(dev, "hid_set_input_callback: pipe: %s", strerror(errno));
+		dev->input_callback = NULL;
+		return -1;
+	}
+
+	res = pthread_create(&dev->input_thread, NULL, input_callback_thread, dev);
+	if (res != 0) {
+		close(dev->input_thread_pipe[0]);
+		close(dev->input_thread_pipe[1]);
+		errno = res;
+		register_device_error_format(dev, "hid_set_input_callback: pthread_create: %s", strerror(res));
+		dev->input_callback = NULL;
+		return -1;
+	}
+	dev->input_thread_running = 1;
+
+	register_device_error(dev, NULL);
+	return 0;
+}
+
+
+int HID_API_EXPORT hid_get_pollable_fd(hid_device *dev)
+{
+	register_device_error(dev, NULL);
+
+	return dev->device_handle;
+}
+
+
+int HID_API_EXPORT hid_get_input_reports_dropped(hid_device *dev, size_t *dropped, int reset)
+{
+	(void)dropped;
+	(void)reset;
+
+	errno = ENOSYS;
+	register_device_error(dev, "hid_get_input_reports_dropped: not supported by hidraw");
+
+	return -1;
+}
+
+
 int HID_API_EXPORT hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
 {
 	int res;
@@ -1291,12 +2489,15 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	if (!dev)
 		return;
 
+	stop_input_callback_thread(dev);
+
 	close(dev->device_handle);
 
 	free(dev->last_error_str);
 	free(dev->last_read_error_str);
 
 	hid_free_enumeration(dev->device_info);
+	report_layout_free(dev->report_layout);
 
 	free(dev);
 }
@@ -1431,6 +2632,50 @@ int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char
 	return (int) buf_size;
 }
 
+struct hid_report_layout HID_API_EXPORT * HID_API_CALL hid_parse_report_descriptor(const unsigned char *descriptor, size_t length)
+{
+	struct hid_report_layout *layout;
+	const char *error;
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		register_global_error(error);
+		return NULL;
+	}
+
+	register_global_error(NULL);
+	return layout;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_free_report_layout(struct hid_report_layout *layout)
+{
+	report_layout_free(layout);
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	const char *error;
+	int res;
+
+	if (dev->report_layout) {
+		register_device_error(dev, NULL);
+		return dev->report_layout;
+	}
+
+	res = hid_get_report_descriptor(dev, descriptor, sizeof(descriptor));
+	if (res < 0)
+		return NULL;
+
+	dev->report_layout = report_layout_parse(descriptor, (size_t)res, &error);
+	if (!dev->report_layout) {
+		register_device_error(dev, error);
+		return NULL;
+	}
+
+	return dev->report_layout;
+}
+
 
 /* Passing in NULL means asking for the last global error message. */
 HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
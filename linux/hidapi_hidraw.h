@@ -0,0 +1,51 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2026, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* Internals of the hidraw backend, shared with its tests (linux/test).
+   Not installed, and not part of the API: the tests build hid.c in. */
+
+#ifndef HIDAPI_HIDRAW_H__
+#define HIDAPI_HIDRAW_H__
+
+#include "hidapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Enumerates the HID devices straight from sysfs, without libudev:
+   the entries of <sysfs_root>/class/hidraw are read directly, and the hid,
+   usb_device and usb_interface parents of each node are found from its
+   path. The records are the same, in the same order, as hid_enumerate().
+
+   sysfs_root is the directory sysfs is mounted on, or NULL for "/sys".
+   Any other directory (e.g. a synthetic tree made by a test) has to follow
+   the layout of sysfs, with relative symlinks. The paths of the records
+   are /dev/hidrawN either way. The list is freed with
+   hid_free_enumeration(). */
+#if defined(__GNUC__)
+__attribute__((visibility("hidden")))
+#endif
+struct hid_device_info *hid_hidraw_enumerate_sysfs(const char *sysfs_root, unsigned short vendor_id, unsigned short product_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
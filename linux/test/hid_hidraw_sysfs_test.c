@@ -0,0 +1,592 @@
+/* for mkdtemp(), nftw(), symlink() and clock_gettime() */
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hidapi.h"
+#include "hidapi_hidraw.h"
+
+/* The number of hidraw nodes of the synthetic sysfs tree by default */
+#define DEFAULT_DEVICE_COUNT 5000
+
+/* The report descriptors of the synthetic devices, and the usage pairs
+   the parser has to find in them */
+struct descriptor_template {
+	const unsigned char *descriptor;
+	size_t size; /* with descriptor NULL: no report_descriptor attribute */
+	size_t num_usages;
+	unsigned short usages[2][2]; /* usage page, usage */
+};
+
+static const unsigned char mouse_descriptor[] = {
+	0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09,
+	0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01,
+	0x81, 0x02, 0x95, 0x01, 0x75, 0x05, 0x81, 0x03, 0x05, 0x01, 0x09, 0x30,
+	0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06,
+	0xC0, 0xC0
+};
+
+static const unsigned char keyboard_consumer_descriptor[] = {
+	0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0xE0,
+	0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+	0xC0, 0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x02, 0x15, 0x00, 0x26,
+	0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81,
+	0x00, 0xC0
+};
+
+static const unsigned char vendor_descriptor[] = {
+	0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00,
+	0x75, 0x08, 0x95, 0x40, 0x09, 0x01, 0x81, 0x02, 0x09, 0x01, 0x91, 0x02,
+	0xC0
+};
+
+static const struct descriptor_template descriptor_templates[] = {
+	{ mouse_descriptor, sizeof(mouse_descriptor), 1, { { 0x0001, 0x0002 } } },
+	{ keyboard_consumer_descriptor, sizeof(keyboard_consumer_descriptor), 2, { { 0x0001, 0x0006 }, { 0x000C, 0x0001 } } },
+	{ vendor_descriptor, sizeof(vendor_descriptor), 1, { { 0xFF00, 0x0001 } } },
+	/* An empty descriptor, and none at all: a single record with 0/0 */
+	{ mouse_descriptor, 0, 0, { { 0, 0 } } },
+	{ NULL, 0, 0, { { 0, 0 } } },
+};
+
+#define NUM_DESCRIPTOR_TEMPLATES (sizeof(descriptor_templates) / sizeof(descriptor_templates[0]))
+
+/* A hidraw node of the synthetic tree, and the fields of its records */
+struct synthetic_device {
+	char devpath[256]; /* of the hidraw node, relative to the root */
+	char path[32];
+	unsigned short vendor_id;
+	unsigned short product_id;
+	char serial_number[32];
+	unsigned short release_number;
+	char manufacturer_string[32];
+	char product_string[32];
+	int interface_number;
+	hid_bus_type bus_type;
+	const struct descriptor_template *descriptor;
+};
+
+/* snprintf() for the paths of the tree: fails on truncation */
+static int format_path(char *buf, size_t size, const char *format, ...) __attribute__((format(printf, 3, 4)));
+static int format_path(char *buf, size_t size, const char *format, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, format);
+	len = vsnprintf(buf, size, format, args);
+	va_end(args);
+
+	if (len < 0 || (size_t) len >= size) {
+		fprintf(stderr, "Path too long: %s\n", buf);
+		return -1;
+	}
+	return 0;
+}
+
+/* Creates the directory root/path and all of its parents */
+static int make_dirs(const char *root, const char *path)
+{
+	char full_path[PATH_MAX];
+	char *p;
+
+	snprintf(full_path, sizeof(full_path), "%s/%s", root, path);
+	for (p = full_path + strlen(root) + 1; ; p++) {
+		if (*p == '/' || *p == '\0') {
+			char c = *p;
+			*p = '\0';
+			if (mkdir(full_path, 0755) != 0 && errno != EEXIST) {
+				fprintf(stderr, "mkdir(%s) failed: %s\n", full_path, strerror(errno));
+				return -1;
+			}
+			*p = c;
+			if (c == '\0')
+				break;
+		}
+	}
+	return 0;
+}
+
+static int write_file(const char *root, const char *path, const void *data, size_t size)
+{
+	char full_path[PATH_MAX];
+	FILE *file;
+	int res = 0;
+
+	snprintf(full_path, sizeof(full_path), "%s/%s", root, path);
+	file = fopen(full_path, "wb");
+	if (!file) {
+		fprintf(stderr, "fopen(%s) failed: %s\n", full_path, strerror(errno));
+		return -1;
+	}
+	if (size > 0 && fwrite(data, 1, size, file) != size)
+		res = -1;
+	if (fclose(file) != 0)
+		res = -1;
+	return res;
+}
+
+static int write_attr(const char *root, const char *dir, const char *name, const char *value)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	return write_file(root, path, value, strlen(value));
+}
+
+/* Creates root/path as a relative symlink to root/target, like the
+   links of sysfs */
+static int make_link(const char *root, const char *path, const char *target)
+{
+	char full_path[PATH_MAX];
+	char relative_target[PATH_MAX];
+	size_t len = 0;
+	const char *p;
+
+	for (p = path; *p; p++) {
+		if (*p == '/')
+			len += (size_t) snprintf(relative_target + len, sizeof(relative_target) - len, "../");
+	}
+	snprintf(relative_target + len, sizeof(relative_target) - len, "%s", target);
+
+	snprintf(full_path, sizeof(full_path), "%s/%s", root, path);
+	if (symlink(relative_target, full_path) != 0) {
+		fprintf(stderr, "symlink(%s) failed: %s\n", full_path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int make_device_dir(const char *root, const char *dir, const char *subsystem, const char *uevent)
+{
+	char path[PATH_MAX];
+
+	if (make_dirs(root, dir) < 0)
+		return -1;
+	snprintf(path, sizeof(path), "%s/subsystem", dir);
+	if (make_link(root, path, subsystem) < 0)
+		return -1;
+	return write_attr(root, dir, "uevent", uevent);
+}
+
+/* Makes the hidraw node i of the synthetic tree at root, and describes
+   it in *device: a USB interface most of the time, but also Bluetooth
+   and I2C devices, and an uhid device claiming to be a USB one. */
+static int generate_device(const char *root, unsigned int i, struct synthetic_device *device)
+{
+	char usb_device_dir[128];
+	char hid_dir[192];
+	char dir[256];
+	char value[512];
+	unsigned int kind = i % 10;
+	unsigned int bus;
+	const char *hid_name;
+	const char *hid_uniq;
+
+	memset(device, 0, sizeof(*device));
+	device->vendor_id = (unsigned short)(0x046D + i % 7);
+	device->product_id = (unsigned short)(0xC000 + i);
+	device->descriptor = &descriptor_templates[(i + i / 10) % NUM_DESCRIPTOR_TEMPLATES];
+	device->interface_number = -1;
+	snprintf(device->path, sizeof(device->path), "/dev/hidraw%u", i);
+	snprintf(device->serial_number, sizeof(device->serial_number), "SN%05u", i);
+
+	if (kind <= 5) {
+		unsigned int usb_bus = i / 100 + 1;
+		unsigned int usb_port = i % 100 + 1;
+
+		bus = 0x0003;
+		device->bus_type = HID_API_BUS_USB;
+		device->interface_number = (int)(i % 3);
+		device->release_number = (unsigned short)(0x0100 + i % 256);
+		snprintf(device->manufacturer_string, sizeof(device->manufacturer_string), "Manufacturer %u", i);
+		snprintf(device->product_string, sizeof(device->product_string), "Product %u", i);
+		hid_name = device->product_string;
+		hid_uniq = device->serial_number;
+
+		if (format_path(usb_device_dir, sizeof(usb_device_dir), "devices/pci0000:00/0000:00:14.0/usb%u/%u-%u", usb_bus, usb_bus, usb_port) < 0)
+			return -1;
+		snprintf(value, sizeof(value), "MAJOR=189\nMINOR=%u\nDEVNAME=bus/usb/%03u/%03u\nDEVTYPE=usb_device\nDRIVER=usb\n", i, usb_bus, usb_port);
+		if (make_device_dir(root, usb_device_dir, "bus/usb", value) < 0)
+			return -1;
+		snprintf(value, sizeof(value), "%04x\n", device->vendor_id);
+		write_attr(root, usb_device_dir, "idVendor", value);
+		snprintf(value, sizeof(value), "%04x\n", device->product_id);
+		write_attr(root, usb_device_dir, "idProduct", value);
+		snprintf(value, sizeof(value), "%04x\n", device->release_number);
+		write_attr(root, usb_device_dir, "bcdDevice", value);
+		snprintf(value, sizeof(value), "%s\n", device->manufacturer_string);
+		write_attr(root, usb_device_dir, "manufacturer", value);
+		snprintf(value, sizeof(value), "%s\n", device->product_string);
+		write_attr(root, usb_device_dir, "product", value);
+		snprintf(value, sizeof(value), "%s\n", device->serial_number);
+		write_attr(root, usb_device_dir, "serial", value);
+
+		if (format_path(dir, sizeof(dir), "%s/%u-%u:1.%d", usb_device_dir, usb_bus, usb_port, device->interface_number) < 0 ||
+		    make_device_dir(root, dir, "bus/usb", "DEVTYPE=usb_interface\nDRIVER=usbhid\n") < 0)
+			return -1;
+		snprintf(value, sizeof(value), "%02x\n", (unsigned int) device->interface_number);
+		write_attr(root, dir, "bInterfaceNumber", value);
+	}
+	else if (kind <= 7) {
+		bus = 0x0005;
+		device->bus_type = HID_API_BUS_BLUETOOTH;
+		snprintf(device->product_string, sizeof(device->product_string), "Bluetooth Device %u", i);
+		snprintf(device->serial_number, sizeof(device->serial_number), "aa:bb:cc:dd:%02x:%02x", (i >> 8) & 0xFF, i & 0xFF);
+		hid_name = device->product_string;
+		hid_uniq = device->serial_number;
+		snprintf(dir, sizeof(dir), "devices/virtual/misc/uhid");
+	}
+	else if (kind == 8) {
+		bus = 0x0018;
+		device->bus_type = HID_API_BUS_I2C;
+		snprintf(device->product_string, sizeof(device->product_string), "I2C Device %u", i);
+		device->serial_number[0] = '\0';
+		hid_name = device->product_string;
+		hid_uniq = device->serial_number;
+		snprintf(dir, sizeof(dir), "devices/platform/AMDI0010:00/i2c-0/i2c-DEV%04X:00", i);
+	}
+	else {
+		/* A USB device without a usb_device parent (uhid): its fields are
+		   the ones of the HID layer, like for the other buses */
+		bus = 0x0003;
+		device->bus_type = HID_API_BUS_UNKNOWN;
+		snprintf(device->product_string, sizeof(device->product_string), "Virtual Device %u", i);
+		hid_name = device->product_string;
+		hid_uniq = device->serial_number;
+		snprintf(dir, sizeof(dir), "devices/virtual/misc/uhid");
+	}
+
+	if (format_path(hid_dir, sizeof(hid_dir), "%s/%04X:%04X:%04X.%04X", dir, bus, device->vendor_id, device->product_id, i + 1) < 0)
+		return -1;
+	snprintf(value, sizeof(value),
+		"DRIVER=hid-generic\nHID_ID=%04X:%08X:%08X\nHID_NAME=%s\nHID_PHYS=synthetic/input%u\nHID_UNIQ=%s\nMODALIAS=hid:b%04Xg0001v%08Xp%08X\n",
+		bus, device->vendor_id, device->product_id, hid_name, i, hid_uniq, bus, device->vendor_id, device->product_id);
+	if (make_device_dir(root, hid_dir, "bus/hid", value) < 0)
+		return -1;
+	if (device->descriptor->descriptor) {
+		if (format_path(dir, sizeof(dir), "%s/report_descriptor", hid_dir) < 0 ||
+		    write_file(root, dir, device->descriptor->descriptor, device->descriptor->size) < 0)
+			return -1;
+	}
+
+	if (format_path(device->devpath, sizeof(device->devpath), "%s/hidraw/hidraw%u", hid_dir, i) < 0)
+		return -1;
+	snprintf(value, sizeof(value), "MAJOR=240\nMINOR=%u\nDEVNAME=hidraw%u\n", i, i);
+	if (make_device_dir(root, device->devpath, "class/hidraw", value) < 0)
+		return -1;
+	if (format_path(dir, sizeof(dir), "%s/device", device->devpath) < 0 ||
+	    make_link(root, dir, hid_dir) < 0)
+		return -1;
+
+	if (format_path(dir, sizeof(dir), "class/hidraw/hidraw%u", i) < 0)
+		return -1;
+	return make_link(root, dir, device->devpath);
+}
+
+static int compare_devpaths(const void *a, const void *b)
+{
+	return strcmp(((const struct synthetic_device*) a)->devpath, ((const struct synthetic_device*) b)->devpath);
+}
+
+/* Generates a synthetic sysfs tree of count hidraw nodes at root, which
+   has to exist. Returns the nodes, in the order of their records,
+   or NULL on failure. */
+static struct synthetic_device *generate_tree(const char *root, unsigned int count)
+{
+	struct synthetic_device *devices;
+	unsigned int i;
+
+	if (make_dirs(root, "class/hidraw") < 0 ||
+	    make_dirs(root, "bus/usb") < 0 ||
+	    make_dirs(root, "bus/hid") < 0 ||
+	    make_dirs(root, "devices/virtual/misc/uhid") < 0)
+		return NULL;
+	if (make_device_dir(root, "devices/virtual/misc/uhid", "class/misc", "MAJOR=10\nMINOR=239\nDEVNAME=uhid\n") < 0)
+		return NULL;
+
+	devices = (struct synthetic_device*) calloc(count ? count : 1, sizeof(struct synthetic_device));
+	if (!devices)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		if (generate_device(root, i, &devices[i]) < 0) {
+			free(devices);
+			return NULL;
+		}
+	}
+
+	/* Both libudev and hid_hidraw_enumerate_sysfs() sort the nodes by path */
+	qsort(devices, count, sizeof(struct synthetic_device), compare_devpaths);
+	return devices;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+	(void) sb;
+	(void) ftwbuf;
+	return typeflag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void remove_tree(const char *root)
+{
+	if (nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS) != 0)
+		fprintf(stderr, "WARNING: couldn't remove '%s': %s\n", root, strerror(errno));
+}
+
+static int strings_equal(const wchar_t *actual, const char *expected)
+{
+	if (!actual)
+		return 0;
+	while (*expected) {
+		if (*actual++ != (wchar_t)(unsigned char) *expected++)
+			return 0;
+	}
+	return *actual == L'\0';
+}
+
+static int wide_strings_equal(const wchar_t *a, const wchar_t *b)
+{
+	if (!a || !b)
+		return a == b;
+	return wcscmp(a, b) == 0;
+}
+
+#define CHECK_FIELD(condition, name) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s (%s): %s differs\n", device->devpath, device->path, name); \
+			return -1; \
+		} \
+	} while (0)
+
+static int check_record(const struct hid_device_info *info, const struct synthetic_device *device, size_t usage_index)
+{
+	const unsigned short *usage = device->descriptor->usages[usage_index];
+
+	CHECK_FIELD(info->path && strcmp(info->path, device->path) == 0, "path");
+	CHECK_FIELD(info->vendor_id == device->vendor_id, "vendor_id");
+	CHECK_FIELD(info->product_id == device->product_id, "product_id");
+	CHECK_FIELD(strings_equal(info->serial_number, device->serial_number), "serial_number");
+	CHECK_FIELD(info->release_number == device->release_number, "release_number");
+	CHECK_FIELD(strings_equal(info->manufacturer_string, device->manufacturer_string), "manufacturer_string");
+	CHECK_FIELD(strings_equal(info->product_string, device->product_string), "product_string");
+	CHECK_FIELD(info->usage_page == usage[0], "usage_page");
+	CHECK_FIELD(info->usage == usage[1], "usage");
+	CHECK_FIELD(info->interface_number == device->interface_number, "interface_number");
+	CHECK_FIELD(info->bus_type == device->bus_type, "bus_type");
+	return 0;
+}
+
+/* Checks the records of the devices, one for each usage pair (or a
+   single one with 0/0), field by field. Returns the number of errors. */
+static int check_records(const struct hid_device_info *devs, const struct synthetic_device *devices, unsigned int count)
+{
+	const struct hid_device_info *cur = devs;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		size_t num_records = devices[i].descriptor->num_usages ? devices[i].descriptor->num_usages : 1;
+		size_t u;
+
+		for (u = 0; u < num_records; u++) {
+			if (!cur) {
+				fprintf(stderr, "%s: record %u missing\n", devices[i].devpath, (unsigned) u);
+				return 1;
+			}
+			if (check_record(cur, &devices[i], u) < 0)
+				return 1;
+			cur = cur->next;
+		}
+	}
+
+	if (cur) {
+		fprintf(stderr, "Unexpected record: %s\n", cur->path ? cur->path : "(null)");
+		return 1;
+	}
+	return 0;
+}
+
+static int check_synthetic_tree(const char *root, const struct synthetic_device *devices, unsigned int count)
+{
+	struct hid_device_info *devs;
+	int errors = 0;
+
+	devs = hid_hidraw_enumerate_sysfs(root, 0, 0);
+	if (!devs && count > 0) {
+		fprintf(stderr, "hid_hidraw_enumerate_sysfs failed: %ls\n", hid_error(NULL));
+		return 1;
+	}
+	errors += check_records(devs, devices, count);
+	hid_free_enumeration(devs);
+
+	/* The VID/PID filter: the PIDs are unique */
+	if (count > 0) {
+		const struct synthetic_device *device = &devices[count / 2];
+
+		devs = hid_hidraw_enumerate_sysfs(root, device->vendor_id, device->product_id);
+		errors += check_records(devs, device, 1);
+		hid_free_enumeration(devs);
+	}
+
+	devs = hid_hidraw_enumerate_sysfs(root, 0x0001, 0x0001);
+	if (devs) {
+		fprintf(stderr, "Records found for 0001:0001\n");
+		errors++;
+	}
+	hid_free_enumeration(devs);
+
+	printf("%u synthetic hidraw nodes: %s\n", count, errors ? "FAILED" : "OK");
+	return errors;
+}
+
+/* Compares hid_hidraw_enumerate_sysfs() with hid_enumerate() on the
+   running system, field by field. Returns the number of errors. */
+static int check_system(void)
+{
+	struct hid_device_info *udev_devs = hid_enumerate(0, 0);
+	struct hid_device_info *sysfs_devs = hid_hidraw_enumerate_sysfs(NULL, 0, 0);
+	const struct hid_device_info *a = udev_devs;
+	const struct hid_device_info *b = sysfs_devs;
+	unsigned int num_records = 0;
+	int errors = 0;
+
+	for (; a && b; a = a->next, b = b->next, num_records++) {
+		if (!a->path || !b->path || strcmp(a->path, b->path) != 0 ||
+		    a->vendor_id != b->vendor_id ||
+		    a->product_id != b->product_id ||
+		    !wide_strings_equal(a->serial_number, b->serial_number) ||
+		    a->release_number != b->release_number ||
+		    !wide_strings_equal(a->manufacturer_string, b->manufacturer_string) ||
+		    !wide_strings_equal(a->product_string, b->product_string) ||
+		    a->usage_page != b->usage_page ||
+		    a->usage != b->usage ||
+		    a->interface_number != b->interface_number ||
+		    a->bus_type != b->bus_type) {
+			fprintf(stderr, "Record %u differs: %s (hid_enumerate) vs %s (hid_hidraw_enumerate_sysfs)\n",
+				num_records, a->path ? a->path : "(null)", b->path ? b->path : "(null)");
+			errors++;
+		}
+	}
+	if (a || b) {
+		fprintf(stderr, "hid_enumerate and hid_hidraw_enumerate_sysfs return a different number of records\n");
+		errors++;
+	}
+
+	hid_free_enumeration(udev_devs);
+	hid_free_enumeration(sysfs_devs);
+
+	printf("%u records of the system: %s\n", num_records, errors ? "FAILED" : "OK");
+	return errors;
+}
+
+static double elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - start->tv_sec) * 1e3 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static unsigned int count_records(struct hid_device_info *devs)
+{
+	unsigned int n = 0;
+	struct hid_device_info *cur;
+	for (cur = devs; cur; cur = cur->next)
+		n++;
+	hid_free_enumeration(devs);
+	return n;
+}
+
+/* Prints the timings of the enumeration of the synthetic tree and
+   of the system, through sysfs and through libudev */
+static void benchmark(const char *root, unsigned int count, unsigned int iterations)
+{
+	struct timespec start;
+	unsigned int num_records = 0;
+	unsigned int n;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < iterations; n++)
+		num_records = count_records(hid_hidraw_enumerate_sysfs(root, 0, 0));
+	printf("hid_hidraw_enumerate_sysfs, %u synthetic nodes: %8.2f ms (%u records)\n", count, elapsed_ms(&start) / iterations, num_records);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < iterations; n++)
+		num_records = count_records(hid_hidraw_enumerate_sysfs(NULL, 0, 0));
+	printf("hid_hidraw_enumerate_sysfs, system:       %8.2f ms (%u records)\n", elapsed_ms(&start) / iterations, num_records);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < iterations; n++)
+		num_records = count_records(hid_enumerate(0, 0));
+	printf("hid_enumerate, system:                    %8.2f ms (%u records)\n", elapsed_ms(&start) / iterations, num_records);
+}
+
+int main(int argc, char **argv)
+{
+	char root[PATH_MAX];
+	struct synthetic_device *devices;
+	unsigned int count = DEFAULT_DEVICE_COUNT;
+	int time_mode = 0;
+	int errors = 0;
+
+	if (argc == 2 && strcmp(argv[1], "--system") == 0) {
+		errors = check_system();
+		hid_exit();
+		return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--generate") == 0) {
+		if (argc == 4)
+			count = (unsigned int) strtoul(argv[3], NULL, 10);
+		devices = generate_tree(argv[2], count);
+		free(devices);
+		return devices ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--time") == 0) {
+		time_mode = 1;
+		argc--;
+		argv++;
+	}
+
+	if (argc != 2 && argc != 3) {
+		fprintf(stderr, "Usage: %s [--time] <directory> [count]\n", argv[0]);
+		fprintf(stderr, "       %s --generate <sysfs_root> [count]\n", argv[0]);
+		fprintf(stderr, "       %s --system\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 3)
+		count = (unsigned int) strtoul(argv[2], NULL, 10);
+
+	/* A fresh tree in the directory, removed afterwards */
+	snprintf(root, sizeof(root), "%s/sysfs.XXXXXX", argv[1]);
+	if (!mkdtemp(root)) {
+		fprintf(stderr, "mkdtemp(%s) failed: %s\n", root, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	devices = generate_tree(root, count);
+	if (!devices) {
+		errors++;
+	}
+	else if (time_mode) {
+		benchmark(root, count, 10);
+	}
+	else {
+		errors += check_synthetic_tree(root, devices, count);
+		errors += check_system();
+	}
+
+	free(devices);
+	remove_tree(root);
+	hid_exit();
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
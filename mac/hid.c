@@ -28,9 +28,11 @@
 #include <IOKit/usb/USBSpec.h>
 #include <CoreFoundation/CoreFoundation.h>
 #include <mach/mach_error.h>
+#include <mach/mach_time.h>
 #include <stdbool.h>
 #include <wchar.h>
 #include <locale.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -38,6 +40,10 @@
 
 #include "hidapi_darwin.h"
 
+#include "../core/hidapi_report_layout.c"
+#include "../core/hidapi_timestamp.c"
+#include "../core/hidapi_enumerate_filter.c"
+
 /* Barrier implementation because Mac OSX doesn't have pthread_barrier.
    It also doesn't have clock_gettime(). So much for POSIX and SUSv2.
    This implementation came from Brent Priddy and was posted on
@@ -100,15 +106,20 @@ static int pthread_barrier_wait(pthread_barrier_t *barrier)
 	}
 }
 
-static int return_data(hid_device *dev, unsigned char *data, size_t length);
+static int return_data(hid_device *dev, unsigned char *data, size_t length, uint64_t *timestamp);
 
 /* Linked List of input reports received from the device. */
 struct input_report {
 	uint8_t *data;
 	size_t len;
+	uint32_t report_id;
+	uint64_t timestamp; /* mach_absolute_time() in nanoseconds */
 	struct input_report *next;
 };
 
+/* Default depth of the input report queue, see hid_set_input_queue() */
+#define HIDAPI_INPUT_REPORT_QUEUE_SIZE 32
+
 static struct hid_api_version api_version = {
 	.major = HID_API_VERSION_MAJOR,
 	.minor = HID_API_VERSION_MINOR,
@@ -133,10 +144,22 @@ struct hid_device_ {
 	uint8_t *input_report_buf;
 	CFIndex max_input_report_len;
 	struct input_report *input_reports;
+	size_t num_input_reports;
+	size_t max_input_reports;
+	hid_input_queue_policy input_queue_policy;
+	size_t input_reports_dropped;
+	hid_input_callback input_callback;
+	void *input_callback_user_data;
+	/* The callback is being called on the read thread, and whether
+	   hid_set_input_callback() waits for it to return */
+	int input_callback_running;
+	int input_callback_waiting;
 	struct hid_device_info* device_info;
+	/* See hid_get_report_layout(), compiled on the first call */
+	struct hid_report_layout *report_layout;
 
 	pthread_t thread;
-	pthread_mutex_t mutex; /* Protects input_reports */
+	pthread_mutex_t mutex; /* Protects input_reports and the queue settings */
 	pthread_cond_t condition;
 	pthread_barrier_t barrier; /* Ensures correct startup sequence */
 	pthread_barrier_t shutdown_barrier; /* Ensures correct shutdown sequence */
@@ -161,6 +184,12 @@ static hid_device *new_hid_device(void)
 	dev->source = NULL;
 	dev->input_report_buf = NULL;
 	dev->input_reports = NULL;
+	dev->num_input_reports = 0;
+	dev->max_input_reports = HIDAPI_INPUT_REPORT_QUEUE_SIZE;
+	dev->input_queue_policy = HID_API_INPUT_QUEUE_DROP_OLDEST;
+	dev->input_reports_dropped = 0;
+	dev->input_callback = NULL;
+	dev->input_callback_user_data = NULL;
 	dev->device_info = NULL;
 	dev->shutdown_thread = 0;
 	dev->last_error_str = NULL;
@@ -200,6 +229,7 @@ static void free_hid_device(hid_device *dev)
 	free(dev->last_error_str);
 	free(dev->last_read_error_str);
 	hid_free_enumeration(dev->device_info);
+	report_layout_free(dev->report_layout);
 
 	/* Clean up the thread objects */
 	pthread_barrier_destroy(&dev->shutdown_barrier);
@@ -540,7 +570,21 @@ static int read_usb_interface_from_hid_service_parent(io_service_t hid_service)
 	return result;
 }
 
-static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev, int32_t usage_page, int32_t usage)
+/* The criteria which are the same for all of the usage pairs of a device */
+static int enumerate_filter_match_device(const struct hid_enumerate_filter *filter, const struct hid_device_info *info)
+{
+	if (!filter)
+		return 1;
+
+	if ((filter->match & HID_API_FILTER_BUS_TYPE) && filter->bus_type != info->bus_type)
+		return 0;
+	if ((filter->match & HID_API_FILTER_INTERFACE_NUMBER) && filter->interface_number != info->interface_number)
+		return 0;
+
+	return enumerate_filter_match_serial_number(filter, info->serial_number);
+}
+
+static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev, int32_t usage_page, int32_t usage, int fields)
 {
 	unsigned short dev_vid;
 	unsigned short dev_pid;
@@ -598,14 +642,20 @@ static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev,
 	}
 
 	/* Serial Number */
-	get_serial_number(dev, buf, BufLen);
-	cur_dev->serial_number = dup_wcs(buf);
+	if (fields & HID_API_DEVICE_INFO_SERIAL_NUMBER) {
+		get_serial_number(dev, buf, BufLen);
+		cur_dev->serial_number = dup_wcs(buf);
+	}
 
 	/* Manufacturer and Product strings */
-	get_manufacturer_string(dev, buf, BufLen);
-	cur_dev->manufacturer_string = dup_wcs(buf);
-	get_product_string(dev, buf, BufLen);
-	cur_dev->product_string = dup_wcs(buf);
+	if (fields & HID_API_DEVICE_INFO_MANUFACTURER_STRING) {
+		get_manufacturer_string(dev, buf, BufLen);
+		cur_dev->manufacturer_string = dup_wcs(buf);
+	}
+	if (fields & HID_API_DEVICE_INFO_PRODUCT_STRING) {
+		get_product_string(dev, buf, BufLen);
+		cur_dev->product_string = dup_wcs(buf);
+	}
 
 	/* VID/PID */
 	cur_dev->vendor_id = dev_vid;
@@ -653,17 +703,30 @@ static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev,
 	return cur_dev;
 }
 
-static struct hid_device_info *create_device_info(IOHIDDeviceRef device)
+/* Creates the records of the usage pairs of a device which match
+   the filter (NULL for all of them). The usage pairs not matching
+   are skipped without getting the properties of the device. */
+static struct hid_device_info *create_device_info(IOHIDDeviceRef device, const struct hid_enumerate_filter *filter)
 {
 	const int32_t primary_usage_page = get_int_property(device, CFSTR(kIOHIDPrimaryUsagePageKey));
 	const int32_t primary_usage = get_int_property(device, CFSTR(kIOHIDPrimaryUsageKey));
+	const int fields = enumerate_filter_fields(filter);
+
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur = NULL;
 
 	/* Primary should always be first, to match previous behavior. */
-	struct hid_device_info *root = create_device_info_with_usage(device, primary_usage_page, primary_usage);
-	struct hid_device_info *cur = root;
+	if (enumerate_filter_match_usage(filter, (unsigned short)primary_usage_page, (unsigned short)primary_usage)) {
+		root = create_device_info_with_usage(device, primary_usage_page, primary_usage, fields);
+		if (!root)
+			return NULL;
 
-	if (!root)
-		return NULL;
+		if (!enumerate_filter_match_device(filter, root)) {
+			hid_free_enumeration(root);
+			return NULL;
+		}
+		cur = root;
+	}
 
 	CFArrayRef usage_pairs = get_usage_pairs(device);
 
@@ -689,11 +752,25 @@ static struct hid_device_info *create_device_info(IOHIDDeviceRef device)
 			if (usage_page == primary_usage_page && usage == primary_usage)
 				continue; /* Already added. */
 
-			next = create_device_info_with_usage(device, usage_page, usage);
-			cur->next = next;
-			if (next != NULL) {
-				cur = next;
+			if (!enumerate_filter_match_usage(filter, (unsigned short)usage_page, (unsigned short)usage))
+				continue;
+
+			next = create_device_info_with_usage(device, usage_page, usage, fields);
+			if (next == NULL)
+				continue;
+
+			if (root == NULL) {
+				/* The first record checks the rest of the filter for all of them */
+				if (!enumerate_filter_match_device(filter, next)) {
+					hid_free_enumeration(next);
+					return NULL;
+				}
+				root = next;
+			}
+			else {
+				cur->next = next;
 			}
+			cur = next;
 		}
 	}
 
@@ -701,11 +778,32 @@ static struct hid_device_info *create_device_info(IOHIDDeviceRef device)
 }
 
 struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	return hid_enumerate_fields(vendor_id, product_id, HID_API_DEVICE_INFO_ALL_STRINGS);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_fields(unsigned short vendor_id, unsigned short product_id, int fields)
+{
+	struct hid_enumerate_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.fields = fields;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_ex(const struct hid_enumerate_filter *filter)
 {
 	struct hid_device_info *root = NULL; /* return object */
 	struct hid_device_info *cur_dev = NULL;
 	CFIndex num_devices;
 	int i;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	int32_t usage_page;
+	int32_t usage;
 
 	/* Set up the HID Manager if it hasn't been done */
 	if (hid_init() < 0) {
@@ -713,12 +811,22 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 	}
 	/* register_global_error: global error is set/reset by hid_init */
 
+	if (!filter) {
+		register_global_error("hid_enumerate_ex: filter is NULL");
+		return NULL;
+	}
+
+	vendor_id = filter->vendor_id;
+	product_id = filter->product_id;
+	usage_page = filter->usage_page;
+	usage = filter->usage;
+
 	/* give the IOHIDManager a chance to update itself */
 	process_pending_events();
 
 	/* Get a list of the Devices */
 	CFMutableDictionaryRef matching = NULL;
-	if (vendor_id != 0 || product_id != 0) {
+	if (vendor_id != 0 || product_id != 0 || (filter->match & (HID_API_FILTER_USAGE_PAGE | HID_API_FILTER_USAGE))) {
 		matching = CFDictionaryCreateMutable(kCFAllocatorDefault, kIOHIDOptionsTypeNone, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
 
 		if (matching && vendor_id != 0) {
@@ -732,6 +840,21 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 			CFDictionarySetValue(matching, CFSTR(kIOHIDProductIDKey), p);
 			CFRelease(p);
 		}
+
+		/* Matched against each of the usage pairs of a device
+		   (kIOHIDDeviceUsagePairsKey), which are filtered again
+		   one by one in create_device_info(). */
+		if (matching && (filter->match & HID_API_FILTER_USAGE_PAGE)) {
+			CFNumberRef up = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &usage_page);
+			CFDictionarySetValue(matching, CFSTR(kIOHIDDeviceUsagePageKey), up);
+			CFRelease(up);
+		}
+
+		if (matching && (filter->match & HID_API_FILTER_USAGE)) {
+			CFNumberRef u = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &usage);
+			CFDictionarySetValue(matching, CFSTR(kIOHIDDeviceUsageKey), u);
+			CFRelease(u);
+		}
 	}
 	IOHIDManagerSetDeviceMatching(hid_mgr, matching);
 	if (matching != NULL) {
@@ -759,7 +882,7 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 			continue;
 		}
 
-		struct hid_device_info *tmp = create_device_info(dev);
+		struct hid_device_info *tmp = create_device_info(dev, filter);
 		if (tmp == NULL) {
 			continue;
 		}
@@ -783,7 +906,9 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 		CFRelease(device_set);
 
 	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
+		if (filter->match != 0 || filter->serial_number_prefix) {
+			register_global_error("No HID devices matching the filter found in the system.");
+		} else if (vendor_id == 0 && product_id == 0) {
 			register_global_error("No HID devices found in the system.");
 		} else {
 			register_global_error("No HID devices with requested VID/PID found in the system.");
@@ -808,6 +933,52 @@ void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
 	}
 }
 
+int HID_API_EXPORT hid_set_enumeration_cache(int enable)
+{
+	register_global_error(NULL);
+
+	if (!enable)
+		return 0;
+
+	register_global_error("hid_set_enumeration_cache: not supported on macOS");
+	return -1;
+}
+
+int HID_API_EXPORT hid_set_report_descriptor_cache(int enable, const char *path)
+{
+	(void)path;
+
+	register_global_error(NULL);
+
+	if (!enable)
+		return 0;
+
+	register_global_error("hid_set_report_descriptor_cache: not supported on macOS");
+	return -1;
+}
+
+int HID_API_EXPORT hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	(void)vendor_id;
+	(void)product_id;
+	(void)events;
+	(void)flags;
+	(void)callback;
+	(void)user_data;
+	(void)callback_handle;
+
+	register_global_error("hid_hotplug_register_callback: not supported on macOS");
+	return -1;
+}
+
+int HID_API_EXPORT hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	(void)callback_handle;
+
+	register_global_error("hid_hotplug_deregister_callback: not supported on macOS");
+	return -1;
+}
+
 hid_device * HID_API_EXPORT hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
 {
 	/* This function is identical to the Linux version. Platform independent. */
@@ -875,21 +1046,74 @@ static void hid_report_callback(void *context, IOReturn result, void *sender,
 	(void) result;
 	(void) sender;
 	(void) report_type;
-	(void) report_id;
 
 	struct input_report *rpt;
+	struct input_report *cur;
+	hid_input_callback callback;
+	void *user_data;
 	hid_device *dev = (hid_device*) context;
 
+	pthread_mutex_lock(&dev->mutex);
+	callback = dev->input_callback;
+	user_data = dev->input_callback_user_data;
+	if (callback)
+		dev->input_callback_running = 1;
+	pthread_mutex_unlock(&dev->mutex);
+
+	if (callback) {
+		/* Hand the report over without queuing it */
+		callback(dev, report, (size_t) report_length, user_data);
+
+		pthread_mutex_lock(&dev->mutex);
+		dev->input_callback_running = 0;
+		if (dev->input_callback_waiting)
+			pthread_cond_broadcast(&dev->condition);
+		pthread_mutex_unlock(&dev->mutex);
+		return;
+	}
+
 	/* Make a new Input Report object */
 	rpt = (struct input_report*) calloc(1, sizeof(struct input_report));
 	rpt->data = (uint8_t*) calloc(1, report_length);
 	memcpy(rpt->data, report, report_length);
 	rpt->len = report_length;
+	rpt->report_id = report_id;
+	rpt->timestamp = get_timestamp();
 	rpt->next = NULL;
 
 	/* Lock this section */
 	pthread_mutex_lock(&dev->mutex);
 
+	if (dev->input_queue_policy == HID_API_INPUT_QUEUE_CONFLATE) {
+		/* Replace a queued report with the same Report ID in place */
+		for (cur = dev->input_reports; cur != NULL; cur = cur->next) {
+			if (cur->report_id == report_id) {
+				free(cur->data);
+				cur->data = rpt->data;
+				cur->len = rpt->len;
+				free(rpt);
+				dev->input_reports_dropped++;
+				pthread_mutex_unlock(&dev->mutex);
+				return;
+			}
+		}
+	}
+
+	if (dev->num_input_reports >= dev->max_input_reports) {
+		dev->input_reports_dropped++;
+		if (dev->input_queue_policy == HID_API_INPUT_QUEUE_DROP_NEWEST) {
+			free(rpt->data);
+			free(rpt);
+			pthread_mutex_unlock(&dev->mutex);
+			return;
+		}
+
+		/* Pop one off if the queue is full. This way we don't
+		   grow forever if the user never reads anything from
+		   the device. */
+		return_data(dev, NULL, 0, NULL);
+	}
+
 	/* Attach the new report object to the end of the list. */
 	if (dev->input_reports == NULL) {
 		/* The list is empty. Put it at the root. */
@@ -897,21 +1121,13 @@ static void hid_report_callback(void *context, IOReturn result, void *sender,
 	}
 	else {
 		/* Find the end of the list and attach. */
-		struct input_report *cur = dev->input_reports;
-		int num_queued = 0;
+		cur = dev->input_reports;
 		while (cur->next != NULL) {
 			cur = cur->next;
-			num_queued++;
 		}
 		cur->next = rpt;
-
-		/* Pop one off if we've reached 30 in the queue. This
-		   way we don't grow forever if the user never reads
-		   anything from the device. */
-		if (num_queued > 30) {
-			return_data(dev, NULL, 0);
-		}
 	}
+	dev->num_input_reports++;
 
 	/* Signal a waiting thread that there is data. */
 	pthread_cond_signal(&dev->condition);
@@ -1192,7 +1408,7 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
 }
 
 /* Helper function, so that this isn't duplicated in hid_read(). */
-static int return_data(hid_device *dev, unsigned char *data, size_t length)
+static int return_data(hid_device *dev, unsigned char *data, size_t length, uint64_t *timestamp)
 {
 	/* Copy the data out of the linked list item (rpt) into the
 	   return buffer (data), and delete the liked list item. */
@@ -1201,7 +1417,11 @@ static int return_data(hid_device *dev, unsigned char *data, size_t length)
 	if (data != NULL) {
 		memcpy(data, rpt->data, len);
 	}
+	if (timestamp != NULL) {
+		*timestamp = rpt->timestamp;
+	}
 	dev->input_reports = rpt->next;
+	dev->num_input_reports--;
 	free(rpt->data);
 	free(rpt);
 	return (int) len;
@@ -1249,7 +1469,7 @@ static int cond_timedwait(hid_device *dev, pthread_cond_t *cond, pthread_mutex_t
 	return 0;
 }
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+int HID_API_EXPORT hid_read_timestamped(hid_device *dev, unsigned char *data, size_t length, int milliseconds, uint64_t *timestamp)
 {
 	int bytes_read = -1;
 
@@ -1266,7 +1486,7 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 	/* There's an input report queued up. Return it. */
 	if (dev->input_reports) {
 		/* Return the first one */
-		bytes_read = return_data(dev, data, length);
+		bytes_read = return_data(dev, data, length, timestamp);
 		goto ret;
 	}
 
@@ -1293,7 +1513,7 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 		int res;
 		res = cond_wait(dev, &dev->condition, &dev->mutex);
 		if (res == 0)
-			bytes_read = return_data(dev, data, length);
+			bytes_read = return_data(dev, data, length, timestamp);
 		else {
 			/* There was an error, or a device disconnection. */
 			register_error_str(&dev->last_read_error_str, "hid_read_timeout: error waiting for more data");
@@ -1316,7 +1536,7 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 
 		res = cond_timedwait(dev, &dev->condition, &dev->mutex, &ts);
 		if (res == 0) {
-			bytes_read = return_data(dev, data, length);
+			bytes_read = return_data(dev, data, length, timestamp);
 		} else if (res == ETIMEDOUT) {
 			bytes_read = 0;
 		} else {
@@ -1335,6 +1555,48 @@ ret:
 	return bytes_read;
 }
 
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	return hid_read_timestamped(dev, data, length, milliseconds, NULL);
+}
+
+int HID_API_EXPORT hid_read_many(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds)
+{
+	size_t i;
+	int bytes_read;
+
+	if (!reports || (count == 0)) {
+		register_error_str(&dev->last_read_error_str, "Zero buffer/length");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!reports[i].data || (reports[i].length == 0)) {
+			register_error_str(&dev->last_read_error_str, "Zero buffer/length");
+			return -1;
+		}
+	}
+
+	/* The count of reports read is returned as an int */
+	if (count > INT_MAX)
+		count = INT_MAX;
+
+	/* Wait for the first report just like hid_read_timeout() does */
+	bytes_read = hid_read_timestamped(dev, reports[0].data, reports[0].length, milliseconds, &reports[0].timestamp);
+	if (bytes_read <= 0)
+		return bytes_read;
+	reports[0].bytes_read = (size_t) bytes_read;
+
+	/* Take the rest of the queued reports under a single lock */
+	pthread_mutex_lock(&dev->mutex);
+	for (i = 1; i < count && dev->input_reports; i++) {
+		reports[i].bytes_read = (size_t) return_data(dev, reports[i].data, reports[i].length, &reports[i].timestamp);
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	return (int) i;
+}
+
 int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
@@ -1355,6 +1617,85 @@ int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 	return 0;
 }
 
+int HID_API_EXPORT hid_set_input_queue(hid_device *dev, size_t max_reports, hid_input_queue_policy policy)
+{
+	if (max_reports == 0) {
+		register_device_error(dev, "hid_set_input_queue: the queue must hold at least one report");
+		return -1;
+	}
+
+	switch (policy) {
+	case HID_API_INPUT_QUEUE_DROP_OLDEST:
+	case HID_API_INPUT_QUEUE_DROP_NEWEST:
+	case HID_API_INPUT_QUEUE_CONFLATE:
+		break;
+	case HID_API_INPUT_QUEUE_BLOCK:
+		/* The reports are delivered by IOKit on the run loop of the
+		   read thread, which can't hold them back */
+		register_device_error(dev, "hid_set_input_queue: HID_API_INPUT_QUEUE_BLOCK is not supported on macOS");
+		return -1;
+	default:
+		register_device_error(dev, "hid_set_input_queue: unknown policy");
+		return -1;
+	}
+
+	pthread_mutex_lock(&dev->mutex);
+
+	/* Discard the oldest reports which don't fit anymore */
+	while (dev->num_input_reports > max_reports) {
+		return_data(dev, NULL, 0, NULL);
+		dev->input_reports_dropped++;
+	}
+
+	dev->max_input_reports = max_reports;
+	dev->input_queue_policy = policy;
+
+	pthread_mutex_unlock(&dev->mutex);
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_set_input_callback(hid_device *dev, hid_input_callback callback, void *user_data)
+{
+	pthread_mutex_lock(&dev->mutex);
+	dev->input_callback = callback;
+	dev->input_callback_user_data = user_data;
+
+	/* Wait for the previous callback to return, unless this is
+	   called from the callback, on the read thread */
+	if (!pthread_equal(pthread_self(), dev->thread)) {
+		dev->input_callback_waiting++;
+		while (dev->input_callback_running)
+			pthread_cond_wait(&dev->condition, &dev->mutex);
+		dev->input_callback_waiting--;
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_get_pollable_fd(hid_device *dev)
+{
+	register_device_error(dev, "hid_get_pollable_fd: not supported on macOS");
+	return -1;
+}
+
+int HID_API_EXPORT hid_get_input_reports_dropped(hid_device *dev, size_t *dropped, int reset)
+{
+	if (!dropped) {
+		register_device_error(dev, "hid_get_input_reports_dropped: dropped is NULL");
+		return -1;
+	}
+
+	pthread_mutex_lock(&dev->mutex);
+	*dropped = dev->input_reports_dropped;
+	if (reset)
+		dev->input_reports_dropped = 0;
+	pthread_mutex_unlock(&dev->mutex);
+
+	return 0;
+}
+
 int HID_API_EXPORT hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
 {
 	return set_report(dev, kIOHIDReportTypeFeature, data, length);
@@ -1421,7 +1762,7 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	/* Clear out the queue of received reports. */
 	pthread_mutex_lock(&dev->mutex);
 	while (dev->input_reports) {
-		return_data(dev, NULL, 0);
+		return_data(dev, NULL, 0, NULL);
 	}
 	pthread_mutex_unlock(&dev->mutex);
 	CFRelease(dev->device_handle);
@@ -1493,7 +1834,7 @@ HID_API_EXPORT struct hid_device_info *HID_API_CALL hid_get_device_info(hid_devi
 		register_device_error(dev, NULL);
 	}
 	else {
-		dev->device_info = create_device_info(dev->device_handle);
+		dev->device_info = create_device_info(dev->device_handle, NULL);
 		if (!dev->device_info) {
 			register_device_error(dev, "Failed to create hid_device_info");
 		}
@@ -1581,6 +1922,50 @@ int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char
 	}
 }
 
+struct hid_report_layout HID_API_EXPORT * HID_API_CALL hid_parse_report_descriptor(const unsigned char *descriptor, size_t length)
+{
+	struct hid_report_layout *layout;
+	const char *error;
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		register_global_error(error);
+		return NULL;
+	}
+
+	register_global_error(NULL);
+	return layout;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_free_report_layout(struct hid_report_layout *layout)
+{
+	report_layout_free(layout);
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	const char *error;
+	int res;
+
+	if (dev->report_layout) {
+		register_device_error(dev, NULL);
+		return dev->report_layout;
+	}
+
+	res = hid_get_report_descriptor(dev, descriptor, sizeof(descriptor));
+	if (res < 0)
+		return NULL;
+
+	dev->report_layout = report_layout_parse(descriptor, (size_t)res, &error);
+	if (!dev->report_layout) {
+		register_device_error(dev, error);
+		return NULL;
+	}
+
+	return dev->report_layout;
+}
+
 HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
 {
 	if (dev) {
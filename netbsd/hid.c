@@ -25,11 +25,13 @@
 #include <locale.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 
 /* Unix */
 #include <unistd.h>
 #include <fcntl.h>
 #include <iconv.h>
+#include <time.h>
 #ifndef ICONV_CONST
 #define ICONV_CONST
 #endif
@@ -43,6 +45,11 @@
 
 #include "hidapi.h"
 
+#define REPORT_LAYOUT_WITH_SCAN
+#include "../core/hidapi_report_layout.c"
+#include "../core/hidapi_timestamp.c"
+#include "../core/hidapi_enumerate_filter.c"
+
 #define HIDAPI_MAX_CHILD_DEVICES 256
 
 struct hid_device_ {
@@ -51,6 +58,8 @@ struct hid_device_ {
 	wchar_t *last_error_str;
 	wchar_t *last_read_error_str;
 	struct hid_device_info *device_info;
+	/* See hid_get_report_layout(), compiled on the first call */
+	struct hid_report_layout *report_layout;
 	size_t poll_handles_length;
 	struct pollfd poll_handles[256];
 	int report_handles[256];
@@ -61,8 +70,7 @@ struct hid_enumerate_data {
 	struct hid_device_info *root;
 	struct hid_device_info *end;
 	int drvctl;
-	uint16_t vendor_id;
-	uint16_t product_id;
+	const struct hid_enumerate_filter *filter;
 };
 
 typedef void (*enumerate_devices_callback) (const struct usb_device_info *, void *);
@@ -162,317 +170,112 @@ static void register_device_read_error_format(hid_device *dev, const char *forma
 }
 
 /*
- * Gets the size of the HID item at the given position
- * Returns 1 if successful, 0 if an invalid key
- * Sets data_len and key_size when successful
- */
-static int get_hid_item_size(const uint8_t *report_descriptor, uint32_t size, unsigned int pos, int *data_len, int *key_size)
-{
-	int key = report_descriptor[pos];
-	int size_code;
-
-	/*
-	 * This is a Long Item. The next byte contains the
-	 * length of the data section (value) for this key.
-	 * See the HID specification, version 1.11, section
-	 * 6.2.2.3, titled "Long Items."
-	 */
-	if ((key & 0xf0) == 0xf0) {
-		if (pos + 1 < size)
-		{
-			*data_len = report_descriptor[pos + 1];
-			*key_size = 3;
-			return 1;
-		}
-		*data_len = 0; /* malformed report */
-		*key_size = 0;
-	}
-
-	/*
-	 * This is a Short Item. The bottom two bits of the
-	 * key contain the size code for the data section
-	 * (value) for this key. Refer to the HID
-	 * specification, version 1.11, section 6.2.2.2,
-	 * titled "Short Items."
-	 */
-	size_code = key & 0x3;
-	switch (size_code) {
-	case 0:
-	case 1:
-	case 2:
-		*data_len = size_code;
-		*key_size = 1;
-		return 1;
-	case 3:
-		*data_len = 4;
-		*key_size = 1;
-		return 1;
-	default:
-		/* Can't ever happen since size_code is & 0x3 */
-		*data_len = 0;
-		*key_size = 0;
-		break;
-	};
-
-	/* malformed report */
-	return 0;
-}
-
-/*
- * Get bytes from a HID Report Descriptor.
- * Only call with a num_bytes of 0, 1, 2, or 4.
- */
-static uint32_t get_hid_report_bytes(const uint8_t *rpt, size_t len, size_t num_bytes, size_t cur)
-{
-	/* Return if there aren't enough bytes. */
-	if (cur + num_bytes >= len)
-		return 0;
-
-	if (num_bytes == 0)
-		return 0;
-	else if (num_bytes == 1)
-		return rpt[cur + 1];
-	else if (num_bytes == 2)
-		return (rpt[cur + 2] * 256 + rpt[cur + 1]);
-	else if (num_bytes == 4)
-		return (
-			rpt[cur + 4] * 0x01000000 +
-			rpt[cur + 3] * 0x00010000 +
-			rpt[cur + 2] * 0x00000100 +
-			rpt[cur + 1] * 0x00000001
-		);
-	else
-		return 0;
-}
-
-/*
- * Iterates until the end of a Collection.
- * Assumes that *pos is exactly at the beginning of a Collection.
- * Skips all nested Collection, i.e. iterates until the end of current level Collection.
- *
- * The return value is non-0 when an end of current Collection is found,
- * 0 when error is occurred (broken Descriptor, end of a Collection is found before its begin,
- *  or no Collection is found at all).
- */
-static int hid_iterate_over_collection(const uint8_t *report_descriptor, uint32_t size, unsigned int *pos, int *data_len, int *key_size)
-{
-	int collection_level = 0;
-
-	while (*pos < size) {
-		int key = report_descriptor[*pos];
-		int key_cmd = key & 0xfc;
-
-		/* Determine data_len and key_size */
-		if (!get_hid_item_size(report_descriptor, size, *pos, data_len, key_size))
-			return 0; /* malformed report */
-
-		switch (key_cmd) {
-		case 0xa0: /* Collection 6.2.2.4 (Main) */
-			collection_level++;
-			break;
-		case 0xc0: /* End Collection 6.2.2.4 (Main) */
-			collection_level--;
-			break;
-		}
-
-		if (collection_level < 0) {
-			/* Broken descriptor or someone is using this function wrong,
-			 * i.e. should be called exactly at the collection start */
-			return 0;
-		}
-
-		if (collection_level == 0) {
-			/* Found it!
-			 * Also possible when called not at the collection start, but should not happen if used correctly */
-			return 1;
-		}
-
-		*pos += *data_len + *key_size;
-	}
-
-	return 0; /* Did not find the end of a Collection */
-}
-
-struct hid_usage_iterator {
-	unsigned int pos;
-	int usage_page_found;
-	unsigned short usage_page;
-};
-
-/*
- * Retrieves the device's Usage Page and Usage from the report descriptor.
- * The algorithm returns the current Usage Page/Usage pair whenever a new
- * Collection is found and a Usage Local Item is currently in scope.
- * Usage Local Items are consumed by each Main Item (See. 6.2.2.8).
- * The algorithm should give similar results as Apple's:
- *   https://developer.apple.com/documentation/iokit/kiohiddeviceusagepairskey?language=objc
- * Physical Collections are also matched (macOS does the same).
- *
- * This function can be called repeatedly until it returns non-0
- * Usage is found. pos is the starting point (initially 0) and will be updated
- * to the next search position.
- *
- * The return value is 0 when a pair is found.
- * 1 when finished processing descriptor.
- * -1 on a malformed report.
+ * Creates a record for each usage pair of the device matching the filter
+ * (NULL for all of them). Only the serial number and the usage are
+ * checked, the rest of the filter is up to the caller.
  */
-static int get_next_hid_usage(const uint8_t *report_descriptor, uint32_t size, struct hid_usage_iterator *ctx, unsigned short *usage_page, unsigned short *usage)
-{
-	int data_len, key_size;
-	int initial = ctx->pos == 0; /* Used to handle case where no top-level application collection is defined */
-
-	int usage_found = 0;
-
-	while (ctx->pos < size) {
-		int key = report_descriptor[ctx->pos];
-		int key_cmd = key & 0xfc;
-
-		/* Determine data_len and key_size */
-		if (!get_hid_item_size(report_descriptor, size, ctx->pos, &data_len, &key_size))
-			return -1; /* malformed report */
-
-		switch (key_cmd) {
-		case 0x4: /* Usage Page 6.2.2.7 (Global) */
-			ctx->usage_page = get_hid_report_bytes(report_descriptor, size, data_len, ctx->pos);
-			ctx->usage_page_found = 1;
-			break;
-
-		case 0x8: /* Usage 6.2.2.8 (Local) */
-			if (data_len == 4) { /* Usages 5.5 / Usage Page 6.2.2.7 */
-				ctx->usage_page = get_hid_report_bytes(report_descriptor, size, 2, ctx->pos + 2);
-				ctx->usage_page_found = 1;
-				*usage = get_hid_report_bytes(report_descriptor, size, 2, ctx->pos);
-				usage_found = 1;
-			}
-			else {
-				*usage = get_hid_report_bytes(report_descriptor, size, data_len, ctx->pos);
-				usage_found = 1;
-			}
-			break;
-
-		case 0xa0: /* Collection 6.2.2.4 (Main) */
-			if (!hid_iterate_over_collection(report_descriptor, size, &ctx->pos, &data_len, &key_size)) {
-				return -1;
-			}
-
-			/* A pair is valid - to be reported when Collection is found */
-			if (usage_found && ctx->usage_page_found) {
-				*usage_page = ctx->usage_page;
-				return 0;
-			}
-
-			break;
-		}
-
-		/* Skip over this key and its associated data */
-		ctx->pos += data_len + key_size;
-	}
-
-	/* If no top-level application collection is found and usage page/usage pair is found, pair is valid
-	   https://docs.microsoft.com/en-us/windows-hardware/drivers/hid/top-level-collections */
-	if (initial && usage_found && ctx->usage_page_found) {
-			*usage_page = ctx->usage_page;
-			return 0; /* success */
-	}
-
-	return 1; /* finished processing */
-}
-
-static struct hid_device_info *create_device_info(const struct usb_device_info *udi, const char *path, const struct usb_ctl_report_desc *ucrd)
+static struct hid_device_info *create_device_info(const struct usb_device_info *udi, const char *path, const struct usb_ctl_report_desc *ucrd, const struct hid_enumerate_filter *filter)
 {
 	struct hid_device_info *root;
 	struct hid_device_info *end;
+	struct hid_device_info info; /* the fields shared by all of the records */
+	int fields;
+	struct report_layout_summary summary;
+	struct report_layout_usage_pair no_usage;
+	const struct report_layout_usage_pair *usage_pairs;
+	size_t num_usage_pairs, i;
 
-	root = (struct hid_device_info *) calloc(1, sizeof(struct hid_device_info));
-	if (!root)
-		return NULL;
-
-	end = root;
-
-	/* Path */
-	end->path = (path) ? strdup(path) : NULL;
+	fields = enumerate_filter_fields(filter);
+	memset(&info, 0, sizeof(info));
 
 	/* Vendor Id */
-	end->vendor_id = udi->udi_vendorNo;
+	info.vendor_id = udi->udi_vendorNo;
 
 	/* Product Id */
-	end->product_id = udi->udi_productNo;
+	info.product_id = udi->udi_productNo;
 
 	/* Serial Number */
-	end->serial_number = utf8_to_wchar_t(udi->udi_serial);
+	if (fields & HID_API_DEVICE_INFO_SERIAL_NUMBER)
+		info.serial_number = utf8_to_wchar_t(udi->udi_serial);
+
+	if (!enumerate_filter_match_serial_number(filter, info.serial_number)) {
+		free(info.serial_number);
+		return NULL;
+	}
 
 	/* Release Number */
-	end->release_number = udi->udi_releaseNo;
+	info.release_number = udi->udi_releaseNo;
 
 	/* Manufacturer String */
-	end->manufacturer_string = utf8_to_wchar_t(udi->udi_vendor);
+	if (fields & HID_API_DEVICE_INFO_MANUFACTURER_STRING)
+		info.manufacturer_string = utf8_to_wchar_t(udi->udi_vendor);
 
 	/* Product String */
-	end->product_string = utf8_to_wchar_t(udi->udi_product);
-
-	/* Usage Page */
-	end->usage_page = 0;
-
-	/* Usage */
-	end->usage = 0;
+	if (fields & HID_API_DEVICE_INFO_PRODUCT_STRING)
+		info.product_string = utf8_to_wchar_t(udi->udi_product);
 
 	/* Interface Number */
-	end->interface_number = -1;
-
-	/* Next Device Info */
-	end->next = NULL;
+	info.interface_number = -1;
 
 	/* Bus Type */
-	end->bus_type = HID_API_BUS_USB;
+	info.bus_type = HID_API_BUS_USB;
 
-	if (ucrd) {
-		uint16_t page;
-		uint16_t usage;
-		struct hid_usage_iterator usage_iterator;
+	/*
+	 * Parse the usage pairs out of the report descriptor.
+	 * Without one, there is a single record with 0/0.
+	 */
+	memset(&summary, 0, sizeof(summary));
+	if (ucrd)
+		report_layout_scan(ucrd->ucrd_data, (size_t) ucrd->ucrd_size, &summary);
+	if (summary.num_usage_pairs > 0) {
+		usage_pairs = summary.usage_pairs;
+		num_usage_pairs = summary.num_usage_pairs;
+	}
+	else {
+		no_usage.usage_page = 0;
+		no_usage.usage = 0;
+		usage_pairs = &no_usage;
+		num_usage_pairs = 1;
+	}
 
-		page = usage = 0;
-		memset(&usage_iterator, 0, sizeof(usage_iterator));
+	root = end = NULL;
 
-		/*
-		 * Parse the first usage and usage page
-		 * out of the report descriptor.
-		 */
-		if (get_next_hid_usage(ucrd->ucrd_data, ucrd->ucrd_size, &usage_iterator, &page, &usage) == 0) {
-			end->usage_page = page;
-			end->usage = usage;
-		}
+	/*
+	 * Create a record for each usage pair matching the filter.
+	 */
+	for (i = 0; i < num_usage_pairs; i++) {
+		struct hid_device_info *node;
 
-		/*
-		 * Parse any additional usage and usage pages
-		 * out of the report descriptor.
-		 */
-		while (get_next_hid_usage(ucrd->ucrd_data, ucrd->ucrd_size, &usage_iterator, &page, &usage) == 0) {
-			/* Create new record for additional usage pairs */
-			struct hid_device_info *node = (struct hid_device_info *) calloc(1, sizeof(struct hid_device_info));
-
-			if (!node)
-				continue;
-
-			/* Update fields */
-			node->path = (end->path) ? strdup(end->path) : NULL;
-			node->vendor_id = end->vendor_id;
-			node->product_id = end->product_id;
-			node->serial_number = (end->serial_number) ? wcsdup(end->serial_number) : NULL;
-			node->release_number = end->release_number;
-			node->manufacturer_string = (end->manufacturer_string) ? wcsdup(end->manufacturer_string) : NULL;
-			node->product_string = (end->product_string) ? wcsdup(end->product_string) : NULL;
-			node->usage_page = page;
-			node->usage = usage;
-			node->interface_number = end->interface_number;
-			node->next = NULL;
-			node->bus_type = end->bus_type;
-
-			/* Insert node */
+		if (!enumerate_filter_match_usage(filter, usage_pairs[i].usage_page, usage_pairs[i].usage))
+			continue;
+
+		node = (struct hid_device_info *) calloc(1, sizeof(struct hid_device_info));
+		if (!node)
+			break;
+
+		/* Update fields */
+		*node = info;
+		node->path = (path) ? strdup(path) : NULL;
+		node->serial_number = (info.serial_number) ? wcsdup(info.serial_number) : NULL;
+		node->manufacturer_string = (info.manufacturer_string) ? wcsdup(info.manufacturer_string) : NULL;
+		node->product_string = (info.product_string) ? wcsdup(info.product_string) : NULL;
+		node->usage_page = usage_pairs[i].usage_page;
+		node->usage = usage_pairs[i].usage;
+		node->next = NULL;
+
+		/* Insert node */
+		if (!root)
+			root = node;
+		else
 			end->next = node;
-			end = node;
-		}
+		end = node;
 	}
 
+	free(summary.usage_pairs);
+	free(info.serial_number);
+	free(info.manufacturer_string);
+	free(info.product_string);
+
 	return root;
 }
 
@@ -552,10 +355,10 @@ static void hid_enumerate_callback(const struct usb_device_info *udi, void *data
 
 	hed = (struct hid_enumerate_data *) data;
 
-	if (hed->vendor_id != 0 && hed->vendor_id != udi->udi_vendorNo)
+	if (hed->filter->vendor_id != 0 && hed->filter->vendor_id != udi->udi_vendorNo)
 		return;
 
-	if (hed->product_id != 0 && hed->product_id != udi->udi_productNo)
+	if (hed->filter->product_id != 0 && hed->filter->product_id != udi->udi_productNo)
 		return;
 
 	for (size_t i = 0; i < USB_MAX_DEVNAMES; i++) {
@@ -591,7 +394,7 @@ static void hid_enumerate_callback(const struct usb_device_info *udi, void *data
 			use_ucrd = 0;
 		}
 
-		node = create_device_info(udi, parent_dev, (use_ucrd) ? &ucrd : NULL);
+		node = create_device_info(udi, parent_dev, (use_ucrd) ? &ucrd : NULL, hed->filter);
 		if (!node)
 			continue;
 
@@ -699,6 +502,23 @@ int HID_API_EXPORT HID_API_CALL hid_exit(void)
 }
 
 struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	return hid_enumerate_fields(vendor_id, product_id, HID_API_DEVICE_INFO_ALL_STRINGS);
+}
+
+struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_fields(unsigned short vendor_id, unsigned short product_id, int fields)
+{
+	struct hid_enumerate_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.fields = fields;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_ex(const struct hid_enumerate_filter *filter)
 {
 	int res;
 	int drvctl;
@@ -710,6 +530,21 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 	if (res == -1)
 		return NULL;
 
+	if (!filter) {
+		register_global_error("hid_enumerate_ex: filter is NULL");
+		return NULL;
+	}
+
+	hed.root = NULL;
+	hed.end = NULL;
+	hed.filter = filter;
+
+	/* All of the uhid devices are USB devices without an interface number */
+	if (((filter->match & HID_API_FILTER_BUS_TYPE) && filter->bus_type != HID_API_BUS_USB) ||
+	    ((filter->match & HID_API_FILTER_INTERFACE_NUMBER) && filter->interface_number != -1)) {
+		goto end;
+	}
+
 	drvctl = open(DRVCTLDEV, O_RDONLY | O_CLOEXEC);
 	if (drvctl == -1) {
 		register_global_error_format("failed to open drvctl: %s", strerror(errno));
@@ -719,11 +554,7 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 	len = 0;
 	walk_device_tree(drvctl, "", 0, arr, &len, is_usb_controller);
 
-	hed.root = NULL;
-	hed.end = NULL;
 	hed.drvctl = drvctl;
-	hed.vendor_id = vendor_id;
-	hed.product_id = product_id;
 
 	for (size_t i = 0; i < len; i++) {
 		char devpath[USB_MAX_DEVNAMELEN];
@@ -754,6 +585,17 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 
 	close(drvctl);
 
+end:
+	if (hed.root == NULL) {
+		if (filter->match != 0 || filter->serial_number_prefix) {
+			register_global_error("No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
+			register_global_error("No HID devices found in the system.");
+		} else {
+			register_global_error("No HID devices with requested VID/PID found in the system.");
+		}
+	}
+
 	return hed.root;
 }
 
@@ -770,6 +612,52 @@ void HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *de
 	}
 }
 
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable)
+{
+	register_global_error(NULL);
+
+	if (!enable)
+		return 0;
+
+	register_global_error("hid_set_enumeration_cache: not supported by uhid");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_report_descriptor_cache(int enable, const char *path)
+{
+	(void)path;
+
+	register_global_error(NULL);
+
+	if (!enable)
+		return 0;
+
+	register_global_error("hid_set_report_descriptor_cache: not supported by uhid");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	(void)vendor_id;
+	(void)product_id;
+	(void)events;
+	(void)flags;
+	(void)callback;
+	(void)user_data;
+	(void)callback_handle;
+
+	register_global_error("hid_hotplug_register_callback: not supported by uhid");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	(void)callback_handle;
+
+	register_global_error("hid_hotplug_deregister_callback: not supported by uhid");
+	return -1;
+}
+
 HID_API_EXPORT hid_device * HID_API_CALL hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
 {
 	struct hid_device_info *devs;
@@ -943,6 +831,54 @@ int HID_API_EXPORT HID_API_CALL hid_read_timeout(hid_device *dev, unsigned char
 	return n;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_read_timestamped(hid_device *dev, unsigned char *data, size_t length, int milliseconds, uint64_t *timestamp)
+{
+	int res = hid_read_timeout(dev, data, length, milliseconds);
+
+	/* The kernel doesn't tell when it queued the report,
+	   so this is as close as it gets */
+	if (res > 0 && timestamp)
+		*timestamp = get_timestamp();
+
+	return res;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read_many(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds)
+{
+	size_t i;
+	int res;
+
+	if (!reports || !count) {
+		register_device_read_error(dev, "Zero buffer/length");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!reports[i].data || !reports[i].length) {
+			register_device_read_error(dev, "Zero buffer/length");
+			return -1;
+		}
+	}
+
+	/* The count of reports read is returned as an int */
+	if (count > INT_MAX)
+		count = INT_MAX;
+
+	/* Only the first report is waited for. The rest are taken
+	   only if they are already queued by the uhid driver. */
+	for (i = 0; i < count; i++) {
+		res = hid_read_timeout(dev, reports[i].data, reports[i].length, (i == 0)? milliseconds: 0);
+		if (res < 0)
+			return (i == 0)? -1: (int)i;
+		if (res == 0)
+			break;
+		reports[i].bytes_read = (size_t)res;
+		reports[i].timestamp = get_timestamp();
+	}
+
+	return (int)i;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, (dev->blocking) ? -1 : 0);
@@ -961,6 +897,53 @@ int HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonbloc
 	return 0;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_set_input_queue(hid_device *dev, size_t max_reports, hid_input_queue_policy policy)
+{
+	(void)max_reports;
+	(void)policy;
+
+	/* Input reports are queued by the uhid kernel driver */
+	errno = ENOSYS;
+	register_device_error(dev, "hid_set_input_queue: not supported by uhid");
+
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_input_callback(hid_device *dev, hid_input_callback callback, void *user_data)
+{
+	(void)callback;
+	(void)user_data;
+
+	errno = ENOSYS;
+	register_device_error(dev, "hid_set_input_callback: not supported by uhid");
+
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_pollable_fd(hid_device *dev)
+{
+	/* hid_read() polls all of the uhid devices of the HID device,
+	   one per Report ID, which a single fd can't stand in for */
+	if (dev->poll_handles_length != 1) {
+		errno = ENOSYS;
+		register_device_error(dev, "hid_get_pollable_fd: device has more than one uhid device");
+		return -1;
+	}
+
+	return dev->poll_handles[0].fd;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_input_reports_dropped(hid_device *dev, size_t *dropped, int reset)
+{
+	(void)dropped;
+	(void)reset;
+
+	errno = ENOSYS;
+	register_device_error(dev, "hid_get_input_reports_dropped: not supported by uhid");
+
+	return -1;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
 {
 	return set_report(dev, data, length, UHID_FEATURE_REPORT);
@@ -990,6 +973,7 @@ void HID_API_EXPORT HID_API_CALL hid_close(hid_device *dev)
 	free(dev->last_read_error_str);
 
 	hid_free_enumeration(dev->device_info);
+	report_layout_free(dev->report_layout);
 
 	for (size_t i = 0; i < dev->poll_handles_length; i++)
 		close(dev->poll_handles[i].fd);
@@ -1085,7 +1069,7 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_get_device_info(hid_dev
 
 	use_ucrd = (ioctl(dev->device_handle, USB_GET_REPORT_DESC, &ucrd) != -1);
 
-	hdi = create_device_info(&udi, dev->path, (use_ucrd) ? &ucrd : NULL);
+	hdi = create_device_info(&udi, dev->path, (use_ucrd) ? &ucrd : NULL, NULL);
 	if (!hdi) {
 		register_device_error(dev, "failed to create device info");
 		return NULL;
@@ -1185,6 +1169,50 @@ int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char
 	return (int) buf_size;
 }
 
+struct hid_report_layout HID_API_EXPORT * HID_API_CALL hid_parse_report_descriptor(const unsigned char *descriptor, size_t length)
+{
+	struct hid_report_layout *layout;
+	const char *error;
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		register_global_error(error);
+		return NULL;
+	}
+
+	register_global_error(NULL);
+	return layout;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_free_report_layout(struct hid_report_layout *layout)
+{
+	report_layout_free(layout);
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	const char *error;
+	int res;
+
+	if (dev->report_layout) {
+		register_device_error(dev, NULL);
+		return dev->report_layout;
+	}
+
+	res = hid_get_report_descriptor(dev, descriptor, sizeof(descriptor));
+	if (res < 0)
+		return NULL;
+
+	dev->report_layout = report_layout_parse(descriptor, (size_t)res, &error);
+	if (!dev->report_layout) {
+		register_device_error(dev, error);
+		return NULL;
+	}
+
+	return dev->report_layout;
+}
+
 HID_API_EXPORT const wchar_t* HID_API_CALL hid_error(hid_device *dev)
 {
 	if (dev) {
@@ -59,6 +59,11 @@ typedef LONG NTSTATUS;
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+
+#include "../core/hidapi_report_layout.c"
+#include "../core/hidapi_timestamp.c"
+#include "../core/hidapi_enumerate_filter.c"
 
 /* MSVC secure CRT (VS2005+) provides swprintf_s/wcsncpy_s.
    Older MSVC and GCC/MinGW/Cygwin use the classic variants. */
@@ -205,6 +210,8 @@ struct hid_device_ {
 		OVERLAPPED write_ol;
 		struct hid_device_info* device_info;
 		DWORD write_timeout_ms;
+		/* See hid_get_report_layout(), compiled on the first call */
+		struct hid_report_layout *report_layout;
 };
 
 static hid_device *new_hid_device()
@@ -231,6 +238,7 @@ static hid_device *new_hid_device()
 	memset(&dev->write_ol, 0, sizeof(dev->write_ol));
 	dev->write_ol.hEvent = CreateEvent(NULL, FALSE, FALSE /*initial state f=nonsignaled*/, NULL);
 	dev->device_info = NULL;
+	dev->report_layout = NULL;
 	dev->write_timeout_ms = 1000;
 
 	return dev;
@@ -249,6 +257,7 @@ static void free_hid_device(hid_device *dev)
 	free(dev->feature_buf);
 	free(dev->read_buf);
 	hid_free_enumeration(dev->device_info);
+	report_layout_free(dev->report_layout);
 	free(dev);
 }
 
@@ -522,7 +531,7 @@ static void hid_internal_get_usb_info(struct hid_device_info* dev, DEVINST dev_n
 	}
 
 	/* Try to get USB device manufacturer string if not provided by HidD_GetManufacturerString. */
-	if (wcslen(dev->manufacturer_string) == 0) {
+	if (dev->manufacturer_string && wcslen(dev->manufacturer_string) == 0) {
 		wchar_t* manufacturer_string = (wchar_t *)hid_internal_get_devnode_property(dev_node, &DEVPKEY_Device_Manufacturer, DEVPROP_TYPE_STRING);
 		if (manufacturer_string) {
 			free(dev->manufacturer_string);
@@ -531,7 +540,7 @@ static void hid_internal_get_usb_info(struct hid_device_info* dev, DEVINST dev_n
 	}
 
 	/* Try to get USB device serial number if not provided by HidD_GetSerialNumberString. */
-	if (wcslen(dev->serial_number) == 0) {
+	if (dev->serial_number && wcslen(dev->serial_number) == 0) {
 		DEVINST usb_dev_node = dev_node;
 		if (dev->interface_number != -1) {
 			/* Get devnode parent to reach out composite parent USB device.
@@ -580,7 +589,7 @@ end:
 */
 static void hid_internal_get_ble_info(struct hid_device_info* dev, DEVINST dev_node)
 {
-	if (wcslen(dev->manufacturer_string) == 0) {
+	if (dev->manufacturer_string && wcslen(dev->manufacturer_string) == 0) {
 		/* Manufacturer Name String (UUID: 0x2A29) */
 		wchar_t* manufacturer_string = (wchar_t *)hid_internal_get_devnode_property(dev_node, (const DEVPROPKEY*)&PKEY_DeviceInterface_Bluetooth_Manufacturer, DEVPROP_TYPE_STRING);
 		if (manufacturer_string) {
@@ -589,7 +598,7 @@ static void hid_internal_get_ble_info(struct hid_device_info* dev, DEVINST dev_n
 		}
 	}
 
-	if (wcslen(dev->serial_number) == 0) {
+	if (dev->serial_number && wcslen(dev->serial_number) == 0) {
 		/* Serial Number String (UUID: 0x2A25) */
 		wchar_t* serial_number = (wchar_t *)hid_internal_get_devnode_property(dev_node, (const DEVPROPKEY*)&PKEY_DeviceInterface_Bluetooth_DeviceAddress, DEVPROP_TYPE_STRING);
 		if (serial_number) {
@@ -598,7 +607,7 @@ static void hid_internal_get_ble_info(struct hid_device_info* dev, DEVINST dev_n
 		}
 	}
 
-	if (wcslen(dev->product_string) == 0) {
+	if (dev->product_string && wcslen(dev->product_string) == 0) {
 		/* Model Number String (UUID: 0x2A24) */
 		wchar_t* product_string = (wchar_t *)hid_internal_get_devnode_property(dev_node, (const DEVPROPKEY*)&PKEY_DeviceInterface_Bluetooth_ModelNumber, DEVPROP_TYPE_STRING);
 		if (!product_string) {
@@ -734,7 +743,8 @@ static wchar_t *hid_internal_UTF8toUTF16(const char *src)
 	return dst;
 }
 
-static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path, HANDLE handle)
+/* Returns NULL if the device doesn't match the filter (NULL for any device). */
+static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path, HANDLE handle, const struct hid_enumerate_filter *filter)
 {
 	struct hid_device_info *dev = NULL; /* return object */
 	HIDD_ATTRIBUTES attrib;
@@ -744,6 +754,7 @@ static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path,
 	ULONG len;
 	ULONG size;
 	hid_internal_detect_bus_type_result detect_bus_type_result;
+	int fields = enumerate_filter_fields(filter);
 
 	/* Create the record. */
 	dev = (struct hid_device_info*)calloc(1, sizeof(struct hid_device_info));
@@ -777,28 +788,43 @@ static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path,
 		HidD_FreePreparsedData(pp_data);
 	}
 
+	if (!enumerate_filter_match_usage(filter, dev->usage_page, dev->usage))
+		goto not_matching;
+
 	/* detect bus type before reading string descriptors */
 	detect_bus_type_result = hid_internal_detect_bus_type(path);
 	dev->bus_type = detect_bus_type_result.bus_type;
 
+	if (filter && (filter->match & HID_API_FILTER_BUS_TYPE) && filter->bus_type != dev->bus_type)
+		goto not_matching;
+
 	len = dev->bus_type == HID_API_BUS_USB ? MAX_STRING_WCHARS_USB : MAX_STRING_WCHARS;
 	string[len] = L'\0';
 	size = len * sizeof(wchar_t);
 
+	/* Each of the strings below costs a request to the device:
+	   the ones not asked for are left NULL (and skipped by the fallbacks below). */
+
 	/* Serial Number */
-	string[0] = L'\0';
-	HidD_GetSerialNumberString(handle, string, size);
-	dev->serial_number = _wcsdup(string);
+	if (fields & HID_API_DEVICE_INFO_SERIAL_NUMBER) {
+		string[0] = L'\0';
+		HidD_GetSerialNumberString(handle, string, size);
+		dev->serial_number = _wcsdup(string);
+	}
 
 	/* Manufacturer String */
-	string[0] = L'\0';
-	HidD_GetManufacturerString(handle, string, size);
-	dev->manufacturer_string = _wcsdup(string);
+	if (fields & HID_API_DEVICE_INFO_MANUFACTURER_STRING) {
+		string[0] = L'\0';
+		HidD_GetManufacturerString(handle, string, size);
+		dev->manufacturer_string = _wcsdup(string);
+	}
 
 	/* Product String */
-	string[0] = L'\0';
-	HidD_GetProductString(handle, string, size);
-	dev->product_string = _wcsdup(string);
+	if (fields & HID_API_DEVICE_INFO_PRODUCT_STRING) {
+		string[0] = L'\0';
+		HidD_GetProductString(handle, string, size);
+		dev->product_string = _wcsdup(string);
+	}
 
 	/* now, the portion that depends on string descriptors */
 	switch (dev->bus_type) {
@@ -819,10 +845,39 @@ static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path,
 		break;
 	}
 
+	/* The interface number and the serial number of USB devices
+	   may come from the devnode properties, so these are checked last. */
+	if (filter && (filter->match & HID_API_FILTER_INTERFACE_NUMBER) && filter->interface_number != dev->interface_number)
+		goto not_matching;
+
+	if (!enumerate_filter_match_serial_number(filter, dev->serial_number))
+		goto not_matching;
+
 	return dev;
+
+not_matching:
+	hid_free_enumeration(dev);
+	return NULL;
 }
 
 struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	return hid_enumerate_fields(vendor_id, product_id, HID_API_DEVICE_INFO_ALL_STRINGS);
+}
+
+struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_fields(unsigned short vendor_id, unsigned short product_id, int fields)
+{
+	struct hid_enumerate_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.fields = fields;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_ex(const struct hid_enumerate_filter *filter)
 {
 	struct hid_device_info *root = NULL; /* return object */
 	struct hid_device_info *cur_dev = NULL;
@@ -836,6 +891,11 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 		return NULL;
 	}
 
+	if (!filter) {
+		register_global_error(L"hid_enumerate_ex: filter is NULL");
+		return NULL;
+	}
+
 	/* Retrieve HID Interface Class GUID
 	   https://docs.microsoft.com/windows-hardware/drivers/install/guid-devinterface-hid */
 	HidD_GetHidGuid(&interface_class_guid);
@@ -891,11 +951,11 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 
 		/* Check the VID/PID to see if we should add this
 		   device to the enumeration list. */
-		if ((vendor_id == 0x0 || attrib.VendorID == vendor_id) &&
-		    (product_id == 0x0 || attrib.ProductID == product_id)) {
+		if ((filter->vendor_id == 0x0 || attrib.VendorID == filter->vendor_id) &&
+		    (filter->product_id == 0x0 || attrib.ProductID == filter->product_id)) {
 
-			/* VID/PID match. Create the record. */
-			struct hid_device_info *tmp = hid_internal_get_device_info(device_interface, device_handle);
+			/* VID/PID match. Create the record, if the rest of the filter matches. */
+			struct hid_device_info *tmp = hid_internal_get_device_info(device_interface, device_handle, filter);
 
 			if (tmp == NULL) {
 				goto cont_close;
@@ -915,7 +975,9 @@ cont_close:
 	}
 
 	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
+		if (filter->match != 0 || filter->serial_number_prefix) {
+			register_global_error(L"No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
 			register_global_error(L"No HID devices found in the system.");
 		} else {
 			register_global_error(L"No HID devices with requested VID/PID found in the system.");
@@ -943,6 +1005,52 @@ void  HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *d
 	}
 }
 
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable)
+{
+	register_global_error(NULL);
+
+	if (!enable)
+		return 0;
+
+	register_global_error(L"hid_set_enumeration_cache: not supported on Windows");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_report_descriptor_cache(int enable, const char *path)
+{
+	(void)path;
+
+	register_global_error(NULL);
+
+	if (!enable)
+		return 0;
+
+	register_global_error(L"hid_set_report_descriptor_cache: not supported on Windows");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	(void)vendor_id;
+	(void)product_id;
+	(void)events;
+	(void)flags;
+	(void)callback;
+	(void)user_data;
+	(void)callback_handle;
+
+	register_global_error(L"hid_hotplug_register_callback: not supported on Windows");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	(void)callback_handle;
+
+	register_global_error(L"hid_hotplug_deregister_callback: not supported on Windows");
+	return -1;
+}
+
 HID_API_EXPORT hid_device * HID_API_CALL hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
 {
 	/* TODO: Merge this functions with the Linux version. This function should be platform independent. */
@@ -1056,7 +1164,7 @@ HID_API_EXPORT hid_device * HID_API_CALL hid_open_path(const char *path)
 	dev->input_report_length = caps.InputReportByteLength;
 	dev->feature_report_length = caps.FeatureReportByteLength;
 	dev->read_buf = (char*) malloc(dev->input_report_length);
-	dev->device_info = hid_internal_get_device_info(interface_path, dev->device_handle);
+	dev->device_info = hid_internal_get_device_info(interface_path, dev->device_handle, NULL);
 
 end_of_function:
 	free(interface_path);
@@ -1245,6 +1353,54 @@ end_of_function:
 	return (int) copy_len;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_read_timestamped(hid_device *dev, unsigned char *data, size_t length, int milliseconds, uint64_t *timestamp)
+{
+	int res = hid_read_timeout(dev, data, length, milliseconds);
+
+	/* The HID class driver doesn't tell when it queued the report,
+	   so this is as close as it gets */
+	if (res > 0 && timestamp)
+		*timestamp = get_timestamp();
+
+	return res;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read_many(hid_device *dev, struct hid_input_report_buffer *reports, size_t count, int milliseconds)
+{
+	size_t i;
+	int res;
+
+	if (!reports || !count) {
+		register_string_error_to_buffer(&dev->last_read_error_str, L"Zero buffer/length");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!reports[i].data || !reports[i].length) {
+			register_string_error_to_buffer(&dev->last_read_error_str, L"Zero buffer/length");
+			return -1;
+		}
+	}
+
+	/* The count of reports read is returned as an int */
+	if (count > INT_MAX)
+		count = INT_MAX;
+
+	/* Only the first report is waited for. The rest are taken
+	   only if they are already queued by the HID class driver. */
+	for (i = 0; i < count; i++) {
+		res = hid_read_timeout(dev, reports[i].data, reports[i].length, (i == 0)? milliseconds: 0);
+		if (res < 0)
+			return (i == 0)? -1: (int)i;
+		if (res == 0)
+			break;
+		reports[i].bytes_read = (size_t)res;
+		reports[i].timestamp = get_timestamp();
+	}
+
+	return (int)i;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
@@ -1263,6 +1419,53 @@ int HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonbloc
 	return 0; /* Success */
 }
 
+int HID_API_EXPORT HID_API_CALL hid_set_input_queue(hid_device *dev, size_t max_reports, hid_input_queue_policy policy)
+{
+	/* Input reports are queued by the HID class driver, in a ring
+	   buffer which always discards the oldest report when full */
+	if (policy != HID_API_INPUT_QUEUE_DROP_OLDEST) {
+		register_string_error(dev, L"hid_set_input_queue: only HID_API_INPUT_QUEUE_DROP_OLDEST is supported on Windows");
+		return -1;
+	}
+
+	if ((size_t)(ULONG)max_reports != max_reports) {
+		register_string_error(dev, L"hid_set_input_queue: max_reports is too large");
+		return -1;
+	}
+
+	if (!HidD_SetNumInputBuffers(dev->device_handle, (ULONG)max_reports)) {
+		register_winapi_error(dev, L"HidD_SetNumInputBuffers");
+		return -1;
+	}
+
+	register_string_error(dev, NULL);
+	return 0;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_input_callback(hid_device *dev, hid_input_callback callback, void *user_data)
+{
+	(void)callback;
+	(void)user_data;
+
+	register_string_error(dev, L"hid_set_input_callback: not supported on Windows");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_pollable_fd(hid_device *dev)
+{
+	register_string_error(dev, L"hid_get_pollable_fd: not supported on Windows");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_input_reports_dropped(hid_device *dev, size_t *dropped, int reset)
+{
+	(void)dropped;
+	(void)reset;
+
+	register_string_error(dev, L"hid_get_input_reports_dropped: not supported on Windows, the input report queue is kept by the HID class driver");
+	return -1;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
 {
 	BOOL res = FALSE;
@@ -1594,6 +1797,56 @@ int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char
 	return res;
 }
 
+struct hid_report_layout HID_API_EXPORT * HID_API_CALL hid_parse_report_descriptor(const unsigned char *descriptor, size_t length)
+{
+	struct hid_report_layout *layout;
+	const char *error;
+	wchar_t *error_str;
+
+	layout = report_layout_parse(descriptor, length, &error);
+	if (!layout) {
+		error_str = hid_internal_UTF8toUTF16(error);
+		register_global_error(error_str);
+		free(error_str);
+		return NULL;
+	}
+
+	register_global_error(NULL);
+	return layout;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_free_report_layout(struct hid_report_layout *layout)
+{
+	report_layout_free(layout);
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	unsigned char descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	const char *error;
+	wchar_t *error_str;
+	int res;
+
+	if (dev->report_layout) {
+		register_string_error(dev, NULL);
+		return dev->report_layout;
+	}
+
+	res = hid_get_report_descriptor(dev, descriptor, sizeof(descriptor));
+	if (res < 0)
+		return NULL;
+
+	dev->report_layout = report_layout_parse(descriptor, (size_t)res, &error);
+	if (!dev->report_layout) {
+		error_str = hid_internal_UTF8toUTF16(error);
+		register_string_error(dev, error_str);
+		free(error_str);
+		return NULL;
+	}
+
+	return dev->report_layout;
+}
+
 HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
 {
 	if (dev) {